@@ -3,6 +3,7 @@
 #include "g_levellocals.h"
 #include "d_event.h"
 #include "v_video.h"
+#include "hw_cpulightmapper.h"
 
 void G_SetMap(const char* mapname, int mode);
 void D_SingleTick();
@@ -70,6 +71,26 @@ void LightmapBuildCmdlet::OnCommand(FArgs args)
 
 		TArray<LightmapTile*> tiles;
 
+		if (args.CheckParm("-cpu", 0))
+		{
+			// Bake every tile so that the lump can be written without reading anything back from a GPU
+			for (auto& e : level.levelMesh->Lightmap.Tiles)
+				tiles.Push(&e);
+
+			CPULightmapper lightmapper(level.levelMesh);
+			int threadsArg = args.CheckParm("-threads", 0);
+			if (threadsArg && threadsArg + 1 < args.NumArgs())
+				lightmapper.SetThreadCount(atoi(args.GetArg(threadsArg + 1)));
+			lightmapper.Raytrace(tiles);
+
+			Printf("Baked %u pixels in %.3f ms\n", lightmapper.GetPixelCount(), lightmapper.GetBakeTimeMS());
+			Printf("Finished baking map.\n");
+			level.levelMesh->SaveLightmapLump(level, false);
+
+			Printf("Lightmap build complete.\n");
+			return;
+		}
+
 		while (stats.tiles.dirty > 0)
 		{
 			tiles.Clear();
@@ -101,6 +122,8 @@ void LightmapBuildCmdlet::OnCommand(FArgs args)
 void LightmapBuildCmdlet::OnPrintHelp()
 {
 	Printf(TEXTCOLOR_ORANGE "lightmap build " TEXTCOLOR_CYAN "[map name]" TEXTCOLOR_NORMAL " - Bakes all the lightmap lights and stores the result in a LIGHTMAP lump\n");
+	Printf("    " TEXTCOLOR_CYAN "-cpu" TEXTCOLOR_NORMAL " - Bake on the CPU instead of using the GPU\n");
+	Printf("    " TEXTCOLOR_CYAN "-threads <count>" TEXTCOLOR_NORMAL " - Number of threads the CPU baker uses (default is one per core)\n");
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -57,6 +57,7 @@
 #include "base64.h"
 #include "vm.h"
 #include "i_interface.h"
+#include "superfasthash.h"
 
 using namespace FileSys;
 
@@ -118,6 +119,198 @@ const char *UnicodeToString(const char *cc)
 	return &out[0];
 }
 
+//==========================================================================
+//
+// FBinaryWriter :: Key
+//
+//==========================================================================
+
+void FBinaryWriter::Key(const char *k)
+{
+	size_t len = strlen(k);
+	unsigned hash = SuperFastHash(k, len);
+	unsigned mask = mKeyBuckets.Size() - 1;
+
+	unsigned slot;
+	for (slot = hash & mask; mKeyBuckets[slot] >= 0; slot = (slot + 1) & mask)
+	{
+		int index = mKeyBuckets[slot];
+		if (mKeyHashes[index] == hash && !strcmp(&mKeyText[mKeyOffsets[index]], k))
+		{
+			Token(BST_Key);
+			VarUint(index);
+			return;
+		}
+	}
+
+	int index = mKeyOffsets.Size();
+	mKeyOffsets.Push(mKeyText.Size());
+	mKeyHashes.Push(hash);
+	unsigned pos = mKeyText.Reserve(unsigned(len + 1));
+	memcpy(&mKeyText[pos], k, len + 1);
+	mKeyBuckets[slot] = index;
+
+	if (mKeyOffsets.Size() * 2 > mKeyBuckets.Size())
+	{
+		mKeyBuckets.Resize(mKeyBuckets.Size() * 2);
+		for (auto &b : mKeyBuckets) b = -1;
+		mask = mKeyBuckets.Size() - 1;
+		for (unsigned i = 0; i < mKeyHashes.Size(); i++)
+		{
+			for (slot = mKeyHashes[i] & mask; mKeyBuckets[slot] >= 0; slot = (slot + 1) & mask) {}
+			mKeyBuckets[slot] = i;
+		}
+	}
+
+	Token(BST_NewKey);
+	Text(k, len);
+}
+
+//==========================================================================
+//
+// FReader :: ParseBinary
+//
+// Builds the same document that parsing the JSON text would have given.
+// Strings are not copied, they point into the reader's copy of the data.
+//
+//==========================================================================
+
+struct FBinaryParser
+{
+	const uint8_t *p, *end;
+	rapidjson::Document::AllocatorType &alloc;
+	struct FKey
+	{
+		const char *text;
+		unsigned len;
+	};
+	TArray<FKey> keys;
+
+	bool VarUint(uint64_t &v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7)
+		{
+			uint8_t b = *p++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool Text(const char *&text, unsigned &len)
+	{
+		uint64_t l;
+		if (!VarUint(l) || l >= uint64_t(end - p)) return false;
+		text = (const char *)p;
+		len = unsigned(l);
+		p += l;
+		return *p++ == 0;
+	}
+
+	bool Value(rapidjson::Value &value, int token, int depth)
+	{
+		uint64_t v;
+		const char *text;
+		unsigned len;
+
+		switch (token)
+		{
+		case BST_Null:
+			value.SetNull();
+			return true;
+
+		case BST_False:
+		case BST_True:
+			value.SetBool(token == BST_True);
+			return true;
+
+		case BST_Int:
+			if (!VarUint(v)) return false;
+			value.SetInt64(int64_t(v >> 1) ^ -int64_t(v & 1));
+			return true;
+
+		case BST_Uint:
+			if (!VarUint(v)) return false;
+			value.SetUint64(v);
+			return true;
+
+		case BST_Double:
+		{
+			if (end - p < (ptrdiff_t)sizeof(double)) return false;
+			double d;
+			memcpy(&d, p, sizeof(d));
+			p += sizeof(d);
+			value.SetDouble(d);
+			return true;
+		}
+
+		case BST_String:
+			if (!Text(text, len)) return false;
+			value.SetString(rapidjson::StringRef(text, len));
+			return true;
+
+		case BST_StartObject:
+			if (depth > 1000) return false;
+			value.SetObject();
+			while (p < end)
+			{
+				token = *p++;
+				if (token == BST_End) return true;
+
+				if (token == BST_NewKey)
+				{
+					if (!Text(text, len)) return false;
+					keys.Push({ text, len });
+				}
+				else if (token == BST_Key)
+				{
+					if (!VarUint(v) || v >= keys.Size()) return false;
+					text = keys[unsigned(v)].text;
+					len = keys[unsigned(v)].len;
+				}
+				else return false;
+
+				rapidjson::Value name(rapidjson::StringRef(text, len));
+				rapidjson::Value member;
+				if (p >= end || !Value(member, *p++, depth + 1)) return false;
+				value.AddMember(name, member, alloc);
+			}
+			return false;
+
+		case BST_StartArray:
+			if (depth > 1000) return false;
+			value.SetArray();
+			while (p < end)
+			{
+				token = *p++;
+				if (token == BST_End) return true;
+
+				rapidjson::Value element;
+				if (!Value(element, token, depth + 1)) return false;
+				value.PushBack(element, alloc);
+			}
+			return false;
+
+		default:
+			return false;
+		}
+	}
+};
+
+void FReader::ParseBinary(const char *buffer, size_t length)
+{
+	mBinaryData.Resize(unsigned(length));
+	memcpy(mBinaryData.Data(), buffer, length);
+
+	FBinaryParser parser = { (const uint8_t *)mBinaryData.Data() + sizeof(BinarySerializerMagic), (const uint8_t *)mBinaryData.Data() + length, mDoc.GetAllocator() };
+	if (parser.p >= parser.end || !parser.Value(mDoc, *parser.p++, 0))
+	{
+		Printf(TEXTCOLOR_RED "Corrupt binary serializer data\n");
+		mDoc.SetNull();
+	}
+}
+
 //==========================================================================
 //
 //
@@ -134,6 +327,23 @@ bool FSerializer::OpenWriter(bool pretty)
 	return true;
 }
 
+//==========================================================================
+//
+// Writes the compact binary form instead of JSON. OpenReader recognizes
+// it by itself.
+//
+//==========================================================================
+
+bool FSerializer::OpenBinaryWriter()
+{
+	if (w != nullptr || r != nullptr) return false;
+
+	mErrors = 0;
+	w = new FWriter(false, true);
+	BeginObject(nullptr);
+	return true;
+}
+
 //==========================================================================
 //
 //
@@ -772,11 +982,7 @@ const char *FSerializer::GetOutput(unsigned *len)
 	if (isReading()) return nullptr;
 	WriteObjects();
 	EndObject();
-	if (len != nullptr)
-	{
-		*len = (unsigned)w->mOutString.GetSize();
-	}
-	return w->mOutString.GetString();
+	return w->GetOutput(len);
 }
 
 //==========================================================================
@@ -788,19 +994,34 @@ const char *FSerializer::GetOutput(unsigned *len)
 FCompressedBuffer FSerializer::GetCompressedOutput()
 {
 	if (isReading()) return{ 0,0,0,0,0,nullptr };
-	FCompressedBuffer buff;
 	WriteObjects();
 	EndObject();
+	unsigned len;
+	const char *output = w->GetOutput(&len);
+	return CompressBuffer(output, len);
+}
+
+//==========================================================================
+//
+// Deflates serialized output into a zip-compatible buffer. This does not
+// touch any serializer state so it may be called from a worker thread.
+// The text must be null-terminated.
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::CompressBuffer(const char *text, unsigned size)
+{
+	FCompressedBuffer buff;
 	buff.filename = nullptr;
-	buff.mSize = (unsigned)w->mOutString.GetSize();
-	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
+	buff.mSize = size;
+	buff.mCRC32 = crc32(0, (const Bytef*)text, buff.mSize);
 
 	uint8_t *compressbuf = new uint8_t[buff.mSize+1];
 
 	z_stream stream;
 	int err;
 
-	stream.next_in = (Bytef *)w->mOutString.GetString();
+	stream.next_in = (Bytef *)text;
 	stream.avail_in = (unsigned)buff.mSize;
 	stream.next_out = (Bytef*)compressbuf;
 	stream.avail_out = (unsigned)buff.mSize;
@@ -834,7 +1055,8 @@ FCompressedBuffer FSerializer::GetCompressedOutput()
 	}
 
 error:
-	memcpy(compressbuf, w->mOutString.GetString(), buff.mSize + 1);
+	memcpy(compressbuf, text, buff.mSize + 1);
+	buff.mBuffer = (char*)compressbuf;
 	buff.mCompressedSize = buff.mSize;
 	buff.mMethod = METHOD_STORED;
 	return buff;
@@ -25,6 +25,125 @@ struct FJSONObject
 	}
 };
 
+//==========================================================================
+//
+// Binary form of the same document. It is a stream of tokens that follows
+// the writer calls one to one:
+//
+//   - integers are zigzag (signed) or plain (unsigned) LEB128 varints,
+//   - doubles are stored as their raw 8 bytes,
+//   - strings are a varint length, the text and a terminating 0,
+//   - a key's text is only stored the first time. Later uses store the
+//     index it got then.
+//
+// The reader turns this back into a RapidJSON document, so everything that
+// reads values does not need to know which format it got.
+//
+//==========================================================================
+
+enum EBinarySerializerToken : uint8_t
+{
+	BST_Null,
+	BST_False,
+	BST_True,
+	BST_Int,
+	BST_Uint,
+	BST_Double,
+	BST_String,
+	BST_StartObject,
+	BST_StartArray,
+	BST_End,
+	BST_NewKey,
+	BST_Key,
+};
+
+// Starts with a 0 so that it can never be mistaken for JSON text.
+static const char BinarySerializerMagic[4] = { 0, 'B', 'S', '1' };
+
+inline bool IsBinarySerializerData(const char *buffer, size_t length)
+{
+	return length >= sizeof(BinarySerializerMagic) && !memcmp(buffer, BinarySerializerMagic, sizeof(BinarySerializerMagic));
+}
+
+struct FBinaryWriter
+{
+	TArray<uint8_t> mBuffer;
+	bool mTerminated = false;
+
+	// Interned keys, found through an open addressing hash of indices into mKeyOffsets.
+	TArray<char> mKeyText;
+	TArray<unsigned> mKeyOffsets;
+	TArray<unsigned> mKeyHashes;
+	TArray<int> mKeyBuckets;
+
+	FBinaryWriter()
+	{
+		mBuffer.Grow(1 << 16);
+		mBuffer.Resize(sizeof(BinarySerializerMagic));
+		memcpy(mBuffer.Data(), BinarySerializerMagic, sizeof(BinarySerializerMagic));
+		mKeyBuckets.Resize(1024);
+		for (auto &b : mKeyBuckets) b = -1;
+	}
+
+	void Token(EBinarySerializerToken t)
+	{
+		mBuffer.Push(t);
+	}
+
+	void VarUint(uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			mBuffer.Push(uint8_t(v | 0x80));
+			v >>= 7;
+		}
+		mBuffer.Push(uint8_t(v));
+	}
+
+	void VarInt(int64_t v)
+	{
+		VarUint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	}
+
+	void Text(const char *k, size_t len)
+	{
+		VarUint(len);
+		unsigned pos = mBuffer.Reserve(unsigned(len + 1));
+		memcpy(&mBuffer[pos], k, len);
+		mBuffer[pos + unsigned(len)] = 0;
+	}
+
+	void StartObject() { Token(BST_StartObject); }
+	void EndObject() { Token(BST_End); }
+	void StartArray() { Token(BST_StartArray); }
+	void EndArray() { Token(BST_End); }
+	void Key(const char *k);
+	void Null() { Token(BST_Null); }
+	void String(const char *k) { Token(BST_String); Text(k, strlen(k)); }
+	void Bool(bool k) { Token(k ? BST_True : BST_False); }
+	void Int64(int64_t k) { Token(BST_Int); VarInt(k); }
+	void Uint64(uint64_t k) { Token(BST_Uint); VarUint(k); }
+
+	void Double(double k)
+	{
+		Token(BST_Double);
+		unsigned pos = mBuffer.Reserve(sizeof(k));
+		memcpy(&mBuffer[pos], &k, sizeof(k));
+	}
+
+	const char *GetOutput(unsigned *len)
+	{
+		// Keep a 0 behind the data, like the text writer does.
+		if (!mTerminated)
+		{
+			mBuffer.Push(0);
+			mTerminated = true;
+		}
+		if (len != nullptr) *len = mBuffer.Size() - 1;
+		return (const char *)mBuffer.Data();
+	}
+};
+
 //==========================================================================
 //
 // some wrapper stuff to keep the RapidJSON dependencies out of the global headers.
@@ -39,21 +158,27 @@ struct FWriter
 
 	Writer *mWriter1;
 	PrettyWriter *mWriter2;
+	FBinaryWriter *mWriter3;
 	TArray<bool> mInObject;
 	rapidjson::StringBuffer mOutString;
 	TArray<DObject *> mDObjects;
 	TMap<DObject *, int> mObjectMap;
 
-	FWriter(bool pretty)
+	FWriter(bool pretty, bool binary = false)
 	{
-		if (!pretty)
+		mWriter1 = nullptr;
+		mWriter2 = nullptr;
+		mWriter3 = nullptr;
+		if (binary)
+		{
+			mWriter3 = new FBinaryWriter;
+		}
+		else if (!pretty)
 		{
 			mWriter1 = new Writer(mOutString);
-			mWriter2 = nullptr;
 		}
 		else
 		{
-			mWriter1 = nullptr;
 			mWriter2 = new PrettyWriter(mOutString);
 		}
 	}
@@ -62,6 +187,14 @@ struct FWriter
 	{
 		if (mWriter1) delete mWriter1;
 		if (mWriter2) delete mWriter2;
+		if (mWriter3) delete mWriter3;
+	}
+
+	const char *GetOutput(unsigned *len)
+	{
+		if (mWriter3) return mWriter3->GetOutput(len);
+		if (len != nullptr) *len = (unsigned)mOutString.GetSize();
+		return mOutString.GetString();
 	}
 
 
@@ -74,36 +207,42 @@ struct FWriter
 	{
 		if (mWriter1) mWriter1->StartObject();
 		else if (mWriter2) mWriter2->StartObject();
+		else if (mWriter3) mWriter3->StartObject();
 	}
 
 	void EndObject()
 	{
 		if (mWriter1) mWriter1->EndObject();
 		else if (mWriter2) mWriter2->EndObject();
+		else if (mWriter3) mWriter3->EndObject();
 	}
 
 	void StartArray()
 	{
 		if (mWriter1) mWriter1->StartArray();
 		else if (mWriter2) mWriter2->StartArray();
+		else if (mWriter3) mWriter3->StartArray();
 	}
 
 	void EndArray()
 	{
 		if (mWriter1) mWriter1->EndArray();
 		else if (mWriter2) mWriter2->EndArray();
+		else if (mWriter3) mWriter3->EndArray();
 	}
 
 	void Key(const char *k)
 	{
 		if (mWriter1) mWriter1->Key(k);
 		else if (mWriter2) mWriter2->Key(k);
+		else if (mWriter3) mWriter3->Key(k);
 	}
 
 	void Null()
 	{
 		if (mWriter1) mWriter1->Null();
 		else if (mWriter2) mWriter2->Null();
+		else if (mWriter3) mWriter3->Null();
 	}
 
 	void StringU(const char *k, bool encode)
@@ -111,6 +250,7 @@ struct FWriter
 		if (encode) k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void String(const char *k)
@@ -118,6 +258,7 @@ struct FWriter
 		k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void String(const char *k, int size)
@@ -125,36 +266,42 @@ struct FWriter
 		k = StringToUnicode(k, size);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void Bool(bool k)
 	{
 		if (mWriter1) mWriter1->Bool(k);
 		else if (mWriter2) mWriter2->Bool(k);
+		else if (mWriter3) mWriter3->Bool(k);
 	}
 
 	void Int(int32_t k)
 	{
 		if (mWriter1) mWriter1->Int(k);
 		else if (mWriter2) mWriter2->Int(k);
+		else if (mWriter3) mWriter3->Int64(k);
 	}
 
 	void Int64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Int64(k);
 		else if (mWriter2) mWriter2->Int64(k);
+		else if (mWriter3) mWriter3->Int64(k);
 	}
 
 	void Uint(uint32_t k)
 	{
 		if (mWriter1) mWriter1->Uint(k);
 		else if (mWriter2) mWriter2->Uint(k);
+		else if (mWriter3) mWriter3->Uint64(k);
 	}
 
 	void Uint64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Uint64(k);
 		else if (mWriter2) mWriter2->Uint64(k);
+		else if (mWriter3) mWriter3->Uint64(k);
 	}
 
 	void Double(double k)
@@ -167,6 +314,10 @@ struct FWriter
 		{
 			mWriter2->Double(k);
 		}
+		else if (mWriter3)
+		{
+			mWriter3->Double(k);
+		}
 	}
 
 };
@@ -185,12 +336,23 @@ struct FReader
 	rapidjson::Value *mKeyValue = nullptr;
 	bool mObjectsRead = false;
 
+	TArray<char> mBinaryData;	// string values of a binary document point into this
+
 	FReader(const char *buffer, size_t length)
 	{
-		mDoc.Parse(buffer, length);
+		if (IsBinarySerializerData(buffer, length))
+		{
+			ParseBinary(buffer, length);
+		}
+		else
+		{
+			mDoc.Parse(buffer, length);
+		}
 		mObjects.Push(FJSONObject(&mDoc));
 	}
 
+	void ParseBinary(const char *buffer, size_t length);
+
 	rapidjson::Value *FindKey(const char *key)
 	{
 		FJSONObject &obj = mObjects.Last();
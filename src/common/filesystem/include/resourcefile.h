@@ -28,6 +28,8 @@ struct LumpFilterInfo
 	std::vector<std::string> blockedfolders; // File folders that will never be accepted (e.g. __macosx)
 	std::function<bool(const char*, const char*)> filenamecheck;	// for scanning directories, this allows to eliminate unwanted content.
 	std::function<void()> postprocessFunc;
+	bool maparchives = false;	// map the engine and IWAD archives into memory so that their entries can be read from any thread without copying them.
+	std::string indexcachepath;	// directory where the processed directories of archives get cached. Empty to disable the cache.
 };
 
 enum class FSMessageLevel
@@ -132,11 +134,21 @@ protected:
 	{
 		Entries[entry].Flags &= ~RESFF_NEEDFILESTART;
 	}
+	// Same for memory backed archives, but this only looks at the buffer and does not change the entry.
+	virtual size_t GetEntryAddress(uint32_t entry, const char* buffer)
+	{
+		return Entries[entry].Position;
+	}
+	const char* GetEntryMemory(uint32_t entry, size_t& length);
+	// dirinfo is the archive's own directory record, e.g. a zip's end of central directory, which is checked along with the file's size and time.
+	bool LoadIndexCache(LumpFilterInfo* filter, int64_t dirpos, const void* dirinfo, size_t dirsize);
+	void SaveIndexCache(LumpFilterInfo* filter, int64_t dirpos, const void* dirinfo, size_t dirsize);
 	bool IsFileInFolder(const char* const resPath);
 	void CheckEmbedded(uint32_t entry, LumpFilterInfo* lfi);
 
 private:
 	uint32_t FirstLump;
+	FileReader IndexCache;	// the entry names point into this mapping if the directory came from the index cache.
 
 	int FilterLumps(const std::string& filtername, uint32_t max);
 	bool FindPrefixRange(const char* filter, uint32_t max, uint32_t &start, uint32_t &end);
@@ -155,6 +167,8 @@ public:
 	uint32_t GetFirstEntry() const { return FirstLump; }
 	void SetFirstLump(uint32_t f) { FirstLump = f; }
 	const char* GetHash() const { return Hash; }
+	// Memory backed archives share no state between reads so their entries can be read from any thread at the same time.
+	bool IsMemoryBacked() { return Reader.isOpen() && Reader.GetBuffer() != nullptr; }
 
 	int EntryCount() const { return NumLumps; }
 	uint32_t EntryCountU() const { return NumLumps; }
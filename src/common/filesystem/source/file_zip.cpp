@@ -110,6 +110,7 @@ static uint32_t Zip_FindCentralDir(FileReader &fin, bool* zip64)
 class FZipFile : public FResourceFile
 {
 	void SetEntryAddress(uint32_t entry) override;
+	size_t GetEntryAddress(uint32_t entry, const char* buffer) override;
 
 public:
 	FZipFile(const char* filename, FileReader& file, StringPool* sp);
@@ -140,13 +141,24 @@ bool FZipFile::Open(LumpFilterInfo* filter, FileSystemMessageFunc Printf)
 		return false;
 	}
 
+	// Read the central directory info. A cached index is only used if it was made from the same record.
+	uint8_t dirinfo[sizeof(FZipEndOfCentralDirectory64)];
+	size_t dirinfosize = zip64 ? sizeof(FZipEndOfCentralDirectory64) : sizeof(FZipEndOfCentralDirectory);
+	Reader.Seek(centraldir, FileReader::SeekSet);
+	if (Reader.Read(dirinfo, dirinfosize) != (FileReader::Size)dirinfosize)
+	{
+		Printf(FSMessageLevel::Error, "%s: ZIP file corrupt!\n", FileName);
+		return false;
+	}
+
+	if (LoadIndexCache(filter, centraldir, dirinfo, dirinfosize))
+		return true;
+
 	uint64_t dirsize, DirectoryOffset;
 	if (!zip64)
 	{
 		FZipEndOfCentralDirectory info;
-		// Read the central directory info.
-		Reader.Seek(centraldir, FileReader::SeekSet);
-		Reader.Read(&info, sizeof(FZipEndOfCentralDirectory));
+		memcpy(&info, dirinfo, sizeof(info));
 
 		// No multi-disk zips!
 		if (info.NumEntries != info.NumEntriesOnAllDisks ||
@@ -163,9 +175,7 @@ bool FZipFile::Open(LumpFilterInfo* filter, FileSystemMessageFunc Printf)
 	else
 	{
 		FZipEndOfCentralDirectory64 info;
-		// Read the central directory info.
-		Reader.Seek(centraldir, FileReader::SeekSet);
-		Reader.Read(&info, sizeof(FZipEndOfCentralDirectory64));
+		memcpy(&info, dirinfo, sizeof(info));
 
 		// No multi-disk zips!
 		if (info.NumEntries != info.NumEntriesOnAllDisks ||
@@ -320,6 +330,7 @@ bool FZipFile::Open(LumpFilterInfo* filter, FileSystemMessageFunc Printf)
 
 	GenerateHash();
 	PostProcessArchive(filter);
+	SaveIndexCache(filter, centraldir, dirinfo, dirinfosize);
 	return true;
 }
 
@@ -341,9 +352,18 @@ FCompressedBuffer FZipFile::GetRawData(uint32_t entry)
 	{
 		auto& e = Entries[entry];
 		cbuf = { e.Length, e.CompressedSize, e.Method, e.CRC32, new char[e.CompressedSize] };
-		if (e.Flags & RESFF_NEEDFILESTART) SetEntryAddress(entry);
-		Reader.Seek(e.Position, FileReader::SeekSet);
-		Reader.Read(cbuf.mBuffer, e.CompressedSize);
+		if (IsMemoryBacked())
+		{
+			size_t length;
+			auto buf = GetEntryMemory(entry, length);
+			memcpy(cbuf.mBuffer, buf, length);
+		}
+		else
+		{
+			if (e.Flags & RESFF_NEEDFILESTART) SetEntryAddress(entry);
+			Reader.Seek(e.Position, FileReader::SeekSet);
+			Reader.Read(cbuf.mBuffer, e.CompressedSize);
+		}
 	}
 	
 	return cbuf;
@@ -370,6 +390,28 @@ void FZipFile::SetEntryAddress(uint32_t entry)
 	Entries[entry].Flags &= ~RESFF_NEEDFILESTART;
 }
 
+//==========================================================================
+//
+// GetEntryAddress
+//
+// For memory backed files the local file header is skipped on every access
+// instead of updating the entry so that no state is shared between threads.
+//
+//==========================================================================
+
+size_t FZipFile::GetEntryAddress(uint32_t entry, const char* buffer)
+{
+	size_t position = Entries[entry].Position;
+	if (!(Entries[entry].Flags & RESFF_NEEDFILESTART))
+		return position;
+
+	if (position + sizeof(FZipLocalFileHeader) > (size_t)Reader.GetLength())
+		return Reader.GetLength();
+
+	auto localHeader = (const FZipLocalFileHeader*)(buffer + position);
+	return position + sizeof(FZipLocalFileHeader) + LittleShort(localHeader->NameLength) + LittleShort(localHeader->ExtraLength);
+}
+
 //==========================================================================
 //
 // File open
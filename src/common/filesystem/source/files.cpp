@@ -40,6 +40,16 @@
 #include <string.h>
 #include "files_internal.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
 namespace FileSys {
 	
 #ifdef _WIN32
@@ -358,6 +368,75 @@ char* BufferingReader::Gets(char* strbuf, ptrdiff_t len)
 	return MemoryReader::Gets(strbuf, len);
 }
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// reads data from a file that is mapped into memory.
+// GetBuffer gives direct access to the file content.
+//
+//==========================================================================
+
+class MappedFileReader : public MemoryReader
+{
+#ifdef _WIN32
+	HANDLE MappingHandle = nullptr;
+#endif
+
+public:
+	~MappedFileReader()
+	{
+		if (bufptr == nullptr) return;
+#ifndef _WIN32
+		munmap((void*)bufptr, Length);
+#else
+		UnmapViewOfFile(bufptr);
+		CloseHandle(MappingHandle);
+#endif
+	}
+
+	bool Open(const char *filename)
+	{
+#ifndef _WIN32
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size <= 0)
+		{
+			close(fd);
+			return false;
+		}
+		void *mem = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);	// the mapping keeps the file referenced.
+		if (mem == MAP_FAILED) return false;
+		bufptr = (const char*)mem;
+		Length = info.st_size;
+#else
+		HANDLE file = CreateFileW(toWide(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		MappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);	// the mapping keeps the file referenced.
+		if (MappingHandle == nullptr) return false;
+		void *mem = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (mem == nullptr)
+		{
+			CloseHandle(MappingHandle);
+			return false;
+		}
+		bufptr = (const char*)mem;
+		Length = (ptrdiff_t)size.QuadPart;
+#endif
+		FilePos = 0;
+		return true;
+	}
+};
+
 //==========================================================================
 //
 // FileReader
@@ -380,6 +459,19 @@ bool FileReader::OpenFile(const char *filename, FileReader::Size start, FileRead
 	return true;
 }
 
+bool FileReader::OpenMappedFile(const char *filename)
+{
+	auto reader = new MappedFileReader;
+	if (!reader->Open(filename))
+	{
+		delete reader;
+		return false;
+	}
+	Close();
+	mReader = reader;
+	return true;
+}
+
 bool FileReader::OpenFilePart(FileReader &parent, FileReader::Size start, FileReader::Size length)
 {
 	auto reader = new FileReaderRedirect(parent, start, length);
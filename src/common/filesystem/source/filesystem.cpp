@@ -41,6 +41,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <inttypes.h>
+#include <algorithm>
 
 #include "resourcefile.h"
 #include "fs_filesystem.h"
@@ -273,7 +274,9 @@ bool FileSystem::InitMultipleFiles (std::vector<std::string>& filenames, LumpFil
 
 	for(size_t i=0;i<filenames.size(); i++)
 	{
-		AddFile(filenames[i].c_str(), nullptr, filter, Printf);
+		// Only the engine's own files and the IWAD get mapped. They are not going to be replaced while the game is running.
+		bool mapfile = filter && filter->maparchives && (int)i <= MaxIwadIndex;
+		AddFile(filenames[i].c_str(), nullptr, filter, Printf, mapfile);
 
 		if (i == (unsigned)MaxIwadIndex) MoveLumpsInFolder("after_iwad/");
 		std::string path = "filter/%s";
@@ -332,7 +335,7 @@ int FileSystem::AddFromBuffer(const char* name, char* data, int size, int id, in
 // [RH] Removed reload hack
 //==========================================================================
 
-void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInfo* filter, FileSystemMessageFunc Printf)
+void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInfo* filter, FileSystemMessageFunc Printf, bool mapfile)
 {
 	std::unique_lock lock(Mutex);
 	int startlump;
@@ -354,7 +357,9 @@ void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInf
 
 		if (!isdir)
 		{
-			if (!filereader.OpenFile(filename))
+			// Mapping the file needs enough address space, so only do it for 64 bit builds.
+			bool mapped = sizeof(void*) >= 8 && mapfile && filereader.OpenMappedFile(filename);
+			if (!mapped && !filereader.OpenFile(filename))
 			{ // Didn't find file
 				if (Printf)
 				{
@@ -386,6 +391,9 @@ void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInf
 
 		resfile->SetFirstLump(lumpstart);
 		Files.push_back(resfile);
+		// Grow geometrically, reserving the exact size for every archive would copy all lumps each time.
+		size_t needed = FileInfo.size() + resfile->EntryCount();
+		if (FileInfo.capacity() < needed) FileInfo.reserve(std::max(FileInfo.capacity() * 2, needed));
 		for (int i = 0; i < resfile->EntryCount(); i++)
 		{
 			FileInfo.resize(FileInfo.size() + 1);
@@ -819,12 +827,13 @@ void FileSystem::InitHashChains (void)
 			NextLumpIndex_FullName[i] = FirstLumpIndex_FullName[j];
 			FirstLumpIndex_FullName[j] = i;
 
-			std::string nameNoExt = FileInfo[i].LongName;
-			auto dot = nameNoExt.find_last_of('.');
-			auto slash = nameNoExt.find_last_of('/');
-			if ((dot > slash || slash == std::string::npos) && dot != std::string::npos) nameNoExt.resize(dot);
+			// hash the name without its extension in place
+			const char* longName = FileInfo[i].LongName;
+			auto dot = strrchr(longName, '.');
+			auto slash = strrchr(longName, '/');
+			size_t lengthNoExt = (dot && dot > slash) ? size_t(dot - longName) : SIZE_MAX;
 
-			j = MakeHash(nameNoExt.c_str()) % NumEntries;
+			j = MakeHash(longName, lengthNoExt) % NumEntries;
 			NextLumpIndex_NoExt[i] = FirstLumpIndex_NoExt[j];
 			FirstLumpIndex_NoExt[j] = i;
 
@@ -1290,7 +1299,12 @@ FileData FileSystem::ReadFile (int lump)
 	{
 		throw FileSystemException("ReadFile: %u >= NumEntries", lump);
 	}
-	return FileInfo[lump].resfile->Read(FileInfo[lump].resindex);
+	auto file = FileInfo[lump].resfile;
+	auto resindex = FileInfo[lump].resindex;
+
+	// Memory backed files can be read without holding the lock. Resource files never get closed while the file system is in use.
+	if (file->IsMemoryBacked()) lock.unlock();
+	return file->Read(resindex);
 }
 
 //==========================================================================
@@ -1311,7 +1325,9 @@ FileReader FileSystem::OpenFileReader(int lump, int readertype, int readerflags)
 	}
 
 	auto file = FileInfo[lump].resfile;
-	return file->GetEntryReader(FileInfo[lump].resindex, readertype, readerflags);
+	auto resindex = FileInfo[lump].resindex;
+	if (file->IsMemoryBacked()) lock.unlock();
+	return file->GetEntryReader(resindex, readertype, readerflags);
 }
 
 FileReader FileSystem::OpenFileReader(const char* name)
@@ -33,6 +33,7 @@
 */
 
 #include "fs_findfile.h"
+#include <stdio.h>
 #include <string.h>
 #include <vector>
 #include <sys/stat.h>
@@ -426,4 +427,57 @@ bool FS_DirEntryExists(const char* pathname, bool* isdir)
 	return res;
 }
 
+//==========================================================================
+//
+// GetFileTimeAndSize
+//
+// Gets the modification time and size of a file. The time is as precise
+// as the platform allows and is only meant to be compared with values
+// from earlier calls.
+//
+//==========================================================================
+
+bool FS_GetFileTimeAndSize(const char* pathname, int64_t* mtime, int64_t* size)
+{
+	if (pathname == NULL || *pathname == 0)
+		return false;
+
+#ifndef _WIN32
+	struct stat info;
+	if (stat(pathname, &info) != 0 || (info.st_mode & S_IFDIR))
+		return false;
+#ifdef __APPLE__
+	*mtime = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	*mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+	*size = (int64_t)info.st_size;
+#else
+	// _wstat64 only has whole seconds, the file attributes have the full FILETIME (100 nanosecond units).
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExW(toWide(pathname).c_str(), GetFileExInfoStandard, &info) || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	*mtime = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+	*size = (int64_t)(((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow);
+#endif
+	return true;
+}
+
+//==========================================================================
+//
+// ReplaceFile
+//
+// Renames a file, replacing the target if it exists.
+//
+//==========================================================================
+
+bool FS_ReplaceFile(const char* from, const char* to)
+{
+#ifndef _WIN32
+	return rename(from, to) == 0;
+#else
+	return MoveFileExW(toWide(from).c_str(), toWide(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+}
+
 }
@@ -344,6 +344,222 @@ void FResourceFile::GenerateHash()
 	}
 }
 
+//==========================================================================
+//
+// Index cache
+//
+// Reading the directory of a large archive, normalizing the names and
+// running the filters takes a while, so the processed entry table is
+// stored on disk. It only gets used if the archive's size and time stamp
+// and the filter settings are still the same as when it was written.
+// The cache is mapped into memory and the entry names point directly
+// into it.
+//
+//==========================================================================
+
+static const uint32_t INDEXCACHE_VERSION = 2;
+
+struct FIndexCacheHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	int64_t FileSize;
+	int64_t FileTime;
+	uint8_t FilterHash[16];
+	uint32_t NumEntries;
+	uint32_t PathLength;
+	uint32_t StringSize;
+	uint32_t DirInfoSize;
+	int64_t DirInfoPos;
+	uint8_t DirInfo[64];
+	char Hash[48];
+};
+
+struct FIndexCacheEntry
+{
+	uint64_t Length;
+	uint64_t CompressedSize;
+	uint64_t Position;
+	uint32_t NameOffset;	// UINT32_MAX if the entry has no name
+	int32_t ResourceID;
+	uint32_t CRC32;
+	uint16_t Flags;
+	uint16_t Method;
+	int16_t Namespace;
+	int16_t Padding[3];
+};
+
+static size_t GetIndexCacheEntriesOffset(uint32_t pathlength)
+{
+	return (sizeof(FIndexCacheHeader) + pathlength + 7) & ~(size_t)7;
+}
+
+static std::string GetIndexCachePath(LumpFilterInfo* filter, const char* filename)
+{
+	using namespace FileSys::md5;
+
+	// The cache is named after the archive's path.
+	md5_state_t state;
+	md5_init(&state);
+	md5_append(&state, (const uint8_t*)filename, (unsigned)strlen(filename));
+	uint8_t digest[16];
+	md5_finish(&state, digest);
+
+	std::string path = filter->indexcachepath;
+	if (path.back() != '/' && path.back() != '\\') path += '/';
+	for (auto c : digest)
+	{
+		char hex[3];
+		snprintf(hex, 3, "%02x", c);
+		path += hex;
+	}
+	path += ".fsi";
+	return path;
+}
+
+static void HashFilter(LumpFilterInfo* filter, uint8_t* digest)
+{
+	using namespace FileSys::md5;
+
+	md5_state_t state;
+	md5_init(&state);
+	for (auto list : { &filter->gameTypeFilter, &filter->reservedFolders, &filter->requiredPrefixes, &filter->embeddings, &filter->blockedextensions, &filter->blockedfolders })
+	{
+		for (auto& str : *list)
+		{
+			md5_append(&state, (const uint8_t*)str.c_str(), (unsigned)str.size() + 1);
+		}
+		md5_append(&state, (const uint8_t*)"\n", 1);
+	}
+	md5_finish(&state, digest);
+}
+
+bool FResourceFile::LoadIndexCache(LumpFilterInfo* filter, int64_t dirpos, const void* dirinfo, size_t dirsize)
+{
+	int64_t filetime, filesize;
+	if (!filter || filter->indexcachepath.empty() || dirsize > sizeof(FIndexCacheHeader::DirInfo) ||
+		!FS_GetFileTimeAndSize(FileName, &filetime, &filesize) || filesize != Reader.GetLength())
+		return false;
+
+	FileReader cache;
+	if (!cache.OpenMappedFile(GetIndexCachePath(filter, FileName).c_str()))
+		return false;
+
+	auto buffer = cache.GetBuffer();
+	size_t length = (size_t)cache.GetLength();
+	if (length < sizeof(FIndexCacheHeader))
+		return false;
+
+	FIndexCacheHeader header;
+	memcpy(&header, buffer, sizeof(header));
+	uint8_t filterhash[16];
+	HashFilter(filter, filterhash);
+	size_t pathlength = strlen(FileName);
+	if (memcmp(header.Magic, "FSIX", 4) || header.Version != INDEXCACHE_VERSION || header.FileSize != filesize || header.FileTime != filetime ||
+		header.DirInfoPos != dirpos || header.DirInfoSize != dirsize || memcmp(header.DirInfo, dirinfo, dirsize) ||
+		memcmp(header.FilterHash, filterhash, 16) || header.PathLength != pathlength || length < sizeof(header) + pathlength ||
+		memcmp(buffer + sizeof(header), FileName, pathlength))
+		return false;
+
+	size_t entriesOffset = GetIndexCacheEntriesOffset(header.PathLength);
+	size_t stringsOffset = entriesOffset + header.NumEntries * sizeof(FIndexCacheEntry);
+	if (length != stringsOffset + header.StringSize || (header.StringSize > 0 && buffer[length - 1] != 0))
+		return false;
+
+	auto cacheentries = (const FIndexCacheEntry*)(buffer + entriesOffset);
+	auto strings = buffer + stringsOffset;
+	AllocateEntries(header.NumEntries);
+	for (uint32_t i = 0; i < NumLumps; i++)
+	{
+		const FIndexCacheEntry& src = cacheentries[i];
+		FResourceEntry& dest = Entries[i];
+		if (src.NameOffset != UINT32_MAX && src.NameOffset >= header.StringSize)
+		{
+			NumLumps = 0;
+			return false;
+		}
+		dest.Length = (size_t)src.Length;
+		dest.CompressedSize = (size_t)src.CompressedSize;
+		dest.Position = (size_t)src.Position;
+		dest.FileName = src.NameOffset != UINT32_MAX ? strings + src.NameOffset : nullptr;
+		dest.ResourceID = src.ResourceID;
+		dest.CRC32 = src.CRC32;
+		dest.Flags = src.Flags;
+		dest.Method = src.Method;
+		dest.Namespace = src.Namespace;
+	}
+	memcpy(Hash, header.Hash, sizeof(Hash));
+	Hash[sizeof(Hash) - 1] = 0;
+
+	IndexCache = std::move(cache);
+	return true;
+}
+
+void FResourceFile::SaveIndexCache(LumpFilterInfo* filter, int64_t dirpos, const void* dirinfo, size_t dirsize)
+{
+	int64_t filetime, filesize;
+	if (!filter || filter->indexcachepath.empty() || dirsize > sizeof(FIndexCacheHeader::DirInfo) ||
+		!FS_GetFileTimeAndSize(FileName, &filetime, &filesize) || filesize != Reader.GetLength())
+		return;
+
+	FIndexCacheHeader header = {};
+	memcpy(header.Magic, "FSIX", 4);
+	header.Version = INDEXCACHE_VERSION;
+	header.FileSize = filesize;
+	header.FileTime = filetime;
+	header.DirInfoSize = (uint32_t)dirsize;
+	header.DirInfoPos = dirpos;
+	memcpy(header.DirInfo, dirinfo, dirsize);
+	HashFilter(filter, header.FilterHash);
+	header.NumEntries = NumLumps;
+	header.PathLength = (uint32_t)strlen(FileName);
+	memcpy(header.Hash, Hash, sizeof(Hash));
+
+	std::vector<FIndexCacheEntry> cacheentries(NumLumps);
+	std::vector<char> strings;
+	for (uint32_t i = 0; i < NumLumps; i++)
+	{
+		const FResourceEntry& src = Entries[i];
+		FIndexCacheEntry& dest = cacheentries[i];
+		dest = {};
+		dest.Length = src.Length;
+		dest.CompressedSize = src.CompressedSize;
+		dest.Position = src.Position;
+		dest.NameOffset = UINT32_MAX;
+		if (src.FileName)
+		{
+			dest.NameOffset = (uint32_t)strings.size();
+			strings.insert(strings.end(), src.FileName, src.FileName + strlen(src.FileName) + 1);
+		}
+		dest.ResourceID = src.ResourceID;
+		dest.CRC32 = src.CRC32;
+		dest.Flags = src.Flags;
+		dest.Method = src.Method;
+		dest.Namespace = src.Namespace;
+	}
+	header.StringSize = (uint32_t)strings.size();
+
+	// Write to a temporary file first so that nobody ever maps a partially written cache.
+	std::string path = GetIndexCachePath(filter, FileName);
+	std::string temppath = path + ".tmp";
+	auto fw = FileWriter::Open(temppath.c_str());
+	if (fw == nullptr)
+		return;
+
+	static const char zeros[8] = {};
+	size_t padding = GetIndexCacheEntriesOffset(header.PathLength) - sizeof(header) - header.PathLength;
+	bool success =
+		fw->Write(&header, sizeof(header)) == sizeof(header) &&
+		fw->Write(FileName, header.PathLength) == header.PathLength &&
+		fw->Write(zeros, padding) == padding &&
+		fw->Write(cacheentries.data(), cacheentries.size() * sizeof(FIndexCacheEntry)) == cacheentries.size() * sizeof(FIndexCacheEntry) &&
+		fw->Write(strings.data(), strings.size()) == strings.size();
+	delete fw;
+
+	if (!success || !FS_ReplaceFile(temppath.c_str(), path.c_str()))
+		remove(temppath.c_str());
+}
+
 static bool IsBlockedExt(LumpFilterInfo* filter, const std::string_view& name)
 {
 	size_t extpos = name.find_last_of('.');
@@ -707,36 +923,49 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 	FileReader fr;
 	if (entry < NumLumps)
 	{
+		if (IsMemoryBacked())
+		{
+			// Create the readers directly on the buffer. This doesn't touch the container's reader
+			// so it works from any thread, and stored entries do not get copied.
+			size_t length;
+			auto buf = GetEntryMemory(entry, length);
+			if (!(Entries[entry].Flags & RESFF_COMPRESSED))
+			{
+				fr.OpenMemory(buf, length);
+			}
+			else
+			{
+				FileReader fri;
+				fri.OpenMemory(buf, length);
+				int flags = DCF_TRANSFEROWNER | DCF_EXCEPTIONS;
+				if (readertype == READER_CACHED) flags |= DCF_CACHED;
+				else if (readerflags & READERFLAG_SEEKABLE) flags |= DCF_SEEKABLE;
+				OpenDecompressor(fr, fri, Entries[entry].Length, Entries[entry].Method, flags);
+			}
+			return fr;
+		}
+
 		if (Entries[entry].Flags & RESFF_NEEDFILESTART)
 		{
 			SetEntryAddress(entry);
 		}
 		if (!(Entries[entry].Flags & RESFF_COMPRESSED))
 		{
-			auto buf = Reader.GetBuffer();
-			// if this is backed by a memory buffer, create a new reader directly referencing it.
-			if (buf != nullptr)
+			if (readertype == READER_SHARED && !mainThread)
+				readertype = READER_NEW;
+			if (readertype == READER_SHARED)
 			{
-				fr.OpenMemory(buf + Entries[entry].Position, Entries[entry].Length);
+				fr.OpenFilePart(Reader, Entries[entry].Position, Entries[entry].Length);
 			}
-			else
+			else if (readertype == READER_NEW)
 			{
-				if (readertype == READER_SHARED && !mainThread)
-					readertype = READER_NEW;
-				if (readertype == READER_SHARED)
-				{
-					fr.OpenFilePart(Reader, Entries[entry].Position, Entries[entry].Length);
-				}
-				else if (readertype == READER_NEW)
-				{
-					fr.OpenFile(FileName, Entries[entry].Position, Entries[entry].Length);
-				}
-				else if (readertype == READER_CACHED)
-				{
-					Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
-					auto data = Reader.Read(Entries[entry].Length);
-					fr.OpenMemoryArray(data);
-				}
+				fr.OpenFile(FileName, Entries[entry].Position, Entries[entry].Length);
+			}
+			else if (readertype == READER_CACHED)
+			{
+				Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
+				auto data = Reader.Read(Entries[entry].Length);
+				fr.OpenMemoryArray(data);
 			}
 		}
 		else
@@ -753,16 +982,30 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 	return fr;
 }
 
+//==========================================================================
+//
+// Returns an entry's raw data in a memory backed container, clipped to
+// the container's size.
+//
+//==========================================================================
+
+const char* FResourceFile::GetEntryMemory(uint32_t entry, size_t& length)
+{
+	auto buf = Reader.GetBuffer();
+	size_t size = (size_t)Reader.GetLength();
+	size_t position = std::min(GetEntryAddress(entry, buf), size);
+	length = std::min((Entries[entry].Flags & RESFF_COMPRESSED) ? Entries[entry].CompressedSize : Entries[entry].Length, size - position);
+	return buf + position;
+}
+
 FileData FResourceFile::Read(uint32_t entry)
 {
-	if (!(Entries[entry].Flags & RESFF_COMPRESSED) && Reader.isOpen())
+	if (entry < NumLumps && !(Entries[entry].Flags & RESFF_COMPRESSED) && IsMemoryBacked())
 	{
-		auto buf = Reader.GetBuffer();
 		// if this is backed by a memory buffer, we can just return a reference to the backing store.
-		if (buf != nullptr)
-		{
-			return FileData(buf + Entries[entry].Position, Entries[entry].Length, false);
-		}
+		size_t length;
+		auto buf = GetEntryMemory(entry, length);
+		return FileData(buf, length, false);
 	}
 
 	auto fr = GetEntryReader(entry, READER_SHARED, 0);
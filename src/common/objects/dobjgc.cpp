@@ -63,6 +63,8 @@
 #include "stats.h"
 #include "printf.h"
 #include "cmdlib.h"
+#include "c_cvars.h"
+#include "threadpool.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -107,6 +109,9 @@
 // Cost of destroying an object
 #define GCDESTROYCOST		15
 
+// Number of gray objects a mark thread takes from the shared list at once
+#define GCMARKBATCH			32
+
 // TYPES -------------------------------------------------------------------
 
 class FAveragizer
@@ -135,6 +140,14 @@ struct FStepStats
 	void Reset();
 };
 
+struct FCycleStats
+{
+	size_t Traced;		// Objects whose references were propagated
+	size_t Survivors;	// Objects that were kept by the sweep
+	size_t Freed;		// Objects that were deleted by the sweep
+	double MaxPause;	// Longest single step, in milliseconds
+};
+
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -147,6 +160,10 @@ static size_t CalcStepSize();
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
+// Propagates marks on all hardware threads. The mark phase is then done at
+// once in Atomic instead of being spread over several steps.
+CVAR(Bool, gc_parallelmark, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 namespace GC
 {
 size_t AllocBytes;
@@ -167,11 +184,27 @@ FStepStats StepStats;
 FStepStats PrevStepStats;
 bool FinalGC;
 bool HadToDestroy;
+double StepTimeMS;
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 static FAveragizer AllocHistory;// Tracks allocation rate over time
 static cycle_t GCTime;			// Track time spent in GC
+static FCycleStats CycleStats;
+static FCycleStats PrevCycleStats;
+static double PeakPauseMS;		// Longest step of the session
+static bool ParallelMarking;	// Marks are propagated by several threads
+static thread_local DObject *LocalGray;	// Gray list of this mark thread while ParallelMarking is set
+
+// Shared state of the mark threads
+static std::mutex MarkMutex;
+static std::condition_variable MarkWake;
+static TArray<DObject *> SharedGray;
+static int ActiveMarkers;
+static bool MarkDone;
+static std::atomic<bool> MarkStarving;
+static std::atomic<size_t> MarkedBytes;
+static std::atomic<size_t> MarkedObjects;
 
 // CODE --------------------------------------------------------------------
 
@@ -216,6 +249,78 @@ void SetThreshold()
 //
 //==========================================================================
 
+//==========================================================================
+//
+// Mark bits are updated atomically while several threads are marking,
+// so that each object gets claimed by exactly one of them. None of this
+// is used when marking on a single thread.
+//
+//==========================================================================
+
+static std::atomic<uint32_t> &AtomicFlags(DObject *obj)
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(obj->ObjectFlags), "ObjectFlags cannot be accessed atomically");
+	return *reinterpret_cast<std::atomic<uint32_t> *>(&obj->ObjectFlags);
+}
+
+static bool ClaimWhite(DObject *obj)
+{
+	auto &flags = AtomicFlags(obj);
+	uint32_t old = flags.load(std::memory_order_relaxed);
+	while (old & OF_WhiteBits)
+	{
+		if (flags.compare_exchange_weak(old, old & ~OF_WhiteBits, std::memory_order_acq_rel))
+			return true;
+	}
+	return false;
+}
+
+static void MarkParallel(DObject **obj)
+{
+	DObject *lobj = *obj;
+	uint32_t flags = AtomicFlags(lobj).load(std::memory_order_relaxed);
+	if (flags & OF_Released)
+	{
+		return;
+	}
+	if (flags & OF_EuthanizeMe)
+	{
+		*obj = nullptr;
+	}
+	else if ((flags & OF_WhiteBits) && ClaimWhite(lobj))
+	{
+		lobj->GCNext = LocalGray;
+		LocalGray = lobj;
+	}
+}
+
+static void RescanParallel(DObject *obj)
+{
+	auto &flags = AtomicFlags(obj);
+	uint32_t old = flags.load(std::memory_order_relaxed);
+	if ((old & OF_Black) && !(old & (OF_Released | OF_EuthanizeMe)))
+	{
+		if (flags.fetch_and(~OF_Black, std::memory_order_acq_rel) & OF_Black)
+		{
+			obj->GCNext = LocalGray;
+			LocalGray = obj;
+		}
+	}
+	else
+	{
+		MarkParallel(&obj);
+	}
+}
+
+static size_t PropagateMarkParallel()
+{
+	DObject *obj = LocalGray;
+	LocalGray = obj->GCNext;
+	uint32_t flags = AtomicFlags(obj).fetch_or(OF_Black, std::memory_order_acq_rel);
+	return !(flags & OF_EuthanizeMe) ? obj->PropagateMark() :
+		obj->GetClass()->Size;
+}
+
 size_t PropagateMark()
 {
 	DObject *obj = Gray;
@@ -249,6 +354,7 @@ static size_t SweepObjects(size_t count)
 			assert(!curr->IsDead() || (curr->ObjectFlags & OF_Fixed));
 			curr->MakeWhite();	// make it white (for next cycle)
 			SweepPos = &curr->ObjNext;
+			CycleStats.Survivors++;
 		}
 		else
 		{
@@ -265,6 +371,7 @@ static size_t SweepObjects(size_t count)
 				curr->ObjectFlags |= OF_Cleanup;
 				delete curr;
 				swept += GCDELETECOST;
+				CycleStats.Freed++;
 			}
 		}
 	}
@@ -319,6 +426,12 @@ void Mark(DObject **obj)
 {
 	DObject *lobj = *obj;
 
+	if (ParallelMarking)
+	{
+		if (lobj != nullptr) MarkParallel(obj);
+		return;
+	}
+
 	//assert(lobj == nullptr || !(lobj->ObjectFlags & OF_Released));
 	if (lobj != nullptr && !(lobj->ObjectFlags & OF_Released))
 	{
@@ -335,6 +448,31 @@ void Mark(DObject **obj)
 	}
 }
 
+//==========================================================================
+//
+// Rescan
+//
+//==========================================================================
+
+void Rescan(DObject *obj)
+{
+	if (ParallelMarking)
+	{
+		if (obj != nullptr) RescanParallel(obj);
+		return;
+	}
+	if (obj != nullptr && obj->IsBlack() && !(obj->ObjectFlags & (OF_Released | OF_EuthanizeMe)))
+	{
+		obj->Black2Gray();
+		obj->GCNext = Gray;
+		Gray = obj;
+	}
+	else
+	{
+		Mark(obj);
+	}
+}
+
 //==========================================================================
 //
 // MarkArray
@@ -384,6 +522,8 @@ static void MarkRoot()
 {
 	PrevStepStats = StepStats;
 	StepStats.Reset();
+	PrevCycleStats = CycleStats;
+	CycleStats = {};
 
 	Gray = nullptr;
 
@@ -407,22 +547,134 @@ static void MarkRoot()
 	State = GCS_Propagate;
 }
 
+//==========================================================================
+//
+// MarkWorker
+//
+// Runs on every mark thread. Each one traces from its own gray list and
+// refills it in batches from the shared list. Threads with plenty of work
+// hand some of it back to the shared list whenever another one runs dry.
+// Marking is done once no thread is busy and the shared list is empty.
+//
+//==========================================================================
+
+static void MarkWorker()
+{
+	size_t bytes = 0, objects = 0;
+	LocalGray = nullptr;
+
+	std::unique_lock<std::mutex> lock(MarkMutex);
+	if (MarkDone)
+		return;
+	ActiveMarkers++;
+	while (true)
+	{
+		while (SharedGray.Size() == 0)
+		{
+			if (--ActiveMarkers == 0)
+			{
+				MarkDone = true;
+				MarkWake.notify_all();
+			}
+			else
+			{
+				MarkStarving = true;
+				MarkWake.wait(lock, [] { return MarkDone || SharedGray.Size() > 0; });
+			}
+			if (MarkDone)
+			{
+				MarkedBytes += bytes;
+				MarkedObjects += objects;
+				return;
+			}
+			ActiveMarkers++;
+		}
+
+		for (unsigned i = 0; i < GCMARKBATCH && SharedGray.Size() > 0; i++)
+		{
+			DObject *obj = SharedGray.Last();
+			SharedGray.Pop();
+			obj->GCNext = LocalGray;
+			LocalGray = obj;
+		}
+		lock.unlock();
+
+		while (LocalGray != nullptr)
+		{
+			bytes += PropagateMarkParallel();
+			objects++;
+
+			if (MarkStarving.load(std::memory_order_relaxed) && LocalGray != nullptr && LocalGray->GCNext != nullptr)
+			{
+				std::unique_lock<std::mutex> donate(MarkMutex);
+				for (unsigned i = 0; i < GCMARKBATCH && LocalGray->GCNext != nullptr; i++)
+				{
+					SharedGray.Push(LocalGray);
+					LocalGray = LocalGray->GCNext;
+				}
+				MarkStarving = false;
+				MarkWake.notify_all();
+			}
+		}
+		lock.lock();
+	}
+}
+
+//==========================================================================
+//
+// ParallelPropagate
+//
+// Propagates all marks on the gray list at once, on all hardware threads.
+//
+//==========================================================================
+
+static size_t ParallelPropagate()
+{
+	SharedGray.Clear();
+	for (DObject *obj = Gray; obj != nullptr; obj = obj->GCNext)
+	{
+		SharedGray.Push(obj);
+	}
+	Gray = nullptr;
+	ActiveMarkers = 0;
+	MarkDone = false;
+	MarkStarving = false;
+	MarkedBytes = 0;
+	MarkedObjects = 0;
+
+	ParallelMarking = true;
+	FThreadPool *pool = GetSharedThreadPool();
+	pool->Run(pool->GetThreadCount(), [](int) { MarkWorker(); });
+	ParallelMarking = false;
+
+	assert(SharedGray.Size() == 0 && Gray == nullptr);
+	CycleStats.Traced += MarkedObjects;
+	return MarkedBytes;
+}
+
 //==========================================================================
 //
 // Atomic
 //
-// If there were any propagations that needed to be done atomicly, they
-// would go here. It also sets things up for the sweep state.
+// Finishes the mark phase, with all threads if parallel marking is on,
+// and sets things up for the sweep state.
 //
 //==========================================================================
 
-static void Atomic()
+static size_t Atomic()
 {
+	size_t marked = 0;
+	if (gc_parallelmark && Gray != nullptr)
+	{
+		marked = ParallelPropagate();
+	}
+
 	// Flip current white
 	CurrentWhite = OtherWhite();
 	SweepPos = &Root;
 	State = GCS_Sweep;
 	Estimate = AllocBytes;
+	return marked;
 }
 
 //==========================================================================
@@ -457,14 +709,14 @@ static size_t SingleStep()
 		return 0;
 
 	case GCS_Propagate:
-		if (Gray != nullptr)
+		if (Gray != nullptr && !gc_parallelmark)
 		{
+			CycleStats.Traced++;
 			return PropagateMark();
 		}
 		else
 		{ // no more gray objects
-			Atomic();	// finish mark phase
-			return 0;
+			return Atomic();	// finish mark phase
 		}
 
 	case GCS_Sweep: {
@@ -550,6 +802,9 @@ void Step()
 	StepStats.Clock[enter_state].Unclock();
 	StepStats.BytesCovered[enter_state] += did;
 	GCTime.Unclock();
+	StepTimeMS += GCTime.TimeMS();
+	CycleStats.MaxPause = std::max(CycleStats.MaxPause, GCTime.TimeMS());
+	PeakPauseMS = std::max(PeakPauseMS, GCTime.TimeMS());
 }
 
 //==========================================================================
@@ -787,6 +1042,15 @@ ADD_STAT(gc)
 		(GC::AllocBytes + 1023) >> 10,
 		(GC::Estimate + 1023) >> 10,
 		(GC::Threshold + 1023) >> 10);
+	out.AppendFormat("\nCycle  Pause:%6.2fms (peak %6.2fms)  Traced:%7zu  Survivors:%7zu  Freed:%6zu%s",
+		GC::PrevCycleStats.MaxPause,
+		GC::PeakPauseMS,
+		GC::PrevCycleStats.Traced,
+		GC::PrevCycleStats.Survivors,
+		GC::PrevCycleStats.Freed,
+		gc_parallelmark ? "  [parallel mark]" : "");
+	out << "\n";
+	GC::SlabStats(out);
 	return out;
 }
 
@@ -3,6 +3,7 @@
 #include "tarray.h"
 class DObject;
 class FSerializer;
+class FString;
 
 enum EObjectFlags
 {
@@ -80,6 +81,9 @@ namespace GC
 	// Is this the final collection just before exit?
 	extern bool FinalGC;
 
+	// Accumulated time spent in collection steps, in milliseconds.
+	extern double StepTimeMS;
+
 	// Current white value for known-dead objects.
 	static inline uint32_t OtherWhite()
 	{
@@ -92,6 +96,18 @@ namespace GC
 	// Does a complete collection.
 	void FullGC();
 
+	// Zeroed storage for a DObject, taken from the size-class slabs. See dobjpool.cpp.
+	void *AllocObject(size_t size);
+
+	// Returns storage obtained from AllocObject.
+	void FreeObject(void *mem);
+
+	// Frees slabs that no longer contain any live objects.
+	void ReclaimSlabs();
+
+	// Appends pool occupancy to the gc stat.
+	void SlabStats(FString &out);
+
 	// Handles the grunt work for a write barrier.
 	void Barrier(DObject *pointing, DObject *pointed);
 
@@ -137,6 +153,10 @@ namespace GC
 	// Marks an array of objects.
 	void MarkArray(DObject **objs, size_t count);
 
+	// Like Mark, but also puts a black object back on the gray list. Used by
+	// objects that spread their PropagateMark over several steps.
+	void Rescan(DObject *obj);
+
 	// For cleanup
 	void DelSoftRootHead();
 
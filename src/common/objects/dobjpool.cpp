@@ -0,0 +1,279 @@
+/*
+** dobjpool.cpp
+**
+** Slab allocator for DObject storage
+**
+** Objects are grouped into size classes. Each class hands out fixed-size
+** slots from large slabs and keeps freed slots on a free list, so the
+** constant spawning and collecting of short lived actors no longer goes
+** through the general purpose heap. Every slot is preceded by a small
+** header pointing back to its slab. Objects that are too large for any
+** class get a header with no slab and are allocated individually.
+**
+** Slabs that no longer hold any live object are returned to the system
+** by ReclaimSlabs, which runs after the full collection on level unload.
+**
+** Everything here is plain data without destructors, because objects can
+** still be freed during static destruction at exit.
+**
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <new>
+#include "dobjgc.h"
+#include "zstring.h"
+
+namespace GC
+{
+
+struct FObjectSizeClass;
+
+struct FObjectSlab
+{
+	FObjectSizeClass *Class;
+	FObjectSlab *Next;
+	uint8_t *Memory;
+	unsigned Live;
+};
+
+struct alignas(16) FObjectHeader
+{
+	FObjectSlab *Slab;	// nullptr for objects that are allocated individually
+	size_t Size;		// only set for those
+};
+
+struct FObjectFreeSlot
+{
+	FObjectFreeSlot *Next;
+};
+
+struct FObjectSizeClass
+{
+	size_t SlotSize;	// including the header
+	unsigned SlotsPerSlab;
+	FObjectSlab *Slabs;
+	FObjectFreeSlot *FreeList;
+	unsigned NumSlabs;
+	size_t Live;
+};
+
+// 32 byte steps up to 512, 128 byte steps up to 2048, 512 byte steps up to 8192.
+static constexpr int NUM_SIZE_CLASSES = 16 + 12 + 12;
+static constexpr size_t MAX_POOLED_SIZE = 8192;
+static constexpr size_t SLAB_SIZE = 65536;
+static constexpr unsigned MIN_SLOTS_PER_SLAB = 8;
+
+static FObjectSizeClass SizeClasses[NUM_SIZE_CLASSES];
+static size_t LargeObjects;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static int GetSizeClass(size_t size)
+{
+	if (size <= 512) return int((size + 31) / 32) - 1;
+	if (size <= 2048) return 15 + int((size - 512 + 127) / 128);
+	if (size <= MAX_POOLED_SIZE) return 27 + int((size - 2048 + 511) / 512);
+	return -1;
+}
+
+static size_t GetClassObjectSize(int index)
+{
+	if (index < 16) return (index + 1) * 32;
+	if (index < 28) return 512 + (index - 15) * 128;
+	return 2048 + (index - 27) * 512;
+}
+
+static FObjectSizeClass *GetClass(int index)
+{
+	auto cls = &SizeClasses[index];
+	if (cls->SlotSize == 0)
+	{
+		cls->SlotSize = sizeof(FObjectHeader) + GetClassObjectSize(index);
+		cls->SlotsPerSlab = std::max<unsigned>(MIN_SLOTS_PER_SLAB, unsigned(SLAB_SIZE / cls->SlotSize));
+	}
+	return cls;
+}
+
+static void AddSlab(FObjectSizeClass *cls)
+{
+	auto slab = (FObjectSlab *)malloc(sizeof(FObjectSlab));
+	auto memory = (uint8_t *)malloc(cls->SlotSize * cls->SlotsPerSlab);
+	if (slab == nullptr || memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	slab->Class = cls;
+	slab->Memory = memory;
+	slab->Live = 0;
+	slab->Next = cls->Slabs;
+	cls->Slabs = slab;
+	cls->NumSlabs++;
+
+	// Thread the slots in ascending order so that new objects are laid out contiguously.
+	for (unsigned i = cls->SlotsPerSlab; i-- > 0; )
+	{
+		auto header = (FObjectHeader *)(memory + i * cls->SlotSize);
+		header->Slab = slab;
+		auto slot = (FObjectFreeSlot *)(header + 1);
+		slot->Next = cls->FreeList;
+		cls->FreeList = slot;
+	}
+}
+
+//==========================================================================
+//
+// AllocObject
+//
+// Returns zeroed storage for an object of the given size.
+//
+//==========================================================================
+
+void *AllocObject(size_t size)
+{
+	int index = GetSizeClass(size);
+	if (index < 0)
+	{
+		auto header = (FObjectHeader *)calloc(1, sizeof(FObjectHeader) + size);
+		if (header == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		header->Slab = nullptr;
+		header->Size = size;
+		LargeObjects++;
+		ReportAlloc(size);
+		return header + 1;
+	}
+
+	auto cls = GetClass(index);
+	if (cls->FreeList == nullptr)
+	{
+		AddSlab(cls);
+	}
+	auto slot = cls->FreeList;
+	cls->FreeList = slot->Next;
+
+	auto header = (FObjectHeader *)slot - 1;
+	header->Slab->Live++;
+	cls->Live++;
+	size_t objsize = cls->SlotSize - sizeof(FObjectHeader);
+	memset(slot, 0, objsize);
+	ReportAlloc(objsize);
+	return slot;
+}
+
+//==========================================================================
+//
+// FreeObject
+//
+//==========================================================================
+
+void FreeObject(void *mem)
+{
+	if (mem == nullptr)
+		return;
+
+	auto header = (FObjectHeader *)mem - 1;
+	auto slab = header->Slab;
+	if (slab == nullptr)
+	{
+		LargeObjects--;
+		ReportDealloc(header->Size);
+		free(header);
+		return;
+	}
+
+	auto cls = slab->Class;
+	assert(slab->Live > 0);
+	slab->Live--;
+	cls->Live--;
+	ReportDealloc(cls->SlotSize - sizeof(FObjectHeader));
+
+	auto slot = (FObjectFreeSlot *)mem;
+	slot->Next = cls->FreeList;
+	cls->FreeList = slot;
+}
+
+//==========================================================================
+//
+// ReclaimSlabs
+//
+// Frees all slabs without live objects. Their slots must first be taken
+// off the free list, which is rebuilt from the slots that remain.
+//
+//==========================================================================
+
+void ReclaimSlabs()
+{
+	for (auto &cls : SizeClasses)
+	{
+		bool anyempty = false;
+		for (auto slab = cls.Slabs; slab != nullptr; slab = slab->Next)
+		{
+			anyempty |= slab->Live == 0;
+		}
+		if (!anyempty)
+			continue;
+
+		FObjectFreeSlot *freelist = nullptr;
+		FObjectFreeSlot **tail = &freelist;
+		for (auto slot = cls.FreeList; slot != nullptr; slot = slot->Next)
+		{
+			if (((FObjectHeader *)slot - 1)->Slab->Live > 0)
+			{
+				*tail = slot;
+				tail = &slot->Next;
+			}
+		}
+		*tail = nullptr;
+		cls.FreeList = freelist;
+
+		for (FObjectSlab **prev = &cls.Slabs; *prev != nullptr; )
+		{
+			auto slab = *prev;
+			if (slab->Live == 0)
+			{
+				*prev = slab->Next;
+				free(slab->Memory);
+				free(slab);
+				cls.NumSlabs--;
+			}
+			else
+			{
+				prev = &slab->Next;
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+// SlabStats
+//
+// One line of pool occupancy for the gc stat.
+//
+//==========================================================================
+
+void SlabStats(FString &out)
+{
+	unsigned slabs = 0;
+	size_t slots = 0, live = 0, bytes = 0;
+	for (auto &cls : SizeClasses)
+	{
+		slabs += cls.NumSlabs;
+		slots += size_t(cls.NumSlabs) * cls.SlotsPerSlab;
+		live += cls.Live;
+		bytes += size_t(cls.NumSlabs) * cls.SlotsPerSlab * cls.SlotSize;
+	}
+	out.AppendFormat("Slabs:%5u (%6zuK)  Objects:%7zu/%7zu (%5.1f%%)  Large:%5zu",
+		slabs, (bytes + 1023) >> 10, live, slots, slots ? live * 100. / slots : 0., LargeObjects);
+}
+
+}
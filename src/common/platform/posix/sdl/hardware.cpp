@@ -42,6 +42,7 @@
 #include "m_argv.h"
 #include "c_console.h"
 #include "printf.h"
+#include "cpu_framebuffer.h"
 
 IVideo *Video;
 
@@ -68,6 +69,13 @@ void I_InitGraphics ()
 #endif // __APPLE__
 	SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0");
 
+	// No window and no GPU: everything is drawn into system memory.
+	if (Args->CheckParm("-headless"))
+	{
+		Video = new CPUVideo;
+		return;
+	}
+
 	if (SDL_InitSubSystem (SDL_INIT_VIDEO) < 0)
 	{
 		I_FatalError ("Could not initialize SDL video:\n%s\n", SDL_GetError());
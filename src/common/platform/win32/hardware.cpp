@@ -43,6 +43,7 @@
 #include "m_argv.h"
 #include "version.h"
 #include "printf.h"
+#include "cpu_framebuffer.h"
 #ifdef HAVE_VULKAN
 #include "win32vulkanvideo.h"
 #endif
@@ -85,6 +86,13 @@ void I_InitGraphics ()
 		// are the active app. Huh?
 	}
 
+	// No GPU: everything is drawn into system memory.
+	if (Args->CheckParm("-headless"))
+	{
+		Video = new CPUVideo;
+		return;
+	}
+
 #ifdef HAVE_VULKAN
 	Video = new Win32VulkanVideo();
 #endif
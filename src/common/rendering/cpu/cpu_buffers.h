@@ -0,0 +1,37 @@
+#pragma once
+
+#include "tarray.h"
+#include "buffers.h"
+#include <string.h>
+
+// Vertex and index data of the CPU backend. Nothing gets uploaded anywhere,
+// so this is just memory the 2D rasterizer and the level setup can read back.
+class CPUBuffer : public IBuffer
+{
+	TArray<uint8_t> mData;
+
+public:
+	void SetData(size_t size, const void *data, BufferUsageType type) override
+	{
+		mData.Resize((unsigned)size);
+		if (data && size) memcpy(mData.Data(), data, size);
+		buffersize = size;
+		map = mData.Data();
+	}
+
+	void SetSubData(size_t offset, size_t size, const void *data) override
+	{
+		assert(offset + size <= buffersize);
+		memcpy(mData.Data() + offset, data, size);
+	}
+
+	void *Lock(unsigned int size) override
+	{
+		if (size > buffersize) SetData(size, nullptr, BufferUsageType::Stream);
+		return map;
+	}
+
+	void Unlock() override
+	{
+	}
+};
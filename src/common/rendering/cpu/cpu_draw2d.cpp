@@ -0,0 +1,477 @@
+/*
+**  CPU backend
+**
+**  2D drawing into the software framebuffer. This follows the hardware
+**  renderer's 2D path (see hw_draw2d.cpp and the scene shaders) closely
+**  enough for menus, the HUD and the console to come out the same.
+**
+*/
+
+#include <math.h>
+#include "cpu_draw2d.h"
+#include "cpu_hwtexture.h"
+#include "v_video.h"
+#include "hw_renderstate.h"
+#include "hw_clock.h"
+#include "palettecontainer.h"
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void CPUDraw2D::Draw(F2DDrawer *drawer, DCanvas *canvas)
+{
+	auto &vertices = drawer->mVertices;
+	auto &indices = drawer->mIndices;
+	auto &commands = drawer->mData;
+
+	if (commands.Size() == 0)
+	{
+		return;
+	}
+
+	twoD.Clock();
+
+	Dest = (uint32_t*)canvas->GetPixels();
+	Pitch = canvas->GetPitch();
+	Width = canvas->GetWidth();
+	Height = canvas->GetHeight();
+
+	// Every 2D pass starts with a cleared stencil that is not in use.
+	Stencil.Resize(Pitch * Height);
+	memset(Stencil.Data(), 0, Stencil.Size());
+	StencilTest = false;
+	StencilRef = screen->stencilValue;
+	StencilOp = SOP_Keep;
+	ColorWrite = true;
+
+	for (auto &cmd : commands)
+	{
+		if (cmd.isSpecial != SpecialDrawCommand::NotSpecial)
+		{
+			if (cmd.isSpecial == SpecialDrawCommand::EnableStencil)
+			{
+				StencilTest = cmd.stencilOn;
+			}
+			else if (cmd.isSpecial == SpecialDrawCommand::SetStencil)
+			{
+				StencilRef = screen->stencilValue + cmd.stencilOffs;
+				StencilOp = cmd.stencilOp;
+				if (cmd.stencilFlags != -1) ColorWrite = !(cmd.stencilFlags & SF_ColorMaskOff);
+			}
+			else if (cmd.isSpecial == SpecialDrawCommand::ClearStencil)
+			{
+				memset(Stencil.Data(), 0, Stencil.Size());
+			}
+			continue;
+		}
+
+		SetupCommand(cmd);
+
+		if (cmd.shape2DBufInfo != nullptr)
+		{
+			auto& buffers = cmd.shape2DBufInfo->buffers[cmd.shape2DBufIndex];
+			auto shapevertices = (F2DDrawer::TwoDVertex*)buffers.GetBufferObjects().first->Memory();
+			auto shapeindices = (int*)buffers.GetBufferObjects().second->Memory();
+			if (Style.BlendOp != STYLEOP_None && shapevertices != nullptr && shapeindices != nullptr)
+			{
+				for (int i = 0; i + 2 < cmd.shape2DIndexCount; i += 3)
+				{
+					DrawTriangle(TransformVertex(cmd, shapevertices[shapeindices[i]]),
+						TransformVertex(cmd, shapevertices[shapeindices[i + 1]]),
+						TransformVertex(cmd, shapevertices[shapeindices[i + 2]]));
+				}
+			}
+
+			// Same buffer bookkeeping as the hardware renderer.
+			if (cmd.shape2DCommandCounter == cmd.shape2DBufInfo->lastCommand)
+			{
+				cmd.shape2DBufInfo->lastCommand = -1;
+				if (cmd.shape2DBufInfo->bufIndex > 0)
+				{
+					cmd.shape2DBufInfo->needsVertexUpload = true;
+					cmd.shape2DBufInfo->buffers.Clear();
+					cmd.shape2DBufInfo->bufIndex = -1;
+				}
+			}
+			cmd.shape2DBufInfo->uploadedOnce = false;
+			continue;
+		}
+
+		if (Style.BlendOp == STYLEOP_None)
+		{
+			continue;
+		}
+
+		switch (cmd.mType)
+		{
+		default:
+		case F2DDrawer::DrawTypeTriangles:
+			for (int i = 0; i + 2 < cmd.mIndexCount; i += 3)
+			{
+				int index = cmd.mIndexIndex + i;
+				DrawTriangle(TransformVertex(cmd, vertices[indices[index]]),
+					TransformVertex(cmd, vertices[indices[index + 1]]),
+					TransformVertex(cmd, vertices[indices[index + 2]]));
+			}
+			break;
+
+		case F2DDrawer::DrawTypeLines:
+			for (int i = 0; i + 1 < cmd.mVertCount; i += 2)
+			{
+				DrawLine(TransformVertex(cmd, vertices[cmd.mVertIndex + i]), TransformVertex(cmd, vertices[cmd.mVertIndex + i + 1]));
+			}
+			break;
+
+		case F2DDrawer::DrawTypePoints:
+			for (int i = 0; i < cmd.mVertCount; i++)
+			{
+				Vertex v = TransformVertex(cmd, vertices[cmd.mVertIndex + i]);
+				DrawPixel((int)floorf(v.x), (int)floorf(v.y), v);
+			}
+			break;
+		}
+	}
+
+	twoD.Unclock();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void CPUDraw2D::SetupCommand(const F2DDrawer::RenderCommand &cmd)
+{
+	if (cmd.mFlags & F2DDrawer::DTF_Scissor)
+	{
+		ClipX1 = max(cmd.mScissor[0], 0);
+		ClipY1 = max(cmd.mScissor[1], 0);
+		ClipX2 = min(cmd.mScissor[2], Width);
+		ClipY2 = min(cmd.mScissor[3], Height);
+	}
+	else
+	{
+		ClipX1 = 0;
+		ClipY1 = 0;
+		ClipX2 = Width;
+		ClipY2 = Height;
+	}
+
+	Texture = nullptr;
+	Texels = nullptr;
+	if (cmd.mTexture != nullptr && cmd.mTexture->isValid())
+	{
+		// Canvas textures only exist on the GPU. Anything drawn with them stays untextured.
+		if (!cmd.mTexture->isHardwareCanvas())
+		{
+			Texture = CPUHardwareTexture::GetTexture(cmd.mTexture->GetTexture(), cmd.mTranslationId.index());
+			Texels = Texture->GetPixels();
+		}
+	}
+	Wrap = !!(cmd.mFlags & F2DDrawer::DTF_Wrap);
+	TextureMode = cmd.mDrawMode;
+
+	// The colormap range is stored at half intensity.
+	FixedColormap = cmd.mSpecialColormap[0].a != 0;
+	ColormapStart[0] = cmd.mSpecialColormap[0].r * (2.f / 255.f);
+	ColormapStart[1] = cmd.mSpecialColormap[0].g * (2.f / 255.f);
+	ColormapStart[2] = cmd.mSpecialColormap[0].b * (2.f / 255.f);
+	ColormapEnd[0] = cmd.mSpecialColormap[1].r * (2.f / 255.f);
+	ColormapEnd[1] = cmd.mSpecialColormap[1].g * (2.f / 255.f);
+	ColormapEnd[2] = cmd.mSpecialColormap[1].b * (2.f / 255.f);
+
+	Overlay[0] = cmd.mColor1.r * (1.f / 255.f);
+	Overlay[1] = cmd.mColor1.g * (1.f / 255.f);
+	Overlay[2] = cmd.mColor1.b * (1.f / 255.f);
+	Desaturate = cmd.mDesaturate * (1.f / 255.f);
+	Style = cmd.mRenderStyle;
+}
+
+CPUDraw2D::Vertex CPUDraw2D::TransformVertex(const F2DDrawer::RenderCommand &cmd, const F2DDrawer::TwoDVertex &v)
+{
+	Vertex result;
+	if (cmd.useTransform)
+	{
+		auto &m = cmd.transform;
+		result.x = float(m.Cells[0][0] * v.x + m.Cells[0][1] * v.y + m.Cells[0][2]);
+		result.y = float(m.Cells[1][0] * v.x + m.Cells[1][1] * v.y + m.Cells[1][2]);
+	}
+	else
+	{
+		result.x = v.x;
+		result.y = v.y;
+	}
+	result.u = v.u;
+	result.v = v.v;
+	result.r = v.color0.r * (1.f / 255.f);
+	result.g = v.color0.g * (1.f / 255.f);
+	result.b = v.color0.b * (1.f / 255.f);
+	result.a = v.color0.a * (1.f / 255.f);
+	return result;
+}
+
+//==========================================================================
+//
+// Fills the pixels whose centers are inside the triangle. Pixels on an
+// edge shared by two triangles are only drawn by one of them.
+//
+//==========================================================================
+
+static inline float EdgeFunction(const float ax, const float ay, const float bx, const float by, const float px, const float py)
+{
+	return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+static inline bool OwnsEdge(float stepx, float stepy)
+{
+	return stepx > 0 || (stepx == 0 && stepy > 0);
+}
+
+void CPUDraw2D::DrawTriangle(const Vertex &v0, const Vertex &in1, const Vertex &in2)
+{
+	const Vertex *v1 = &in1, *v2 = &in2;
+	float area = EdgeFunction(v0.x, v0.y, v1->x, v1->y, v2->x, v2->y);
+	if (area == 0)
+	{
+		return;
+	}
+	if (area < 0)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	int minx = max(ClipX1, (int)floorf(min(v0.x, min(v1->x, v2->x))));
+	int maxx = min(ClipX2 - 1, (int)ceilf(max(v0.x, max(v1->x, v2->x))));
+	int miny = max(ClipY1, (int)floorf(min(v0.y, min(v1->y, v2->y))));
+	int maxy = min(ClipY2 - 1, (int)ceilf(max(v0.y, max(v1->y, v2->y))));
+	if (minx > maxx || miny > maxy)
+	{
+		return;
+	}
+
+	// Steps of the three edge functions per pixel.
+	float stepx0 = -(v2->y - v1->y), stepy0 = v2->x - v1->x;
+	float stepx1 = -(v0.y - v2->y), stepy1 = v0.x - v2->x;
+	float stepx2 = -(v1->y - v0.y), stepy2 = v1->x - v0.x;
+	bool owns0 = OwnsEdge(stepx0, stepy0);
+	bool owns1 = OwnsEdge(stepx1, stepy1);
+	bool owns2 = OwnsEdge(stepx2, stepy2);
+	float invarea = 1.f / area;
+
+	for (int y = miny; y <= maxy; y++)
+	{
+		float px = minx + 0.5f, py = y + 0.5f;
+		float w0 = EdgeFunction(v1->x, v1->y, v2->x, v2->y, px, py);
+		float w1 = EdgeFunction(v2->x, v2->y, v0.x, v0.y, px, py);
+		float w2 = EdgeFunction(v0.x, v0.y, v1->x, v1->y, px, py);
+
+		for (int x = minx; x <= maxx; x++, w0 += stepx0, w1 += stepx1, w2 += stepx2)
+		{
+			if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+			if ((w0 == 0 && !owns0) || (w1 == 0 && !owns1) || (w2 == 0 && !owns2)) continue;
+
+			float b0 = w0 * invarea, b1 = w1 * invarea, b2 = w2 * invarea;
+			Shade(x, y,
+				b0 * v0.u + b1 * v1->u + b2 * v2->u,
+				b0 * v0.v + b1 * v1->v + b2 * v2->v,
+				b0 * v0.r + b1 * v1->r + b2 * v2->r,
+				b0 * v0.g + b1 * v1->g + b2 * v2->g,
+				b0 * v0.b + b1 * v1->b + b2 * v2->b,
+				b0 * v0.a + b1 * v1->a + b2 * v2->a);
+		}
+	}
+}
+
+void CPUDraw2D::DrawLine(const Vertex &v0, const Vertex &v1)
+{
+	float dx = v1.x - v0.x, dy = v1.y - v0.y;
+	int steps = (int)ceilf(max(fabsf(dx), fabsf(dy)));
+	if (steps == 0)
+	{
+		DrawPixel((int)floorf(v0.x), (int)floorf(v0.y), v0);
+		return;
+	}
+
+	// Like the hardware lines this leaves out the last pixel.
+	for (int i = 0; i < steps; i++)
+	{
+		float t = i / (float)steps;
+		DrawPixel((int)floorf(v0.x + dx * t), (int)floorf(v0.y + dy * t), v0);
+	}
+}
+
+void CPUDraw2D::DrawPixel(int x, int y, const Vertex &v)
+{
+	if (x >= ClipX1 && x < ClipX2 && y >= ClipY1 && y < ClipY2)
+	{
+		Shade(x, y, v.u, v.v, v.r, v.g, v.b, v.a);
+	}
+}
+
+//==========================================================================
+//
+// Texture lookup, color and blending for one pixel.
+//
+//==========================================================================
+
+static inline float Grayscale(float r, float g, float b)
+{
+	return r * 0.3f + g * 0.56f + b * 0.14f;
+}
+
+static inline void BlendFactor(int mode, const float *src, float srcalpha, const float *dst, float *factor)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		switch (mode)
+		{
+		default:
+		case STYLEALPHA_Zero:		factor[i] = 0; break;
+		case STYLEALPHA_One:		factor[i] = 1; break;
+		case STYLEALPHA_Src:		factor[i] = srcalpha; break;
+		case STYLEALPHA_InvSrc:		factor[i] = 1 - srcalpha; break;
+		case STYLEALPHA_SrcCol:		factor[i] = src[i]; break;
+		case STYLEALPHA_InvSrcCol:	factor[i] = 1 - src[i]; break;
+		case STYLEALPHA_DstCol:		factor[i] = dst[i]; break;
+		case STYLEALPHA_InvDstCol:	factor[i] = 1 - dst[i]; break;
+		case STYLEALPHA_Dst:		factor[i] = 1; break;	// the framebuffer is opaque
+		case STYLEALPHA_InvDst:		factor[i] = 0; break;
+		}
+	}
+}
+
+void CPUDraw2D::Shade(int x, int y, float u, float v, float r, float g, float b, float a)
+{
+	float texel[4] = { 1, 1, 1, 1 };
+	if (Texels)
+	{
+		int tw = Texture->GetWidth(), th = Texture->GetHeight();
+		int tx = (int)floorf(u * tw), ty = (int)floorf(v * th);
+		if (Wrap)
+		{
+			tx %= tw; if (tx < 0) tx += tw;
+			ty %= th; if (ty < 0) ty += th;
+		}
+		else
+		{
+			tx = clamp(tx, 0, tw - 1);
+			ty = clamp(ty, 0, th - 1);
+		}
+
+		if (Texture->GetTexelSize() == 4)
+		{
+			const uint8_t *p = Texels + (ty * tw + tx) * 4;
+			texel[0] = p[2] * (1.f / 255.f);
+			texel[1] = p[1] * (1.f / 255.f);
+			texel[2] = p[0] * (1.f / 255.f);
+			texel[3] = p[3] * (1.f / 255.f);
+		}
+		else
+		{
+			// The software renderer's paletted output.
+			PalEntry pe = GPalette.BaseColors[Texels[ty * tw + tx]];
+			texel[0] = pe.r * (1.f / 255.f);
+			texel[1] = pe.g * (1.f / 255.f);
+			texel[2] = pe.b * (1.f / 255.f);
+		}
+	}
+
+	if (FixedColormap)
+	{
+		float gray = Grayscale(texel[0], texel[1], texel[2]);
+		for (int i = 0; i < 3; i++)
+		{
+			texel[i] = clamp(ColormapStart[i] + gray * (ColormapEnd[i] - ColormapStart[i]), 0.f, 1.f);
+		}
+	}
+	else
+	{
+		switch (TextureMode)
+		{
+		case TM_STENCIL:
+			texel[0] = texel[1] = texel[2] = 1;
+			break;
+
+		case TM_OPAQUE:
+			texel[3] = 1;
+			break;
+
+		case TM_INVERSE:
+			texel[0] = 1 - texel[0]; texel[1] = 1 - texel[1]; texel[2] = 1 - texel[2];
+			break;
+
+		case TM_ALPHATEXTURE:
+			texel[3] *= Grayscale(texel[0], texel[1], texel[2]);
+			texel[0] = texel[1] = texel[2] = 1;
+			break;
+
+		case TM_CLAMPY:
+			if (v < 0 || v > 1) texel[3] = 0;
+			break;
+
+		case TM_INVERTOPAQUE:
+			texel[0] = 1 - texel[0]; texel[1] = 1 - texel[1]; texel[2] = 1 - texel[2];
+			texel[3] = 1;
+			break;
+		}
+
+		if (Desaturate > 0)
+		{
+			float gray = Grayscale(texel[0], texel[1], texel[2]);
+			for (int i = 0; i < 3; i++) texel[i] += (gray - texel[i]) * Desaturate;
+		}
+	}
+
+	float src[3] = { texel[0] * r + Overlay[0], texel[1] * g + Overlay[1], texel[2] * b + Overlay[2] };
+	float srcalpha = texel[3] * a;
+
+	// The alpha test of the 2D drawer.
+	if (srcalpha <= 0)
+	{
+		return;
+	}
+
+	int offset = y * Pitch + x;
+	if (StencilTest)
+	{
+		uint8_t &stencil = Stencil[offset];
+		if (stencil != (uint8_t)StencilRef) return;
+		if (StencilOp == SOP_Increment && stencil < 255) stencil++;
+		else if (StencilOp == SOP_Decrement && stencil > 0) stencil--;
+	}
+	if (!ColorWrite)
+	{
+		return;
+	}
+
+	uint32_t &dest = Dest[offset];
+	float dst[3] = { ((dest >> 16) & 0xff) * (1.f / 255.f), ((dest >> 8) & 0xff) * (1.f / 255.f), (dest & 0xff) * (1.f / 255.f) };
+
+	int op = Style.BlendOp & 15;
+	int srcmode = Style.SrcAlpha, destmode = Style.DestAlpha;
+	if (op > STYLEOP_RevSub)
+	{
+		// Fuzz styles have no 2D version.
+		srcmode = STYLEALPHA_DstCol;
+		destmode = STYLEALPHA_InvSrc;
+		op = STYLEOP_Add;
+	}
+
+	float srcfactor[3], destfactor[3];
+	BlendFactor(srcmode, src, srcalpha, dst, srcfactor);
+	BlendFactor(destmode, src, srcalpha, dst, destfactor);
+
+	uint32_t result = 0xff000000;
+	for (int i = 0; i < 3; i++)
+	{
+		float s = src[i] * srcfactor[i], d = dst[i] * destfactor[i];
+		float c = op == STYLEOP_Sub ? s - d : op == STYLEOP_RevSub ? d - s : s + d;
+		result |= (uint32_t)(clamp(c, 0.f, 1.f) * 255.f + 0.5f) << (16 - i * 8);
+	}
+	dest = result;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "tarray.h"
+#include "v_2ddrawer.h"
+
+class DCanvas;
+class CPUHardwareTexture;
+
+// Rasterizes the command list of a 2D drawer into a BGRA canvas, following what
+// the hardware renderer's 2D shader does with the same commands.
+class CPUDraw2D
+{
+public:
+	void Draw(F2DDrawer *drawer, DCanvas *canvas);
+
+private:
+	struct Vertex
+	{
+		float x, y, u, v;
+		float r, g, b, a;
+	};
+
+	void SetupCommand(const F2DDrawer::RenderCommand &cmd);
+	Vertex TransformVertex(const F2DDrawer::RenderCommand &cmd, const F2DDrawer::TwoDVertex &v);
+	void DrawTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2);
+	void DrawLine(const Vertex &v0, const Vertex &v1);
+	void DrawPixel(int x, int y, const Vertex &v);
+	void Shade(int x, int y, float u, float v, float r, float g, float b, float a);
+
+	// Target
+	uint32_t *Dest = nullptr;
+	int Pitch = 0;
+	int Width = 0, Height = 0;
+	TArray<uint8_t> Stencil;
+
+	// Current command
+	int ClipX1, ClipY1, ClipX2, ClipY2;
+	CPUHardwareTexture *Texture;
+	const uint8_t *Texels;
+	bool Wrap;
+	int TextureMode;
+	bool FixedColormap;
+	float ColormapStart[3], ColormapEnd[3];
+	float Overlay[3];
+	float Desaturate;
+	FRenderStyle Style;
+
+	// Stencil state. This stays set across commands.
+	bool StencilTest = false;
+	int StencilRef = 0;
+	int StencilOp = 0;
+	bool ColorWrite = true;
+};
@@ -0,0 +1,234 @@
+/*
+**  CPU backend
+**
+**  A framebuffer in system memory for running without a GPU. Only the
+**  software renderer can draw the 3D view into it.
+**
+*/
+
+#include <math.h>
+#include "cpu_framebuffer.h"
+#include "cpu_renderstate.h"
+#include "cpu_hwtexture.h"
+#include "cpu_buffers.h"
+#include "v_2ddrawer.h"
+#include "v_draw.h"
+#include "hw_clock.h"
+#include "m_png.h"
+#include "cmdlib.h"
+#include "printf.h"
+#include "c_cvars.h"
+#include "palutil.h"
+#include "fs_files.h"
+#include "version.h"
+
+EXTERN_CVAR(Int, vid_defwidth)
+EXTERN_CVAR(Int, vid_defheight)
+
+// Writes every presented frame (or every vid_dumpframeinterval'th) to this directory.
+CVAR(String, vid_dumpframes, "", 0)
+CVAR(Int, vid_dumpframeinterval, 1, 0)
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+DFrameBuffer *CPUVideo::CreateFrameBuffer()
+{
+	return new CPUFrameBuffer(vid_defwidth, vid_defheight);
+}
+
+CPUFrameBuffer::CPUFrameBuffer(int width, int height) : DFrameBuffer(width, height)
+{
+	ClientWidth = width;
+	ClientHeight = height;
+	mRenderState.reset(new CPURenderState());
+}
+
+CPUFrameBuffer::~CPUFrameBuffer()
+{
+}
+
+void CPUFrameBuffer::InitializeState()
+{
+	vendorstring = "None";
+	Printf("Using the CPU framebuffer (%d x %d). Nothing will be shown on screen.\n", ClientWidth, ClientHeight);
+}
+
+void CPUFrameBuffer::SetWindowSize(int w, int h)
+{
+	ClientWidth = max(w, VID_MIN_WIDTH);
+	ClientHeight = max(h, VID_MIN_HEIGHT);
+}
+
+//==========================================================================
+//
+// The canvas always has the size of the virtual screen.
+//
+//==========================================================================
+
+DCanvas *CPUFrameBuffer::GetCanvas()
+{
+	if (!Canvas || Canvas->GetWidth() != GetWidth() || Canvas->GetHeight() != GetHeight())
+	{
+		Canvas.reset(new DCanvas(GetWidth(), GetHeight(), true));
+	}
+	return Canvas.get();
+}
+
+FRenderState *CPUFrameBuffer::RenderState()
+{
+	return mRenderState.get();
+}
+
+IHardwareTexture *CPUFrameBuffer::CreateHardwareTexture(int numchannels)
+{
+	return new CPUHardwareTexture(numchannels);
+}
+
+IBuffer *CPUFrameBuffer::CreateVertexBuffer(int numBindingPoints, int numAttributes, size_t stride, const FVertexBufferAttribute* attrs)
+{
+	return new CPUBuffer;
+}
+
+IBuffer *CPUFrameBuffer::CreateIndexBuffer()
+{
+	return new CPUBuffer;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void CPUFrameBuffer::BeginFrame()
+{
+	auto canvas = GetCanvas();
+	memset(canvas->GetPixels(), 0, canvas->GetPitch() * canvas->GetHeight() * 4);
+}
+
+void CPUFrameBuffer::Draw2D()
+{
+	Drawer2D.Draw(twod, GetCanvas());
+}
+
+//==========================================================================
+//
+// Only the special colormaps and the flash of the software renderer's
+// output need to be done here. Bloom and the other effects need a GPU.
+//
+//==========================================================================
+
+void CPUFrameBuffer::PostProcessScene(bool swscene, int fixedcm, float flash, bool palettePostprocess, const std::function<void()> &afterBloomDrawEndScene2D)
+{
+	bool colormap = fixedcm >= CM_FIRSTSPECIALCOLORMAP && fixedcm < CM_MAXCOLORMAP;
+	if (colormap || flash != 1.f)
+	{
+		uint8_t flashmap[256];
+		for (int i = 0; i < 256; i++)
+		{
+			flashmap[i] = (uint8_t)clamp(powf(i / 255.f, flash) * 255.f + 0.5f, 0.f, 255.f);
+		}
+
+		float start[3] = { 0, 0, 0 }, range[3] = { 0, 0, 0 };
+		if (colormap)
+		{
+			FSpecialColormap *scm = &SpecialColormaps[fixedcm - CM_FIRSTSPECIALCOLORMAP];
+			for (int i = 0; i < 3; i++)
+			{
+				start[i] = scm->ColorizeStart[i] * 255.f;
+				range[i] = (scm->ColorizeEnd[i] - scm->ColorizeStart[i]) * 255.f;
+			}
+		}
+
+		auto canvas = GetCanvas();
+		for (int y = 0; y < canvas->GetHeight(); y++)
+		{
+			uint32_t *line = (uint32_t*)canvas->GetPixels() + y * canvas->GetPitch();
+			for (int x = 0; x < canvas->GetWidth(); x++)
+			{
+				int r = flashmap[(line[x] >> 16) & 0xff], g = flashmap[(line[x] >> 8) & 0xff], b = flashmap[line[x] & 0xff];
+				if (colormap)
+				{
+					float gray = (r * 0.3f + g * 0.56f + b * 0.14f) * (1.f / 255.f);
+					r = (int)clamp(start[0] + gray * range[0], 0.f, 255.f);
+					g = (int)clamp(start[1] + gray * range[1], 0.f, 255.f);
+					b = (int)clamp(start[2] + gray * range[2], 0.f, 255.f);
+				}
+				line[x] = 0xff000000 | (r << 16) | (g << 8) | b;
+			}
+		}
+	}
+
+	if (afterBloomDrawEndScene2D) afterBloomDrawEndScene2D();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void CPUFrameBuffer::Update()
+{
+	twoD.Reset();
+	Draw2D();
+	twod->Clear();
+
+	FPSLimit();
+	WriteFrame();
+
+	Super::Update();
+}
+
+void CPUFrameBuffer::WriteFrame()
+{
+	const char *path = vid_dumpframes;
+	int frame = FrameCount++;
+	if (*path == 0 || Canvas == nullptr || frame % max(*vid_dumpframeinterval, 1) != 0)
+	{
+		return;
+	}
+
+	FString filename = path;
+	if (filename.Back() != '/' && filename.Back() != '\\')
+	{
+		filename += '/';
+	}
+	CreatePath(filename.GetChars());
+	filename.AppendFormat("frame%06d.png", frame);
+
+	FileWriter *file = FileWriter::Open(filename.GetChars());
+	if (file == nullptr)
+	{
+		Printf("Could not write %s. Frame dumping has been stopped.\n", filename.GetChars());
+		vid_dumpframes = "";
+		return;
+	}
+	if (!M_CreatePNG(file, Canvas->GetPixels(), nullptr, SS_BGRA, Canvas->GetWidth(), Canvas->GetHeight(), Canvas->GetPitch() * 4, 1.f) || !M_FinishPNG(file))
+	{
+		Printf("Could not write %s.\n", filename.GetChars());
+	}
+	delete file;
+}
+
+TArray<uint8_t> CPUFrameBuffer::GetScreenshotBuffer(int &pitch, ESSType &color_type, float &gamma)
+{
+	auto canvas = GetCanvas();
+	int width = canvas->GetWidth();
+	int height = canvas->GetHeight();
+
+	TArray<uint8_t> buffer(width * height * 4, true);
+	for (int y = 0; y < height; y++)
+	{
+		memcpy(buffer.Data() + y * width * 4, canvas->GetPixels() + y * canvas->GetPitch() * 4, width * 4);
+	}
+
+	pitch = width * 4;
+	color_type = SS_BGRA;
+	gamma = 1.0f;
+	return buffer;
+}
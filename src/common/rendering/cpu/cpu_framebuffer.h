@@ -0,0 +1,58 @@
+#pragma once
+
+#include "v_video.h"
+#include "i_video.h"
+#include "cpu_draw2d.h"
+#include <memory>
+
+class CPURenderState;
+
+// Framebuffer that lives in system memory. The software renderer draws straight into
+// it, the 2D drawer is rasterized on top, and the result can be written out as PNG files.
+// Nothing is shown on screen, which makes this usable without a GPU or a window.
+class CPUFrameBuffer : public DFrameBuffer
+{
+	typedef DFrameBuffer Super;
+
+public:
+	CPUFrameBuffer(int width, int height);
+	~CPUFrameBuffer();
+
+	void InitializeState() override;
+	bool IsPoly() override { return true; }
+	const char* DeviceName() const override { return "CPU"; }
+
+	bool IsFullscreen() override { return false; }
+	int GetClientWidth() override { return ClientWidth; }
+	int GetClientHeight() override { return ClientHeight; }
+	void SetWindowSize(int w, int h) override;
+
+	DCanvas* GetCanvas() override;
+	FRenderState* RenderState() override;
+	IHardwareTexture *CreateHardwareTexture(int numchannels) override;
+	IBuffer* CreateVertexBuffer(int numBindingPoints, int numAttributes, size_t stride, const FVertexBufferAttribute* attrs) override;
+	IBuffer* CreateIndexBuffer() override;
+
+	void BeginFrame() override;
+	void Draw2D() override;
+	void PostProcessScene(bool swscene, int fixedcm, float flash, bool palettePostprocess, const std::function<void()> &afterBloomDrawEndScene2D) override;
+	void Update() override;
+
+	TArray<uint8_t> GetScreenshotBuffer(int &pitch, ESSType &color_type, float &gamma) override;
+
+private:
+	void WriteFrame();
+
+	int ClientWidth;
+	int ClientHeight;
+	std::unique_ptr<DCanvas> Canvas;
+	std::unique_ptr<CPURenderState> mRenderState;
+	CPUDraw2D Drawer2D;
+	int FrameCount = 0;
+};
+
+class CPUVideo : public IVideo
+{
+public:
+	DFrameBuffer *CreateFrameBuffer() override;
+};
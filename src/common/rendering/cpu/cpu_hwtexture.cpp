@@ -0,0 +1,82 @@
+/*
+**  CPU backend
+**
+**  Textures are kept in system memory in the layout the 2D rasterizer samples from.
+**
+*/
+
+#include "cpu_hwtexture.h"
+#include "textures.h"
+
+CPUHardwareTexture::CPUHardwareTexture(int numchannels)
+{
+	mTexelsize = numchannels;
+}
+
+//==========================================================================
+//
+// Returns the pixels of a texture, converting it on first use. Textures
+// filled by the software renderer already have theirs.
+//
+//==========================================================================
+
+CPUHardwareTexture *CPUHardwareTexture::GetTexture(FTexture *tex, int translation)
+{
+	auto hwtex = static_cast<CPUHardwareTexture*>(tex->SystemTextures.GetHardwareTexture(translation, 0));
+	if (hwtex == nullptr)
+	{
+		hwtex = new CPUHardwareTexture(4);
+		tex->SystemTextures.AddHardwareTexture(translation, 0, hwtex);
+		hwtex->Load(tex, translation);
+	}
+	return hwtex;
+}
+
+void CPUHardwareTexture::Load(FTexture *tex, int translation)
+{
+	FTextureBuffer texbuffer = tex->CreateTexBuffer(translation);
+	mWidth = texbuffer.mWidth;
+	mHeight = texbuffer.mHeight;
+	mTexelsize = 4;
+	bufferpitch = mWidth;
+	if (texbuffer.mBuffer != nullptr && mWidth > 0 && mHeight > 0)
+	{
+		mPixels.Resize(mWidth * mHeight * 4);
+		memcpy(mPixels.Data(), texbuffer.mBuffer, mPixels.Size());
+	}
+}
+
+//==========================================================================
+//
+// Software renderer output
+//
+//==========================================================================
+
+void CPUHardwareTexture::AllocateBuffer(int w, int h, int texelsize)
+{
+	if (mWidth != w || mHeight != h || mTexelsize != texelsize || mPixels.Size() == 0)
+	{
+		mWidth = w;
+		mHeight = h;
+		mTexelsize = texelsize;
+		mPixels.Resize(w * h * texelsize);
+		memset(mPixels.Data(), 0, mPixels.Size());
+	}
+	bufferpitch = w;
+}
+
+uint8_t *CPUHardwareTexture::MapBuffer()
+{
+	return mPixels.Size() > 0 ? mPixels.Data() : nullptr;
+}
+
+unsigned int CPUHardwareTexture::CreateTexture(unsigned char *buffer, int w, int h, int texunit, bool mipmap, const char *name)
+{
+	// Without a buffer this only marks the mapped buffer as complete, which needs no work here.
+	if (buffer)
+	{
+		AllocateBuffer(w, h, mTexelsize);
+		memcpy(mPixels.Data(), buffer, mPixels.Size());
+	}
+	return 0;
+}
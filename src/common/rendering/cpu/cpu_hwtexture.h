@@ -0,0 +1,35 @@
+#pragma once
+
+#include "tarray.h"
+#include "hw_ihwtexture.h"
+
+class FTexture;
+struct PalEntry;
+
+// Texture storage of the CPU backend. Normal textures are converted to BGRA once per
+// translation, the software renderer's output textures are filled through MapBuffer.
+class CPUHardwareTexture : public IHardwareTexture
+{
+public:
+	CPUHardwareTexture(int numchannels);
+
+	static CPUHardwareTexture *GetTexture(FTexture *tex, int translation);
+
+	// Software renderer stuff
+	void AllocateBuffer(int w, int h, int texelsize) override;
+	uint8_t *MapBuffer() override;
+	unsigned int CreateTexture(unsigned char *buffer, int w, int h, int texunit, bool mipmap, const char *name) override;
+
+	const uint8_t *GetPixels() const { return mPixels.Size() > 0 ? mPixels.Data() : nullptr; }
+	int GetWidth() const { return mWidth; }
+	int GetHeight() const { return mHeight; }
+	int GetTexelSize() const { return mTexelsize; }
+
+private:
+	void Load(FTexture *tex, int translation);
+
+	TArray<uint8_t> mPixels;
+	int mWidth = 0;
+	int mHeight = 0;
+	int mTexelsize = 4;
+};
@@ -0,0 +1,25 @@
+/*
+**  CPU backend
+**
+**  Render state that accepts the hardware renderer's data without drawing it.
+**
+*/
+
+#include "cpu_renderstate.h"
+
+CPURenderState::CPURenderState()
+{
+	Reset();
+}
+
+//==========================================================================
+//
+// The returned vertices are only valid until the next allocation.
+//
+//==========================================================================
+
+std::pair<FFlatVertex*, unsigned int> CPURenderState::AllocVertices(unsigned int count)
+{
+	unsigned int index = mVertices.Reserve(count);
+	return std::make_pair(mVertices.Data() + index, index);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "hw_renderstate.h"
+#include "flatvertices.h"
+
+// The CPU backend only runs the software renderer. The level setup still hands its
+// vertex data to the render state though, so this accepts all of it and draws nothing.
+class CPURenderState : public FRenderState
+{
+public:
+	CPURenderState();
+
+	// Vertices
+	std::pair<FFlatVertex*, unsigned int> AllocVertices(unsigned int count) override;
+	void SetShadowData(const TArray<FFlatVertex>& vertices, const TArray<uint32_t>& indexes) override { }
+	void UpdateShadowData(unsigned int index, const FFlatVertex* vertices, unsigned int count) override { }
+	void ResetVertices() override { mVertices.Clear(); }
+
+	// Buffers
+	int SetViewpoint(const HWViewpointUniforms& vp) override { return 0; }
+	void SetViewpoint(int index) override { }
+	void SetModelMatrix(const VSMatrix& matrix, const VSMatrix& normalMatrix) override { }
+	void SetTextureMatrix(const VSMatrix& matrix) override { }
+	int UploadLights(const FDynLightData& lightdata) override { return -1; }
+	int UploadBones(const TArray<VSMatrix>& bones) override { return -1; }
+	int UploadFogballs(const TArray<Fogball>& balls) override { return -1; }
+
+	// Draw commands
+	void ClearScreen() override { }
+
+	// Immediate render state change commands
+	bool SetDepthClamp(bool on) override { bool last = mDepthClamp; mDepthClamp = on; return last; }
+	void SetDepthMask(bool on) override { }
+	void SetDepthFunc(int func) override { }
+	void SetDepthRange(float min, float max) override { }
+	void SetColorMask(bool r, bool g, bool b, bool a) override { }
+	void SetStencil(int offs, int op, int flags = -1) override { }
+	void SetCulling(int mode) override { }
+	void Clear(int targets) override { }
+	void EnableStencil(bool on) override { }
+	void SetScissor(int x, int y, int w, int h) override { }
+	void SetViewport(int x, int y, int w, int h) override { }
+	void EnableDepthTest(bool on) override { }
+	void EnableLineSmooth(bool on) override { }
+	void EnableDrawBuffers(int count, bool apply = false) override { }
+
+protected:
+	void DoDraw(int dt, int index, int count, bool apply) override { }
+	void DoDrawIndexed(int dt, int index, int count, bool apply) override { }
+
+private:
+	TArray<FFlatVertex> mVertices;
+	bool mDepthClamp = true;
+};
@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <functional>
 #include <cfloat>
+#include <cstring>
 #ifndef NO_SSE
 #include <immintrin.h>
 #endif
@@ -44,6 +45,11 @@ CPUAccelStruct::CPUAccelStruct(LevelMesh* mesh) : Mesh(mesh)
 		int indexStart = instance * IndexesPerBLAS;
 		int indexEnd = std::min(indexStart + IndexesPerBLAS, Mesh->Mesh.IndexCount);
 		DynamicBLAS[instance] = CreateBLAS(indexStart, indexEnd - indexStart);
+		if (DynamicBLAS[instance])
+		{
+			LastUpdate.Built++;
+			LastUpdate.BuildTime += DynamicBLAS[instance]->GetBuildTimeMS();
+		}
 	}
 
 	CreateTLAS();
@@ -58,7 +64,8 @@ TraceHit CPUAccelStruct::FindFirstHit(const FVector3& rayStart, const FVector3&
 {
 	RayBBox ray(rayStart, rayEnd);
 	TraceHit hit;
-	FindFirstHit(ray, TLAS.Root, &hit);
+	if (TLAS.Root != -1)
+		FindFirstHit(ray, TLAS.Root, &hit);
 	return hit;
 }
 
@@ -94,48 +101,56 @@ void CPUAccelStruct::Update()
 		return;
 
 	DynamicBLASTime.ResetAndClock();
-	InstanceCount = (Mesh->Mesh.IndexCount + IndexesPerBLAS - 1) / IndexesPerBLAS;
 
-	bool reCreated = false;
-
-	if(InstanceCount > DynamicBLAS.size())
+	// AllocGeometry may have reallocated the vertex and index arrays
+	for (int instance = 0; instance < (int)DynamicBLAS.size(); instance++)
 	{
-		IndexesPerBLAS = ((Mesh->Mesh.Indexes.size() + 2) / 3 / DynamicBLAS.size() + 1) * 3;
-		InstanceCount = (Mesh->Mesh.IndexCount + IndexesPerBLAS - 1) / IndexesPerBLAS;
-		reCreated = true;
+		if (DynamicBLAS[instance])
+			DynamicBLAS[instance]->SetBuffers(Mesh->Mesh.Vertices.Data(), Mesh->Mesh.Vertices.Size(), &Mesh->Mesh.Indexes[instance * IndexesPerBLAS]);
 	}
 
+	// Add instances as the mesh grows rather than recreating the ones that already exist
+	InstanceCount = (Mesh->Mesh.IndexCount + IndexesPerBLAS - 1) / IndexesPerBLAS;
+	if (InstanceCount > (int)DynamicBLAS.size())
+		DynamicBLAS.resize(InstanceCount);
+
+	std::vector<bool> needsUpdate(InstanceCount);
 
-	if(reCreated)
+	for (const MeshBufferRange& range : Mesh->UploadRanges.Index.GetRanges())
 	{
-		for (int instance = 0; instance < InstanceCount; instance++)
+		int start = range.Start / IndexesPerBLAS;
+		int end = std::min((range.End + IndexesPerBLAS - 1) / IndexesPerBLAS, InstanceCount);
+		for (int i = start; i < end; i++)
 		{
-			int indexStart = instance * IndexesPerBLAS;
-			int indexEnd = std::min(indexStart + IndexesPerBLAS, Mesh->Mesh.IndexCount);
-			DynamicBLAS[instance] = CreateBLAS(indexStart, indexEnd - indexStart);
+			needsUpdate[i] = true;
 		}
 	}
-	else
+
+	LastUpdate = {};
+
+	for (int instance = 0; instance < InstanceCount; instance++)
 	{
-		std::vector<bool> needsUpdate(InstanceCount);
+		if (!needsUpdate[instance])
+			continue;
+
+		int indexStart = instance * IndexesPerBLAS;
+		int indexEnd = std::min(indexStart + IndexesPerBLAS, Mesh->Mesh.IndexCount);
+		auto& blas = DynamicBLAS[instance];
 
-		for (const MeshBufferRange& range : Mesh->UploadRanges.Index.GetRanges())
+		// Things like moving floors only change the vertices. Their tree can be kept and only needs new bounding boxes.
+		if (blas && blas->HasSameTriangles(&Mesh->Mesh.Indexes[indexStart], indexEnd - indexStart))
 		{
-			int start = range.Start / IndexesPerBLAS;
-			int end = range.End / IndexesPerBLAS;
-			for (int i = start; i < end; i++)
-			{
-				needsUpdate[i] = true;
-			}
+			blas->Refit();
+			LastUpdate.Refit++;
+			LastUpdate.RefitTime += blas->GetRefitTimeMS();
 		}
-
-		for (int instance = 0; instance < InstanceCount; instance++)
+		else
 		{
-			if (needsUpdate[instance])
+			blas = CreateBLAS(indexStart, indexEnd - indexStart);
+			if (blas)
 			{
-				int indexStart = instance * IndexesPerBLAS;
-				int indexEnd = std::min(indexStart + IndexesPerBLAS, Mesh->Mesh.IndexCount);
-				DynamicBLAS[instance] = CreateBLAS(indexStart, indexEnd - indexStart);
+				LastUpdate.Built++;
+				LastUpdate.BuildTime += blas->GetBuildTimeMS();
 			}
 		}
 	}
@@ -184,10 +199,10 @@ void CPUAccelStruct::Upload()
 
 	// Copy the BLAS nodes to the mesh node list and remember their locations
 	int offset = TLAS.Nodes.size();
-	int instance = 0;
 	std::vector<int> blasOffsets(DynamicBLAS.size());
-	for (auto& blas : DynamicBLAS)
+	for (int instance = 0; instance < (int)DynamicBLAS.size(); instance++)
 	{
+		auto& blas = DynamicBLAS[instance];
 		if (blas)
 		{
 			int blasStart = offset;
@@ -204,7 +219,6 @@ void CPUAccelStruct::Upload()
 				info.element_index = node.element_index != -1 ? indexStart + node.element_index : -1;
 				offset++;
 			}
-			instance++;
 		}
 	}
 
@@ -249,18 +263,13 @@ void CPUAccelStruct::CreateTLAS()
 	Scratch.leafs.clear();
 	Scratch.leafs.reserve(InstanceCount);
 	Scratch.centroids.clear();
-	Scratch.centroids.reserve(DynamicBLAS.size());
+	Scratch.centroids.resize(InstanceCount);
 	for (int i = 0; i < InstanceCount; i++)
 	{
 		if (DynamicBLAS[i])
 		{
 			Scratch.leafs.push_back(i);
-			Scratch.centroids.push_back(FVector4(DynamicBLAS[i]->GetBBox().Center, 1.0f));
-		}
-		else
-		{
-			Scratch.leafs.push_back(0);
-			Scratch.centroids.push_back(FVector4(-1000000.0f, -1000000.0f, -1000000.0f, 1.0f));
+			Scratch.centroids[i] = FVector4(DynamicBLAS[i]->GetBBox().Center, 1.0f);
 		}
 	}
 
@@ -394,13 +403,63 @@ void CPUAccelStruct::PrintStats()
 	{
 		if (DynamicBLAS[i])
 		{
-			Printf("#%d avg=%2.3f balanced=%2.3f nodes=%d buildtime=%2.3f ms\n", (int)i, (double)DynamicBLAS[i]->GetAverageDepth(), (double)DynamicBLAS[i]->GetBalancedDepth(), (int)DynamicBLAS[i]->GetNodes().size(), DynamicBLAS[i]->GetBuildTimeMS());
+			Printf("#%d avg=%2.3f balanced=%2.3f nodes=%d widenodes=%d buildtime=%2.3f ms refittime=%2.3f ms\n", (int)i, (double)DynamicBLAS[i]->GetAverageDepth(), (double)DynamicBLAS[i]->GetBalancedDepth(), (int)DynamicBLAS[i]->GetNodes().size(), (int)DynamicBLAS[i]->GetWideNodes().size(), DynamicBLAS[i]->GetBuildTimeMS(), DynamicBLAS[i]->GetRefitTimeMS());
 		}
 		else
 		{
 			Printf("#%d unused\n", (int)i);
 		}
 	}
+
+	Printf("Last update: %d built in %2.3f ms, %d refit in %2.3f ms\n", LastUpdate.Built, LastUpdate.BuildTime, LastUpdate.Refit, LastUpdate.RefitTime);
+	MeasureTraversal();
+}
+
+// Traces rays between random vertices of the mesh to see how fast the acceleration structure is
+void CPUAccelStruct::MeasureTraversal()
+{
+	const int numTriangles = Mesh->Mesh.IndexCount / 3;
+	if (numTriangles == 0 || TLAS.Root == -1)
+		return;
+
+	// Use a fixed seed so that the numbers can be compared between runs
+	uint32_t seed = 12345;
+	auto random = [&]() -> int {
+		seed = seed * 1664525 + 1013904223;
+		return (int)(seed >> 8);
+	};
+
+	const int numRays = 100000;
+	std::vector<FVector3> points;
+	points.reserve(numRays * 2);
+	for (int attempt = 0; attempt < numRays * 4 && (int)points.size() < numRays * 2; attempt++)
+	{
+		int element = (random() % numTriangles) * 3;
+		const unsigned int* triangle = &Mesh->Mesh.Indexes[element];
+		if (triangle[0] == triangle[1])
+			continue;
+
+		FVector3 centroid = (Mesh->Mesh.Vertices[triangle[0]].fPos() + Mesh->Mesh.Vertices[triangle[1]].fPos() + Mesh->Mesh.Vertices[triangle[2]].fPos()) * (1.0f / 3.0f);
+		points.push_back(centroid);
+	}
+	if (points.size() < 2)
+		return;
+
+	int rays = (int)points.size() / 2;
+	int hits = 0;
+
+	cycle_t timer;
+	timer.ResetAndClock();
+	for (int i = 0; i < rays; i++)
+	{
+		TraceHit hit = FindFirstHit(points[i * 2], points[i * 2 + 1]);
+		if (hit.triangle != -1)
+			hits++;
+	}
+	timer.Unclock();
+
+	double ms = timer.TimeMS();
+	Printf("Traversal: %d rays in %2.3f ms (%2.3f Mrays/s), %d hits\n", rays, ms, ms > 0.0 ? rays / (ms * 1000.0) : 0.0, hits);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -415,11 +474,14 @@ CPUBottomLevelAccelStruct::CPUBottomLevelAccelStruct(const FFlatVertex *vertices
 	cycle_t timer;
 	timer.ResetAndClock();
 
+	built_elements.assign(elements, elements + num_elements);
+
+	// The per triangle data is indexed by triangle, the leafs list only has the ones in use
 	scratch.leafs.clear();
 	scratch.leafs.reserve(num_triangles);
-	scratch.centroids.clear();
-	scratch.centroids.reserve(num_triangles);
-	int active_triangles = 0;
+	scratch.centroids.resize(num_triangles);
+	scratch.trianglemins.resize(num_triangles);
+	scratch.trianglemaxs.resize(num_triangles);
 	for (int i = 0; i < num_triangles; i++)
 	{
 		int element_index = i * 3;
@@ -429,22 +491,73 @@ CPUBottomLevelAccelStruct::CPUBottomLevelAccelStruct(const FFlatVertex *vertices
 		if (a == b)
 			continue;
 
-		FVector3 centroid = (vertices[a].fPos() + vertices[b].fPos() + vertices[c].fPos()) * (1.0f / 3.0f);
+		FVector3 pa = vertices[a].fPos();
+		FVector3 pb = vertices[b].fPos();
+		FVector3 pc = vertices[c].fPos();
+
 		scratch.leafs.push_back(i);
-		scratch.centroids.push_back(FVector4(centroid, 1.0f));
-		active_triangles++;
+		scratch.centroids[i] = FVector4((pa + pb + pc) * (1.0f / 3.0f), 1.0f);
+		scratch.trianglemins[i] = FVector3(std::min({ pa.X, pb.X, pc.X }), std::min({ pa.Y, pb.Y, pc.Y }), std::min({ pa.Z, pb.Z, pc.Z }));
+		scratch.trianglemaxs[i] = FVector3(std::max({ pa.X, pb.X, pc.X }), std::max({ pa.Y, pb.Y, pc.Y }), std::max({ pa.Z, pb.Z, pc.Z }));
 	}
 
-	size_t neededbuffersize = active_triangles * 2;
-	if (scratch.workbuffer.size() < neededbuffersize)
-		scratch.workbuffer.resize(neededbuffersize);
-
-	root = Subdivide(scratch.leafs.data(), (int)scratch.leafs.size(), scratch.centroids.data(), scratch.workbuffer.data());
+	nodes.reserve(scratch.leafs.size() * 2);
+	root = Subdivide(scratch.leafs.data(), (int)scratch.leafs.size(), scratch.centroids.data(), scratch.trianglemins.data(), scratch.trianglemaxs.data());
+	CreateWideNodes();
 
 	timer.Unclock();
 	buildtime = timer.TimeMS();
 }
 
+void CPUBottomLevelAccelStruct::SetBuffers(const FFlatVertex* vertices, int num_vertices, const unsigned int* elements)
+{
+	this->vertices = vertices;
+	this->num_vertices = num_vertices;
+	this->elements = elements;
+}
+
+bool CPUBottomLevelAccelStruct::HasSameTriangles(const unsigned int* elements, int num_elements) const
+{
+	return num_elements == (int)built_elements.size() && (num_elements == 0 || memcmp(elements, built_elements.data(), num_elements * sizeof(unsigned int)) == 0);
+}
+
+void CPUBottomLevelAccelStruct::Refit()
+{
+	if (root == -1)
+		return;
+
+	cycle_t timer;
+	timer.ResetAndClock();
+
+	// Subdivide adds the children before their parent
+	FVector3 margin(0.1f, 0.1f, 0.1f);
+	for (Node& node : nodes)
+	{
+		FVector3 min, max;
+		if (node.IsLeaf())
+		{
+			FVector3 pa = vertices[elements[node.element_index]].fPos();
+			FVector3 pb = vertices[elements[node.element_index + 1]].fPos();
+			FVector3 pc = vertices[elements[node.element_index + 2]].fPos();
+			min = FVector3(std::min({ pa.X, pb.X, pc.X }), std::min({ pa.Y, pb.Y, pc.Y }), std::min({ pa.Z, pb.Z, pc.Z })) - margin;
+			max = FVector3(std::max({ pa.X, pb.X, pc.X }), std::max({ pa.Y, pb.Y, pc.Y }), std::max({ pa.Z, pb.Z, pc.Z })) + margin;
+		}
+		else
+		{
+			const CollisionBBox& left = nodes[node.left].aabb;
+			const CollisionBBox& right = nodes[node.right].aabb;
+			min = FVector3(std::min(left.min.X, right.min.X), std::min(left.min.Y, right.min.Y), std::min(left.min.Z, right.min.Z));
+			max = FVector3(std::max(left.max.X, right.max.X), std::max(left.max.Y, right.max.Y), std::max(left.max.Z, right.max.Z));
+		}
+		node.aabb = CollisionBBox(min, max);
+	}
+
+	CreateWideNodes();
+
+	timer.Unclock();
+	refittime = timer.TimeMS();
+}
+
 TraceHit CPUBottomLevelAccelStruct::FindFirstHit(const FVector3 &ray_start, const FVector3 &ray_end)
 {
 	TraceHit hit;
@@ -462,7 +575,7 @@ TraceHit CPUBottomLevelAccelStruct::FindFirstHit(const FVector3 &ray_start, cons
 		float segstart = t / tracedist;
 		float segend = std::min(t + segmentlen, tracedist) / tracedist;
 
-		FindFirstHit(RayBBox(ray_start + ray_dir * segstart, ray_start + ray_dir * segend), root, &hit);
+		FindFirstHit(RayBBox(ray_start + ray_dir * segstart, ray_start + ray_dir * segend), wideroot, &hit);
 		if (hit.fraction < 1.0f)
 		{
 			hit.fraction = segstart * (1.0f - hit.fraction) + segend * hit.fraction;
@@ -475,32 +588,36 @@ TraceHit CPUBottomLevelAccelStruct::FindFirstHit(const FVector3 &ray_start, cons
 
 void CPUBottomLevelAccelStruct::FindFirstHit(const RayBBox &ray, int a, TraceHit *hit)
 {
-	if (IntersectionTest::ray_aabb(ray, nodes[a].aabb) == IntersectionTest::overlap)
+	const WideNode& node = widenodes[a];
+	int mask = IntersectionTest::ray_aabb4(ray, node);
+	for (int i = 0; i < 4; i++)
 	{
-		if (nodes[a].IsLeaf())
+		if ((mask & (1 << i)) == 0)
+			continue;
+
+		int child = node.children[i];
+		if (child >= 0)
 		{
+			FindFirstHit(ray, child, hit);
+		}
+		else if (child != -1)
+		{
+			int start_element = -(child + 2);
 			float baryB, baryC;
-			float t = IntersectTriangleRay(ray, a, baryB, baryC);
+			float t = IntersectTriangleRay(ray, start_element, baryB, baryC);
 			if (t < hit->fraction)
 			{
 				hit->fraction = t;
-				hit->triangle = nodes[a].element_index / 3;
+				hit->triangle = start_element / 3;
 				hit->b = baryB;
 				hit->c = baryC;
 			}
 		}
-		else
-		{
-			FindFirstHit(ray, nodes[a].left, hit);
-			FindFirstHit(ray, nodes[a].right, hit);
-		}
 	}
 }
 
-float CPUBottomLevelAccelStruct::IntersectTriangleRay(const RayBBox &ray, int a, float &barycentricB, float &barycentricC)
+float CPUBottomLevelAccelStruct::IntersectTriangleRay(const RayBBox &ray, int start_element, float &barycentricB, float &barycentricC)
 {
-	const int start_element = nodes[a].element_index;
-
 	FVector3 p[3] =
 	{
 		vertices[elements[start_element]].fPos(),
@@ -635,199 +752,72 @@ int CPUBottomLevelAccelStruct::SubdivideLeaf(int* triangles, int num_triangles)
 	return (int)nodes.size() - 1;
 }
 
-// Sadly, this seems to be slower than what the compiler generated :(
-// Use it in debug mode anyway as its time critical and faster there
-#if !defined(NO_SSE) && defined(_DEBUG)
-
-static const FVector3 axes[3] = { FVector3(-1.0f, 0.0f, 0.0f), FVector3(0.0f, -1.0f, 0.0f), FVector3(0.0f, 0.0f, -1.0f) };
-
-int CPUBottomLevelAccelStruct::Subdivide(int* triangles, int num_triangles, const FVector4* centroids, int* work_buffer)
+namespace
 {
-	if (num_triangles <= 1)
-		return SubdivideLeaf(triangles, num_triangles);
-
-	// Let the compiler optimize these into registers
-	const FFlatVertex* vertices = this->vertices;
-	const unsigned int* elements = this->elements;
-
-	// Find bounding box and median of the triangle centroids
-	__m128 mmedian = _mm_setzero_ps();
-	__m128 mmin = _mm_loadu_ps(reinterpret_cast<const float*>(&vertices[elements[triangles[0] * 3]]));
-	__m128 mmax = mmin;
-	for (int i = 0; i < num_triangles; i++)
+	struct SAHBin
 	{
-		int v = triangles[i];
-		int element_index = v + v + v; // triangles[i] * 3
-		for (int j = 0; j < 3; j++)
-		{
-			__m128 vertex = _mm_loadu_ps(reinterpret_cast<const float*>(&vertices[elements[element_index + j]]));
-			mmin = _mm_min_ps(mmin, vertex);
-			mmax = _mm_max_ps(mmax, vertex);
-		}
-
-		mmedian = _mm_add_ps(mmedian, _mm_loadu_ps(reinterpret_cast<const float*>(&centroids[triangles[i]])));
-	}
-	mmedian = _mm_div_ps(mmedian, _mm_set1_ps((float)num_triangles));
+		FVector3 min = FVector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		FVector3 max = FVector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		int count = 0;
 
-	// For numerical stability
-	mmin = _mm_sub_ps(mmin, _mm_set1_ps(0.1f));
-	mmax = _mm_add_ps(mmax, _mm_set1_ps(0.1f));
-
-	// FFlatVertex got Y and Z swapped
-	mmin = _mm_shuffle_ps(mmin, mmin, _MM_SHUFFLE(3, 1, 2, 0));
-	mmax = _mm_shuffle_ps(mmax, mmax, _MM_SHUFFLE(3, 1, 2, 0));
-
-	float min[4], max[4], median[4], axis_lengths[4];
-	_mm_store_ps(min, mmin);
-	_mm_store_ps(max, mmax);
-	_mm_store_ps(median, mmedian);
-	_mm_store_ps(axis_lengths, _mm_sub_ps(mmax, mmin));
-
-	// Find the longest axis
-#if 0
-	int axis_order[3] = { 0, 1, 2 };
-	std::sort(axis_order, axis_order + 3, [&](int a, int b) { return axis_lengths[a] > axis_lengths[b]; });
-#else
-	int axis_order[3];
-	if (axis_lengths[0] >= axis_lengths[1] && axis_lengths[0] >= axis_lengths[2])
-	{
-		axis_order[0] = 0;
-		if (axis_lengths[1] >= axis_lengths[2])
+		void Add(const FVector3& bmin, const FVector3& bmax)
 		{
-			axis_order[1] = 1;
-			axis_order[2] = 2;
+			min.X = std::min(min.X, bmin.X);
+			min.Y = std::min(min.Y, bmin.Y);
+			min.Z = std::min(min.Z, bmin.Z);
+			max.X = std::max(max.X, bmax.X);
+			max.Y = std::max(max.Y, bmax.Y);
+			max.Z = std::max(max.Z, bmax.Z);
 		}
-		else
-		{
-			axis_order[1] = 2;
-			axis_order[2] = 1;
-		}
-	}
-	else if (axis_lengths[1] >= axis_lengths[0] && axis_lengths[1] >= axis_lengths[2])
-	{
-		axis_order[0] = 1;
-		if (axis_lengths[0] >= axis_lengths[2])
-		{
-			axis_order[1] = 0;
-			axis_order[2] = 2;
-		}
-		else
-		{
-			axis_order[1] = 2;
-			axis_order[2] = 0;
-		}
-	}
-	else
-	{
-		axis_order[0] = 2;
-		if (axis_lengths[0] >= axis_lengths[1])
-		{
-			axis_order[1] = 0;
-			axis_order[2] = 1;
-		}
-		else
-		{
-			axis_order[1] = 1;
-			axis_order[2] = 0;
-		}
-	}
-#endif
 
-	// Try split at longest axis, then if that fails the next longest, and then the remaining one
-	int left_count, right_count;
-	for (int attempt = 0; attempt < 3; attempt++)
-	{
-		// Find the split plane for axis
-		const FVector3& axis = axes[axis_order[attempt]];
-		FVector4 plane(axis, median[0] * axis.X + median[1] * axis.Y + median[2] * axis.Z); // plane(axis, -dot(median, axis));
-
-		// Split triangles into two
-		left_count = 0;
-		right_count = 0;
-		for (int i = 0; i < num_triangles; i++)
+		float Area() const
 		{
-			int triangle = triangles[i];
-			int element_index = triangle * 3;
-
-			float side = centroids[triangles[i]] | plane; // dot(FVector4(centroids[triangles[i]], 1.0f), plane);
-			if (side >= 0.0f)
-			{
-				work_buffer[left_count] = triangle;
-				left_count++;
-			}
-			else
-			{
-				work_buffer[num_triangles + right_count] = triangle;
-				right_count++;
-			}
+			FVector3 size = max - min;
+			return size.X * size.Y + size.Y * size.Z + size.Z * size.X;
 		}
+	};
 
-		if (left_count != 0 && right_count != 0)
-			break;
-	}
+	enum { NumSAHBins = 16 };
 
-	// Check if something went wrong when splitting and do a random split instead
-	if (left_count == 0 || right_count == 0)
+	int GetSAHBin(float centroid, float start, float scale)
 	{
-		left_count = num_triangles / 2;
-		right_count = num_triangles - left_count;
-	}
-	else
-	{
-		// Move result back into triangles list:
-		for (int i = 0; i < left_count; i++)
-			triangles[i] = work_buffer[i];
-		for (int i = 0; i < right_count; i++)
-			triangles[i + left_count] = work_buffer[num_triangles + i];
+		return std::min((int)((centroid - start) * scale), NumSAHBins - 1);
 	}
-
-	// Create child nodes:
-	int left_index = -1;
-	int right_index = -1;
-	if (left_count > 0)
-		left_index = Subdivide(triangles, left_count, centroids, work_buffer);
-	if (right_count > 0)
-		right_index = Subdivide(triangles + left_count, right_count, centroids, work_buffer);
-
-	nodes.push_back(Node(FVector3(min[0], min[1], min[2]), FVector3(max[0], max[1], max[2]), left_index, right_index));
-	return (int)nodes.size() - 1;
 }
 
-#else
-
-int CPUBottomLevelAccelStruct::Subdivide(int *triangles, int num_triangles, const FVector4 *centroids, int *work_buffer)
+int CPUBottomLevelAccelStruct::Subdivide(int *triangles, int num_triangles, const FVector4 *centroids, const FVector3 *mins, const FVector3 *maxs)
 {
 	if (num_triangles <= 1)
 		return SubdivideLeaf(triangles, num_triangles);
 
-	// Let the compiler optimize these into registers
-	const FFlatVertex* vertices = this->vertices;
-	const unsigned int* elements = this->elements;
-
-	// Find bounding box and median of the triangle centroids
-	FVector3 median(0.0f, 0.0f, 0.0f);
-	FVector3 min, max;
-	min = vertices[elements[triangles[0] * 3]].fPos();
-	max = min;
-	for (int i = 0; i < num_triangles; i++)
+	// Find bounding box of the triangles and of their centroids
+	FVector3 min = mins[triangles[0]];
+	FVector3 max = maxs[triangles[0]];
+	FVector3 centroidmin = centroids[triangles[0]].XYZ();
+	FVector3 centroidmax = centroidmin;
+	for (int i = 1; i < num_triangles; i++)
 	{
-		int element_index = triangles[i] * 3;
-		for (int j = 0; j < 3; j++)
-		{
-			const FVector3 &vertex = vertices[elements[element_index + j]].fPos();
-
-			min.X = std::min(min.X, vertex.X);
-			min.Y = std::min(min.Y, vertex.Y);
-			min.Z = std::min(min.Z, vertex.Z);
-
-			max.X = std::max(max.X, vertex.X);
-			max.Y = std::max(max.Y, vertex.Y);
-			max.Z = std::max(max.Z, vertex.Z);
-		}
-
-		median += centroids[triangles[i]].XYZ();
+		int triangle = triangles[i];
+		const FVector3& tmin = mins[triangle];
+		const FVector3& tmax = maxs[triangle];
+		FVector3 centroid = centroids[triangle].XYZ();
+
+		min.X = std::min(min.X, tmin.X);
+		min.Y = std::min(min.Y, tmin.Y);
+		min.Z = std::min(min.Z, tmin.Z);
+
+		max.X = std::max(max.X, tmax.X);
+		max.Y = std::max(max.Y, tmax.Y);
+		max.Z = std::max(max.Z, tmax.Z);
+
+		centroidmin.X = std::min(centroidmin.X, centroid.X);
+		centroidmin.Y = std::min(centroidmin.Y, centroid.Y);
+		centroidmin.Z = std::min(centroidmin.Z, centroid.Z);
+
+		centroidmax.X = std::max(centroidmax.X, centroid.X);
+		centroidmax.Y = std::max(centroidmax.Y, centroid.Y);
+		centroidmax.Z = std::max(centroidmax.Z, centroid.Z);
 	}
-	median /= (float)num_triangles;
 
 	// For numerical stability
 	min.X -= 0.1f;
@@ -837,131 +827,164 @@ int CPUBottomLevelAccelStruct::Subdivide(int *triangles, int num_triangles, cons
 	max.Y += 0.1f;
 	max.Z += 0.1f;
 
-	// Find the longest axis
-	float axis_lengths[3] =
+	// Sort the centroids into bins along each axis and pick the split between two bins with the lowest surface area heuristic cost
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
 	{
-		max.X - min.X,
-		max.Y - min.Y,
-		max.Z - min.Z
-	};
+		float extent = centroidmax[axis] - centroidmin[axis];
+		if (extent <= 0.0f)
+			continue;
+		float scale = NumSAHBins / extent;
 
-#if 0
-	int axis_order[3] = { 0, 1, 2 };
-	std::sort(axis_order, axis_order + 3, [&](int a, int b) { return axis_lengths[a] > axis_lengths[b]; });
-#else
-	int axis_order[3];
-	if (axis_lengths[0] >= axis_lengths[1] && axis_lengths[0] >= axis_lengths[2])
-	{
-		axis_order[0] = 0;
-		if (axis_lengths[1] >= axis_lengths[2])
-		{
-			axis_order[1] = 1;
-			axis_order[2] = 2;
-		}
-		else
-		{
-			axis_order[1] = 2;
-			axis_order[2] = 1;
-		}
-	}
-	else if (axis_lengths[1] >= axis_lengths[0] && axis_lengths[1] >= axis_lengths[2])
-	{
-		axis_order[0] = 1;
-		if (axis_lengths[0] >= axis_lengths[2])
-		{
-			axis_order[1] = 0;
-			axis_order[2] = 2;
-		}
-		else
-		{
-			axis_order[1] = 2;
-			axis_order[2] = 0;
-		}
-	}
-	else
-	{
-		axis_order[0] = 2;
-		if (axis_lengths[0] >= axis_lengths[1])
-		{
-			axis_order[1] = 0;
-			axis_order[2] = 1;
-		}
-		else
+		SAHBin bins[NumSAHBins];
+		for (int i = 0; i < num_triangles; i++)
 		{
-			axis_order[1] = 1;
-			axis_order[2] = 0;
+			int triangle = triangles[i];
+			SAHBin& bin = bins[GetSAHBin(centroids[triangle][axis], centroidmin[axis], scale)];
+			bin.Add(mins[triangle], maxs[triangle]);
+			bin.count++;
 		}
-	}
-#endif
 
-	// Try split at longest axis, then if that fails the next longest, and then the remaining one
-	int left_count, right_count;
-	FVector3 axis;
-	for (int attempt = 0; attempt < 3; attempt++)
-	{
-		// Find the split plane for axis
-		switch (axis_order[attempt])
+		// Cost of everything to the right of each split
+		float right_area[NumSAHBins - 1];
+		int right_count[NumSAHBins - 1];
+		SAHBin right;
+		for (int i = NumSAHBins - 1; i > 0; i--)
 		{
-		default:
-		case 0: axis = FVector3(1.0f, 0.0f, 0.0f); break;
-		case 1: axis = FVector3(0.0f, 1.0f, 0.0f); break;
-		case 2: axis = FVector3(0.0f, 0.0f, 1.0f); break;
+			right.Add(bins[i].min, bins[i].max);
+			right.count += bins[i].count;
+			right_area[i - 1] = right.Area();
+			right_count[i - 1] = right.count;
 		}
-		FVector4 plane(axis, -(median | axis)); // plane(axis, -dot(median, axis));
 
-		// Split triangles into two
-		left_count = 0;
-		right_count = 0;
-		for (int i = 0; i < num_triangles; i++)
+		SAHBin left;
+		for (int i = 0; i < NumSAHBins - 1; i++)
 		{
-			int triangle = triangles[i];
-			int element_index = triangle * 3;
+			left.Add(bins[i].min, bins[i].max);
+			left.count += bins[i].count;
+			if (left.count == 0 || right_count[i] == 0)
+				continue;
 
-			float side = centroids[triangles[i]] | plane; // dot(FVector4(centroids[triangles[i]], 1.0f), plane);
-			if (side >= 0.0f)
+			float cost = left.Area() * left.count + right_area[i] * right_count[i];
+			if (cost < best_cost)
 			{
-				work_buffer[left_count] = triangle;
-				left_count++;
-			}
-			else
-			{
-				work_buffer[num_triangles + right_count] = triangle;
-				right_count++;
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i;
 			}
 		}
-
-		if (left_count != 0 && right_count != 0)
-			break;
 	}
 
-	// Check if something went wrong when splitting and do a random split instead
-	if (left_count == 0 || right_count == 0)
+	int left_count;
+	if (best_axis != -1)
 	{
-		left_count = num_triangles / 2;
-		right_count = num_triangles - left_count;
+		float start = centroidmin[best_axis];
+		float scale = NumSAHBins / (centroidmax[best_axis] - centroidmin[best_axis]);
+		int* middle = std::partition(triangles, triangles + num_triangles, [&](int triangle) {
+			return GetSAHBin(centroids[triangle][best_axis], start, scale) <= best_split;
+		});
+		left_count = (int)(middle - triangles);
 	}
 	else
 	{
-		// Move result back into triangles list:
-		for (int i = 0; i < left_count; i++)
-			triangles[i] = work_buffer[i];
-		for (int i = 0; i < right_count; i++)
-			triangles[i + left_count] = work_buffer[num_triangles + i];
+		// All the centroids are at the same spot
+		left_count = num_triangles / 2;
 	}
+	int right_count = num_triangles - left_count;
 
 	// Create child nodes:
-	int left_index = -1;
-	int right_index = -1;
-	if (left_count > 0)
-		left_index = Subdivide(triangles, left_count, centroids, work_buffer);
-	if (right_count > 0)
-		right_index = Subdivide(triangles + left_count, right_count, centroids, work_buffer);
+	int left_index = Subdivide(triangles, left_count, centroids, mins, maxs);
+	int right_index = Subdivide(triangles + left_count, right_count, centroids, mins, maxs);
 
 	nodes.push_back(Node(min, max, left_index, right_index));
 	return (int)nodes.size() - 1;
 }
 
-#endif
+void CPUBottomLevelAccelStruct::CreateWideNodes()
+{
+	widenodes.clear();
+	wideroot = -1;
+	if (root == -1)
+		return;
+
+	widenodes.reserve(nodes.size() / 2 + 1);
+	wideroot = CreateWideNode(root);
+}
+
+int CPUBottomLevelAccelStruct::CreateWideNode(int a)
+{
+	// Pull up grandchildren until there are four children, opening the biggest box first
+	int children[4];
+	int count = 0;
+	if (nodes[a].IsLeaf())
+	{
+		children[count++] = a;
+	}
+	else
+	{
+		children[count++] = nodes[a].left;
+		children[count++] = nodes[a].right;
+		while (count < 4)
+		{
+			int best = -1;
+			float best_area = -1.0f;
+			for (int i = 0; i < count; i++)
+			{
+				const Node& node = nodes[children[i]];
+				if (node.IsLeaf())
+					continue;
+
+				const FVector3& e = node.aabb.Extents;
+				float area = e.X * e.Y + e.Y * e.Z + e.Z * e.X;
+				if (area > best_area)
+				{
+					best_area = area;
+					best = i;
+				}
+			}
+			if (best == -1)
+				break;
+
+			const Node& node = nodes[children[best]];
+			children[best] = node.left;
+			children[count++] = node.right;
+		}
+	}
+
+	int index = (int)widenodes.size();
+	widenodes.push_back({});
+
+	WideNode widenode;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i < count)
+		{
+			const Node& node = nodes[children[i]];
+			widenode.centerX[i] = node.aabb.Center.X;
+			widenode.centerY[i] = node.aabb.Center.Y;
+			widenode.centerZ[i] = node.aabb.Center.Z;
+			widenode.extentX[i] = node.aabb.Extents.X;
+			widenode.extentY[i] = node.aabb.Extents.Y;
+			widenode.extentZ[i] = node.aabb.Extents.Z;
+			widenode.children[i] = node.IsLeaf() ? -(node.element_index + 2) : CreateWideNode(children[i]);
+		}
+		else
+		{
+			// Negative extents never overlap anything
+			widenode.centerX[i] = 0.0f;
+			widenode.centerY[i] = 0.0f;
+			widenode.centerZ[i] = 0.0f;
+			widenode.extentX[i] = -1e30f;
+			widenode.extentY[i] = -1e30f;
+			widenode.extentZ[i] = -1e30f;
+			widenode.children[i] = -1;
+		}
+	}
+	widenodes[index] = widenode;
+	return index;
+}
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -1015,3 +1038,65 @@ IntersectionTest::OverlapResult IntersectionTest::ray_aabb(const RayBBox &ray, c
 	return overlap;
 #endif
 }
+
+int IntersectionTest::ray_aabb4(const RayBBox &ray, const CPUBottomLevelAccelStruct::WideNode &node)
+{
+#ifndef NO_SSE
+
+	__m128 cx = _mm_sub_ps(_mm_set1_ps(ray.c.X), _mm_loadu_ps(node.centerX));
+	__m128 cy = _mm_sub_ps(_mm_set1_ps(ray.c.Y), _mm_loadu_ps(node.centerY));
+	__m128 cz = _mm_sub_ps(_mm_set1_ps(ray.c.Z), _mm_loadu_ps(node.centerZ));
+	__m128 hx = _mm_loadu_ps(node.extentX);
+	__m128 hy = _mm_loadu_ps(node.extentY);
+	__m128 hz = _mm_loadu_ps(node.extentZ);
+	__m128 vx = _mm_set1_ps(ray.v.X);
+	__m128 vy = _mm_set1_ps(ray.v.Y);
+	__m128 vz = _mm_set1_ps(ray.v.Z);
+	__m128 wx = _mm_set1_ps(ray.w.X);
+	__m128 wy = _mm_set1_ps(ray.w.Y);
+	__m128 wz = _mm_set1_ps(ray.w.Z);
+
+	__m128 clearsignbit = _mm_loadu_ps(reinterpret_cast<const float*>(clearsignbitmask));
+
+	// Same separating axis tests as ray_aabb, one box per lane
+	__m128 separated = _mm_cmpgt_ps(_mm_and_ps(cx, clearsignbit), _mm_add_ps(vx, hx));
+	separated = _mm_or_ps(separated, _mm_cmpgt_ps(_mm_and_ps(cy, clearsignbit), _mm_add_ps(vy, hy)));
+	separated = _mm_or_ps(separated, _mm_cmpgt_ps(_mm_and_ps(cz, clearsignbit), _mm_add_ps(vz, hz)));
+
+	__m128 lhs = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(cy, wz), _mm_mul_ps(cz, wy)), clearsignbit);
+	__m128 rhs = _mm_add_ps(_mm_mul_ps(hy, vz), _mm_mul_ps(hz, vy));
+	separated = _mm_or_ps(separated, _mm_cmpgt_ps(lhs, rhs));
+
+	lhs = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(cx, wz), _mm_mul_ps(cz, wx)), clearsignbit);
+	rhs = _mm_add_ps(_mm_mul_ps(hx, vz), _mm_mul_ps(hz, vx));
+	separated = _mm_or_ps(separated, _mm_cmpgt_ps(lhs, rhs));
+
+	lhs = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(cx, wy), _mm_mul_ps(cy, wx)), clearsignbit);
+	rhs = _mm_add_ps(_mm_mul_ps(hx, vy), _mm_mul_ps(hy, vx));
+	separated = _mm_or_ps(separated, _mm_cmpgt_ps(lhs, rhs));
+
+	return ~_mm_movemask_ps(separated) & 15;
+
+#else
+	const FVector3 &v = ray.v;
+	const FVector3 &w = ray.w;
+
+	int mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		FVector3 h(node.extentX[i], node.extentY[i], node.extentZ[i]);
+		FVector3 c = ray.c - FVector3(node.centerX[i], node.centerY[i], node.centerZ[i]);
+
+		if (std::abs(c.X) > v.X + h.X || std::abs(c.Y) > v.Y + h.Y || std::abs(c.Z) > v.Z + h.Z)
+			continue;
+
+		if (std::abs(c.Y * w.Z - c.Z * w.Y) > h.Y * v.Z + h.Z * v.Y ||
+			std::abs(c.X * w.Z - c.Z * w.X) > h.X * v.Z + h.Z * v.X ||
+			std::abs(c.X * w.Y - c.Y * w.X) > h.X * v.Y + h.Y * v.X)
+			continue;
+
+		mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
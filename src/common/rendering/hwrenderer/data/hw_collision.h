@@ -96,6 +96,8 @@ public:
 	std::vector<int> leafs;
 	std::vector<FVector4> centroids;
 	std::vector<int> workbuffer;
+	std::vector<FVector3> trianglemins;
+	std::vector<FVector3> trianglemaxs;
 };
 
 class CPUAccelStruct
@@ -115,6 +117,7 @@ private:
 	int Subdivide(int* instances, int numInstances, const FVector4* centroids, int* workBuffer);
 	std::unique_ptr<CPUBottomLevelAccelStruct> CreateBLAS(int indexStart, int indexCount);
 	void Upload();
+	void MeasureTraversal();
 
 	LevelMesh* Mesh = nullptr;
 
@@ -143,6 +146,14 @@ private:
 	int InstanceCount = 0;
 
 	AccelStructScratchBuffer Scratch;
+
+	struct
+	{
+		int Built = 0;
+		int Refit = 0;
+		double BuildTime = 0.0;
+		double RefitTime = 0.0;
+	} LastUpdate;
 };
 
 class CPUBottomLevelAccelStruct
@@ -155,11 +166,21 @@ public:
 	float GetAverageDepth() const;
 	float GetBalancedDepth() const;
 	double GetBuildTimeMS() const { return buildtime; }
+	double GetRefitTimeMS() const { return refittime; }
 
 	const CollisionBBox &GetBBox() const { return nodes[root].aabb; }
 
 	TraceHit FindFirstHit(const FVector3 &ray_start, const FVector3 &ray_end);
 
+	// Points the acceleration structure at the mesh arrays again after they were reallocated
+	void SetBuffers(const FFlatVertex* vertices, int num_vertices, const unsigned int* elements);
+
+	// True if the elements still describe the triangles the tree was built from
+	bool HasSameTriangles(const unsigned int* elements, int num_elements) const;
+
+	// Recalculates the bounding boxes after the vertices moved. The tree itself is kept as is.
+	void Refit();
+
 	struct Node
 	{
 		Node() = default;
@@ -174,24 +195,43 @@ public:
 		int element_index = -1;
 	};
 
+	// The binary tree collapsed into nodes with four children each, stored as structure of arrays.
+	// Only used for tracing on the CPU. The GPU gets the binary nodes.
+	struct WideNode
+	{
+		float centerX[4], centerY[4], centerZ[4];
+		float extentX[4], extentY[4], extentZ[4];
+		int children[4]; // Index of a wide node, -1 if unused, or -(element_index + 2) for a leaf
+	};
+
 	const std::vector<Node>& GetNodes() const { return nodes; }
+	const std::vector<WideNode>& GetWideNodes() const { return widenodes; }
 	int GetRoot() const { return root; }
 
 private:
 	const FFlatVertex* vertices = nullptr;
-	const int num_vertices = 0;
+	int num_vertices = 0;
 	const unsigned int *elements = nullptr;
 	int num_elements = 0;
 
 	std::vector<Node> nodes;
 	int root = -1;
 
+	std::vector<WideNode> widenodes;
+	int wideroot = -1;
+
+	// Copy of the elements at build time
+	std::vector<unsigned int> built_elements;
+
 	double buildtime = 0.0;
+	double refittime = 0.0;
 
 	void FindFirstHit(const RayBBox& ray, int a, TraceHit* hit);
-	float IntersectTriangleRay(const RayBBox &ray, int a, float &barycentricB, float &barycentricC);
-	int Subdivide(int *triangles, int num_triangles, const FVector4 *centroids, int *work_buffer);
+	float IntersectTriangleRay(const RayBBox &ray, int start_element, float &barycentricB, float &barycentricC);
+	int Subdivide(int *triangles, int num_triangles, const FVector4 *centroids, const FVector3 *mins, const FVector3 *maxs);
 	int SubdivideLeaf(int* triangles, int num_triangles);
+	void CreateWideNodes();
+	int CreateWideNode(int a);
 };
 
 class IntersectionTest
@@ -204,4 +244,7 @@ public:
 	};
 
 	static OverlapResult ray_aabb(const RayBBox &ray, const CollisionBBox &box);
+
+	// Returns a bit for each of the four children of the node that overlaps the ray
+	static int ray_aabb4(const RayBBox &ray, const CPUBottomLevelAccelStruct::WideNode &node);
 };
@@ -0,0 +1,564 @@
+
+#include "hw_cpulightmapper.h"
+#include "halffloat.h"
+#include "i_interface.h"
+#include "stats.h"
+#include "c_cvars.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cmath>
+
+EXTERN_CVAR(Bool, lm_sunlight);
+EXTERN_CVAR(Bool, lm_blur);
+EXTERN_CVAR(Bool, lm_ao);
+EXTERN_CVAR(Bool, lm_softshadows);
+
+static const float minDistance = 0.01f;
+
+static float RadicalInverse_VdC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f; // / 0x100000000
+}
+
+static FVector2 Hammersley(uint32_t i, uint32_t N)
+{
+	return FVector2(float(i) / float(N), RadicalInverse_VdC(i));
+}
+
+static FVector2 GetVogelDiskSample(int sampleIndex, int sampleCount, float phi)
+{
+	const float goldenAngle = float(M_PI) * (3.0f - std::sqrt(5.0f));
+	float r = std::sqrt((sampleIndex + 0.5f) / sampleCount);
+	float theta = sampleIndex * goldenAngle + phi;
+	return FVector2(std::cos(theta), std::sin(theta)) * r;
+}
+
+static float SmoothStep(float edge0, float edge1, float x)
+{
+	float t = clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+CPULightmapper::CPULightmapper(LevelMesh* mesh) : mesh(mesh)
+{
+}
+
+void CPULightmapper::Raytrace(const TArray<LightmapTile*>& tiles)
+{
+	if (!mesh || tiles.Size() == 0)
+		return;
+
+	// Same rules as VkLightmapper::GetRaytracePipelineIndex
+	useSoftShadows = RunningAsTool || lm_softshadows;
+	useAO = mesh->AmbientOcclusion && (RunningAsTool || lm_ao);
+	useSunlight = mesh->SunColor != FVector3(0.0f, 0.0f, 0.0f) && (RunningAsTool || lm_sunlight);
+	useBlur = lm_blur;
+
+	size_t textureDataSize = (size_t)mesh->Lightmap.TextureSize * mesh->Lightmap.TextureSize * mesh->Lightmap.TextureCount * 4;
+	if (mesh->Lightmap.TextureData.Size() != textureDataSize)
+	{
+		mesh->Lightmap.TextureData.Resize((unsigned int)textureDataSize);
+		memset(mesh->Lightmap.TextureData.Data(), 0, textureDataSize * sizeof(uint16_t));
+	}
+
+	cycle_t timer;
+	timer.ResetAndClock();
+
+	int numThreads = threadCount > 0 ? threadCount : std::max((int)std::thread::hardware_concurrency(), 1);
+	numThreads = std::min(numThreads, (int)tiles.Size());
+
+	// Tiles never overlap in the atlas, so each worker can write its results directly into the texture data
+	std::atomic<int> nextTile = { 0 };
+	std::atomic<uint32_t> pixels = { 0 };
+	auto workerMain = [&]()
+	{
+		WorkerData data;
+		while (true)
+		{
+			int i = nextTile.fetch_add(1);
+			if (i >= (int)tiles.Size())
+				break;
+
+			LightmapTile* tile = tiles[i];
+			if (tile->AtlasLocation.ArrayIndex < 0 || tile->AtlasLocation.ArrayIndex >= mesh->Lightmap.TextureCount)
+				continue;
+
+			BakeTile(tile, data);
+			pixels += tile->AtlasLocation.Area();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numThreads; i++)
+		threads.push_back(std::thread(workerMain));
+	workerMain();
+	for (auto& thread : threads)
+		thread.join();
+
+	for (LightmapTile* tile : tiles)
+	{
+		tile->ReceivedNewLight = false;
+		tile->NeedsInitialBake = false;
+		tile->GeometryUpdate = false;
+	}
+
+	timer.Unclock();
+	bakeTime = timer.TimeMS();
+	pixelCount = pixels;
+}
+
+void CPULightmapper::BakeTile(LightmapTile* tile, WorkerData& data)
+{
+	int width = tile->AtlasLocation.Width;
+	int height = tile->AtlasLocation.Height;
+	if (width <= 0 || height <= 0)
+		return;
+
+	unsigned int count = width * height;
+	data.bakeBuffer.Resize(count);
+	data.resolveBuffer.Resize(count);
+	data.positions.Resize(count);
+	data.surfaces.Resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		data.bakeBuffer[i] = FVector4(0.0f, 0.0f, 0.0f, -1.0f);
+		data.surfaces[i] = -1;
+	}
+
+	RasterizeSurfaces(tile, data);
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int i = x + y * width;
+			if (data.surfaces[i] != -1)
+				data.bakeBuffer[i] = TracePixel(data.positions[i], data.surfaces[i], (float)x, (float)y);
+		}
+	}
+
+	Resolve(width, height, data);
+	if (useBlur)
+		Blur(width, height, data);
+	CopyResult(tile, width, height, data);
+}
+
+void CPULightmapper::RasterizeSurfaces(LightmapTile* tile, WorkerData& data)
+{
+	// Find the world position and surface for the center of each texel the visible surfaces cover
+
+	int width = tile->AtlasLocation.Width;
+	int height = tile->AtlasLocation.Height;
+	const FVector3& worldToLocal = tile->Transform.TranslateWorldToLocal;
+	const FVector3& projU = tile->Transform.ProjLocalToU;
+	const FVector3& projV = tile->Transform.ProjLocalToV;
+
+	data.visibleSurfaces.Clear();
+	mesh->GetVisibleSurfaces(tile, data.visibleSurfaces);
+
+	for (int surfaceIndex : data.visibleSurfaces)
+	{
+		const LevelMeshSurface& surface = mesh->Mesh.Surfaces[surfaceIndex];
+		const uint32_t* elements = &mesh->Mesh.Indexes[surface.MeshLocation.StartElementIndex];
+		for (unsigned int e = 0; e + 2 < surface.MeshLocation.NumElements; e += 3)
+		{
+			FVector3 world[3];
+			FVector2 uv[3];
+			for (int j = 0; j < 3; j++)
+			{
+				world[j] = mesh->Mesh.Vertices[elements[e + j]].fPos();
+				FVector3 local = world[j] - worldToLocal;
+				uv[j] = FVector2(local | projU, local | projV);
+			}
+
+			float area = (uv[1].X - uv[0].X) * (uv[2].Y - uv[0].Y) - (uv[2].X - uv[0].X) * (uv[1].Y - uv[0].Y);
+			if (std::abs(area) < 1e-6f)
+				continue;
+			float invArea = 1.0f / area;
+
+			int x0 = std::max((int)std::floor(std::min({ uv[0].X, uv[1].X, uv[2].X })), 0);
+			int x1 = std::min((int)std::ceil(std::max({ uv[0].X, uv[1].X, uv[2].X })), width - 1);
+			int y0 = std::max((int)std::floor(std::min({ uv[0].Y, uv[1].Y, uv[2].Y })), 0);
+			int y1 = std::min((int)std::ceil(std::max({ uv[0].Y, uv[1].Y, uv[2].Y })), height - 1);
+
+			for (int y = y0; y <= y1; y++)
+			{
+				float py = y + 0.5f;
+				for (int x = x0; x <= x1; x++)
+				{
+					float px = x + 0.5f;
+					float w0 = ((uv[1].X - px) * (uv[2].Y - py) - (uv[2].X - px) * (uv[1].Y - py)) * invArea;
+					float w1 = ((uv[2].X - px) * (uv[0].Y - py) - (uv[0].X - px) * (uv[2].Y - py)) * invArea;
+					float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					int i = x + y * width;
+					data.positions[i] = world[0] * w0 + world[1] * w1 + world[2] * w2;
+					data.surfaces[i] = surfaceIndex;
+				}
+			}
+		}
+	}
+}
+
+void CPULightmapper::Resolve(int width, int height, WorkerData& data)
+{
+	// Fill texels not covered by any surface with the average of their covered neighbours (frag_resolve.glsl)
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const FVector4& center = data.bakeBuffer[x + y * width];
+			if (center.W != -1.0f)
+			{
+				data.resolveBuffer[x + y * width] = center;
+				continue;
+			}
+
+			FVector4 c(0.0f, 0.0f, 0.0f, 0.0f);
+			float count = 0.0f;
+			for (int yy = -1; yy <= 1; yy++)
+			{
+				for (int xx = -1; xx <= 1; xx++)
+				{
+					if (xx == 0 && yy == 0)
+						continue;
+					int px = clamp(x + xx, 0, width - 1);
+					int py = clamp(y + yy, 0, height - 1);
+					const FVector4& p = data.bakeBuffer[px + py * width];
+					if (p.W != -1.0f)
+					{
+						c += p;
+						count++;
+					}
+				}
+			}
+			data.resolveBuffer[x + y * width] = (count != 0.0f) ? c / count : FVector4(0.0f, 0.0f, 0.0f, -1.0f);
+		}
+	}
+}
+
+void CPULightmapper::Blur(int width, int height, WorkerData& data)
+{
+	// Two pass box blur that ignores unset texels (frag_blur.glsl)
+
+	auto clampedSample = [&](const TArray<FVector4>& src, int x, int y, const FVector4& center) -> FVector4
+	{
+		if (x < 0 || x >= width || y < 0 || y >= height)
+			return center;
+		const FVector4& f = src[x + y * width];
+		return f.W != -1.0f ? f : center;
+	};
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const FVector4& center = data.resolveBuffer[x + y * width];
+			if (center.W != -1.0f)
+				data.bakeBuffer[x + y * width] = center * 0.5f + clampedSample(data.resolveBuffer, x + 1, y, center) * 0.25f + clampedSample(data.resolveBuffer, x - 1, y, center) * 0.25f;
+			else
+				data.bakeBuffer[x + y * width] = center;
+		}
+	}
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const FVector4& center = data.bakeBuffer[x + y * width];
+			if (center.W != -1.0f)
+				data.resolveBuffer[x + y * width] = center * 0.5f + clampedSample(data.bakeBuffer, x, y + 1, center) * 0.25f + clampedSample(data.bakeBuffer, x, y - 1, center) * 0.25f;
+			else
+				data.resolveBuffer[x + y * width] = center;
+		}
+	}
+}
+
+void CPULightmapper::CopyResult(LightmapTile* tile, int width, int height, WorkerData& data)
+{
+	int textureSize = mesh->Lightmap.TextureSize;
+	uint16_t* dest = mesh->Lightmap.TextureData.Data() + (size_t)tile->AtlasLocation.ArrayIndex * textureSize * textureSize * 4;
+	for (int y = 0; y < height; y++)
+	{
+		uint16_t* line = dest + ((size_t)tile->AtlasLocation.X + (size_t)(tile->AtlasLocation.Y + y) * textureSize) * 4;
+		for (int x = 0; x < width; x++)
+		{
+			FVector4 c = data.resolveBuffer[x + y * width];
+			if (c.W == -1.0f)
+				c = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+			*(line++) = floatToHalf(c.X);
+			*(line++) = floatToHalf(c.Y);
+			*(line++) = floatToHalf(c.Z);
+			*(line++) = floatToHalf(c.W);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+FVector4 CPULightmapper::TracePixel(const FVector3& origin, int surfaceIndex, float fragX, float fragY)
+{
+	const LevelMeshSurface& surface = mesh->Mesh.Surfaces[surfaceIndex];
+	FVector3 normal = surface.Plane.XYZ();
+	float phi = fragX + fragY * 13.37f;
+
+	float sunAttenuation = useSunlight ? TraceSunAttenuation(origin, normal, phi) : 0.0f;
+
+	FVector3 incoming(0.0f, 0.0f, 0.0f);
+	for (int j = 0; j < surface.LightList.Count; j++)
+	{
+		int lightIndex = mesh->Mesh.LightIndexes[surface.LightList.Pos + j];
+		incoming += TraceLight(origin, normal, mesh->Mesh.Lights[lightIndex], phi);
+	}
+
+	if (useAO)
+	{
+		int fragoffset = int(fragX * 13.37f + fragY * 6.66f) % 9;
+		incoming *= TraceAmbientOcclusion(origin, normal, fragoffset);
+	}
+
+	return FVector4(incoming, sunAttenuation);
+}
+
+float CPULightmapper::TraceSunAttenuation(const FVector3& origin, const FVector3& normal, float phi)
+{
+	const FVector3& sunDir = mesh->SunDirection;
+
+	float angleAttenuation = std::max(normal | sunDir, 0.0f);
+	if (angleAttenuation == 0.0f)
+		return 0.0f;
+
+	const float dist = 65536.0f;
+
+	if (!useSoftShadows)
+		return TraceSunRayAttenuation(origin, minDistance, sunDir, dist);
+
+	FVector3 target = origin + sunDir * dist;
+	FVector3 v = (std::abs(sunDir.X) > std::abs(sunDir.Y)) ? FVector3(0.0f, 1.0f, 0.0f) : FVector3(1.0f, 0.0f, 0.0f);
+	FVector3 xdir = (sunDir ^ v).Unit();
+	FVector3 ydir = sunDir ^ xdir;
+
+	const float lightsize = 100.0f;
+	const int stepCount = 10;
+	float attenuation = 0.0f;
+	for (int i = 0; i < stepCount; i++)
+	{
+		FVector2 gridoffset = GetVogelDiskSample(i, stepCount, phi) * lightsize;
+		FVector3 pos = target + xdir * gridoffset.X + ydir * gridoffset.Y;
+		attenuation += TraceSunRayAttenuation(origin, minDistance, (pos - origin).Unit(), dist);
+	}
+	return attenuation / float(stepCount);
+}
+
+float CPULightmapper::TraceSunRayAttenuation(FVector3 origin, float tmin, FVector3 dir, float tmax)
+{
+	float attenuation = 1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		TraceResult result = TraceFirstHit(origin, tmin, dir, tmax);
+
+		// Stop if we hit nothing. We have to hit a sky surface to hit the sky.
+		if (result.surfaceIndex == -1)
+			return 0.0f;
+
+		const LevelMeshSurface& surface = mesh->Mesh.Surfaces[result.surfaceIndex];
+
+		// Stop if we hit the sky.
+		if (surface.IsSky)
+			return attenuation;
+
+		// Pass through surface texture
+		attenuation = PassAttenuationThroughSurface(surface, attenuation);
+
+		// Stop if there is no light left
+		if (attenuation <= 0.0f)
+			return 0.0f;
+
+		// Move to surface hit point
+		origin += dir * result.t;
+		tmax -= result.t;
+		if (tmax <= tmin)
+			return 0.0f;
+
+		// Move through the portal, if any
+		TransformRay(surface.PortalIndex, origin, dir);
+	}
+	return 0.0f;
+}
+
+FVector3 CPULightmapper::TraceLight(const FVector3& origin, const FVector3& normal, const LevelMeshLight& light, float phi)
+{
+	FVector3 incoming(0.0f, 0.0f, 0.0f);
+	float dist = (light.RelativeOrigin - origin).Length();
+	if (dist > minDistance && dist < light.Radius)
+	{
+		FVector3 dir = (light.RelativeOrigin - origin).Unit();
+
+		float distAttenuation = std::max(1.0f - (dist / light.Radius), 0.0f);
+		float angleAttenuation = std::max(normal | dir, 0.0f);
+		float spotAttenuation = 1.0f;
+		if (light.OuterAngleCos > -1.0f)
+		{
+			float cosDir = dir | light.SpotDir;
+			spotAttenuation = SmoothStep(light.OuterAngleCos, light.InnerAngleCos, cosDir);
+			spotAttenuation = std::max(spotAttenuation, 0.0f);
+		}
+
+		float attenuation = distAttenuation * angleAttenuation * spotAttenuation;
+		if (attenuation > 0.0f)
+		{
+			FVector3 rayColor = light.Color * (attenuation * light.Intensity);
+
+			if (useSoftShadows && light.SoftShadowRadius != 0.0f)
+			{
+				FVector3 v = (std::abs(dir.X) > std::abs(dir.Y)) ? FVector3(0.0f, 1.0f, 0.0f) : FVector3(1.0f, 0.0f, 0.0f);
+				FVector3 xdir = (dir ^ v).Unit();
+				FVector3 ydir = dir ^ xdir;
+
+				float lightsize = light.SoftShadowRadius;
+				const int stepCount = 10;
+				for (int i = 0; i < stepCount; i++)
+				{
+					FVector2 gridoffset = GetVogelDiskSample(i, stepCount, phi) * lightsize;
+					FVector3 pos = light.Origin + xdir * gridoffset.X + ydir * gridoffset.Y;
+					incoming += TracePointLightRay(origin, pos, minDistance, rayColor) / float(stepCount);
+				}
+			}
+			else
+			{
+				incoming += TracePointLightRay(origin, light.Origin, minDistance, rayColor);
+			}
+		}
+	}
+	return incoming;
+}
+
+FVector3 CPULightmapper::TracePointLightRay(FVector3 origin, const FVector3& lightpos, float tmin, FVector3 rayColor)
+{
+	FVector3 dir = (lightpos - origin).Unit();
+	float tmax = (lightpos - origin).Length();
+
+	for (int i = 0; i < 3; i++)
+	{
+		TraceResult result = TraceFirstHit(origin, tmin, dir, tmax);
+
+		// Stop if we hit nothing - the point light is visible.
+		if (result.surfaceIndex == -1)
+			return rayColor;
+
+		const LevelMeshSurface& surface = mesh->Mesh.Surfaces[result.surfaceIndex];
+
+		// Pass through surface texture
+		rayColor *= PassAttenuationThroughSurface(surface, 1.0f);
+
+		// Stop if there is no light left
+		if (rayColor.X + rayColor.Y + rayColor.Z <= 0.0f)
+			return FVector3(0.0f, 0.0f, 0.0f);
+
+		// Move to surface hit point
+		origin += dir * result.t;
+		tmax -= result.t;
+
+		// Move through the portal, if any
+		TransformRay(surface.PortalIndex, origin, dir);
+	}
+	return FVector3(0.0f, 0.0f, 0.0f);
+}
+
+float CPULightmapper::TraceAmbientOcclusion(const FVector3& origin, const FVector3& normal, int fragoffset)
+{
+	const float aoDistance = 100.0f;
+	const int sampleCount = 16;
+
+	FVector3 N = normal;
+	FVector3 up = std::abs(N.X) < std::abs(N.Y) ? FVector3(1.0f, 0.0f, 0.0f) : FVector3(0.0f, 1.0f, 0.0f);
+	FVector3 tangent = (up ^ N).Unit();
+	FVector3 bitangent = N ^ tangent;
+
+	float ambience = 0.0f;
+	for (int i = 0; i < sampleCount; i++)
+	{
+		FVector2 Xi = Hammersley(i * 9 + fragoffset, sampleCount * 9);
+		FVector3 H = FVector3(Xi.X * 2.0f - 1.0f, Xi.Y * 2.0f - 1.0f, 1.5f - Xi.Length()).Unit();
+		FVector3 L = tangent * H.X + bitangent * H.Y + N * H.Z;
+		ambience += clamp(TraceAORay(origin, minDistance, L, aoDistance) / aoDistance, 0.0f, 1.0f);
+	}
+	return ambience / float(sampleCount);
+}
+
+float CPULightmapper::TraceAORay(FVector3 origin, float tmin, FVector3 dir, float tmax)
+{
+	float tcur = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		TraceResult result = TraceFirstHit(origin, tmin, dir, tmax - tcur);
+		if (result.surfaceIndex == -1)
+			return tmax;
+
+		const LevelMeshSurface& surface = mesh->Mesh.Surfaces[result.surfaceIndex];
+
+		// Stop if hit sky portal
+		if (surface.IsSky)
+			return tmax;
+
+		// Stop if opaque surface
+		if (surface.PortalIndex == 0)
+			return tcur + result.t;
+
+		// Move to surface hit point
+		origin += dir * result.t;
+		tcur += result.t;
+		if (tcur >= tmax)
+			return tmax;
+
+		// Move through the portal, if any
+		TransformRay(surface.PortalIndex, origin, dir);
+	}
+	return tmax;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+CPULightmapper::TraceResult CPULightmapper::TraceFirstHit(const FVector3& origin, float tmin, const FVector3& dir, float tmax)
+{
+	TraceResult result;
+	if (tmax <= tmin)
+		return result;
+
+	FVector3 start = origin + dir * tmin;
+	FVector3 end = origin + dir * tmax;
+	TraceHit hit = mesh->Collision->FindFirstHit(start, end);
+	if (hit.triangle >= 0 && hit.fraction < 1.0f)
+	{
+		result.t = tmin + (tmax - tmin) * hit.fraction;
+		result.surfaceIndex = mesh->Mesh.SurfaceIndexes[hit.triangle];
+	}
+	return result;
+}
+
+float CPULightmapper::PassAttenuationThroughSurface(const LevelMeshSurface& surface, float attenuation)
+{
+	// The GPU version samples the surface texture here. We do not have the texture pixels available,
+	// so treat any textured surface as fully covered and only let its translucency through.
+	if (!surface.Texture)
+		return attenuation;
+	return attenuation * (1.0f - surface.Alpha);
+}
+
+void CPULightmapper::TransformRay(int portalIndex, FVector3& origin, FVector3& dir)
+{
+	const LevelMeshPortal& portal = mesh->Portals[portalIndex];
+	origin = portal.TransformPosition(origin);
+	dir = portal.TransformRotation(dir);
+}
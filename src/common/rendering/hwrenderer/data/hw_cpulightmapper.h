@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include "hw_levelmesh.h"
+
+// Bakes lightmap tiles on the CPU using the level mesh CPUAccelStruct.
+//
+// This is a port of the lightmap shaders (frag_raytrace, resolve and blur) so that
+// LIGHTMAP lumps can be built on machines without a Vulkan device. The result is
+// written into LevelMesh::Lightmap.TextureData in the same RGBA16F layout that
+// DFrameBuffer::DownloadLightmap produces.
+class CPULightmapper
+{
+public:
+	CPULightmapper(LevelMesh* mesh);
+
+	// Number of worker threads to use. Zero means one per hardware thread.
+	void SetThreadCount(int count) { threadCount = count; }
+
+	void Raytrace(const TArray<LightmapTile*>& tiles);
+
+	double GetBakeTimeMS() const { return bakeTime; }
+	uint32_t GetPixelCount() const { return pixelCount; }
+
+private:
+	struct WorkerData
+	{
+		TArray<int> visibleSurfaces;
+		TArray<FVector4> bakeBuffer;
+		TArray<FVector4> resolveBuffer;
+		TArray<FVector3> positions;
+		TArray<int> surfaces;
+	};
+
+	void BakeTile(LightmapTile* tile, WorkerData& data);
+	void RasterizeSurfaces(LightmapTile* tile, WorkerData& data);
+	void Resolve(int width, int height, WorkerData& data);
+	void Blur(int width, int height, WorkerData& data);
+	void CopyResult(LightmapTile* tile, int width, int height, WorkerData& data);
+
+	FVector4 TracePixel(const FVector3& origin, int surfaceIndex, float fragX, float fragY);
+
+	float TraceSunAttenuation(const FVector3& origin, const FVector3& normal, float phi);
+	float TraceSunRayAttenuation(FVector3 origin, float tmin, FVector3 dir, float tmax);
+	FVector3 TraceLight(const FVector3& origin, const FVector3& normal, const LevelMeshLight& light, float phi);
+	FVector3 TracePointLightRay(FVector3 origin, const FVector3& lightpos, float tmin, FVector3 rayColor);
+	float TraceAmbientOcclusion(const FVector3& origin, const FVector3& normal, int fragoffset);
+	float TraceAORay(FVector3 origin, float tmin, FVector3 dir, float tmax);
+
+	struct TraceResult
+	{
+		float t = 0.0f;
+		int surfaceIndex = -1;
+	};
+
+	TraceResult TraceFirstHit(const FVector3& origin, float tmin, const FVector3& dir, float tmax);
+	float PassAttenuationThroughSurface(const LevelMeshSurface& surface, float attenuation);
+	void TransformRay(int portalIndex, FVector3& origin, FVector3& dir);
+
+	LevelMesh* mesh = nullptr;
+	int threadCount = 0;
+
+	bool useSunlight = true;
+	bool useSoftShadows = true;
+	bool useAO = true;
+	bool useBlur = true;
+
+	double bakeTime = 0.0;
+	uint32_t pixelCount = 0;
+};
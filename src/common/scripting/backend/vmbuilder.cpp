@@ -38,6 +38,8 @@
 #include "c_cvars.h"
 #include "jit.h"
 #include "filesystem.h"
+#include "stats.h"
+#include "printf.h"
 
 CVAR(Bool, strictdecorate, false, CVAR_GLOBALCONFIG | CVAR_ARCHIVE)
 CVAR(Bool, warningstoerrors, false, CVAR_GLOBALCONFIG | CVAR_ARCHIVE)
@@ -839,6 +841,9 @@ VMFunction *FFunctionBuildList::AddFunction(PNamespace *gnspc, const VersionInfo
 void FFunctionBuildList::Build()
 {
 	VMDisassemblyDumper disasmdump(VMDisassemblyDumper::Overwrite);
+	TArray<VMScriptFunction *> aotfuncs;
+	cycle_t codegentime;
+	codegentime.ResetAndClock();
 
 	for (auto &item : mItems)
 	{
@@ -944,7 +949,7 @@ void FFunctionBuildList::Build()
 				#if HAVE_VM_JIT
 					if(vm_jit && vm_jit_aot)
 					{
-						sfunc->JitCompile();
+						aotfuncs.Push(sfunc);
 					}
 				#endif
 			}
@@ -957,6 +962,12 @@ void FFunctionBuildList::Build()
 		delete item.Code;
 		disasmdump.Flush();
 	}
+	codegentime.Unclock();
+	Printf("Generated code for %u script functions in %.1f ms\n", mItems.Size(), codegentime.TimeMS());
+
+	// Compile everything at once so that the JIT can use all available threads.
+	VMScriptFunction::JitCompileAll(aotfuncs);
+
 	VMFunction::CreateRegUseInfo();
 	FScriptPosition::StrictErrors = strictdecorate;
 
@@ -0,0 +1,1060 @@
+/*
+** zcc_cache.cpp
+**
+** On-disk cache of parsed ZScript syntax trees
+**
+** A translation unit (a ZSCRIPT lump and everything it includes) whose
+** lumps are unchanged since the last run does not need to be lexed and
+** parsed again. The cache stores the syntax tree together with the full
+** path and MD5 of every lump that went into it. Any difference in those,
+** or in the engine build, makes it fall back to parsing.
+**
+** Names, strings, lump numbers and built-in type pointers are stored in
+** a form that does not depend on the current session. The file is in
+** native byte order, as it is only ever read back on the same machine.
+**
+*/
+
+#include "zcc_parser.h"
+#include "filesystem.h"
+#include "i_specialpaths.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "md5.h"
+#include "version.h"
+#include "c_cvars.h"
+#include "printf.h"
+
+CVAR(Bool, zscript_cache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+static const uint32_t CACHE_MAGIC = MAKE_ID('Z', 'S', 'C', 'C');
+static const uint32_t CACHE_VERSION = 1;
+
+//==========================================================================
+//
+// Built-in types the parser may attach to expressions.
+// Index 0 stands for nullptr.
+//
+//==========================================================================
+
+static PType *GetBuiltinType(unsigned index)
+{
+	PType *const types[] =
+	{
+		nullptr, TypeError, TypeAuto, TypeVoid, TypeSInt8, TypeUInt8, TypeSInt16, TypeUInt16, TypeSInt32, TypeUInt32,
+		TypeBool, TypeFloat32, TypeFloat64, TypeString, TypeName, TypeSound, TypeColor, TypeTextureID, TypeTranslationID,
+		TypeSpriteID, TypeVector2, TypeVector3, TypeVector4, TypeFVector2, TypeFVector3, TypeFVector4, TypeQuaternion,
+		TypeFQuaternion, TypeState, TypeStateLabel, TypeNullPtr, TypeVoidPtr,
+	};
+	return index < countof(types) ? types[index] : (PType*)-1;
+}
+
+static int FindBuiltinType(PType *type)
+{
+	for (unsigned i = 0; GetBuiltinType(i) != (PType*)-1; i++)
+	{
+		if (GetBuiltinType(i) == type)
+			return i;
+	}
+	return -1;
+}
+
+//==========================================================================
+//
+// Walks the syntax tree. The same code collects the nodes, writes them
+// and reads them back, so the three can never disagree on the layout.
+//
+//==========================================================================
+
+class FZCCCacheArchive
+{
+public:
+	enum EMode { Collect, Write, Read };
+
+	EMode Mode;
+	bool Failed = false;
+
+	// Collect and Write
+	TMap<ZCC_TreeNode *, int> NodeIndex;
+	TMap<FString *, int> StringIndex;
+	TMap<int, int> NameIndex;
+	TArray<uint8_t> Out;
+
+	// All modes
+	TArray<ZCC_TreeNode *> Nodes;
+	TArray<FString *> Strings;
+	TArray<int> Names;
+	TArray<int> Lumps;
+
+	// Read
+	const uint8_t *In = nullptr;
+	const uint8_t *InEnd = nullptr;
+
+	FZCCCacheArchive(EMode mode) : Mode(mode) {}
+
+	void Bytes(void *data, size_t size)
+	{
+		if (Mode == Write)
+		{
+			unsigned pos = Out.Reserve(size);
+			memcpy(&Out[pos], data, size);
+		}
+		else if (Mode == Read)
+		{
+			if (In + size > InEnd)
+			{
+				Failed = true;
+				memset(data, 0, size);
+				return;
+			}
+			memcpy(data, In, size);
+			In += size;
+		}
+	}
+
+	template<class T> void Value(T &value)
+	{
+		Bytes(&value, sizeof(T));
+	}
+
+	template<class T> void Node(T *&node)
+	{
+		ZCC_TreeNode *n = node;
+		NodeRef(n);
+		node = static_cast<T *>(n);
+	}
+
+	void NodeRef(ZCC_TreeNode *&node)
+	{
+		int index = -1;
+		if (Mode == Collect)
+		{
+			if (node != nullptr && NodeIndex.CheckKey(node) == nullptr)
+			{
+				NodeIndex.Insert(node, Nodes.Size());
+				Nodes.Push(node);
+			}
+		}
+		else if (Mode == Write)
+		{
+			if (node != nullptr) index = NodeIndex[node];
+			Value(index);
+		}
+		else
+		{
+			Value(index);
+			if (index < -1 || index >= (int)Nodes.Size()) Failed = true;
+			node = index >= 0 && !Failed ? Nodes[index] : nullptr;
+		}
+	}
+
+	void String(FString *&str)
+	{
+		int index = -1;
+		if (Mode == Collect)
+		{
+			if (str != nullptr && StringIndex.CheckKey(str) == nullptr)
+			{
+				StringIndex.Insert(str, Strings.Size());
+				Strings.Push(str);
+			}
+		}
+		else if (Mode == Write)
+		{
+			if (str != nullptr) index = StringIndex[str];
+			Value(index);
+		}
+		else
+		{
+			Value(index);
+			if (index < -1 || index >= (int)Strings.Size()) Failed = true;
+			str = index >= 0 && !Failed ? Strings[index] : nullptr;
+		}
+	}
+
+	void Name(ENamedName &name)
+	{
+		int index;
+		if (Mode == Collect)
+		{
+			if (NameIndex.CheckKey(name) == nullptr)
+			{
+				NameIndex.Insert(name, Names.Size());
+				Names.Push(name);
+			}
+		}
+		else if (Mode == Write)
+		{
+			index = NameIndex[name];
+			Value(index);
+		}
+		else
+		{
+			Value(index);
+			if (index < 0 || index >= (int)Names.Size()) Failed = true;
+			name = Failed ? NAME_None : ENamedName(Names[index]);
+		}
+	}
+
+	void Lump(int &lump)
+	{
+		int index = -1;
+		if (Mode == Collect)
+		{
+			if (lump >= 0 && Lumps.Find(lump) >= Lumps.Size()) Failed = true;
+		}
+		else if (Mode == Write)
+		{
+			if (lump >= 0) index = Lumps.Find(lump);
+			Value(index);
+		}
+		else
+		{
+			Value(index);
+			if (index < -1 || index >= (int)Lumps.Size()) Failed = true;
+			lump = index >= 0 && !Failed ? Lumps[index] : -1;
+		}
+	}
+
+	void Type(PType *&type)
+	{
+		int index = 0;
+		if (Mode == Collect)
+		{
+			if (FindBuiltinType(type) < 0) Failed = true;
+		}
+		else if (Mode == Write)
+		{
+			index = FindBuiltinType(type);
+			Value(index);
+		}
+		else
+		{
+			Value(index);
+			type = GetBuiltinType(index);
+			if (type == (PType*)-1)
+			{
+				Failed = true;
+				type = nullptr;
+			}
+		}
+	}
+
+	// Pointers the compiler fills in later. They must still be empty here.
+	template<class T> void Unset(T *&ptr)
+	{
+		if (Mode == Collect && ptr != nullptr) Failed = true;
+		else if (Mode == Read) ptr = nullptr;
+	}
+};
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static size_t GetNodeSize(EZCCTreeNodeType type)
+{
+	switch (type)
+	{
+	#define xx(t) case AST_##t: return sizeof(ZCC_##t);
+	xx(Identifier) xx(Class) xx(Struct) xx(Enum) xx(EnumTerminator) xx(States) xx(StatePart) xx(StateLabel)
+	xx(StateStop) xx(StateWait) xx(StateFail) xx(StateLoop) xx(StateGoto) xx(StateLine) xx(VarName) xx(VarInit)
+	xx(Type) xx(BasicType) xx(MapType) xx(MapIteratorType) xx(DynArrayType) xx(FuncPtrParamDecl) xx(FuncPtrType)
+	xx(ClassType) xx(Expression) xx(ExprID) xx(ExprTypeRef) xx(ExprConstant) xx(ExprFuncCall) xx(ExprMemberAccess)
+	xx(ExprUnary) xx(ExprBinary) xx(ExprTrinary) xx(FuncParm) xx(Statement) xx(CompoundStmt) xx(ContinueStmt)
+	xx(BreakStmt) xx(ReturnStmt) xx(ExpressionStmt) xx(IterationStmt) xx(IfStmt) xx(SwitchStmt) xx(CaseStmt)
+	xx(AssignStmt) xx(AssignDeclStmt) xx(LocalVarStmt) xx(FuncParamDecl) xx(ConstantDef) xx(Declarator)
+	xx(VarDeclarator) xx(FuncDeclarator) xx(Default) xx(FlagStmt) xx(PropertyStmt) xx(VectorValue) xx(DeclFlags)
+	xx(ClassCast) xx(FunctionPtrCast) xx(StaticArrayStatement) xx(Property) xx(FlagDef) xx(MixinDef) xx(MixinStmt)
+	xx(ArrayIterationStmt) xx(TwoArgIterationStmt) xx(ThreeArgIterationStmt) xx(TypedIterationStmt)
+	#undef xx
+	default: return 0;
+	}
+}
+
+static void SerializeNamed(FZCCCacheArchive &arc, ZCC_NamedNode *node)
+{
+	arc.Name(node->NodeName);
+	arc.Unset(node->Symbol);
+}
+
+static void SerializeStruct(FZCCCacheArchive &arc, ZCC_Struct *node)
+{
+	SerializeNamed(arc, node);
+	arc.Value(node->Flags);
+	arc.Node(node->Body);
+	arc.Unset(node->Type);
+	arc.Value(node->Version);
+}
+
+static void SerializeExpression(FZCCCacheArchive &arc, ZCC_Expression *node)
+{
+	arc.Value(node->Operation);
+	arc.Type(node->Type);
+}
+
+static void SerializeVarName(FZCCCacheArchive &arc, ZCC_VarName *node)
+{
+	arc.Name(node->Name);
+	arc.Node(node->ArraySize);
+}
+
+static void SerializeDeclarator(FZCCCacheArchive &arc, ZCC_Declarator *node)
+{
+	arc.Node(node->Type);
+	arc.Value(node->Flags);
+	arc.Value(node->Version);
+}
+
+static void SerializeNode(FZCCCacheArchive &arc, ZCC_TreeNode *node)
+{
+	arc.Node(node->SiblingNext);
+	arc.Node(node->SiblingPrev);
+	arc.String(node->SourceName);
+	arc.Lump(node->SourceLump);
+	arc.Value(node->SourceLoc);
+
+	switch (node->NodeType)
+	{
+	case AST_Identifier:
+		arc.Name(static_cast<ZCC_Identifier *>(node)->Id);
+		break;
+
+	case AST_Class:
+	{
+		auto n = static_cast<ZCC_Class *>(node);
+		SerializeStruct(arc, n);
+		arc.Node(n->ParentName);
+		arc.Node(n->Replaces);
+		arc.Node(n->Sealed);
+		break;
+	}
+
+	case AST_Struct:
+		SerializeStruct(arc, static_cast<ZCC_Struct *>(node));
+		break;
+
+	case AST_Enum:
+	{
+		auto n = static_cast<ZCC_Enum *>(node);
+		SerializeNamed(arc, n);
+		arc.Value(n->EnumType);
+		arc.Node(n->Elements);
+		break;
+	}
+
+	case AST_States:
+	{
+		auto n = static_cast<ZCC_States *>(node);
+		arc.Node(n->Body);
+		arc.Node(n->Flags);
+		break;
+	}
+
+	case AST_StateLabel:
+		arc.Name(static_cast<ZCC_StateLabel *>(node)->Label);
+		break;
+
+	case AST_StateGoto:
+	{
+		auto n = static_cast<ZCC_StateGoto *>(node);
+		arc.Node(n->Qualifier);
+		arc.Node(n->Label);
+		arc.Node(n->Offset);
+		break;
+	}
+
+	case AST_StateLine:
+	{
+		auto n = static_cast<ZCC_StateLine *>(node);
+		uint8_t bits = n->bBright | (n->bFast << 1) | (n->bSlow << 2) | (n->bNoDelay << 3) | (n->bCanRaise << 4);
+		arc.Value(bits);
+		n->bBright = !!(bits & 1);
+		n->bFast = !!(bits & 2);
+		n->bSlow = !!(bits & 4);
+		n->bNoDelay = !!(bits & 8);
+		n->bCanRaise = !!(bits & 16);
+		arc.String(n->Sprite);
+		arc.String(n->Frames);
+		arc.Node(n->Duration);
+		arc.Node(n->Offset);
+		arc.Node(n->Lights);
+		arc.Node(n->Action);
+		break;
+	}
+
+	case AST_VarName:
+		SerializeVarName(arc, static_cast<ZCC_VarName *>(node));
+		break;
+
+	case AST_VarInit:
+	{
+		auto n = static_cast<ZCC_VarInit *>(node);
+		SerializeVarName(arc, n);
+		arc.Node(n->Init);
+		arc.Value(n->InitIsArray);
+		break;
+	}
+
+	case AST_Type:
+		arc.Node(static_cast<ZCC_Type *>(node)->ArraySize);
+		break;
+
+	case AST_BasicType:
+	{
+		auto n = static_cast<ZCC_BasicType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Value(n->Type);
+		arc.Node(n->UserType);
+		arc.Value(n->isconst);
+		break;
+	}
+
+	case AST_MapType:
+	{
+		auto n = static_cast<ZCC_MapType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Node(n->KeyType);
+		arc.Node(n->ValueType);
+		break;
+	}
+
+	case AST_MapIteratorType:
+	{
+		auto n = static_cast<ZCC_MapIteratorType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Node(n->KeyType);
+		arc.Node(n->ValueType);
+		break;
+	}
+
+	case AST_DynArrayType:
+	{
+		auto n = static_cast<ZCC_DynArrayType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Node(n->ElementType);
+		break;
+	}
+
+	case AST_FuncPtrParamDecl:
+	{
+		auto n = static_cast<ZCC_FuncPtrParamDecl *>(node);
+		arc.Node(n->Type);
+		arc.Value(n->Flags);
+		break;
+	}
+
+	case AST_FuncPtrType:
+	{
+		auto n = static_cast<ZCC_FuncPtrType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Node(n->RetType);
+		arc.Node(n->Params);
+		arc.Value(n->Scope);
+		break;
+	}
+
+	case AST_ClassType:
+	{
+		auto n = static_cast<ZCC_ClassType *>(node);
+		arc.Node(n->ArraySize);
+		arc.Node(n->Restriction);
+		break;
+	}
+
+	case AST_Expression:
+		SerializeExpression(arc, static_cast<ZCC_Expression *>(node));
+		break;
+
+	case AST_ExprID:
+	{
+		auto n = static_cast<ZCC_ExprID *>(node);
+		SerializeExpression(arc, n);
+		arc.Name(n->Identifier);
+		break;
+	}
+
+	case AST_ExprTypeRef:
+	{
+		auto n = static_cast<ZCC_ExprTypeRef *>(node);
+		SerializeExpression(arc, n);
+		arc.Type(n->RefType);
+		break;
+	}
+
+	case AST_ExprConstant:
+	{
+		auto n = static_cast<ZCC_ExprConstant *>(node);
+		SerializeExpression(arc, n);
+		if (n->Type == TypeString)
+		{
+			arc.String(n->StringVal);
+		}
+		else if (n->Type == TypeName)
+		{
+			ENamedName name = ENamedName(n->IntVal);
+			arc.Name(name);
+			n->IntVal = name;
+		}
+		else
+		{
+			arc.Value(n->DoubleVal);	// covers all other members of the union
+		}
+		break;
+	}
+
+	case AST_ExprFuncCall:
+	{
+		auto n = static_cast<ZCC_ExprFuncCall *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->Function);
+		arc.Node(n->Parameters);
+		break;
+	}
+
+	case AST_ExprMemberAccess:
+	{
+		auto n = static_cast<ZCC_ExprMemberAccess *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->Left);
+		arc.Name(n->Right);
+		break;
+	}
+
+	case AST_ExprUnary:
+	{
+		auto n = static_cast<ZCC_ExprUnary *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->Operand);
+		break;
+	}
+
+	case AST_ExprBinary:
+	{
+		auto n = static_cast<ZCC_ExprBinary *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->Left);
+		arc.Node(n->Right);
+		break;
+	}
+
+	case AST_ExprTrinary:
+	{
+		auto n = static_cast<ZCC_ExprTrinary *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->Test);
+		arc.Node(n->Left);
+		arc.Node(n->Right);
+		break;
+	}
+
+	case AST_VectorValue:
+	{
+		auto n = static_cast<ZCC_VectorValue *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->X);
+		arc.Node(n->Y);
+		arc.Node(n->Z);
+		arc.Node(n->W);
+		break;
+	}
+
+	case AST_ClassCast:
+	{
+		auto n = static_cast<ZCC_ClassCast *>(node);
+		SerializeExpression(arc, n);
+		arc.Name(n->ClassName);
+		arc.Node(n->Parameters);
+		break;
+	}
+
+	case AST_FunctionPtrCast:
+	{
+		auto n = static_cast<ZCC_FunctionPtrCast *>(node);
+		SerializeExpression(arc, n);
+		arc.Node(n->PtrType);
+		arc.Node(n->Expr);
+		break;
+	}
+
+	case AST_FuncParm:
+	{
+		auto n = static_cast<ZCC_FuncParm *>(node);
+		arc.Node(n->Value);
+		arc.Name(n->Label);
+		break;
+	}
+
+	case AST_CompoundStmt:
+	case AST_Default:
+		arc.Node(static_cast<ZCC_CompoundStmt *>(node)->Content);
+		break;
+
+	case AST_ReturnStmt:
+		arc.Node(static_cast<ZCC_ReturnStmt *>(node)->Values);
+		break;
+
+	case AST_ExpressionStmt:
+		arc.Node(static_cast<ZCC_ExpressionStmt *>(node)->Expression);
+		break;
+
+	case AST_IterationStmt:
+	{
+		auto n = static_cast<ZCC_IterationStmt *>(node);
+		arc.Node(n->LoopCondition);
+		arc.Node(n->LoopStatement);
+		arc.Node(n->LoopBumper);
+		arc.Value(n->CheckAt);
+		break;
+	}
+
+	case AST_ArrayIterationStmt:
+	{
+		auto n = static_cast<ZCC_ArrayIterationStmt *>(node);
+		arc.Node(n->ItName);
+		arc.Node(n->ItArray);
+		arc.Node(n->LoopStatement);
+		break;
+	}
+
+	case AST_TwoArgIterationStmt:
+	{
+		auto n = static_cast<ZCC_TwoArgIterationStmt *>(node);
+		arc.Node(n->ItKey);
+		arc.Node(n->ItValue);
+		arc.Node(n->ItMap);
+		arc.Node(n->LoopStatement);
+		break;
+	}
+
+	case AST_ThreeArgIterationStmt:
+	{
+		auto n = static_cast<ZCC_ThreeArgIterationStmt *>(node);
+		arc.Node(n->ItVar);
+		arc.Node(n->ItPos);
+		arc.Node(n->ItFlags);
+		arc.Node(n->ItBlock);
+		arc.Node(n->LoopStatement);
+		break;
+	}
+
+	case AST_TypedIterationStmt:
+	{
+		auto n = static_cast<ZCC_TypedIterationStmt *>(node);
+		arc.Node(n->ItType);
+		arc.Node(n->ItVar);
+		arc.Node(n->ItExpr);
+		arc.Node(n->LoopStatement);
+		break;
+	}
+
+	case AST_IfStmt:
+	{
+		auto n = static_cast<ZCC_IfStmt *>(node);
+		arc.Node(n->Condition);
+		arc.Node(n->TruePath);
+		arc.Node(n->FalsePath);
+		break;
+	}
+
+	case AST_SwitchStmt:
+	{
+		auto n = static_cast<ZCC_SwitchStmt *>(node);
+		arc.Node(n->Condition);
+		arc.Node(n->Content);
+		break;
+	}
+
+	case AST_CaseStmt:
+		arc.Node(static_cast<ZCC_CaseStmt *>(node)->Condition);
+		break;
+
+	case AST_AssignStmt:
+	{
+		auto n = static_cast<ZCC_AssignStmt *>(node);
+		arc.Node(n->Dests);
+		arc.Node(n->Sources);
+		arc.Value(n->AssignOp);
+		break;
+	}
+
+	case AST_AssignDeclStmt:
+	{
+		auto n = static_cast<ZCC_AssignDeclStmt *>(node);
+		arc.Node(n->Dests);
+		arc.Node(n->Sources);
+		arc.Value(n->AssignOp);
+		break;
+	}
+
+	case AST_LocalVarStmt:
+	{
+		auto n = static_cast<ZCC_LocalVarStmt *>(node);
+		arc.Node(n->Type);
+		arc.Node(n->Vars);
+		break;
+	}
+
+	case AST_StaticArrayStatement:
+	{
+		auto n = static_cast<ZCC_StaticArrayStatement *>(node);
+		arc.Node(n->Type);
+		arc.Name(n->Id);
+		arc.Node(n->Values);
+		break;
+	}
+
+	case AST_FuncParamDecl:
+	{
+		auto n = static_cast<ZCC_FuncParamDecl *>(node);
+		arc.Node(n->Type);
+		arc.Node(n->Default);
+		arc.Name(n->Name);
+		arc.Value(n->Flags);
+		break;
+	}
+
+	case AST_DeclFlags:
+	{
+		auto n = static_cast<ZCC_DeclFlags *>(node);
+		arc.Node(n->Id);
+		arc.String(n->DeprecationMessage);
+		arc.Value(n->Version);
+		arc.Value(n->Flags);
+		break;
+	}
+
+	case AST_ConstantDef:
+	{
+		auto n = static_cast<ZCC_ConstantDef *>(node);
+		arc.Name(n->NodeName);
+		arc.Unset(static_cast<ZCC_NamedNode *>(n)->Symbol);
+		arc.Node(n->Value);
+		arc.Unset(n->Symbol);
+		arc.Node(n->Type);
+		break;
+	}
+
+	case AST_Declarator:
+		SerializeDeclarator(arc, static_cast<ZCC_Declarator *>(node));
+		break;
+
+	case AST_VarDeclarator:
+	{
+		auto n = static_cast<ZCC_VarDeclarator *>(node);
+		SerializeDeclarator(arc, n);
+		arc.Node(n->Names);
+		arc.String(n->DeprecationMessage);
+		break;
+	}
+
+	case AST_FuncDeclarator:
+	{
+		auto n = static_cast<ZCC_FuncDeclarator *>(node);
+		SerializeDeclarator(arc, n);
+		arc.Node(n->Params);
+		arc.Name(n->Name);
+		arc.Node(n->Body);
+		arc.Node(n->UseFlags);
+		arc.String(n->DeprecationMessage);
+		break;
+	}
+
+	case AST_PropertyStmt:
+	{
+		auto n = static_cast<ZCC_PropertyStmt *>(node);
+		arc.Node(n->Prop);
+		arc.Node(n->Values);
+		break;
+	}
+
+	case AST_FlagStmt:
+	{
+		auto n = static_cast<ZCC_FlagStmt *>(node);
+		arc.Node(n->name);
+		arc.Value(n->set);
+		break;
+	}
+
+	case AST_Property:
+	{
+		auto n = static_cast<ZCC_Property *>(node);
+		SerializeNamed(arc, n);
+		arc.Node(n->Body);
+		break;
+	}
+
+	case AST_FlagDef:
+	{
+		auto n = static_cast<ZCC_FlagDef *>(node);
+		SerializeNamed(arc, n);
+		arc.Name(n->RefName);
+		arc.Value(n->BitValue);
+		break;
+	}
+
+	case AST_MixinDef:
+	{
+		auto n = static_cast<ZCC_MixinDef *>(node);
+		SerializeNamed(arc, n);
+		arc.Node(n->Body);
+		arc.Value(n->MixinType);
+		break;
+	}
+
+	case AST_MixinStmt:
+		arc.Name(static_cast<ZCC_MixinStmt *>(node)->MixinName);
+		break;
+
+	case AST_EnumTerminator:
+	case AST_StatePart:
+	case AST_StateStop:
+	case AST_StateWait:
+	case AST_StateFail:
+	case AST_StateLoop:
+	case AST_Statement:
+	case AST_ContinueStmt:
+	case AST_BreakStmt:
+		break;
+
+	default:
+		arc.Failed = true;
+		break;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static FString GetCacheFileName(int baselump, bool create)
+{
+	FString path = M_GetCachePath(create);
+	FString lumpname = fileSystem.GetFileFullPath(baselump).c_str();
+	auto separator = lumpname.IndexOf(':');
+	path << "/zscript/" << lumpname.Left(separator);
+	if (create) CreatePath(path.GetChars());
+
+	lumpname.ReplaceChars('/', '%');
+	lumpname.ReplaceChars(':', '$');
+	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ".zsc";
+	return path;
+}
+
+static void GetLumpHash(int lump, uint8_t digest[16])
+{
+	auto data = fileSystem.ReadFile(lump);
+	MD5Context md5;
+	md5.Update(data.bytes(), (unsigned)data.size());
+	md5.Final(digest);
+}
+
+static void WriteString(TArray<uint8_t> &out, const char *str, size_t len)
+{
+	uint32_t len32 = (uint32_t)len;
+	unsigned pos = out.Reserve(sizeof(len32) + len);
+	memcpy(&out[pos], &len32, sizeof(len32));
+	memcpy(&out[pos + sizeof(len32)], str, len);
+}
+
+static bool ReadString(FZCCCacheArchive &arc, FString &str)
+{
+	uint32_t len = 0;
+	arc.Value(len);
+	if (arc.Failed || arc.In + len > arc.InEnd) return false;
+	str = FString((const char *)arc.In, len);
+	arc.In += len;
+	return true;
+}
+
+static FString GetBuildSignature()
+{
+	FString sig;
+	sig.Format("%s %s %u", GetVersionString(), GetGitHash(), (unsigned)sizeof(void*));
+	return sig;
+}
+
+//==========================================================================
+//
+// Writes the syntax tree of a successfully parsed translation unit.
+// includes are the resolved include paths in the order they were read.
+//
+//==========================================================================
+
+void ZCC_WriteParseCache(int baselump, const TArray<FString> &includes, ZCCParseState &state)
+{
+	if (!zscript_cache || state.TopNode == nullptr)
+		return;
+
+	FZCCCacheArchive arc(FZCCCacheArchive::Collect);
+	TArray<FString> paths;
+	paths.Push("");
+	arc.Lumps.Push(baselump);
+	for (auto &inc : includes)
+	{
+		int lump = fileSystem.CheckNumForFullName(inc.GetChars(), true);
+		if (lump < 0) return;
+		paths.Push(inc);
+		arc.Lumps.Push(lump);
+	}
+
+	ZCC_TreeNode *top = state.TopNode;
+	arc.NodeRef(top);
+	for (unsigned i = 0; i < arc.Nodes.Size() && !arc.Failed; i++)
+	{
+		SerializeNode(arc, arc.Nodes[i]);
+	}
+	if (arc.Failed)
+	{
+		DPrintf(DMSG_NOTIFY, "Syntax tree of %s cannot be cached\n", fileSystem.GetFileFullPath(baselump).c_str());
+		return;
+	}
+
+	arc.Mode = FZCCCacheArchive::Write;
+	auto &out = arc.Out;
+	uint32_t magic = CACHE_MAGIC, version = CACHE_VERSION;
+	arc.Value(magic);
+	arc.Value(version);
+	FString sig = GetBuildSignature();
+	WriteString(out, sig.GetChars(), sig.Len());
+
+	uint32_t count = arc.Lumps.Size();
+	arc.Value(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto fullpath = fileSystem.GetFileFullPath(arc.Lumps[i]);
+		WriteString(out, fullpath.c_str(), fullpath.length());
+		WriteString(out, paths[i].GetChars(), paths[i].Len());
+		uint8_t digest[16];
+		GetLumpHash(arc.Lumps[i], digest);
+		arc.Bytes(digest, 16);
+	}
+	arc.Value(state.ParseVersion);
+
+	count = arc.Strings.Size();
+	arc.Value(count);
+	for (auto str : arc.Strings)
+		WriteString(out, str->GetChars(), str->Len());
+
+	count = arc.Names.Size();
+	arc.Value(count);
+	for (auto name : arc.Names)
+	{
+		const char *chars = FName(ENamedName(name)).GetChars();
+		WriteString(out, chars, strlen(chars));
+	}
+
+	count = arc.Nodes.Size();
+	arc.Value(count);
+	for (auto node : arc.Nodes)
+		arc.Value(node->NodeType);
+	for (auto node : arc.Nodes)
+		SerializeNode(arc, node);
+
+	FString filename = GetCacheFileName(baselump, true);
+	FileWriter *fw = FileWriter::Open(filename.GetChars());
+	if (fw != nullptr)
+	{
+		fw->Write(out.Data(), out.Size());
+		delete fw;
+	}
+}
+
+//==========================================================================
+//
+// Fills in state from the cache if every lump the translation unit was
+// built from is unchanged. Returns false if it has to be parsed.
+//
+//==========================================================================
+
+bool ZCC_ReadParseCache(int baselump, ZCCParseState &state)
+{
+	if (!zscript_cache)
+		return false;
+
+	FileReader fr;
+	if (!fr.OpenFile(GetCacheFileName(baselump, false).GetChars()))
+		return false;
+	auto data = fr.Read();
+
+	FZCCCacheArchive arc(FZCCCacheArchive::Read);
+	arc.In = data.bytes();
+	arc.InEnd = arc.In + data.size();
+
+	uint32_t magic = 0, version = 0, count = 0;
+	arc.Value(magic);
+	arc.Value(version);
+	FString sig;
+	if (magic != CACHE_MAGIC || version != CACHE_VERSION || !ReadString(arc, sig) || sig.Compare(GetBuildSignature()) != 0)
+		return false;
+
+	arc.Value(count);
+	for (unsigned i = 0; i < count && !arc.Failed; i++)
+	{
+		FString fullpath, path;
+		uint8_t digest[16], current[16];
+		if (!ReadString(arc, fullpath) || !ReadString(arc, path))
+			return false;
+		arc.Bytes(digest, 16);
+
+		int lump = i == 0 ? baselump : fileSystem.CheckNumForFullName(path.GetChars(), true);
+		if (lump < 0 || fullpath.Compare(fileSystem.GetFileFullPath(lump).c_str()) != 0)
+			return false;
+		GetLumpHash(lump, current);
+		if (memcmp(digest, current, 16))
+			return false;
+		arc.Lumps.Push(lump);
+	}
+	VersionInfo parseversion;
+	arc.Value(parseversion);
+
+	// Everything below is session independent data that only needs to be converted.
+	arc.Value(count);
+	for (unsigned i = 0; i < count && !arc.Failed; i++)
+	{
+		FString str;
+		if (!ReadString(arc, str)) return false;
+		arc.Strings.Push(state.Strings.Alloc(str));
+	}
+
+	arc.Value(count);
+	for (unsigned i = 0; i < count && !arc.Failed; i++)
+	{
+		FString str;
+		if (!ReadString(arc, str)) return false;
+		arc.Names.Push(FName(str).GetIndex());
+	}
+
+	arc.Value(count);
+	if (arc.Failed || count == 0 || count > (size_t)(arc.InEnd - arc.In) / sizeof(EZCCTreeNodeType))
+		return false;
+	for (unsigned i = 0; i < count; i++)
+	{
+		EZCCTreeNodeType type;
+		arc.Value(type);
+		size_t size = GetNodeSize(type);
+		if (size == 0) return false;
+		auto node = state.ZCC_AST::InitNode(size, type, nullptr);
+		memset(node, 0, size);
+		node->NodeType = type;
+		arc.Nodes.Push(node);
+	}
+	for (auto node : arc.Nodes)
+	{
+		SerializeNode(arc, node);
+		if (arc.Failed) break;
+	}
+	if (arc.Failed || arc.In != arc.InEnd)
+	{
+		// The nodes stay in the arena until the state is freed, but are not referenced by anything.
+		return false;
+	}
+
+	state.TopNode = arc.Nodes[0];
+	state.ParseVersion = parseversion;
+	return true;
+}
@@ -409,15 +409,14 @@ parse_end:
 
 //**--------------------------------------------------------------------------
 
-PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
+static void ParseTranslationUnit(const int baselump, ZCCParseState &state)
 {
 	FScanner sc;
 	void *parser;
 	ZCCToken value;
 	int lumpnum = baselump;
-	auto fileno = fileSystem.GetFileContainer(lumpnum);
-
-	state.FileNo = fileno;
+	auto fileno = state.FileNo;
+	int warnings = FScriptPosition::WarnCounter;
 
 	if (TokenMap.CountUsed() == 0)
 	{
@@ -498,6 +497,7 @@ PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
 			ParseSingleFile(nullptr, nullptr, lumpnum, parser, state);
 		}
 	}
+	TArray<FString> includes = std::move(Includes);
 	Includes.Clear();
 	Includes.ShrinkToFit();
 	IncludeLocs.Clear();
@@ -521,6 +521,22 @@ PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
 	}
 #endif
 
+	if (FScriptPosition::WarnCounter == warnings)
+	{
+		// Files that produce warnings are parsed every time so that the warnings do not get lost.
+		ZCC_WriteParseCache(baselump, includes, state);
+	}
+}
+
+PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
+{
+	state.FileNo = fileSystem.GetFileContainer(baselump);
+
+	if (!ZCC_ReadParseCache(baselump, state))
+	{
+		ParseTranslationUnit(baselump, state);
+	}
+
 	// Make a dump of the AST before running the compiler for diagnostic purposes.
 	if (Args->CheckParm("-dumpast"))
 	{
@@ -699,4 +699,8 @@ ZCC_TreeNode *TreeNodeDeepCopy(ZCC_AST *ast, ZCC_TreeNode *orig, bool copySiblin
 // Main entry point for the parser. Returns some data needed by the compiler.
 PNamespace* ParseOneScript(const int baselump, ZCCParseState& state);
 
+// On-disk cache of parsed translation units, see zcc_cache.cpp.
+bool ZCC_ReadParseCache(int baselump, ZCCParseState &state);
+void ZCC_WriteParseCache(int baselump, const TArray<FString> &includes, ZCCParseState &state);
+
 #endif
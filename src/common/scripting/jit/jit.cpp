@@ -1,7 +1,10 @@
 
+#include <memory>
+#include <exception>
 #include "jit.h"
 #include "jitintern.h"
 #include "printf.h"
+#include "threadpool.h"
 
 extern PString *TypeString;
 extern PStruct *TypeVector2;
@@ -40,6 +43,91 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 	}
 }
 
+//==========================================================================
+//
+// Code generation only depends on the function being compiled, so it can
+// run on several threads at once. Placing the code in executable memory
+// is done afterwards, in order, which gives the same memory layout and
+// error output as compiling the functions one by one.
+//
+//==========================================================================
+
+struct JitBatchItem
+{
+	asmjit::StringLogger Logger;
+	ThrowingErrorHandler ErrorHandler;
+	asmjit::CodeHolder Code;
+	std::unique_ptr<JitCompiler> Compiler;
+	asmjit::CCFunc *Func = nullptr;
+	FString Error;
+	std::exception_ptr Exception;
+};
+
+void JitCompileBatch(const TArray<VMScriptFunction *> &funcs, TArray<JitFuncPtr> &results, FThreadPool *pool)
+{
+	using namespace asmjit;
+
+	// Limits how much generated code is kept in memory before it gets placed.
+	const unsigned batchSize = 1024;
+
+	results.Resize(funcs.Size());
+	CodeInfo codeInfo = GetHostCodeInfo();
+
+	for (unsigned start = 0; start < funcs.Size(); start += batchSize)
+	{
+		unsigned count = min(batchSize, funcs.Size() - start);
+		std::unique_ptr<JitBatchItem[]> items(new JitBatchItem[count]);
+
+		pool->Run(count, [&](int i)
+		{
+			JitBatchItem &item = items[i];
+			try
+			{
+				item.Code.init(codeInfo);
+				item.Code.setErrorHandler(&item.ErrorHandler);
+				item.Code.setLogger(&item.Logger);
+
+				item.Compiler.reset(new JitCompiler(&item.Code, funcs[start + i]));
+				item.Func = item.Compiler->Codegen();
+			}
+			catch (const CRecoverableError &e)
+			{
+				item.Error = e.what();
+			}
+			catch (...)
+			{
+				item.Exception = std::current_exception();
+			}
+		});
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			JitBatchItem &item = items[i];
+			VMScriptFunction *sfunc = funcs[start + i];
+			if (item.Exception)
+				std::rethrow_exception(item.Exception);
+
+			results[start + i] = nullptr;
+			if (item.Error.IsEmpty())
+			{
+				try
+				{
+					results[start + i] = reinterpret_cast<JitFuncPtr>(LinkJitFunction(&item.Code, item.Compiler.get(), item.Func));
+				}
+				catch (const CRecoverableError &e)
+				{
+					item.Error = e.what();
+				}
+			}
+			if (item.Error.IsNotEmpty())
+			{
+				OutputJitLog(item.Logger);
+				Printf("%s: Unexpected JIT error: %s\n", sfunc->PrintableName, item.Error.GetChars());
+			}
+		}
+	}
+}
+
 void JitDumpLog(FILE *file, VMScriptFunction *sfunc)
 {
 	using namespace asmjit;
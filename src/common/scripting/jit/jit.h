@@ -3,6 +3,10 @@
 
 #include "vmintern.h"
 
+class FThreadPool;
+
 JitFuncPtr JitCompile(VMScriptFunction *func);
+// Compiles all functions, generating their code on the pool. results[i] is null for functions that failed.
+void JitCompileBatch(const TArray<VMScriptFunction *> &funcs, TArray<JitFuncPtr> &results, FThreadPool *pool);
 void JitDumpLog(FILE *file, VMScriptFunction *func);
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int maxFrames = -1);
@@ -2,6 +2,7 @@
 #include "jitintern.h"
 #include <map>
 #include <memory>
+#include <mutex>
 
 void JitCompiler::EmitPARAM()
 {
@@ -89,6 +90,15 @@ void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
 	auto scriptcall = newTempIntPtr();
 	cc.mov(scriptcall, x86::ptr(vmfunc, myoffsetof(VMScriptFunction, ScriptCall)));
 
+	// Route the call through the profiler while it is active
+	auto profiling = newTempIntPtr();
+	auto L_noprofile = cc.newLabel();
+	cc.mov(profiling, imm_ptr(&VMProfiling));
+	cc.cmp(x86::byte_ptr(profiling), 0);
+	cc.je(L_noprofile);
+	cc.mov(scriptcall, imm_ptr(VMProfiledScriptCall));
+	cc.bind(L_noprofile);
+
 	auto result = newResultInt32();
 	auto call = cc.call(scriptcall, FuncSignature5<int, VMFunction *, VMValue*, int, VMReturn*, int>());
 	call->setRet(0, result);
@@ -590,6 +600,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 }
 
 static std::map<FString, std::unique_ptr<TArray<uint8_t>>> argsCache;
+static std::mutex argsCacheMutex;	// Functions may be compiled in parallel
 
 asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 {
@@ -712,8 +723,10 @@ asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 	}
 
 	// FuncSignature only keeps a pointer to its args array. Store a copy of each args array variant.
+	std::unique_lock<std::mutex> lock(argsCacheMutex);
 	std::unique_ptr<TArray<uint8_t>> &cachedArgs = argsCache[key];
 	if (!cachedArgs) cachedArgs.reset(new TArray<uint8_t>(args));
+	lock.unlock();
 
 	FuncSignature signature;
 	signature.init(CallConv::kIdHost, rettype, cachedArgs->Data(), cachedArgs->Size());
@@ -44,6 +44,11 @@ asmjit::CodeInfo GetHostCodeInfo()
 	return codeInfo;
 }
 
+void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+{
+	return LinkJitFunction(code, compiler, compiler->Codegen());
+}
+
 static void *AllocJitMemory(size_t size)
 {
 	using namespace asmjit;
@@ -253,12 +258,10 @@ static TArray<uint16_t> CreateUnwindInfoWindows(asmjit::CCFunc *func)
 	return info;
 }
 
-void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+void *LinkJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler, asmjit::CCFunc *func)
 {
 	using namespace asmjit;
 
-	CCFunc *func = compiler->Codegen();
-
 	size_t codeSize = code->getCodeSize();
 	if (codeSize == 0)
 		return nullptr;
@@ -649,12 +652,10 @@ static TArray<uint8_t> CreateUnwindInfoUnix(asmjit::CCFunc *func, unsigned int &
 	return stream;
 }
 
-void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+void *LinkJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler, asmjit::CCFunc *func)
 {
 	using namespace asmjit;
 
-	CCFunc *func = compiler->Codegen();
-
 	size_t codeSize = code->getCodeSize();
 	if (codeSize == 0)
 		return nullptr;
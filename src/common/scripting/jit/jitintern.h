@@ -354,4 +354,6 @@ public:
 };
 
 void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler);
+// Places code that has already been generated into executable memory. Must not be called concurrently.
+void *LinkJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler, asmjit::CCFunc *func);
 asmjit::CodeInfo GetHostCodeInfo();
@@ -903,7 +903,10 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 			else
 			{
 				auto sfunc1 = static_cast<VMScriptFunction *>(call);
-				numret1 = sfunc1->ScriptCall(sfunc1, reg.param + f->NumParam - b, b, returns, C);
+				if (VMProfiling)
+					numret1 = VMProfiledScriptCall(sfunc1, reg.param + f->NumParam - b, b, returns, C);
+				else
+					numret1 = sfunc1->ScriptCall(sfunc1, reg.param + f->NumParam - b, b, returns, C);
 			}
 			assert(numret1 == C && "Number of parameters returned differs from what was expected by the caller");
 			f->NumParam -= B;
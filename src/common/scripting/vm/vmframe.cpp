@@ -43,6 +43,7 @@
 #include "jit.h"
 #include "c_cvars.h"
 #include "version.h"
+#include "threadpool.h"
 
 #ifdef HAVE_VM_JIT
 #ifdef __DragonFly__
@@ -309,6 +310,59 @@ void VMScriptFunction::JitCompile()
 	}
 }
 
+//==========================================================================
+//
+// Ahead-of-time compilation. The native code for all functions is
+// generated on a thread pool and the ScriptCall pointers are only set
+// once every function is done, so the result is the same as calling
+// JitCompile on each of them in order.
+//
+//==========================================================================
+
+void VMScriptFunction::JitCompileAll(const TArray<VMScriptFunction *> &funcs)
+{
+	TArray<VMScriptFunction *> jitfuncs;
+	TArray<JitFuncPtr> results;
+
+#ifdef HAVE_VM_JIT
+	if (vm_jit)
+	{
+		for (auto func : funcs)
+		{
+			if (!(func->VarFlags & VARF_Abstract) && CanJit(func))
+				jitfuncs.Push(func);
+		}
+	}
+
+	if (jitfuncs.Size() > 0)
+	{
+		cycle_t timer;
+		timer.ResetAndClock();
+		FThreadPool pool;
+		JitCompileBatch(jitfuncs, results, &pool);
+		timer.Unclock();
+		Printf("JIT compiled %u functions on %d threads in %.1f ms\n", jitfuncs.Size(), pool.GetThreadCount(), timer.TimeMS());
+	}
+#endif // HAVE_VM_JIT
+
+	unsigned j = 0;
+	for (auto func : funcs)
+	{
+		if (func->VarFlags & VARF_Abstract)
+			continue;
+
+		if (j < jitfuncs.Size() && jitfuncs[j] == func)
+		{
+			func->ScriptCall = results[j] ? results[j] : VMExec;
+			j++;
+		}
+		else
+		{
+			func->ScriptCall = VMExec;
+		}
+	}
+}
+
 int VMScriptFunction::FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
 {
 	// [Player701] Check that we aren't trying to call an abstract function.
@@ -664,7 +718,7 @@ int VMCall(VMFunction *func, VMValue *params, int numparams, VMReturn *results,
 				VMCycles[0].Clock();
 
 				auto sfunc = static_cast<VMScriptFunction *>(func);
-				int numret = sfunc->ScriptCall(sfunc, params, numparams, results, numresults);
+				int numret = VMProfiling ? VMProfiledScriptCall(sfunc, params, numparams, results, numresults) : sfunc->ScriptCall(sfunc, params, numparams, results, numresults);
 				VMCycles[0].Unclock();
 				return numret;
 			}
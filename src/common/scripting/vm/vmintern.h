@@ -484,5 +484,11 @@ public:
 private:
 	static int FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
 	void JitCompile();
+	static void JitCompileAll(const TArray<VMScriptFunction *> &funcs);
 	friend class FFunctionBuildList;
 };
+
+// Instrumented per-function profiler (see vmprofiler.cpp). While VMProfiling is set,
+// script-to-script calls from the interpreter and the JIT go through VMProfiledScriptCall.
+extern bool VMProfiling;
+int VMProfiledScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
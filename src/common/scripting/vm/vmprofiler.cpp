@@ -0,0 +1,310 @@
+/*
+** vmprofiler.cpp
+** Instrumented per-function profiler for script code
+**
+** Every script-to-script call made while profiling is active is routed
+** through VMProfiledScriptCall, which maintains a calling context tree.
+** The tree gives inclusive and exclusive time per call path, and is
+** folded into per-function totals and caller-callee edges for reports.
+**
+*/
+
+#include <algorithm>
+#include "vmintern.h"
+#include "stats.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "v_text.h"
+#include "files.h"
+
+bool VMProfiling;
+
+struct VMProfileFunc
+{
+	VMFunction *Func;
+	uint64_t Calls = 0;
+	double Inclusive = 0;	// Excludes recursive re-entries
+	double Exclusive = 0;
+	int Depth = 0;
+};
+
+struct VMProfileNode
+{
+	VMProfileFunc *Func = nullptr;
+	VMProfileNode *Parent = nullptr;
+	TArray<VMProfileNode *> Children;
+	uint64_t Calls = 0;
+	double Inclusive = 0;
+	double Exclusive = 0;
+};
+
+struct VMProfileStackEntry
+{
+	VMProfileNode *Node;
+	cycle_t Timer;
+	double ChildTime;
+};
+
+static VMProfileNode ProfileRoot;
+static TDeletingArray<VMProfileNode *> ProfileNodes;
+static TDeletingArray<VMProfileFunc *> ProfileFuncs;
+static TMap<VMFunction *, VMProfileFunc *> ProfileFuncMap;
+static TArray<VMProfileStackEntry> ProfileStack;
+static VMProfileNode *ProfileCurrent = &ProfileRoot;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static VMProfileNode *GetChildNode(VMProfileNode *parent, VMFunction *func)
+{
+	for (auto child : parent->Children)
+	{
+		if (child->Func->Func == func)
+			return child;
+	}
+
+	VMProfileFunc **pfunc = ProfileFuncMap.CheckKey(func);
+	VMProfileFunc *pf;
+	if (pfunc == nullptr)
+	{
+		pf = new VMProfileFunc;
+		pf->Func = func;
+		ProfileFuncs.Push(pf);
+		ProfileFuncMap.Insert(func, pf);
+	}
+	else
+	{
+		pf = *pfunc;
+	}
+
+	auto node = new VMProfileNode;
+	node->Func = pf;
+	node->Parent = parent;
+	ProfileNodes.Push(node);
+	parent->Children.Push(node);
+	return node;
+}
+
+static void ProfileEnter(VMFunction *func)
+{
+	VMProfileNode *node = GetChildNode(ProfileCurrent, func);
+	node->Calls++;
+	node->Func->Calls++;
+	node->Func->Depth++;
+	ProfileCurrent = node;
+
+	auto &entry = ProfileStack[ProfileStack.Reserve(1)];
+	entry.Node = node;
+	entry.ChildTime = 0;
+	entry.Timer.ResetAndClock();
+}
+
+static void ProfileLeave()
+{
+	auto &entry = ProfileStack.Last();
+	entry.Timer.Unclock();
+	double elapsed = entry.Timer.Time();
+	double exclusive = elapsed - entry.ChildTime;
+
+	VMProfileNode *node = entry.Node;
+	node->Inclusive += elapsed;
+	node->Exclusive += exclusive;
+	node->Func->Exclusive += exclusive;
+	if (--node->Func->Depth == 0)
+		node->Func->Inclusive += elapsed;
+
+	ProfileStack.Pop();
+	if (ProfileStack.Size() > 0)
+		ProfileStack.Last().ChildTime += elapsed;
+	ProfileCurrent = node->Parent;
+}
+
+int VMProfiledScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
+{
+	ProfileEnter(func);
+	int numret1;
+	try
+	{
+		numret1 = func->ScriptCall(func, params, numparams, ret, numret);
+	}
+	catch (...)
+	{
+		ProfileLeave();
+		throw;
+	}
+	ProfileLeave();
+	return numret1;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void ProfileReset()
+{
+	ProfileRoot.Children.Clear();
+	ProfileNodes.DeleteAndClear();
+	ProfileFuncs.DeleteAndClear();
+	ProfileFuncMap.Clear();
+	ProfileCurrent = &ProfileRoot;
+}
+
+static void PrintFlatReport(unsigned limit)
+{
+	TArray<VMProfileFunc *> sorted = ProfileFuncs;
+	std::sort(sorted.begin(), sorted.end(), [](const VMProfileFunc *a, const VMProfileFunc *b) { return a->Exclusive > b->Exclusive; });
+
+	Printf(TEXTCOLOR_YELLOW "Excl, ms    Incl, ms    Calls     Function\n");
+	Printf(TEXTCOLOR_YELLOW "----------  ----------  --------  --------------------\n");
+	for (unsigned i = 0; i < min(limit, sorted.Size()); i++)
+	{
+		auto pf = sorted[i];
+		Printf("%10.3f  %10.3f  %8llu  %s\n", pf->Exclusive * 1000., pf->Inclusive * 1000., (unsigned long long)pf->Calls, pf->Func->PrintableName);
+	}
+}
+
+static void PrintEdgeReport(unsigned limit)
+{
+	struct Edge
+	{
+		VMProfileFunc *Caller, *Callee;
+		uint64_t Calls;
+		double Inclusive;
+	};
+	TArray<Edge> edges;
+	TMap<uint64_t, unsigned> edgeIndex;	// Keyed by the pair of function indices
+
+	TMap<VMProfileFunc *, unsigned> funcIndex;
+	for (unsigned i = 0; i < ProfileFuncs.Size(); i++)
+		funcIndex.Insert(ProfileFuncs[i], i);
+
+	for (auto node : ProfileNodes)
+	{
+		if (node->Parent == &ProfileRoot)
+			continue;
+
+		uint64_t key = ((uint64_t)funcIndex[node->Parent->Func] << 32) | funcIndex[node->Func];
+		unsigned *index = edgeIndex.CheckKey(key);
+		if (index == nullptr)
+		{
+			edgeIndex.Insert(key, edges.Size());
+			edges.Push({ node->Parent->Func, node->Func, node->Calls, node->Inclusive });
+		}
+		else
+		{
+			edges[*index].Calls += node->Calls;
+			edges[*index].Inclusive += node->Inclusive;
+		}
+	}
+
+	std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.Inclusive > b.Inclusive; });
+
+	Printf(TEXTCOLOR_YELLOW "Incl, ms    Calls     Caller -> Callee\n");
+	Printf(TEXTCOLOR_YELLOW "----------  --------  --------------------\n");
+	for (unsigned i = 0; i < min(limit, edges.Size()); i++)
+	{
+		auto &edge = edges[i];
+		Printf("%10.3f  %8llu  %s -> %s\n", edge.Inclusive * 1000., (unsigned long long)edge.Calls, edge.Caller->Func->PrintableName, edge.Callee->Func->PrintableName);
+	}
+}
+
+//==========================================================================
+//
+// Writes the calling context tree in the Chrome trace event format.
+// Each node becomes a complete event whose duration is its inclusive
+// time, laid out next to its siblings, so the file can be loaded into
+// chrome://tracing, Perfetto or speedscope as a flame graph.
+//
+//==========================================================================
+
+static void WriteTraceNode(FileWriter *fw, VMProfileNode *node, double start, bool &first)
+{
+	FString name = node->Func->Func->PrintableName;
+	name.Substitute("\\", "\\\\");
+	name.Substitute("\"", "\\\"");
+
+	fw->Printf("%s\n{\"name\":\"%s\",\"cat\":\"zscript\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"calls\":%llu,\"self_ms\":%.4f}}",
+		first ? "" : ",", name.GetChars(), start * 1e6, node->Inclusive * 1e6, (unsigned long long)node->Calls, node->Exclusive * 1000.);
+	first = false;
+
+	for (auto child : node->Children)
+	{
+		WriteTraceNode(fw, child, start, first);
+		start += child->Inclusive;
+	}
+}
+
+static void WriteTrace(const char *filename)
+{
+	FileWriter *fw = FileWriter::Open(filename);
+	if (fw == nullptr)
+	{
+		Printf("Unable to open %s\n", filename);
+		return;
+	}
+
+	fw->Printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	bool first = true;
+	double start = 0;
+	for (auto child : ProfileRoot.Children)
+	{
+		WriteTraceNode(fw, child, start, first);
+		start += child->Inclusive;
+	}
+	fw->Printf("\n]}\n");
+	delete fw;
+	Printf("VM profile trace written to %s\n", filename);
+}
+
+//==========================================================================
+//
+// vmprofile start|stop|reset|report [count]|trace <file>
+//
+//==========================================================================
+
+CCMD(vmprofile)
+{
+	if (argv.argc() < 2)
+	{
+		Printf("Usage: vmprofile start|stop|reset|report [count]|trace <file>\n");
+		Printf("Profiling is %s, %u functions recorded\n", VMProfiling ? "on" : "off", ProfileFuncs.Size());
+		return;
+	}
+
+	if (!stricmp(argv[1], "start"))
+	{
+		VMProfiling = true;
+	}
+	else if (!stricmp(argv[1], "stop"))
+	{
+		VMProfiling = false;
+	}
+	else if (!stricmp(argv[1], "reset"))
+	{
+		if (ProfileStack.Size() > 0)
+		{
+			Printf("Cannot reset the VM profile while script code is running\n");
+			return;
+		}
+		ProfileReset();
+	}
+	else if (!stricmp(argv[1], "report"))
+	{
+		unsigned limit = argv.argc() > 2 ? (unsigned)strtoul(argv[2], nullptr, 10) : 30;
+		PrintFlatReport(limit);
+		PrintEdgeReport(limit);
+	}
+	else if (!stricmp(argv[1], "trace") && argv.argc() > 2)
+	{
+		WriteTrace(argv[2]);
+	}
+	else
+	{
+		Printf("Usage: vmprofile start|stop|reset|report [count]|trace <file>\n");
+	}
+}
@@ -109,8 +109,7 @@ FGameTexture::~FGameTexture()
 	}
 	for (auto &mat : Material)
 	{
-		if (mat != nullptr) delete mat;
-		mat = nullptr;
+		delete mat.exchange(nullptr);
 	}
 
 }
@@ -423,7 +422,7 @@ void FGameTexture::SetSpriteRect()
 void FGameTexture::CleanHardwareData(bool full)
 {
 	if (full) Base->CleanHardwareTextures();
-	for (auto mat : Material) if (mat) mat->DeleteDescriptors();
+	for (auto &mat : Material) if (auto m = mat.load()) m->DeleteDescriptors();
 }
 
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <memory>
+#include <atomic>
 #include "vectors.h"
 #include "floatrect.h"
 #include "refcounted.h"
@@ -150,7 +151,7 @@ class FGameTexture
 	SpritePositioningInfo* spi = nullptr;
 
 	ISoftwareTexture* SoftwareTexture = nullptr;
-	FMaterial* Material[5] = {  };
+	std::atomic<FMaterial*> Material[5] = {  };	// published once fully constructed, see FMaterial::ValidateTexture
 
 	// Material properties
 	FVector2 detailScale = { 1.f, 1.f };
@@ -237,7 +238,7 @@ public:
 	void SetRotations(int rot) { Rotations = int16_t(rot); }
 	void SetSkyOffset(int offs) { SkyOffset = offs; }
 	int GetSkyOffset() const { return SkyOffset; }
-	void setSeen() { flags |= GTexf_Seen; }
+	void setSeen() { if (!(flags & GTexf_Seen)) flags |= GTexf_Seen; }	// only written once, so worker threads can call this
 	bool isSeen(bool reset) 
 	{ 
 		int v = flags & GTexf_Seen;   
@@ -256,7 +257,7 @@ public:
 
 	FMaterial* GetMaterial(int num)
 	{
-		return Material[num];
+		return Material[num].load(std::memory_order_acquire);
 	}
 
 	int GetShaderIndex() const { return shaderindex; }
@@ -20,6 +20,7 @@
 //--------------------------------------------------------------------------
 //
 
+#include <mutex>
 #include "filesystem.h"
 #include "m_png.h"
 #include "c_dispatch.h"
@@ -201,7 +202,6 @@ FMaterial::FMaterial(FGameTexture * tx, int scaleflags)
 	mScaleFlags = scaleflags;
 
 	mTextureLayers.ShrinkToFit();
-	tx->Material[scaleflags] = this;
 	if (tx->isHardwareCanvas()) tx->SetTranslucent(false);
 }
 
@@ -238,6 +238,8 @@ IHardwareTexture* FMaterial::GetLayer(int i, int translation, MaterialLayerInfo*
 //
 //==========================================================================
 
+static std::mutex CreateMaterialMutex;
+
 FMaterial * FMaterial::ValidateTexture(FGameTexture * gtex, int scaleflags, bool create)
 {
 	if (gtex && gtex->isValid())
@@ -245,10 +247,18 @@ FMaterial * FMaterial::ValidateTexture(FGameTexture * gtex, int scaleflags, bool
 		if (scaleflags & CTF_Indexed) scaleflags = CTF_Indexed;
 		if (!gtex->expandSprites()) scaleflags &= ~CTF_Expand;
 
-		FMaterial *hwtex = gtex->Material[scaleflags];
+		FMaterial *hwtex = gtex->Material[scaleflags].load(std::memory_order_acquire);
 		if (hwtex == NULL && create)
 		{
-			hwtex = screen->CreateMaterial(gtex, scaleflags);
+			// The level mesh generates surfaces on multiple threads. The material is only
+			// published once the derived class has been constructed as well.
+			std::lock_guard<std::mutex> lock(CreateMaterialMutex);
+			hwtex = gtex->Material[scaleflags].load(std::memory_order_relaxed);
+			if (hwtex == NULL)
+			{
+				hwtex = screen->CreateMaterial(gtex, scaleflags);
+				gtex->Material[scaleflags].store(hwtex, std::memory_order_release);
+			}
 		}
 		return hwtex;
 	}
@@ -33,10 +33,12 @@
 */
 
 #include <string.h>
+#include <mutex>
 #include "name.h"
 #include "superfasthash.h"
 #include "cmdlib.h"
 #include "m_alloc.h"
+#include "engineerrors.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -45,9 +47,6 @@
 // that is just large enough to hold it.
 #define BLOCK_SIZE			4096
 
-// How many entries to grow the NameArray by when it needs to grow.
-#define NAME_GROW_AMOUNT	256
-
 // TYPES -------------------------------------------------------------------
 
 // Name text is stored in a linked list of NameBlock structures. This
@@ -60,6 +59,16 @@ struct FName::NameManager::NameBlock
 	NameBlock *NextBlock;
 };
 
+// Open addressing with linear probing. A slot holds the name index + 1,
+// so 0 is an empty slot. Slots are only ever filled, never changed.
+
+struct FName::NameManager::HashTable
+{
+	HashTable *Next;
+	unsigned int Mask;
+	std::atomic<int> *Slots;
+};
+
 // PRIVATE FUNCTION PROTOTYPES ---------------------------------------------
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
@@ -67,7 +76,11 @@ struct FName::NameManager::NameBlock
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 FName::NameManager FName::NameData;
-bool FName::NameManager::Inited;
+std::atomic<bool> FName::NameManager::Inited;
+
+// Serializes adding names. std::mutex is constant initialized, so this is
+// safe to use from static constructors.
+static std::mutex NameMutex;
 
 // Define the predefined names.
 static const char *PredefinedNames[] =
@@ -96,37 +109,11 @@ static const char *PredefinedNames[] =
 
 int FName::NameManager::FindName (const char *text, bool noCreate)
 {
-	if (!Inited)
-	{
-		InitBuckets ();
-	}
-
 	if (text == NULL)
 	{
 		return 0;
 	}
-
-	unsigned int hash = MakeKey (text);
-	unsigned int bucket = hash % HASH_SIZE;
-	int scanner = Buckets[bucket];
-
-	// See if the name already exists.
-	while (scanner >= 0)
-	{
-		if (NameArray[scanner].Hash == hash && stricmp (NameArray[scanner].Text, text) == 0)
-		{
-			return scanner;
-		}
-		scanner = NameArray[scanner].NextHash;
-	}
-
-	// If we get here, then the name does not exist.
-	if (noCreate)
-	{
-		return 0;
-	}
-
-	return AddName (text, hash, bucket);
+	return FindName (text, strlen (text), noCreate);
 }
 
 //==========================================================================
@@ -138,7 +125,7 @@ int FName::NameManager::FindName (const char *text, bool noCreate)
 
 int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreate)
 {
-	if (!Inited)
+	if (!Inited.load(std::memory_order_acquire))
 	{
 		InitBuckets ();
 	}
@@ -149,19 +136,10 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 	}
 
 	unsigned int hash = MakeKey (text, textLen);
-	unsigned int bucket = hash % HASH_SIZE;
-	int scanner = Buckets[bucket];
-
-	// See if the name already exists.
-	while (scanner >= 0)
+	int index = LookupName (Table.load(std::memory_order_acquire), text, textLen, hash);
+	if (index >= 0)
 	{
-		if (NameArray[scanner].Hash == hash &&
-			strnicmp (NameArray[scanner].Text, text, textLen) == 0 &&
-			NameArray[scanner].Text[textLen] == '\0')
-		{
-			return scanner;
-		}
-		scanner = NameArray[scanner].NextHash;
+		return index;
 	}
 
 	// If we get here, then the name does not exist.
@@ -170,7 +148,40 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 		return 0;
 	}
 
-	return AddName (text, hash, bucket);
+	std::lock_guard<std::mutex> lock(NameMutex);
+
+	// Somebody else may have added it in the meantime.
+	index = LookupName (Table.load(std::memory_order_relaxed), text, textLen, hash);
+	if (index >= 0)
+	{
+		return index;
+	}
+	return AddName (text, textLen, hash);
+}
+
+//==========================================================================
+//
+// FName :: NameManager :: LookupName
+//
+// Returns -1 if the name is not in the table.
+//
+//==========================================================================
+
+int FName::NameManager::LookupName (const HashTable *table, const char *text, size_t textLen, unsigned int hash) const
+{
+	for (unsigned int slot = hash & table->Mask; ; slot = (slot + 1) & table->Mask)
+	{
+		int index = table->Slots[slot].load(std::memory_order_acquire) - 1;
+		if (index < 0)
+		{
+			return -1;
+		}
+		const NameEntry &entry = GetEntry(index);
+		if (entry.Hash == hash && entry.Length == textLen && strnicmp (entry.Text, text, textLen) == 0)
+		{
+			return index;
+		}
+	}
 }
 
 //==========================================================================
@@ -183,59 +194,125 @@ int FName::NameManager::FindName (const char *text, size_t textLen, bool noCreat
 
 void FName::NameManager::InitBuckets ()
 {
-	Inited = true;
-	memset (Buckets, -1, sizeof(Buckets));
+	{
+		std::lock_guard<std::mutex> lock(NameMutex);
+		if (Inited.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+		GrowTable (MIN_HASH_SIZE);
 
-	// Register built-in names. 'None' must be name 0.
-	for (size_t i = 0; i < countof(PredefinedNames); ++i)
+		// Register built-in names. 'None' must be name 0.
+		for (size_t i = 0; i < countof(PredefinedNames); ++i)
+		{
+			size_t len = strlen (PredefinedNames[i]);
+			unsigned int hash = MakeKey (PredefinedNames[i], len);
+			assert(LookupName(Table.load(std::memory_order_relaxed), PredefinedNames[i], len, hash) < 0 && "Predefined name already inserted");
+			AddName (PredefinedNames[i], len, hash);
+		}
+	}
+	Inited.store(true, std::memory_order_release);
+}
+
+//==========================================================================
+//
+// FName :: NameManager :: GrowTable
+//
+// Replaces the hash table with an empty one of the given size and puts
+// all the names into it. Must be called with the lock held.
+//
+//==========================================================================
+
+void FName::NameManager::GrowTable (unsigned int size)
+{
+	HashTable *table = new HashTable;
+	table->Mask = size - 1;
+	table->Slots = new std::atomic<int>[size];
+	for (unsigned int i = 0; i < size; i++)
 	{
-		assert((0 == FindName(PredefinedNames[i], true)) && "Predefined name already inserted");
-		FindName (PredefinedNames[i], false);
+		table->Slots[i].store(0, std::memory_order_relaxed);
 	}
+
+	int count = NumNames.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; i++)
+	{
+		unsigned int slot = GetEntry(i).Hash & table->Mask;
+		while (table->Slots[slot].load(std::memory_order_relaxed) != 0)
+		{
+			slot = (slot + 1) & table->Mask;
+		}
+		table->Slots[slot].store(i + 1, std::memory_order_relaxed);
+	}
+
+	HashTable *old = Table.load(std::memory_order_relaxed);
+	if (old != nullptr)
+	{
+		old->Next = OldTables;
+		OldTables = old;
+	}
+	table->Next = nullptr;
+	Table.store(table, std::memory_order_release);
 }
 
 //==========================================================================
 //
 // FName :: NameManager :: AddName
 //
-// Adds a new name to the name table.
+// Adds a new name to the name table. Must be called with the lock held.
 //
 //==========================================================================
 
-int FName::NameManager::AddName (const char *text, unsigned int hash, unsigned int bucket)
+int FName::NameManager::AddName (const char *text, size_t len, unsigned int hash)
 {
 	char *textstore;
 	NameBlock *block = Blocks;
-	size_t len = strlen (text) + 1;
+	int index = NumNames.load(std::memory_order_relaxed);
+
+	if ((index >> ENTRY_BLOCK_SHIFT) >= MAX_ENTRY_BLOCKS)
+	{
+		I_FatalError("Too many names");
+	}
 
 	// Get a block large enough for the name. Only the first block in the
 	// list is ever considered for name storage.
-	if (block == NULL || block->NextAlloc + len >= BLOCK_SIZE)
+	if (block == NULL || block->NextAlloc + len + 1 >= BLOCK_SIZE)
 	{
-		block = AddBlock (len);
+		block = AddBlock (len + 1);
 	}
 
 	// Copy the string into the block.
 	textstore = (char *)block + block->NextAlloc;
-	strcpy (textstore, text);
-	block->NextAlloc += len;
+	memcpy (textstore, text, len);
+	textstore[len] = 0;
+	block->NextAlloc += len + 1;
 
-	// Add an entry for the name to the NameArray
-	if (NumNames >= MaxNames)
+	// Add an entry for the name. Entry blocks are never moved.
+	NameEntry *&entries = EntryBlocks[index >> ENTRY_BLOCK_SHIFT];
+	if (entries == nullptr)
 	{
-		// If no names have been defined yet, make the first allocation
-		// large enough to hold all the predefined names.
-		MaxNames += MaxNames == 0 ? countof(PredefinedNames) + NAME_GROW_AMOUNT : NAME_GROW_AMOUNT;
-
-		NameArray = (NameEntry *)M_Realloc (NameArray, MaxNames * sizeof(NameEntry));
+		entries = (NameEntry *)M_Malloc (ENTRY_BLOCK_SIZE * sizeof(NameEntry));
+	}
+	NameEntry &entry = entries[index & (ENTRY_BLOCK_SIZE - 1)];
+	entry.Text = textstore;
+	entry.Hash = hash;
+	entry.Length = (unsigned int)len;
+
+	// Keep the table at most half full so that probe sequences stay short.
+	HashTable *table = Table.load(std::memory_order_relaxed);
+	if (unsigned(index + 1) * 2 > table->Mask + 1)
+	{
+		GrowTable ((table->Mask + 1) * 2);
+		table = Table.load(std::memory_order_relaxed);
 	}
 
-	NameArray[NumNames].Text = textstore;
-	NameArray[NumNames].Hash = hash;
-	NameArray[NumNames].NextHash = Buckets[bucket];
-	Buckets[bucket] = NumNames;
-
-	return NumNames++;
+	unsigned int slot = hash & table->Mask;
+	while (table->Slots[slot].load(std::memory_order_relaxed) != 0)
+	{
+		slot = (slot + 1) & table->Mask;
+	}
+	NumNames.store(index + 1, std::memory_order_release);
+	table->Slots[slot].store(index + 1, std::memory_order_release);
+	return index;
 }
 
 //==========================================================================
@@ -284,11 +361,29 @@ FName::NameManager::~NameManager()
 	}
 	Blocks = NULL;
 
-	if (NameArray != NULL)
+	for (auto &entries : EntryBlocks)
+	{
+		if (entries != NULL)
+		{
+			M_Free (entries);
+			entries = NULL;
+		}
+	}
+
+	HashTable *table = Table.load(std::memory_order_relaxed);
+	if (table != nullptr)
+	{
+		table->Next = OldTables;
+		OldTables = table;
+	}
+	while (OldTables != nullptr)
 	{
-		M_Free (NameArray);
-		NameArray = NULL;
+		table = OldTables;
+		OldTables = table->Next;
+		delete[] table->Slots;
+		delete table;
 	}
-	NumNames = MaxNames = 0;
-	memset (Buckets, -1, sizeof(Buckets));
+	Table.store(nullptr, std::memory_order_relaxed);
+	NumNames.store(0, std::memory_order_relaxed);
+	Inited.store(false, std::memory_order_relaxed);
 }
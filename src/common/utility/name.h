@@ -34,6 +34,7 @@
 #ifndef NAME_H
 #define NAME_H
 
+#include <atomic>
 #include "tarray.h"
 #include "zstring.h"
 
@@ -65,7 +66,7 @@ public:
  //   ~FName () {}	// Names can be added but never removed.
 
 	int GetIndex() const { return Index; }
-	const char *GetChars() const { return NameData.NameArray[Index].Text; }
+	const char *GetChars() const { return NameData.GetEntry(Index).Text; }
 
 	FName &operator = (const char *text) { Index = NameData.FindName (text, false); return *this; }
 	FName& operator = (const FString& text) { Index = NameData.FindName(text.GetChars(), text.Len(), false); return *this; }
@@ -74,9 +75,9 @@ public:
 
 	int SetName (const char *text, bool noCreate=false) { return Index = NameData.FindName (text, noCreate); }
 
-	bool IsValidName() const { return (unsigned)Index < (unsigned)NameData.NumNames; }
+	bool IsValidName() const { return (unsigned)Index < (unsigned)NameData.NumNames.load(std::memory_order_acquire); }
 
-	static bool IsValidName(int index) { return index >= 0 && index < NameData.NumNames; }
+	static bool IsValidName(int index) { return index >= 0 && index < NameData.NumNames.load(std::memory_order_acquire); }
 
 	// Note that the comparison operators compare the names' indices, not
 	// their text, so they cannot be used to do a lexicographical sort.
@@ -101,9 +102,13 @@ protected:
 	{
 		char *Text;
 		unsigned int Hash;
-		int NextHash;
+		unsigned int Length;
 	};
 
+	// Names can be looked up from any thread without locking. Adding one
+	// takes a lock. Entries live in blocks that never move and the hash
+	// table is replaced by a larger one as it fills up, so a reader never
+	// sees anything being moved.
 	struct NameManager
 	{
 		// No constructor because we can't ensure that it actually gets
@@ -111,20 +116,35 @@ protected:
 		// means this struct must only exist in the program's BSS section.
 		~NameManager();
 
-		enum { HASH_SIZE = 1024 };
+		enum
+		{
+			ENTRY_BLOCK_SHIFT = 12,
+			ENTRY_BLOCK_SIZE = 1 << ENTRY_BLOCK_SHIFT,
+			MAX_ENTRY_BLOCKS = 4096,
+			MIN_HASH_SIZE = 4096
+		};
 		struct NameBlock;
+		struct HashTable;
 
 		NameBlock *Blocks;
-		NameEntry *NameArray;
-		int NumNames, MaxNames;
-		int Buckets[HASH_SIZE];
+		NameEntry *EntryBlocks[MAX_ENTRY_BLOCKS];
+		std::atomic<HashTable *> Table;
+		HashTable *OldTables;			// readers may still be using them, so they are only freed on exit
+		std::atomic<int> NumNames;
+
+		const NameEntry &GetEntry(int index) const
+		{
+			return EntryBlocks[index >> ENTRY_BLOCK_SHIFT][index & (ENTRY_BLOCK_SIZE - 1)];
+		}
 
 		int FindName (const char *text, bool noCreate);
 		int FindName (const char *text, size_t textlen, bool noCreate);
-		int AddName (const char *text, unsigned int hash, unsigned int bucket);
+		int LookupName (const HashTable *table, const char *text, size_t textlen, unsigned int hash) const;
+		int AddName (const char *text, size_t textlen, unsigned int hash);
 		NameBlock *AddBlock (size_t len);
+		void GrowTable (unsigned int size);
 		void InitBuckets ();
-		static bool Inited;
+		static std::atomic<bool> Inited;
 	};
 
 	static NameManager NameData;
@@ -0,0 +1,96 @@
+
+#include "threadpool.h"
+#include <algorithm>
+#include <memory>
+
+FThreadPool::FThreadPool(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	for (int i = 1; i < numThreads; i++)
+		Threads.push_back(std::thread([this]() { WorkerMain(); }));
+}
+
+FThreadPool::~FThreadPool()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	StopFlag = true;
+	lock.unlock();
+	WorkCondition.notify_all();
+
+	for (auto& thread : Threads)
+		thread.join();
+}
+
+void FThreadPool::Run(int count, const std::function<void(int)>& func)
+{
+	if (count <= 0)
+		return;
+
+	if (Threads.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	Job = &func;
+	JobCount = count;
+	NextIndex = 0;
+	ActiveWorkers = (int)Threads.size();
+	Generation++;
+	lock.unlock();
+	WorkCondition.notify_all();
+
+	while (true)
+	{
+		int i = NextIndex.fetch_add(1);
+		if (i >= count)
+			break;
+		func(i);
+	}
+
+	lock.lock();
+	DoneCondition.wait(lock, [&]() { return ActiveWorkers == 0; });
+	Job = nullptr;
+	JobCount = 0;
+}
+
+void FThreadPool::WorkerMain()
+{
+	int seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(Mutex);
+	while (true)
+	{
+		WorkCondition.wait(lock, [&]() { return StopFlag || Generation != seenGeneration; });
+		if (StopFlag)
+			break;
+
+		seenGeneration = Generation;
+		const std::function<void(int)>* job = Job;
+		int count = JobCount;
+		lock.unlock();
+
+		while (true)
+		{
+			int i = NextIndex.fetch_add(1);
+			if (i >= count)
+				break;
+			(*job)(i);
+		}
+
+		lock.lock();
+		if (--ActiveWorkers == 0)
+			DoneCondition.notify_all();
+	}
+}
+
+FThreadPool* GetSharedThreadPool()
+{
+	static std::unique_ptr<FThreadPool> pool;
+	if (!pool)
+		pool.reset(new FThreadPool());
+	return pool.get();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// A set of worker threads that can be used to split CPU work into independent jobs.
+//
+// The calling thread always participates in the work, so a pool with one thread
+// runs everything serially without any synchronization overhead.
+class FThreadPool
+{
+public:
+	// Zero threads means one per hardware thread
+	FThreadPool(int numThreads = 0);
+	~FThreadPool();
+
+	// Total number of threads working on a job, including the calling thread
+	int GetThreadCount() const { return (int)Threads.size() + 1; }
+
+	// Calls func(index) for every index in [0, count) and waits until all of them have finished.
+	// The order in which indexes are processed is not defined.
+	void Run(int count, const std::function<void(int)>& func);
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> Threads;
+	std::mutex Mutex;
+	std::condition_variable WorkCondition;
+	std::condition_variable DoneCondition;
+
+	const std::function<void(int)>* Job = nullptr;
+	int JobCount = 0;
+	std::atomic<int> NextIndex = { 0 };
+	int ActiveWorkers = 0;
+	int Generation = 0;
+	bool StopFlag = false;
+
+	FThreadPool(const FThreadPool&) = delete;
+	FThreadPool& operator=(const FThreadPool&) = delete;
+};
+
+// The pool for parallel work done by the engine as it runs, with one thread per hardware thread.
+// It is created on first use and kept for the whole session. Only the main thread may start jobs
+// on it, and a job must not start another one.
+FThreadPool* GetSharedThreadPool();
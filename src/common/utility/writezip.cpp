@@ -184,12 +184,16 @@ int AppendCentralDirectory(FileWriter *zip_file, const FCompressedBuffer &conten
 
 bool WriteZip(const char* filename, const FCompressedBuffer* content, size_t contentcount)
 {
-	// try to determine local time
-	struct tm *ltime;
+	// try to determine local time. This may run on the save writer thread, so it must not use localtime's static buffer.
+	struct tm ltime;
 	time_t ttime;
 	ttime = time(nullptr);
-	ltime = localtime(&ttime);
-	auto dostime = time_to_dos(ltime);
+#ifdef _WIN32
+	localtime_s(&ltime, &ttime);
+#else
+	localtime_r(&ttime, &ltime);
+#endif
+	auto dostime = time_to_dos(&ltime);
 
 	TArray<int> positions;
 
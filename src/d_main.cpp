@@ -73,6 +73,7 @@
 #include "d_main.h"
 #include "d_dehacked.h"
 #include "cmdlib.h"
+#include "i_specialpaths.h"
 #include "v_text.h"
 #include "gi.h"
 #include "a_dynlight.h"
@@ -122,6 +123,8 @@
 #include "shiftstate.h"
 #include "common/widgets/errorwindow.h"
 #include "commandlets/commandlet.h"
+#include "g_benchmark.h"
+#include "g_savewriter.h"
 
 #ifdef __unix__
 #include "i_system.h"  // for SHARE_DIR
@@ -257,6 +260,17 @@ CUSTOM_CVAR(Int, vid_rendermode, 4, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOIN
 }
 #endif
 
+//==========================================================================
+//
+// The CPU backend can only run the software renderer.
+//
+//==========================================================================
+
+bool V_HasHardwareRenderer()
+{
+	return screen == nullptr || !screen->IsPoly();
+}
+
 CUSTOM_CVAR (Int, fraglimit, 0, CVAR_SERVERINFO)
 {
 	// Check for the fraglimit being hit because the fraglimit is being
@@ -303,6 +317,8 @@ CVAR(Bool, autoloadbrightmaps, true, CVAR_ARCHIVE | CVAR_NOINITCALL | CVAR_GLOBA
 CVAR(Bool, autoloadlights, true, CVAR_ARCHIVE | CVAR_NOINITCALL | CVAR_GLOBALCONFIG)
 CVAR(Bool, autoloadwidescreen, true, CVAR_ARCHIVE | CVAR_NOINITCALL | CVAR_GLOBALCONFIG)
 CVAR(Bool, r_debug_disable_vis_filter, false, 0)
+CVAR(Bool, fs_maparchives, true, CVAR_ARCHIVE | CVAR_NOINITCALL | CVAR_GLOBALCONFIG)	// map the engine and IWAD archives into memory so that lumps can be loaded from multiple threads at once
+CVAR(Bool, fs_indexcache, true, CVAR_ARCHIVE | CVAR_NOINITCALL | CVAR_GLOBALCONFIG)	// cache the processed directories of archives on disk
 CVAR(Int, vid_showpalette, 0, 0)
 
 CUSTOM_CVAR (Bool, i_discordrpc, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
@@ -1186,6 +1202,7 @@ void D_Display ()
 	}
 	cycles.Unclock();
 	FrameCycles = cycles;
+	G_BenchmarkFrame(cycles.TimeMS());
 }
 
 //==========================================================================
@@ -3229,6 +3246,13 @@ static int D_InitGame(const FIWADInfo* iwad_info, std::vector<std::string>& allw
 
 
 	GetReserved(lfi);
+	lfi.maparchives = fs_maparchives;
+	if (fs_indexcache)
+	{
+		FString indexpath = M_GetCachePath(true) + "/fsindex";
+		CreatePath(indexpath.GetChars());
+		lfi.indexcachepath = indexpath.GetChars();
+	}
 
 	lfi.postprocessFunc = [&]()
 	{
@@ -3586,6 +3610,21 @@ static int D_InitGame(const FIWADInfo* iwad_info, std::vector<std::string>& allw
 			G_LoadGame(file.GetChars());
 		}
 
+		v = Args->CheckValue("-benchmark");
+		if (v != NULL)
+		{
+			// -benchtics runs a fixed number of tics without waiting for the timer and then exits.
+			// Combine it with -warp or +map for a run without a demo, or use -timedemo instead.
+			int benchtics = 0;
+			const char *t = Args->CheckValue("-benchtics");
+			if (t != NULL)
+			{
+				benchtics = max((int)strtol(t, nullptr, 10), 1);
+				singletics = true;
+			}
+			G_BenchmarkStart(v, benchtics);
+		}
+
 		v = Args->CheckValue("-playdemo");
 		if (v != NULL)
 		{
@@ -3970,6 +4009,8 @@ int GameMain()
 
 void D_Cleanup()
 {
+	G_WaitForSaves();
+
 	if (demorecording)
 	{
 		G_CheckDemoStatus();
@@ -159,8 +159,14 @@ EXTERN_CVAR(Int, vid_rendermode)
 constexpr int vid_rendermode = 4;
 #endif
 
+bool V_HasHardwareRenderer();
+
 inline bool V_IsHardwareRenderer()
 {
+#ifndef NO_SWRENDERER
+	// Backends without a GPU fall back to the software renderer.
+	if (!V_HasHardwareRenderer()) return false;
+#endif
 	return vid_rendermode == 4 || vid_rendermode == 2;
 }
 
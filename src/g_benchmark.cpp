@@ -0,0 +1,204 @@
+/*
+** g_benchmark.cpp
+**
+** Headless benchmark runs that record per-tic and per-frame timings
+** and write them out as JSON.
+**
+*/
+
+#include <algorithm>
+#include "g_benchmark.h"
+#include "doomstat.h"
+#include "g_levellocals.h"
+#include "dobject.h"
+#include "engineerrors.h"
+#include "files.h"
+#include "printf.h"
+#include "i_time.h"
+
+extern cycle_t VMCycles[10];
+extern cycle_t ThinkCycles;
+extern cycle_t SightCycles;
+
+cycle_t PlaysimCycles;
+
+struct FBenchmarkState
+{
+	FString Filename;
+	int MaxTics = 0;
+	bool Active = false;
+
+	uint64_t StartTime = 0;
+	cycle_t TicCycles;
+	double VMStart = 0;
+	double GCStart = 0;
+
+	// Per-tic timings in milliseconds
+	TArray<double> Tic, Playsim, VM, Think, Sight, GC;
+
+	// Per-frame timings in milliseconds
+	TArray<double> Render;
+};
+
+static FBenchmarkState Bench;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void G_BenchmarkStart(const char *filename, int maxtics)
+{
+	Bench = {};
+	Bench.Filename = filename;
+	Bench.MaxTics = maxtics;
+	Bench.Active = true;
+	Bench.StartTime = I_nsTime();
+	Bench.GCStart = GC::StepTimeMS;
+}
+
+bool G_BenchmarkActive()
+{
+	return Bench.Active;
+}
+
+//==========================================================================
+//
+// Called at the start and end of G_Ticker. GC time is measured between
+// the end of two tics, since CheckGC runs right after G_Ticker.
+//
+//==========================================================================
+
+void G_BenchmarkBeginTic()
+{
+	PlaysimCycles.Reset();
+	if (!Bench.Active)
+		return;
+
+	Bench.TicCycles.ResetAndClock();
+	Bench.VMStart = VMCycles[0].TimeMS();
+}
+
+void G_BenchmarkEndTic()
+{
+	if (!Bench.Active)
+		return;
+
+	Bench.TicCycles.Unclock();
+
+	// The VM stat resets its counter when it gets displayed, which only ever happens between tics.
+	double vm = VMCycles[0].TimeMS();
+	if (vm >= Bench.VMStart)
+		vm -= Bench.VMStart;
+
+	Bench.Tic.Push(Bench.TicCycles.TimeMS());
+	Bench.Playsim.Push(PlaysimCycles.TimeMS());
+	Bench.VM.Push(vm);
+	Bench.Think.Push(ThinkCycles.TimeMS());
+	Bench.Sight.Push(SightCycles.TimeMS());
+	Bench.GC.Push(GC::StepTimeMS - Bench.GCStart);
+	Bench.GCStart = GC::StepTimeMS;
+
+	if (Bench.MaxTics > 0 && (int)Bench.Tic.Size() >= Bench.MaxTics)
+	{
+		G_BenchmarkFinish();
+		throw CExitEvent(0);
+	}
+}
+
+void G_BenchmarkFrame(double renderms)
+{
+	if (Bench.Active)
+		Bench.Render.Push(renderms);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void WriteArray(FString &out, const char *name, const TArray<double> &values, bool last)
+{
+	out.AppendFormat("\t\t\"%s\": [", name);
+	for (unsigned i = 0; i < values.Size(); i++)
+	{
+		out.AppendFormat(i == 0 ? "%.4f" : ",%.4f", values[i]);
+	}
+	out.AppendFormat("]%s\n", last ? "" : ",");
+}
+
+static void WriteSummary(FString &out, const char *name, const TArray<double> &values, bool last)
+{
+	TArray<double> sorted = values;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0;
+	for (double v : sorted)
+		total += v;
+
+	auto percentile = [&](double p) -> double
+	{
+		if (sorted.Size() == 0)
+			return 0;
+		unsigned index = (unsigned)(p * (sorted.Size() - 1) + 0.5);
+		return sorted[index];
+	};
+
+	out.AppendFormat("\t\t\"%s\": { \"total\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+		name, total, sorted.Size() ? total / sorted.Size() : 0.0, percentile(0.5), percentile(0.9), percentile(0.99),
+		sorted.Size() ? sorted.Last() : 0.0, last ? "" : ",");
+}
+
+void G_BenchmarkFinish()
+{
+	if (!Bench.Active)
+		return;
+	Bench.Active = false;
+
+	double elapsed = (I_nsTime() - Bench.StartTime) / 1'000'000.0;
+
+	FString mapname = primaryLevel ? primaryLevel->MapName : FString();
+	mapname.Substitute("\\", "\\\\");
+	mapname.Substitute("\"", "\\\"");
+
+	FString out;
+	out.AppendFormat("{\n\t\"map\": \"%s\",\n\t\"tics\": %u,\n\t\"frames\": %u,\n\t\"elapsedms\": %.4f,\n",
+		mapname.GetChars(), Bench.Tic.Size(), Bench.Render.Size(), elapsed);
+
+	out += "\t\"tic\": {\n";
+	WriteArray(out, "total", Bench.Tic, false);
+	WriteArray(out, "playsim", Bench.Playsim, false);
+	WriteArray(out, "vm", Bench.VM, false);
+	WriteArray(out, "think", Bench.Think, false);
+	WriteArray(out, "sight", Bench.Sight, false);
+	WriteArray(out, "gc", Bench.GC, true);
+	out += "\t},\n";
+
+	out += "\t\"frame\": {\n";
+	WriteArray(out, "render", Bench.Render, true);
+	out += "\t},\n";
+
+	out += "\t\"summary\": {\n";
+	WriteSummary(out, "tic", Bench.Tic, false);
+	WriteSummary(out, "playsim", Bench.Playsim, false);
+	WriteSummary(out, "vm", Bench.VM, false);
+	WriteSummary(out, "think", Bench.Think, false);
+	WriteSummary(out, "sight", Bench.Sight, false);
+	WriteSummary(out, "gc", Bench.GC, false);
+	WriteSummary(out, "render", Bench.Render, true);
+	out += "\t}\n}\n";
+
+	FileWriter *f = FileWriter::Open(Bench.Filename.GetChars());
+	if (f != nullptr)
+	{
+		f->Write(out.GetChars(), out.Len());
+		delete f;
+		Printf("Benchmark timings for %u tics and %u frames saved to %s\n", Bench.Tic.Size(), Bench.Render.Size(), Bench.Filename.GetChars());
+	}
+	else
+	{
+		Printf("Could not write benchmark timings to %s\n", Bench.Filename.GetChars());
+	}
+}
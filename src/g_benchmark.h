@@ -0,0 +1,21 @@
+#ifndef __G_BENCHMARK_H
+#define __G_BENCHMARK_H
+
+#include "stats.h"
+
+// Time spent in P_Ticker during the current tic.
+extern cycle_t PlaysimCycles;
+
+// Starts recording per-tic and per-frame timings that get written to the given JSON file.
+// If maxtics is greater than zero the game exits after that many tics.
+void G_BenchmarkStart(const char *filename, int maxtics);
+bool G_BenchmarkActive();
+
+void G_BenchmarkBeginTic();
+void G_BenchmarkEndTic();
+void G_BenchmarkFrame(double renderms);
+
+// Writes the collected timings and stops recording.
+void G_BenchmarkFinish();
+
+#endif
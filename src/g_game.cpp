@@ -91,6 +91,8 @@
 #include "screenjob.h"
 #include "i_interface.h"
 #include "fs_findfile.h"
+#include "g_benchmark.h"
+#include "g_savewriter.h"
 
 
 static FRandom pr_dmspawn ("DMSpawn");
@@ -118,6 +120,7 @@ void STAT_Serialize(FSerializer &file);
 
 CVARD_NAMED(Int, gameskill, skill, 2, CVAR_SERVERINFO|CVAR_LATCH, "sets the skill for the next newly started game")
 CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves (more readable but a larger files and a bit slower.
+CVAR(Bool, save_binary, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)		// use the compact binary format for level snapshots and globals. save_formatted overrides this.
 CVAR (Int, deathmatch, 0, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR (Bool, chasedemo, false, 0);
 CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
@@ -1144,6 +1147,9 @@ void G_Ticker ()
 	int i;
 	gamestate_t	oldgamestate;
 
+	G_BenchmarkBeginTic();
+	G_CheckSaveWriter();
+
 	// do player reborns if needed
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -1326,12 +1332,16 @@ void G_Ticker ()
 	switch (gamestate)
 	{
 	case GS_LEVEL:
+		PlaysimCycles.Clock();
 		P_Ticker ();
+		PlaysimCycles.Unclock();
 		primaryLevel->automap->Ticker ();
 		break;
 
 	case GS_TITLELEVEL:
+		PlaysimCycles.Clock();
 		P_Ticker ();
+		PlaysimCycles.Unclock();
 		break;
 
 	case GS_DEMOSCREEN:
@@ -1361,6 +1371,8 @@ void G_Ticker ()
 
 	// [MK] Additional ticker for UI events right after all others
 	primaryLevel->localEventManager->PostUiTick();
+
+	G_BenchmarkEndTic();
 }
 
 
@@ -2026,6 +2038,8 @@ void FinishLoadingCVars();
 
 void G_DoLoadGame ()
 {
+	// The requested file may still be in the process of being written.
+	G_WaitForSaves();
 	SetupLoadingCVars();
 	bool hidecon;
 
@@ -2388,10 +2402,11 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	if (cl_waitforsave)
 		I_FreezeTime(true);
 
+	FString leveltext;
 	insave = true;
 	try
 	{
-		level.SnapshotLevel();
+		level.SnapshotLevel(&leveltext);
 	}
 	catch(CRecoverableError &err)
 	{
@@ -2418,7 +2433,8 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	FSerializer savegameglobals;	// and this for non-level related info that must be saved.
 
 	savegameinfo.OpenWriter(true);
-	savegameglobals.OpenWriter(save_formatted);
+	if (save_binary && !save_formatted) savegameglobals.OpenBinaryWriter();
+	else savegameglobals.OpenWriter(save_formatted);
 
 	SaveVersion = SAVEVER;
 	PutSavePic(&savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
@@ -2467,55 +2483,70 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		savegameglobals("nextskill", NextSkill);
 	}
 
+	// Everything below only deals with data that has been captured here, so the
+	// compression and file writing can happen without stopping the game.
+	auto job = new FSaveGameJob;
+	job->Filename = filename.GetChars();
+
 	auto picdata = savepic.GetBuffer();
 	FCompressedBuffer bufpng = { picdata->size(), picdata->size(), FileSys::METHOD_STORED, static_cast<unsigned int>(crc32(0, &(*picdata)[0], picdata->size())), (char*)&(*picdata)[0] };
 
-	savegame_content.Push(bufpng);
-	savegame_filenames.Push("savepic.png");
-	savegame_content.Push(savegameinfo.GetCompressedOutput());
-	savegame_filenames.Push("info.json");
-	savegame_content.Push(savegameglobals.GetCompressedOutput());
-	savegame_filenames.Push("globals.json");
-	G_WriteSnapshots (savegame_filenames, savegame_content);
-	
-	for (unsigned i = 0; i < savegame_content.Size(); i++)
-		savegame_content[i].filename = savegame_filenames[i].GetChars();
-
-	bool succeeded = false;
+	unsigned len;
+	const char *output;
+	job->AddBuffer("savepic.png", bufpng);
+	output = savegameinfo.GetOutput(&len);
+	job->AddText("info.json", FString(output, len));
+	output = savegameglobals.GetOutput(&len);
+	job->AddText("globals.json", FString(output, len));
 
-	if (WriteZip(filename.GetChars(), savegame_content.Data(), savegame_content.Size()))
+	// The current level has no compressed snapshot yet. Give it a stand-in that
+	// points to its text so that it keeps its place in the archive.
+	if (leveltext.Len() > 0)
 	{
-		// Check whether the file is ok by trying to open it.
-		FResourceFile *test = FResourceFile::OpenResourceFile(filename.GetChars(), true);
-		if (test != nullptr)
-		{
-			delete test;
-			succeeded = true;
-		}
+		level.info->Snapshot = { leveltext.Len(), leveltext.Len(), FileSys::METHOD_STORED, 0, (char*)leveltext.GetChars() };
 	}
-
-	if (succeeded)
+	if (!G_WriteSnapshots (savegame_filenames, savegame_content))
 	{
-		savegameManager.NotifyNewSave(filename, description, okForQuicksave, forceQuicksave);
-		BackupSaveName = filename;
-
-		if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), filename.GetChars());
-		else Printf("%s\n", GStrings.GetString("GGSAVED"));
+		// A save without all the hub's levels would lose their state when it is loaded.
+		level.info->Snapshot = {};
+		G_SpillSnapshots(nullptr);
+		delete job;
+		insave = false;
+		Printf(PRINT_HIGH, "Save failed\n");
+		if (cl_waitforsave)
+			I_FreezeTime(false);
+		return;
 	}
-	else
+	for (unsigned i = 0; i < savegame_content.Size(); i++)
 	{
-		Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
+		if (leveltext.Len() > 0 && savegame_content[i].mBuffer == leveltext.GetChars())
+			job->AddText(savegame_filenames[i].GetChars(), std::move(leveltext));
+		else
+			job->AddBuffer(savegame_filenames[i].GetChars(), savegame_content[i]);
 	}
+	// The stand-in must not be cleaned, its buffer belongs to leveltext.
+	level.info->Snapshot = {};
+	// The job has its own copies, so the snapshots that had to be read back can go again.
+	G_SpillSnapshots(nullptr);
 
+	FString desc = description;
+	job->Finished = [=](FSaveGameJob &result)
+	{
+		if (result.Succeeded)
+		{
+			savegameManager.NotifyNewSave(filename, desc, okForQuicksave, forceQuicksave);
+			BackupSaveName = filename;
 
-	// delete the JSON buffers we created just above. Everything else will
-	// either still be needed or taken care of automatically.
-	savegame_content[1].Clean();
-	savegame_content[2].Clean();
+			if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), filename.GetChars());
+			else Printf("%s\n", GStrings.GetString("GGSAVED"));
+		}
+		else
+		{
+			Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
+		}
+	};
+	G_QueueSaveGame(job);
 
-	// We don't need the snapshot any longer.
-	level.info->Snapshot.Clean();
-		
 	insave = false;
 
 	if (cl_waitforsave)
@@ -3055,6 +3086,7 @@ bool G_CheckDemoStatus (void)
 		}
 		if (singledemo || timingdemo)
 		{
+			G_BenchmarkFinish();
 			if (timingdemo)
 			{
 				// Trying to get back to a stable state after timing a demo
@@ -1290,6 +1290,7 @@ bool FLevelLocals::DoCompleted (FString nextlevel, wbstartstruct_t &wminfo)
 		if (!(flags2 & LEVEL2_FORGETSTATE))
 		{
 			SnapshotLevel ();
+			G_SpillSnapshots (info);
 			// Do not free any global strings this level might reference
 			// while it's not loaded.
 			Behaviors.LockLevelVarStrings(levelnum);
@@ -1297,6 +1298,7 @@ bool FLevelLocals::DoCompleted (FString nextlevel, wbstartstruct_t &wminfo)
 		else
 		{ // Make sure we don't have a snapshot lying around from before.
 			info->Snapshot.Clean();
+			info->SnapshotSpill = -1;
 		}
 	}
 	else
@@ -1949,7 +1951,7 @@ void FLevelLocals::AirControlChanged ()
 //
 //==========================================================================
 
-void G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buffers)
+bool G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buffers)
 {
 	unsigned int i;
 	FString filename;
@@ -1958,6 +1960,11 @@ void G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buf
 	{
 		if (wadlevelinfos[i].Snapshot.mCompressedSize > 0)
 		{
+			if (!G_LoadSnapshot(&wadlevelinfos[i]))
+			{
+				Printf(TEXTCOLOR_RED "Unable to read the snapshot of %s back from its temporary file\n", wadlevelinfos[i].MapName.GetChars());
+				return false;
+			}
 			filename.Format("%s.map.json", wadlevelinfos[i].MapName.GetChars());
 			filename.ToLower();
 			filenames.Push(filename);
@@ -1966,11 +1973,177 @@ void G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buf
 	}
 	if (TheDefaultLevelInfo.Snapshot.mCompressedSize > 0)
 	{
+		if (!G_LoadSnapshot(&TheDefaultLevelInfo))
+		{
+			Printf(TEXTCOLOR_RED "Unable to read the snapshot of %s back from its temporary file\n", TheDefaultLevelInfo.MapName.GetChars());
+			return false;
+		}
 		filename.Format("%s.mapd.json", TheDefaultLevelInfo.MapName.GetChars());
 		filename.ToLower();
 		filenames.Push(filename);
 		buffers.Push(TheDefaultLevelInfo.Snapshot);
 	}
+	return true;
+}
+
+//==========================================================================
+//
+// Snapshot spilling
+//
+// Snapshots of the levels in a hub are kept until the hub is left. Once
+// they need more memory than save_snapshotmemory allows, all but the most
+// recent one are moved to a temporary file and read back when they are
+// needed again. A snapshot that has been read back keeps its place in the
+// file, so it can be dropped again without writing it a second time.
+// Space that no level refers to anymore is reused by later snapshots.
+//
+//==========================================================================
+
+CUSTOM_CVAR(Int, save_snapshotmemory, 64, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// in MB, 0 keeps everything in memory
+{
+	if (self < 0) self = 0;
+}
+
+static FILE *SnapshotSpillFile;
+
+static bool IsSpilled(level_info_t *info)
+{
+	return info->Snapshot.mBuffer == nullptr && info->Snapshot.mCompressedSize > 0 && info->SnapshotSpill >= 0;
+}
+
+static bool SeekSpill(int64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(SnapshotSpillFile, offset, SEEK_SET) == 0;
+#else
+	return fseeko(SnapshotSpillFile, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+//==========================================================================
+//
+// Finds room for a snapshot of the given size. The regions still in use
+// are the ones of the levels that point into the file, so the first gap
+// between them that is large enough gets used, or else the space after
+// the last one.
+//
+//==========================================================================
+
+static int64_t FindSpillSpace(size_t size)
+{
+	TArray<std::pair<int64_t, int64_t>> used;
+	for (auto &info : wadlevelinfos)
+	{
+		if (info.SnapshotSpill >= 0) used.Push({ info.SnapshotSpill, info.SnapshotSpill + (int64_t)info.Snapshot.mCompressedSize });
+	}
+	if (TheDefaultLevelInfo.SnapshotSpill >= 0)
+	{
+		used.Push({ TheDefaultLevelInfo.SnapshotSpill, TheDefaultLevelInfo.SnapshotSpill + (int64_t)TheDefaultLevelInfo.Snapshot.mCompressedSize });
+	}
+	std::sort(used.begin(), used.end());
+
+	int64_t offset = 0;
+	for (auto &region : used)
+	{
+		if (region.first - offset >= (int64_t)size) break;
+		offset = max(offset, region.second);
+	}
+	return offset;
+}
+
+static bool WriteSpill(level_info_t *info)
+{
+	if (SnapshotSpillFile == nullptr)
+	{
+		SnapshotSpillFile = tmpfile();
+		if (SnapshotSpillFile == nullptr)
+		{
+			return false;
+		}
+	}
+	int64_t offset = FindSpillSpace(info->Snapshot.mCompressedSize);
+	if (!SeekSpill(offset) || fwrite(info->Snapshot.mBuffer, 1, info->Snapshot.mCompressedSize, SnapshotSpillFile) != info->Snapshot.mCompressedSize)
+	{
+		return false;
+	}
+	info->SnapshotSpill = offset;
+	return true;
+}
+
+void G_SpillSnapshots(level_info_t *keep)
+{
+	if (save_snapshotmemory == 0)
+	{
+		return;
+	}
+
+	TArray<level_info_t *> infos;
+	for (auto &info : wadlevelinfos) infos.Push(&info);
+	infos.Push(&TheDefaultLevelInfo);
+
+	size_t inmemory = 0;
+	for (auto info : infos)
+	{
+		if (info->Snapshot.mBuffer != nullptr) inmemory += info->Snapshot.mCompressedSize;
+	}
+
+	size_t limit = size_t(save_snapshotmemory) << 20;
+	for (auto info : infos)
+	{
+		if (inmemory <= limit) break;
+		if (info == keep || info->Snapshot.mBuffer == nullptr || info->Snapshot.mCompressedSize == 0) continue;
+
+		if (info->SnapshotSpill < 0 && !WriteSpill(info))
+		{
+			Printf(TEXTCOLOR_RED "Unable to move the snapshot of %s to a temporary file\n", info->MapName.GetChars());
+			return;
+		}
+		inmemory -= info->Snapshot.mCompressedSize;
+		delete[] info->Snapshot.mBuffer;
+		info->Snapshot.mBuffer = nullptr;
+	}
+}
+
+//==========================================================================
+//
+// Reads a spilled snapshot back into memory. If that fails, the snapshot
+// stays spilled and the caller has to report the error.
+//
+//==========================================================================
+
+bool G_LoadSnapshot(level_info_t *info)
+{
+	if (!IsSpilled(info))
+	{
+		return true;
+	}
+
+	char *buffer = new char[info->Snapshot.mCompressedSize];
+	if (SnapshotSpillFile == nullptr || !SeekSpill(info->SnapshotSpill) ||
+		fread(buffer, 1, info->Snapshot.mCompressedSize, SnapshotSpillFile) != info->Snapshot.mCompressedSize)
+	{
+		delete[] buffer;
+		return false;
+	}
+	info->Snapshot.mBuffer = buffer;
+	return true;
+}
+
+//==========================================================================
+//
+// Once no snapshots are left, the spill file can start over.
+//
+//==========================================================================
+
+void G_ClearSnapshotSpill()
+{
+	for (auto &info : wadlevelinfos) info.SnapshotSpill = -1;
+	TheDefaultLevelInfo.SnapshotSpill = -1;
+	if (SnapshotSpillFile != nullptr)
+	{
+		fclose(SnapshotSpillFile);
+		SnapshotSpillFile = nullptr;
+	}
 }
 
 //==========================================================================
@@ -2037,6 +2210,7 @@ void G_ReadSnapshots(FResourceFile *resf)
 			if (i != nullptr)
 			{
 				i->Snapshot = resf->GetRawData(j);
+				i->SnapshotSpill = -1;
 			}
 		}
 		else
@@ -2047,9 +2221,11 @@ void G_ReadSnapshots(FResourceFile *resf)
 				ptrdiff_t maplen = ptr - name;
 				FString mapname(name, (size_t)maplen);
 				TheDefaultLevelInfo.Snapshot = resf->GetRawData(j);
+				TheDefaultLevelInfo.SnapshotSpill = -1;
 			}
 		}
 	}
+	G_SpillSnapshots (nullptr);
 }
 
 //==========================================================================
@@ -2238,9 +2414,7 @@ size_t DSectorMarker::PropagateMark()
 	// If there are more items to mark, put ourself back into the gray list.
 	if (moretodo)
 	{
-		Black2Gray();
-		GCNext = GC::Gray;
-		GC::Gray = this;
+		GC::Rescan(this);
 	}
 	return marked;
 }
@@ -37,7 +37,10 @@ void G_DoLoadLevel (const FString &MapName, int position, bool autosave, bool ne
 void G_ClearSnapshots (void);
 void P_RemoveDefereds ();
 void G_ReadSnapshots (FResourceFile *);
-void G_WriteSnapshots (TArray<FString> &, TArray<FCompressedBuffer> &);
+bool G_WriteSnapshots (TArray<FString> &, TArray<FCompressedBuffer> &);
+void G_SpillSnapshots (level_info_t *keep);
+bool G_LoadSnapshot (level_info_t *info);
+void G_ClearSnapshotSpill ();
 void G_WriteVisited(FSerializer &arc);
 void G_ReadVisited(FSerializer &arc);
 void G_ClearHubInfo();
@@ -51,6 +51,7 @@
 #include "p_effect.h"
 #include "d_player.h"
 #include "p_destructible.h"
+#include "p_soundgraph.h"
 #include "r_data/r_sections.h"
 #include "r_data/r_canvastexture.h"
 #include "r_data/r_interpolate.h"
@@ -176,10 +177,11 @@ private:
 	void PlayerSpawnPickClass (int playernum);
 
 public:
-	void SnapshotLevel();
+	void SnapshotLevel(FString *text = nullptr);
 	void UnSnapshotLevel(bool hubLoad);
 
 	void FinalizePortals();
+	void BuildSectorPVS();
 	bool ChangePortal(line_t *ln, int thisid, int destid);
 	unsigned GetSkyboxPortal(AActor *actor);
 	unsigned GetPortal(int type, int plane, sector_t *orgsec, sector_t *destsec, const DVector2 &displacement);
@@ -431,6 +433,17 @@ public:
 		return true;
 	}
 
+	// Only set up for maps without a REJECT lump.
+	bool CheckSectorPVS(sector_t *s1, sector_t *s2)
+	{
+		if (sectorpvs.Size() > 0)
+		{
+			int pnum = int(s1->Index()) * sectors.Size() + int(s2->Index());
+			return !!(sectorpvs[pnum >> 3] & (1 << (pnum & 7)));
+		}
+		return true;
+	}
+
 	DThinker *CreateThinker(PClass *cls, int statnum = STAT_DEFAULT)
 	{
 		DThinker *thinker = static_cast<DThinker*>(cls->CreateNew());
@@ -466,6 +479,8 @@ public:
 	TArray<node_t> gamenodes;
 	node_t *headgamenode;
 	TArray<uint8_t> rejectmatrix;
+	TArray<uint8_t> sectorpvs;		// built at load time if there is no reject. A set bit means the sectors may see each other.
+	uint32_t SightGeometry = 0;		// changes whenever something the sight memo depends on may have changed
 	TArray<zone_t>	Zones;
 	TArray<FPolyObj> Polyobjects;
 
@@ -501,6 +516,7 @@ public:
 	TMap<int, FHealthGroup> healthGroups;
 
 	FBlockmap blockmap;
+	FSoundGraph soundgraph;
 	TArray<polyblock_t *> PolyBlockMap;
 	FUDMFKeyMap UDMFKeys[4];
 
@@ -681,7 +697,8 @@ public:
 	uint32_t			ActiveParticles;
 	uint32_t			InactiveParticles;
 	TArray<particle_t>	Particles;
-	TArray<uint16_t>	ParticlesInSubsec;
+	TArray<uint32_t>	ParticlesInSubsec;
+	FParticleSim		ParticleSim;
 	FThinkerCollection Thinkers;
 
 	TArray<DVector2>	Scrolls;		// NULL if no DScrollers in this level
@@ -0,0 +1,209 @@
+/*
+** g_savewriter.cpp
+**
+** Compresses and writes savegames on a background thread.
+**
+** The game thread only captures the serialized JSON and the savepic.
+** Deflating the JSON, writing the zip and verifying it happen here, one
+** job at a time and in the order they were queued, so two saves to the
+** same file can never interleave. Finished jobs are reported back on the
+** game thread by G_CheckSaveWriter.
+**
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "g_savewriter.h"
+#include "serializer.h"
+#include "resourcefile.h"
+#include "c_cvars.h"
+
+bool WriteZip(const char* filename, const FileSys::FCompressedBuffer* content, size_t contentcount);
+
+CVAR(Bool, save_async, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FSaveGameJob::~FSaveGameJob()
+{
+	for (auto &entry : Entries)
+	{
+		entry.Buffer.Clean();
+	}
+}
+
+void FSaveGameJob::AddBuffer(const char *name, const FileSys::FCompressedBuffer &buffer)
+{
+	auto &entry = Entries[Entries.Reserve(1)];
+	entry.Name = name;
+	entry.Buffer = buffer;
+	entry.Buffer.mBuffer = new char[buffer.mCompressedSize];
+	memcpy(entry.Buffer.mBuffer, buffer.mBuffer, buffer.mCompressedSize);
+}
+
+void FSaveGameJob::AddText(const char *name, FString &&text)
+{
+	auto &entry = Entries[Entries.Reserve(1)];
+	entry.Name = name;
+	entry.Text = std::move(text);
+}
+
+//==========================================================================
+//
+// Runs on the writer thread, or on the game thread if save_async is off.
+// Uses the same deflate settings as FSerializer::GetCompressedOutput so
+// the output matches a synchronous save.
+//
+//==========================================================================
+
+void FSaveGameJob::Write()
+{
+	TArray<FileSys::FCompressedBuffer> content(Entries.Size(), true);
+	for (unsigned i = 0; i < Entries.Size(); i++)
+	{
+		auto &entry = Entries[i];
+		if (entry.Buffer.mBuffer == nullptr)
+		{
+			entry.Buffer = FSerializer::CompressBuffer(entry.Text.GetChars(), (unsigned)entry.Text.Len());
+			entry.Text = FString();
+		}
+		content[i] = entry.Buffer;
+		content[i].filename = entry.Name.GetChars();
+	}
+
+	Succeeded = false;
+	if (WriteZip(Filename.GetChars(), content.Data(), content.Size()))
+	{
+		// Check whether the file is ok by trying to open it.
+		FResourceFile *test = FResourceFile::OpenResourceFile(Filename.GetChars(), true);
+		if (test != nullptr)
+		{
+			delete test;
+			Succeeded = true;
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+struct FSaveWriter
+{
+	std::thread Thread;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Done;
+	TArray<FSaveGameJob *> Pending;
+	TArray<FSaveGameJob *> Finished;
+	bool Busy = false;
+	bool Quit = false;
+
+	~FSaveWriter()
+	{
+		// Saves that are still queued get written before the process exits,
+		// but nobody is left to report them.
+		if (Thread.joinable())
+		{
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				Quit = true;
+			}
+			Wake.notify_all();
+			Thread.join();
+		}
+		for (auto job : Finished)
+			delete job;
+	}
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (true)
+		{
+			Wake.wait(lock, [this] { return Quit || Pending.Size() > 0; });
+			if (Pending.Size() == 0)
+				break;
+
+			FSaveGameJob *job = Pending[0];
+			Pending.Delete(0);
+			Busy = true;
+			lock.unlock();
+
+			job->Write();
+
+			lock.lock();
+			Busy = false;
+			Finished.Push(job);
+			Done.notify_all();
+		}
+	}
+};
+
+static FSaveWriter SaveWriter;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void ReportSave(FSaveGameJob *job)
+{
+	if (job->Finished)
+		job->Finished(*job);
+	delete job;
+}
+
+void G_QueueSaveGame(FSaveGameJob *job)
+{
+	if (!save_async)
+	{
+		// Keep the order intact if this gets switched off while saves are still pending.
+		G_WaitForSaves();
+		job->Write();
+		ReportSave(job);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(SaveWriter.Mutex);
+		SaveWriter.Pending.Push(job);
+	}
+	if (!SaveWriter.Thread.joinable())
+	{
+		SaveWriter.Thread = std::thread([] { SaveWriter.Run(); });
+	}
+	SaveWriter.Wake.notify_one();
+}
+
+void G_CheckSaveWriter()
+{
+	TArray<FSaveGameJob *> finished;
+	{
+		std::unique_lock<std::mutex> lock(SaveWriter.Mutex);
+		if (SaveWriter.Finished.Size() == 0)
+			return;
+		finished = std::move(SaveWriter.Finished);
+	}
+	for (auto job : finished)
+	{
+		ReportSave(job);
+	}
+}
+
+void G_WaitForSaves()
+{
+	{
+		std::unique_lock<std::mutex> lock(SaveWriter.Mutex);
+		SaveWriter.Done.wait(lock, [] { return SaveWriter.Pending.Size() == 0 && !SaveWriter.Busy; });
+	}
+	G_CheckSaveWriter();
+}
@@ -0,0 +1,42 @@
+#ifndef __G_SAVEWRITER_H
+#define __G_SAVEWRITER_H
+
+#include <functional>
+#include "zstring.h"
+#include "tarray.h"
+#include "fs_decompress.h"
+
+struct FSaveGameEntry
+{
+	FString Name;
+	FString Text;						// Uncompressed JSON, deflated by the writer if Buffer is empty.
+	FileSys::FCompressedBuffer Buffer;	// Owned by the entry.
+};
+
+// Everything that goes into one savegame file, captured on the game thread so that
+// compressing and writing it no longer depends on any game state.
+struct FSaveGameJob
+{
+	FString Filename;
+	TArray<FSaveGameEntry> Entries;
+	bool Succeeded = false;
+
+	// Called on the game thread once the file has been written and verified.
+	std::function<void(FSaveGameJob &)> Finished;
+
+	~FSaveGameJob();
+	void AddBuffer(const char *name, const FileSys::FCompressedBuffer &buffer);
+	void AddText(const char *name, FString &&text);
+	void Write();
+};
+
+// Writes the job in the background, or right away if save_async is off. Jobs are written in order.
+void G_QueueSaveGame(FSaveGameJob *job);
+
+// Reports saves that have finished writing. Must be called on the game thread.
+void G_CheckSaveWriter();
+
+// Waits for all queued saves to be written and reports them.
+void G_WaitForSaves();
+
+#endif
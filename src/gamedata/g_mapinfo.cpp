@@ -220,6 +220,7 @@ void G_ClearSnapshots (void)
 		primaryLevel->info->Snapshot.Clean();
 	if (currentVMLevel && currentVMLevel->info)
 		currentVMLevel->info->Snapshot.Clean();
+	G_ClearSnapshotSpill();
 
 	// Since strings are only locked when snapshotting a level, unlock them
 	// all now, since we got rid of all the snapshots that cared about them.
@@ -277,6 +278,7 @@ void level_info_t::Reset()
 	F1Pic = "";
 	musicorder = 0;
 	Snapshot = { 0,0,0,0,0,nullptr };
+	SnapshotSpill = -1;
 	deferred.Clear();
 	skyspeed1 = skyspeed2 = 0.f;
 	fadeto = 0;
@@ -361,6 +361,7 @@ struct level_info_t
 	int8_t		WallVertLight, WallHorizLight;
 	int			musicorder;
 	FileSys::FCompressedBuffer	Snapshot;
+	int64_t		SnapshotSpill;	// where the snapshot is in the spill file, -1 if it has not been written there
 	TArray<acsdefered_t> deferred;
 	float		skyspeed1;
 	float		skyspeed2;
@@ -58,6 +58,7 @@
 
 EXTERN_CVAR(Bool, gl_cachenodes)
 EXTERN_CVAR(Float, gl_cachetime)
+EXTERN_CVAR(Int, gennodes_threads)
 
 // fixed 32 bit gl_vert format v2.0+ (glBsp 1.91)
 struct mapglvertex_t
@@ -956,7 +957,7 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 				0, 0, 0, 0
 			};
 			leveldata.FindMapBounds ();
-			FNodeBuilder builder (leveldata, polyspots, anchors, true);
+			FNodeBuilder builder (leveldata, polyspots, anchors, true, gennodes_threads);
 			
 			builder.Extract (*Level);
 			endTime = I_msTime ();
@@ -965,7 +966,8 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 		}
 	}
 
-	if (!loaded)
+	// Nodes built by the map loader itself are stored in the build cache.
+	if (!loaded && !rebuilt)
 	{
 #ifdef DEBUG
 		// Building nodes in debug is much slower so let's cache them only if cachetime is 0
@@ -993,7 +995,7 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 typedef TArray<uint8_t> MemFile;
 
 
-static FString CreateCacheName(MapData *map, bool create)
+static FString CreateCacheName(MapData *map, bool create, const char *ext = ".gzc")
 {
 	FString path = M_GetCachePath(create);
 	FString lumpname = fileSystem.GetFileFullPath(map->lumpnum).c_str();
@@ -1003,7 +1005,7 @@ static FString CreateCacheName(MapData *map, bool create)
 
 	lumpname.ReplaceChars('/', '%');
 	lumpname.ReplaceChars(':', '$');
-	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ".gzc";
+	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ext;
 	return path;
 }
 
@@ -1192,6 +1194,397 @@ bool MapLoader::CheckCachedNodes(MapData *map)
 	return true;
 }
 
+//==========================================================================
+//
+// Build cache
+//
+// Stores the nodes and the blockmap the map loader had to generate, so that
+// the next load of the same map can skip building them. Unlike the GL node
+// cache above the data is stored uncompressed with fixed size records so it
+// can be used straight out of a memory mapped file.
+//
+//==========================================================================
+
+enum
+{
+	BUILDCACHE_VERSION = 1,
+};
+
+struct FBuildCacheHeader
+{
+	char Magic[4];			// "ZBLD"
+	uint32_t Version;
+	uint8_t MD5[16];		// map checksum
+	uint32_t GeometryKey;	// checksum of the map geometry after compatibility fixes
+	uint32_t NumLines;
+	uint32_t NumOrgVerts;	// number of vertices before the nodes were built
+	uint32_t NumVerts;		// the following are 0 if the nodes were not built
+	uint32_t NumSubsectors;
+	uint32_t NumSegs;
+	uint32_t NumNodes;
+	uint32_t BlockMapSize;	// 0 if the blockmap was not generated
+};
+
+// All sections follow the header in this order. Every value is a little endian 32 bit word.
+enum
+{
+	BC_VERTEX_SIZE = 2,			// x, y
+	BC_LINE_SIZE = 2,			// v1, v2
+	BC_SUBSECTOR_SIZE = 1,		// numlines
+	BC_SEG_SIZE = 7,			// v1, v2, partner, linedef, sidedef, frontsector, backsector
+	BC_NODE_SIZE = 14,			// x, y, dx, dy, bbox[2][4], children[2]
+};
+
+static const uint32_t BC_NONE = 0xffffffffu;
+
+uint32_t MapLoader::GetGeometryKey()
+{
+	uint32_t key = crc32(0, nullptr, 0);
+	for (auto &line : Level->lines)
+	{
+		int32_t data[7] =
+		{
+			line.v1->fixX(), line.v1->fixY(), line.v2->fixX(), line.v2->fixY(),
+			line.sidedef[0] ? Index(line.sidedef[0]) : -1,
+			line.sidedef[1] ? Index(line.sidedef[1]) : -1,
+			int32_t(line.flags & ML_TWOSIDED)
+		};
+		key = crc32(key, (const Bytef *)data, sizeof(data));
+	}
+	for (auto &side : Level->sides)
+	{
+		int32_t sector = side.sector ? Index(side.sector) : -1;
+		key = crc32(key, (const Bytef *)&sector, sizeof(sector));
+	}
+	return key;
+}
+
+// Returns the number of words in the node section, which precedes the blockmap.
+static size_t GetNodeSectionSize(const FBuildCacheHeader *header)
+{
+	if (LittleLong(header->NumSubsectors) == 0) return 0;
+	return (size_t)LittleLong(header->NumVerts) * BC_VERTEX_SIZE +
+		(size_t)LittleLong(header->NumLines) * BC_LINE_SIZE +
+		LittleLong(header->NumOrgVerts) +
+		(size_t)LittleLong(header->NumSubsectors) * BC_SUBSECTOR_SIZE +
+		(size_t)LittleLong(header->NumSegs) * BC_SEG_SIZE +
+		(size_t)LittleLong(header->NumNodes) * BC_NODE_SIZE;
+}
+
+//==========================================================================
+//
+// Opens the build cache of a map and checks that it still matches.
+// Returns a pointer to the header inside the mapped file.
+//
+//==========================================================================
+
+static const FBuildCacheHeader *OpenBuildCache(FileReader &fr, MapData *map, unsigned numlines, uint32_t key)
+{
+	FString path = CreateCacheName(map, false, ".zbc");
+	if (!fr.OpenMappedFile(path.GetChars())) return nullptr;
+
+	auto length = (size_t)fr.GetLength();
+	if (length < sizeof(FBuildCacheHeader)) return nullptr;
+
+	auto header = (const FBuildCacheHeader *)fr.GetBuffer();
+	if (memcmp(header->Magic, "ZBLD", 4) || LittleLong(header->Version) != BUILDCACHE_VERSION) return nullptr;
+
+	uint8_t md5map[16];
+	map->GetChecksum(md5map);
+	if (memcmp(header->MD5, md5map, 16)) return nullptr;
+	if (LittleLong(header->NumLines) != numlines || LittleLong(header->GeometryKey) != key) return nullptr;
+
+	size_t words = GetNodeSectionSize(header) + LittleLong(header->BlockMapSize);
+	if (length < sizeof(FBuildCacheHeader) + words * 4) return nullptr;
+	return header;
+}
+
+//==========================================================================
+//
+// Loads the nodes from the build cache
+//
+//==========================================================================
+
+bool MapLoader::LoadCachedNodes(MapData *map, const int *&oldvertextable)
+{
+	FileReader fr;
+	auto header = OpenBuildCache(fr, map, Level->lines.Size(), GetGeometryKey());
+	if (header == nullptr) return false;
+
+	const uint32_t numOrgVerts = LittleLong(header->NumOrgVerts);
+	const uint32_t numVerts = LittleLong(header->NumVerts);
+	const uint32_t numSubs = LittleLong(header->NumSubsectors);
+	const uint32_t numSegs = LittleLong(header->NumSegs);
+	const uint32_t numNodes = LittleLong(header->NumNodes);
+	const uint32_t numLines = Level->lines.Size();
+	const uint32_t numSides = Level->sides.Size();
+	const uint32_t numSectors = Level->sectors.Size();
+
+	if (numSubs == 0 || numNodes == 0 || numOrgVerts != Level->vertexes.Size()) return false;
+
+	auto verts = (const uint32_t *)(header + 1);
+	auto lines = verts + numVerts * BC_VERTEX_SIZE;
+	auto vertmap = lines + numLines * BC_LINE_SIZE;
+	auto subs = vertmap + numOrgVerts;
+	auto segs = subs + numSubs * BC_SUBSECTOR_SIZE;
+	auto nodes = segs + numSegs * BC_SEG_SIZE;
+
+	// Validate everything before touching the level so that a damaged file simply causes a rebuild.
+	auto invalid = [](uint32_t index, uint32_t count, bool nullable) { return index >= count && !(nullable && index == BC_NONE); };
+
+	for (uint32_t i = 0; i < numLines * BC_LINE_SIZE; i++)
+	{
+		if (invalid(LittleLong(lines[i]), numVerts, false)) return false;
+	}
+	for (uint32_t i = 0; i < numOrgVerts; i++)
+	{
+		if (invalid(LittleLong(vertmap[i]), numVerts, true)) return false;
+	}
+	uint64_t segcount = 0;
+	for (uint32_t i = 0; i < numSubs; i++)
+	{
+		segcount += LittleLong(subs[i]);
+	}
+	if (segcount != numSegs) return false;
+	for (uint32_t i = 0; i < numSegs; i++)
+	{
+		auto seg = &segs[i * BC_SEG_SIZE];
+		if (invalid(LittleLong(seg[0]), numVerts, false) || invalid(LittleLong(seg[1]), numVerts, false) ||
+			invalid(LittleLong(seg[2]), numSegs, true) || invalid(LittleLong(seg[3]), numLines, true) ||
+			invalid(LittleLong(seg[4]), numSides, true) || invalid(LittleLong(seg[5]), numSectors, true) ||
+			invalid(LittleLong(seg[6]), numSectors, true)) return false;
+	}
+	for (uint32_t i = 0; i < numNodes; i++)
+	{
+		auto node = &nodes[i * BC_NODE_SIZE];
+		for (int j = 12; j < 14; j++)
+		{
+			uint32_t child = LittleLong(node[j]);
+			if ((child & 0x80000000) ? (child & 0x7fffffff) >= numSubs : child >= numNodes) return false;
+		}
+	}
+
+	Level->vertexes.Alloc(numVerts);
+	for (uint32_t i = 0; i < numVerts; i++)
+	{
+		Level->vertexes[i].set((fixed_t)LittleLong(verts[i * 2]), (fixed_t)LittleLong(verts[i * 2 + 1]));
+	}
+
+	for (uint32_t i = 0; i < numLines; i++)
+	{
+		Level->lines[i].v1 = &Level->vertexes[LittleLong(lines[i * 2])];
+		Level->lines[i].v2 = &Level->vertexes[LittleLong(lines[i * 2 + 1])];
+	}
+
+	auto table = new int[numOrgVerts];
+	for (uint32_t i = 0; i < numOrgVerts; i++)
+	{
+		table[i] = (int)LittleLong(vertmap[i]);
+	}
+	oldvertextable = table;
+
+	Level->subsectors.Alloc(numSubs);
+	memset(&Level->subsectors[0], 0, numSubs * sizeof(subsector_t));
+	Level->segs.Alloc(numSegs);
+	memset(&Level->segs[0], 0, numSegs * sizeof(seg_t));
+
+	uint32_t firstseg = 0;
+	for (uint32_t i = 0; i < numSubs; i++)
+	{
+		Level->subsectors[i].firstline = &Level->segs[firstseg];
+		Level->subsectors[i].numlines = LittleLong(subs[i]);
+		firstseg += Level->subsectors[i].numlines;
+	}
+
+	for (uint32_t i = 0; i < numSegs; i++)
+	{
+		auto cseg = &segs[i * BC_SEG_SIZE];
+		auto &seg = Level->segs[i];
+		uint32_t partner = LittleLong(cseg[2]), line = LittleLong(cseg[3]), side = LittleLong(cseg[4]);
+		uint32_t front = LittleLong(cseg[5]), back = LittleLong(cseg[6]);
+
+		seg.v1 = &Level->vertexes[LittleLong(cseg[0])];
+		seg.v2 = &Level->vertexes[LittleLong(cseg[1])];
+		seg.PartnerSeg = partner == BC_NONE ? nullptr : &Level->segs[partner];
+		seg.linedef = line == BC_NONE ? nullptr : &Level->lines[line];
+		seg.sidedef = side == BC_NONE ? nullptr : &Level->sides[side];
+		seg.frontsector = front == BC_NONE ? nullptr : &Level->sectors[front];
+		seg.backsector = back == BC_NONE ? nullptr : &Level->sectors[back];
+	}
+
+	Level->nodes.Alloc(numNodes);
+	memset(&Level->nodes[0], 0, numNodes * sizeof(node_t));
+	for (uint32_t i = 0; i < numNodes; i++)
+	{
+		auto cnode = &nodes[i * BC_NODE_SIZE];
+		auto &node = Level->nodes[i];
+
+		node.x = (fixed_t)LittleLong(cnode[0]);
+		node.y = (fixed_t)LittleLong(cnode[1]);
+		node.dx = (fixed_t)LittleLong(cnode[2]);
+		node.dy = (fixed_t)LittleLong(cnode[3]);
+		for (int j = 0; j < 8; j++)
+		{
+			uint32_t bits = LittleLong(cnode[4 + j]);
+			memcpy(&node.bbox[j >> 2][j & 3], &bits, 4);
+		}
+		for (int j = 0; j < 2; j++)
+		{
+			uint32_t child = LittleLong(cnode[12 + j]);
+			if (child & 0x80000000)
+			{
+				node.children[j] = (uint8_t *)&Level->subsectors[child & 0x7fffffff] + 1;
+			}
+			else
+			{
+				node.children[j] = &Level->nodes[child];
+			}
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Loads the blockmap from the build cache
+//
+//==========================================================================
+
+bool MapLoader::LoadCachedBlockMap(MapData *map)
+{
+	FileReader fr;
+	auto header = OpenBuildCache(fr, map, Level->lines.Size(), GetGeometryKey());
+	if (header == nullptr) return false;
+
+	const uint32_t count = LittleLong(header->BlockMapSize);
+	if (count < 4) return false;
+
+	auto data = (const uint32_t *)(header + 1) + GetNodeSectionSize(header);
+
+	auto blockmaplump = new int[count];
+	for (uint32_t i = 0; i < count; i++)
+	{
+		blockmaplump[i] = (int)LittleLong(data[i]);
+	}
+
+	Level->blockmap.blockmaplump = blockmaplump;
+	if (!Level->blockmap.VerifyBlockMap(count, Level->lines.Size()))
+	{
+		delete[] blockmaplump;
+		Level->blockmap.blockmaplump = nullptr;
+		return false;
+	}
+	BlockMapSize = count;
+	return true;
+}
+
+//==========================================================================
+//
+// Writes the generated nodes and blockmap to the build cache
+//
+//==========================================================================
+
+void MapLoader::CreateBuildCache(MapData *map, const int *oldvertextable, unsigned numOrgVerts, bool nodes)
+{
+	MemFile data;
+
+	nodes = nodes && oldvertextable != nullptr;
+	uint32_t blockmapsize = Level->blockmap.blockmaplump != nullptr ? BlockMapSize : 0;
+
+	int v = data.Reserve(sizeof(FBuildCacheHeader));
+	memset(&data[v], 0, sizeof(FBuildCacheHeader));
+
+	if (nodes)
+	{
+		for (auto &vert : Level->vertexes)
+		{
+			WriteLong(data, vert.fixX());
+			WriteLong(data, vert.fixY());
+		}
+		for (auto &line : Level->lines)
+		{
+			WriteLong(data, Index(line.v1));
+			WriteLong(data, Index(line.v2));
+		}
+		for (unsigned i = 0; i < numOrgVerts; i++)
+		{
+			WriteLong(data, oldvertextable[i]);
+		}
+		for (auto &sub : Level->subsectors)
+		{
+			WriteLong(data, sub.numlines);
+		}
+		for (auto &seg : Level->segs)
+		{
+			WriteLong(data, Index(seg.v1));
+			WriteLong(data, Index(seg.v2));
+			WriteLong(data, seg.PartnerSeg ? Index(seg.PartnerSeg) : BC_NONE);
+			WriteLong(data, seg.linedef ? Index(seg.linedef) : BC_NONE);
+			WriteLong(data, seg.sidedef ? Index(seg.sidedef) : BC_NONE);
+			WriteLong(data, seg.frontsector ? Index(seg.frontsector) : BC_NONE);
+			WriteLong(data, seg.backsector ? Index(seg.backsector) : BC_NONE);
+		}
+		for (auto &node : Level->nodes)
+		{
+			WriteLong(data, node.x);
+			WriteLong(data, node.y);
+			WriteLong(data, node.dx);
+			WriteLong(data, node.dy);
+			for (int j = 0; j < 8; j++)
+			{
+				uint32_t bits;
+				memcpy(&bits, &node.bbox[j >> 2][j & 3], 4);
+				WriteLong(data, bits);
+			}
+			for (int j = 0; j < 2; j++)
+			{
+				if ((size_t)node.children[j] & 1)
+				{
+					WriteLong(data, 0x80000000 | uint32_t(Index((subsector_t *)((uint8_t *)node.children[j] - 1))));
+				}
+				else
+				{
+					WriteLong(data, Index((node_t *)node.children[j]));
+				}
+			}
+		}
+	}
+	for (uint32_t i = 0; i < blockmapsize; i++)
+	{
+		WriteLong(data, Level->blockmap.blockmaplump[i]);
+	}
+
+	FBuildCacheHeader header;
+	memcpy(header.Magic, "ZBLD", 4);
+	header.Version = LittleLong(uint32_t(BUILDCACHE_VERSION));
+	map->GetChecksum(header.MD5);
+	header.GeometryKey = LittleLong(GetGeometryKey());
+	header.NumLines = LittleLong(Level->lines.Size());
+	header.NumOrgVerts = LittleLong(nodes ? numOrgVerts : 0);
+	header.NumVerts = LittleLong(nodes ? Level->vertexes.Size() : 0);
+	header.NumSubsectors = LittleLong(nodes ? Level->subsectors.Size() : 0);
+	header.NumSegs = LittleLong(nodes ? Level->segs.Size() : 0);
+	header.NumNodes = LittleLong(nodes ? Level->nodes.Size() : 0);
+	header.BlockMapSize = LittleLong(blockmapsize);
+	memcpy(&data[v], &header, sizeof(header));
+
+	FString path = CreateCacheName(map, true, ".zbc");
+	FileWriter *fw = FileWriter::Open(path.GetChars());
+
+	if (fw != nullptr)
+	{
+		if (fw->Write(data.Data(), data.Size()) != data.Size())
+		{
+			Printf("Error saving build cache to file %s\n", path.GetChars());
+		}
+		delete fw;
+	}
+	else
+	{
+		Printf("Cannot open build cache file %s for writing\n", path.GetChars());
+	}
+}
+
 UNSAFE_CCMD(clearnodecache)
 {
 	FileSys::FileList list;
@@ -97,7 +97,10 @@ CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, genlightmaps, false, CVAR_GLOBALCONFIG);
 CVAR (Bool, ignorelightmaplump, false, CVAR_GLOBALCONFIG);
+CVAR (Int, gennodes_threads, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);	// 0 = one per hardware thread, 1 = single threaded
 EXTERN_CVAR(Bool, lm_dynlights);
+EXTERN_CVAR(Bool, gl_cachenodes)
+EXTERN_CVAR(Float, gl_cachetime)
 
 inline bool P_LoadBuildMap(uint8_t *mapdata, size_t len, FMapThing **things, int *numthings)
 {
@@ -2489,6 +2492,7 @@ void MapLoader::CreateBlockMap ()
 	BlockMap.Reserve (bmapwidth * bmapheight);
 	CreatePackedBlockmap (BlockMap, BlockLists.Data(), bmapwidth, bmapheight);
 
+	BlockMapSize = BlockMap.Size();
 	Level->blockmap.blockmaplump = new int[BlockMap.Size()];
 	for (unsigned int ii = 0; ii < BlockMap.Size(); ++ii)
 	{
@@ -2601,8 +2605,14 @@ void MapLoader::LoadBlockMap (MapData * map)
 		Args->CheckParm("-blockmap")
 		)
 	{
-		DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-		CreateBlockMap ();
+		if (!LoadCachedBlockMap(map))
+		{
+			DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
+			uint64_t startTime = I_msTime();
+			CreateBlockMap ();
+			BuildTime += I_msTime() - startTime;
+			BuildCacheDirty = true;
+		}
 	}
 	else
 	{
@@ -3418,6 +3428,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	else reloop = true;
 
 	uint64_t startTime = 0, endTime = 0;
+	unsigned numOrgVerts = 0;
 
 	bool BuildGLNodes;
 
@@ -3436,23 +3447,34 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 			line.AdjustLine();
 		}
 
+		numOrgVerts = Level->vertexes.Size();
 		startTime = I_msTime();
-		TArray<FNodeBuilder::FPolyStart> polyspots, anchors;
-		GetPolySpots(map, polyspots, anchors);
-		FNodeBuilder::FLevel leveldata =
-		{
-			&Level->vertexes[0], (int)Level->vertexes.Size(),
-			&Level->sides[0], (int)Level->sides.Size(),
-			&Level->lines[0], (int)Level->lines.Size(),
-			0, 0, 0, 0
-		};
-		leveldata.FindMapBounds();
-
-		FNodeBuilder builder(leveldata, polyspots, anchors, BuildGLNodes);
-		builder.Extract(*Level);
-		endTime = I_msTime();
-		DPrintf(DMSG_NOTIFY, "BSP generation took %.3f sec (%d segs)\n", (endTime - startTime) * 0.001, Level->segs.Size());
-		oldvertextable = builder.GetOldVertexTable();
+		if (LoadCachedNodes(map, oldvertextable))
+		{
+			endTime = I_msTime();
+			DPrintf(DMSG_NOTIFY, "BSP loaded from cache in %.3f sec (%d segs)\n", (endTime - startTime) * 0.001, Level->segs.Size());
+		}
+		else
+		{
+			TArray<FNodeBuilder::FPolyStart> polyspots, anchors;
+			GetPolySpots(map, polyspots, anchors);
+			FNodeBuilder::FLevel leveldata =
+			{
+				&Level->vertexes[0], (int)Level->vertexes.Size(),
+				&Level->sides[0], (int)Level->sides.Size(),
+				&Level->lines[0], (int)Level->lines.Size(),
+				0, 0, 0, 0
+			};
+			leveldata.FindMapBounds();
+
+			FNodeBuilder builder(leveldata, polyspots, anchors, BuildGLNodes, gennodes_threads);
+			builder.Extract(*Level);
+			endTime = I_msTime();
+			DPrintf(DMSG_NOTIFY, "BSP generation took %.3f sec (%d segs)\n", (endTime - startTime) * 0.001, Level->segs.Size());
+			oldvertextable = builder.GetOldVertexTable();
+			BuildTime += endTime - startTime;
+			BuildCacheDirty = true;
+		}
 		reloop = true;
 	}
 	else
@@ -3489,6 +3511,19 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 
 	LoadBlockMap(map);
 
+	if (BuildCacheDirty)
+	{
+#ifdef DEBUG
+		// Building nodes in debug is much slower so let's cache them only if cachetime is 0
+		BuildTime = 0;
+#endif
+		if (Level->maptype != MAPTYPE_BUILD && gl_cachenodes && BuildTime / 1000.f >= gl_cachetime)
+		{
+			DPrintf(DMSG_NOTIFY, "Writing build cache\n");
+			CreateBuildCache(map, oldvertextable, numOrgVerts, ForceNodeBuild);
+		}
+	}
+
 	LoadReject(map, false);
 	GroupLines(false);
 	FloodZones();
@@ -3558,6 +3593,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	PO_Init();				// Initialize the polyobjs
 	if (!Level->IsReentering())
 		Level->FinalizePortals();	// finalize line portals after polyobjects have been initialized. This info is needed for properly flagging them.
+	Level->BuildSectorPVS();	// needs the final portal setup and the polyobjects in place.
 
 	InitLightmapTiles(map);
 
@@ -130,6 +130,11 @@ private:
 	// Polyobject init
 	TArray<int32_t> KnownPolySides;
 
+	// Build cache
+	unsigned BlockMapSize = 0;		// size of the generated blockmap
+	uint64_t BuildTime = 0;			// time spent on generating nodes and blockmap
+	bool BuildCacheDirty = false;	// something was generated that is not in the build cache yet
+
 	FName CheckCompatibility(MapData *map);
 	void PostProcessLevel(FName checksum);
 
@@ -283,6 +288,10 @@ public:
 	template<class nodetype, class subsectortype> bool LoadNodes(MapData * map);
 	bool LoadGLNodes(MapData * map);
 	bool CheckCachedNodes(MapData *map);
+	uint32_t GetGeometryKey();
+	bool LoadCachedNodes(MapData *map, const int *&oldvertextable);
+	bool LoadCachedBlockMap(MapData *map);
+	void CreateBuildCache(MapData *map, const int *oldvertextable, unsigned numOrgVerts, bool nodes);
 	bool CheckNodes(MapData * map, bool rebuilt, int buildtime);
 	bool CheckForGLNodes();
 
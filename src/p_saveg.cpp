@@ -63,8 +63,11 @@
 #include "s_music.h"
 #include "model.h"
 #include "d_net.h"
+#include "stats.h"
+#include "c_dispatch.h"
 
 EXTERN_CVAR(Bool, save_formatted)
+EXTERN_CVAR(Bool, save_binary)
 
 //==========================================================================
 //
@@ -1076,23 +1079,36 @@ void FLevelLocals::Serialize(FSerializer &arc, bool hubload)
 
 //==========================================================================
 //
-// Archives the current level
+// Archives the current level. If text is given, the level is returned
+// as uncompressed JSON instead and the snapshot is left empty, so that the
+// caller can compress it on another thread.
 //
 //==========================================================================
 
-void FLevelLocals::SnapshotLevel()
+void FLevelLocals::SnapshotLevel(FString *text)
 {
 	info->Snapshot.Clean();
+	info->SnapshotSpill = -1;
 
 	if (info->isValid())
 	{
 		FDoomSerializer arc(this);
 
-		if (arc.OpenWriter(save_formatted))
+		bool opened = save_binary && !save_formatted ? arc.OpenBinaryWriter() : arc.OpenWriter(save_formatted);
+		if (opened)
 		{
 			SaveVersion = SAVEVER;
 			Serialize(arc, false);
-			info->Snapshot = arc.GetCompressedOutput();
+			if (text == nullptr)
+			{
+				info->Snapshot = arc.GetCompressedOutput();
+			}
+			else
+			{
+				unsigned len;
+				const char *output = arc.GetOutput(&len);
+				*text = FString(output, len);
+			}
 		}
 	}
 }
@@ -1106,6 +1122,12 @@ void FLevelLocals::SnapshotLevel()
 
 void FLevelLocals::UnSnapshotLevel(bool hubLoad)
 {
+	if (!G_LoadSnapshot(info))
+	{
+		// Losing the snapshot would silently reset the level, so this is as fatal as a corrupt one.
+		if (hubLoad) Behaviors.UnlockLevelVarStrings(levelnum);
+		I_Error("Unable to read the snapshot of %s back from its temporary file", info->MapName.GetChars());
+	}
 	if (info->Snapshot.mBuffer == nullptr)
 		return;
 
@@ -1157,3 +1179,55 @@ void FLevelLocals::UnSnapshotLevel(bool hubLoad)
 	}
 }
 
+
+//==========================================================================
+//
+// Compares the serializer formats on the current level. Nothing gets
+// read back into the level, loading is only timed up to the parsed document.
+//
+//==========================================================================
+
+CCMD(benchsave)
+{
+	if (gamestate != GS_LEVEL || !primaryLevel->info->isValid())
+	{
+		Printf("benchsave can only be used while playing a level\n");
+		return;
+	}
+
+	static const char *const formats[] = { "json", "json (formatted)", "binary" };
+	Printf("%-18s %10s %10s %9s %9s %9s\n", "format", "size", "deflated", "write ms", "zip ms", "parse ms");
+	for (int format = 0; format < 3; format++)
+	{
+		cycle_t writetime, ziptime, parsetime;
+		writetime.Reset();
+		ziptime.Reset();
+		parsetime.Reset();
+
+		FDoomSerializer arc(primaryLevel);
+		writetime.Clock();
+		if (format == 2) arc.OpenBinaryWriter();
+		else arc.OpenWriter(format == 1);
+		SaveVersion = SAVEVER;
+		primaryLevel->Serialize(arc, false);
+		unsigned len;
+		const char *output = arc.GetOutput(&len);
+		writetime.Unclock();
+
+		ziptime.Clock();
+		auto compressed = FSerializer::CompressBuffer(output, len);
+		ziptime.Unclock();
+
+		parsetime.Clock();
+		{
+			FSerializer reader;
+			reader.OpenReader(output, len);
+			reader.Close();
+		}
+		parsetime.Unclock();
+
+		Printf("%-18s %10u %10u %9.2f %9.2f %9.2f\n", formats[format], len, (unsigned)compressed.mCompressedSize,
+			writetime.TimeMS(), ziptime.TimeMS(), parsetime.TimeMS());
+		compressed.Clean();
+	}
+}
@@ -352,8 +352,10 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	subsectors.Clear();
 	gamesubsectors.Reset();
 	rejectmatrix.Clear();
+	sectorpvs.Clear();
 	Zones.Clear();
 	blockmap.Clear();
+	soundgraph.Clear();
 	Polyobjects.Clear();
 
 	for (auto &pb : PolyBlockMap)
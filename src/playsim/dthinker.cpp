@@ -47,15 +47,23 @@
 #include "d_main.h"
 
 #include "p_visualthinker.h"
+#include "threadpool.h"
+#include <memory>
 
 static int ThinkCount;
-static cycle_t ThinkCycles;
+cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
 extern int BotWTG;
 
 IMPLEMENT_CLASS(DThinker, false, false)
 
+CVAR(Bool, p_parallelthinkers, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+// Thinkers that can tick concurrently are batched until the next one that cannot,
+// so the order of effects seen by the serially ticked ones is unchanged.
+static TArray<DThinker *> ConcurrentBatch;
+
 struct ProfileInfo
 {
 	int numcalls = 0;
@@ -143,10 +151,15 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 	if (!profilethinkers)
 	{
+		FThreadPool *pool = P_GetParallelTickPool();
+
 		// Tick every thinker left from last time
 		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
 		{
-			Thinkers[i].TickThinkers(nullptr);
+			if (pool)
+				Thinkers[i].TickThinkersParallel(pool);
+			else
+				Thinkers[i].TickThinkers(nullptr);
 		}
 
 		// Keep ticking the fresh thinkers until there are no new ones.
@@ -287,7 +300,12 @@ void FThinkerCollection::DestroyAllThinkers(bool fullgc)
 		}
 	}
 	error |= Thinkers[MAX_STATNUM + 1].DoDestroyThinkers();
-	if (fullgc) GC::FullGC();
+	if (fullgc)
+	{
+		GC::FullGC();
+		// The level's objects are gone, so hand their storage back in one go.
+		GC::ReclaimSlabs();
+	}
 	if (error)
 	{
 		ClearGlobalVMStack();
@@ -625,6 +643,93 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 	return count;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FThreadPool *P_GetParallelTickPool()
+{
+	if (!p_parallelthinkers)
+		return nullptr;
+	FThreadPool *pool = GetSharedThreadPool();
+	return pool->GetThreadCount() > 1 ? pool : nullptr;
+}
+
+static void FlushConcurrentBatch(FThreadPool *pool)
+{
+	const int batchSize = 64;
+	int count = ConcurrentBatch.Size();
+	if (count == 0)
+		return;
+
+	if (count <= batchSize)
+	{
+		for (auto thinker : ConcurrentBatch)
+			thinker->TickConcurrent();
+	}
+	else
+	{
+		pool->Run((count + batchSize - 1) / batchSize, [=](int batch)
+		{
+			int end = min(batch * batchSize + batchSize, count);
+			for (int i = batch * batchSize; i < end; i++)
+				ConcurrentBatch[i]->TickConcurrent();
+		});
+	}
+
+	for (auto thinker : ConcurrentBatch)
+		thinker->CommitTick();
+	ConcurrentBatch.Clear();
+}
+
+//==========================================================================
+//
+// Same as TickThinkers for a list that holds no fresh thinkers, except that
+// runs of thinkers that can tick concurrently are spread over the pool.
+//
+//==========================================================================
+
+int FThinkerList::TickThinkersParallel(FThreadPool *pool)
+{
+	int count = 0;
+	DThinker *node = GetHead();
+
+	if (node == nullptr)
+	{
+		return 0;
+	}
+
+	while (node != Sentinel)
+	{
+		++count;
+		NextToThink = node->NextThinker;
+		if (!(node->ObjectFlags & (OF_JustSpawned | OF_EuthanizeMe)) && node->CanTickConcurrently())
+		{
+			ThinkCount++;
+			ConcurrentBatch.Push(node);
+		}
+		else
+		{
+			FlushConcurrentBatch(pool);
+			if (node->ObjectFlags & OF_JustSpawned)
+			{
+				node->CallPostBeginPlay();
+			}
+			if (!(node->ObjectFlags & OF_EuthanizeMe))
+			{ // Only tick thinkers not scheduled for destruction
+				ThinkCount++;
+				node->CallTick();
+				node->ObjectFlags &= ~OF_JustSpawned;
+			}
+		}
+		node = NextToThink;
+	}
+	FlushConcurrentBatch(pool);
+	return count;
+}
+
 //==========================================================================
 //
 //
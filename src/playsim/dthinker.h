@@ -47,9 +47,13 @@ class FSerializer;
 struct FLevelLocals;
 
 class FThinkerIterator;
+class FThreadPool;
 
 enum { MAX_STATNUM = 127 };
 
+// Worker threads for the parallel thinker tick phase, or null if it is disabled
+FThreadPool *P_GetParallelTickPool();
+
 // Doubly linked ring list of thinkers
 struct FThinkerList
 {
@@ -61,6 +65,7 @@ struct FThinkerList
 	void DestroyThinkers();
 	bool DoDestroyThinkers();
 	int TickThinkers(FThinkerList *dest);	// Returns: # of thinkers ticked
+	int TickThinkersParallel(FThreadPool *pool);
 	int ProfileThinkers(FThinkerList *dest);
 	void SaveList(FSerializer &arc);
 
@@ -101,6 +106,13 @@ public:
 	virtual ~DThinker ();
 	virtual void Tick ();
 	void CallTick();
+
+	// Thinkers that only modify their own state during a tick can have their Tick split in two.
+	// TickConcurrent may run on a worker thread at the same time as other thinkers' TickConcurrent,
+	// CommitTick then runs serially, in list order, for whatever touches shared state (RNG, linking, destroying).
+	virtual bool CanTickConcurrently() { return false; }
+	virtual void TickConcurrent() {}
+	virtual void CommitTick() {}
 	virtual void PostBeginPlay ();	// Called just before the first tick
 	virtual void CallPostBeginPlay(); // different in actor.
 	virtual void PostSerialize();
@@ -310,6 +310,8 @@ void P_Recalculate3DFloors(sector_t * sector)
 	F3DFloor *		clipped=NULL;
 	F3DFloor *		solid=NULL;
 	double			solid_bottom=0;
+
+	sector->Level->SightGeometry++;
 	double			clipped_top;
 	double			clipped_bottom=0;
 	double			maxheight, minheight;
@@ -9079,6 +9079,7 @@ scriptwait:
 						break;
 					}
 				}
+				Level->SightGeometry++;
 
 				sp -= 2;
 			}
@@ -51,6 +51,8 @@
 #include "g_game.h"
 #include "serializer_doom.h"
 #include "p_visualthinker.h"
+#include "threadpool.h"
+#include "types.h"
 
 #include "hwrenderer/scene/hw_drawstructs.h"
 
@@ -107,10 +109,99 @@ static const struct ColorList {
 	{NULL, 0, 0, 0 }
 };
 
+//==========================================================================
+//
+// FParticleSim
+//
+//==========================================================================
+
+void FParticleSim::Reset(uint32_t capacity)
+{
+	Count = 0;
+	Pending.Clear();
+	BinsDirty = true;
+
+	Index.Resize(capacity);
+	Slot.Resize(capacity);
+	for (auto &slot : Slot)
+		slot = NO_PARTICLE;
+
+	for (auto arr : { &PosX, &PosY, &PosZ })
+		arr->Resize(capacity);
+	for (auto arr : { &VelX, &VelY, &VelZ, &AccX, &AccY, &AccZ, &Size, &SizeStep, &Alpha, &FadeStep, &Roll, &RollVel, &RollAcc })
+		arr->Resize(capacity);
+	TTL.Resize(capacity);
+	Expired.Resize(capacity);
+}
+
+void FParticleSim::Load(uint32_t index, const particle_t &particle)
+{
+	uint32_t s = Count++;
+	Index[s] = index;
+	Slot[index] = s;
+
+	PosX[s] = particle.Pos.X;
+	PosY[s] = particle.Pos.Y;
+	PosZ[s] = particle.Pos.Z;
+	VelX[s] = particle.Vel.X;
+	VelY[s] = particle.Vel.Y;
+	VelZ[s] = particle.Vel.Z;
+	AccX[s] = particle.Acc.X;
+	AccY[s] = particle.Acc.Y;
+	AccZ[s] = particle.Acc.Z;
+	Size[s] = particle.size;
+	SizeStep[s] = particle.sizestep;
+	Alpha[s] = particle.alpha;
+	FadeStep[s] = particle.fadestep;
+	TTL[s] = particle.ttl;
+	Expired[s] = false;
+
+	// Without SPF_ROLL the roll is left alone, so the update does not need to look at the flags.
+	bool roll = !!(particle.flags & SPF_ROLL);
+	Roll[s] = particle.Roll;
+	RollVel[s] = roll ? particle.RollVel : 0.f;
+	RollAcc[s] = roll ? particle.RollAcc : 0.f;
+}
+
+void FParticleSim::Remove(uint32_t slot)
+{
+	uint32_t last = --Count;
+	if (slot != last)
+	{
+		Index[slot] = Index[last];
+		Slot[Index[slot]] = slot;
+
+		PosX[slot] = PosX[last];
+		PosY[slot] = PosY[last];
+		PosZ[slot] = PosZ[last];
+		VelX[slot] = VelX[last];
+		VelY[slot] = VelY[last];
+		VelZ[slot] = VelZ[last];
+		AccX[slot] = AccX[last];
+		AccY[slot] = AccY[last];
+		AccZ[slot] = AccZ[last];
+		Size[slot] = Size[last];
+		SizeStep[slot] = SizeStep[last];
+		Alpha[slot] = Alpha[last];
+		FadeStep[slot] = FadeStep[last];
+		Roll[slot] = Roll[last];
+		RollVel[slot] = RollVel[last];
+		RollAcc[slot] = RollAcc[last];
+		TTL[slot] = TTL[last];
+		Expired[slot] = Expired[last];
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 static void FreeParticle(FLevelLocals* Level, particle_t* particle)
 {
 	auto prev = particle->tprev == NO_PARTICLE? nullptr : &Level->Particles[particle->tprev];
-	int pindex = (int)(particle - Level->Particles.Data());
+	uint32_t pindex = (uint32_t)(particle - Level->Particles.Data());
 	auto tnext = particle->tnext;
 	assert(!prev || (prev->tnext == pindex));
 	if (prev)
@@ -132,6 +223,12 @@ static void FreeParticle(FLevelLocals* Level, particle_t* particle)
 	memset(particle, 0, sizeof(particle_t));
 	particle->tnext = Level->InactiveParticles;
 	Level->InactiveParticles = pindex;
+
+	auto &sim = Level->ParticleSim;
+	if (sim.Slot[pindex] < sim.Count)
+		sim.Remove(sim.Slot[pindex]);
+	sim.Slot[pindex] = sim.Slot[pindex] == FParticleSim::PENDING ? FParticleSim::PENDING_FREED : NO_PARTICLE;
+	sim.BinsDirty = true;
 }
 
 static particle_t *NewParticle (FLevelLocals *Level, bool replace = false)
@@ -160,6 +257,13 @@ static particle_t *NewParticle (FLevelLocals *Level, bool replace = false)
 	{
 		Level->OldestParticle = Level->ActiveParticles;
 	}
+
+	// The caller still has to fill in the record, so it is only added to the simulation on the next tic.
+	auto &sim = Level->ParticleSim;
+	if (sim.Slot[Level->ActiveParticles] != FParticleSim::PENDING_FREED)
+		sim.Pending.Push(Level->ActiveParticles);
+	sim.Slot[Level->ActiveParticles] = FParticleSim::PENDING;
+	sim.BinsDirty = true;
 	return result;
 }
 
@@ -180,7 +284,7 @@ void P_InitParticles (FLevelLocals *Level)
 		num = r_maxparticles;
 
 	// This should be good, but eh...
-	int NumParticles = clamp<int>(num, 100, 65535);
+	int NumParticles = clamp<int>(num, 100, MAX_PARTICLES);
 
 	Level->Particles.Resize(NumParticles);
 	P_ClearParticles (Level);
@@ -188,7 +292,7 @@ void P_InitParticles (FLevelLocals *Level)
 
 void P_ClearParticles (FLevelLocals *Level)
 {
-	int i = 0;
+	uint32_t i = 0;
 	Level->OldestParticle = NO_PARTICLE;
 	Level->ActiveParticles = NO_PARTICLE;
 	Level->InactiveParticles = 0;
@@ -200,11 +304,11 @@ void P_ClearParticles (FLevelLocals *Level)
 	}
 	Level->Particles.Last().tnext = NO_PARTICLE;
 	Level->Particles.Data()->tprev = NO_PARTICLE;
+	Level->ParticleSim.Reset(Level->Particles.Size());
 }
 
-// Group particles by subsectors. Because particles are always
-// in motion, there is little benefit to caching this information
-// from one frame to the next.
+// Group particles by subsectors. Particles only move once per tic, so the
+// grouping is rebuilt in one pass whenever a tic or a spawn has changed it.
 // [MC] VisualThinkers hitches a ride here
 
 void P_FindParticleSubsectors (FLevelLocals *Level)
@@ -223,24 +327,44 @@ void P_FindParticleSubsectors (FLevelLocals *Level)
 		sp = sp->GetNext();
 	}
 	// End VisualThinker hitching. Now onto the particles. 
+	auto &sim = Level->ParticleSim;
 	if (Level->ParticlesInSubsec.Size() < Level->subsectors.Size())
 	{
 		Level->ParticlesInSubsec.Reserve (Level->subsectors.Size() - Level->ParticlesInSubsec.Size());
+		sim.BinsDirty = true;
 	}
 
-	fillshort (&Level->ParticlesInSubsec[0], Level->subsectors.Size(), NO_PARTICLE);
-
 	if (!r_particles)
+	{
+		std::fill_n(Level->ParticlesInSubsec.Data(), Level->subsectors.Size(), NO_PARTICLE);
+		sim.BinsDirty = true;
+		return;
+	}
+	if (!sim.BinsDirty)
 	{
 		return;
 	}
-	for (uint16_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->Particles[i].tnext)
+	sim.BinsDirty = false;
+	std::fill_n(Level->ParticlesInSubsec.Data(), Level->subsectors.Size(), NO_PARTICLE);
+
+	auto link = [=](uint32_t i)
 	{
+		particle_t &particle = Level->Particles[i];
 		 // Try to reuse the subsector from the last portal check, if still valid.
-		if (Level->Particles[i].subsector == nullptr) Level->Particles[i].subsector = Level->PointInRenderSubsector(Level->Particles[i].Pos);
-		int ssnum = Level->Particles[i].subsector->Index();
-		Level->Particles[i].snext = Level->ParticlesInSubsec[ssnum];
+		if (particle.subsector == nullptr) particle.subsector = Level->PointInRenderSubsector(particle.Pos);
+		int ssnum = particle.subsector->Index();
+		particle.snext = Level->ParticlesInSubsec[ssnum];
 		Level->ParticlesInSubsec[ssnum] = i;
+	};
+
+	for (uint32_t s = 0; s < sim.Count; s++)
+	{
+		link(sim.Index[s]);
+	}
+	for (uint32_t i : sim.Pending)
+	{
+		if (sim.Slot[i] == FParticleSim::PENDING)
+			link(i);
 	}
 }
 
@@ -281,66 +405,185 @@ void P_InitEffects ()
 	blood2 = ParticleColor(RPART(kind)/3, GPART(kind)/3, BPART(kind)/3);
 }
 
-void P_ThinkParticles (FLevelLocals *Level)
+//==========================================================================
+//
+// Particle movement
+//
+// The common case (level not frozen, no interactive line portals) runs as a
+// vectorizable pass over the packed arrays, followed by a scalar pass that
+// finds the subsectors, applies sector portals and writes the results to the
+// render records. Everything else goes through the scalar fallback.
+//
+//==========================================================================
+
+static void FinishParticle(FLevelLocals *Level, uint32_t s)
+{
+	auto &sim = Level->ParticleSim;
+	particle_t *particle = &Level->Particles[sim.Index[s]];
+
+	DVector3 pos(sim.PosX[s], sim.PosY[s], sim.PosZ[s]);
+	subsector_t *ss = Level->PointInRenderSubsector(pos);
+	sector_t *sec = ss->sector;
+	// Handle crossing a sector portal.
+	if (!sec->PortalBlocksMovement(sector_t::ceiling))
+	{
+		if (pos.Z > sec->GetPortalPlaneZ(sector_t::ceiling))
+		{
+			pos += sec->GetPortalDisplacement(sector_t::ceiling);
+			ss = nullptr;
+		}
+	}
+	else if (!sec->PortalBlocksMovement(sector_t::floor))
+	{
+		if (pos.Z < sec->GetPortalPlaneZ(sector_t::floor))
+		{
+			pos += sec->GetPortalDisplacement(sector_t::floor);
+			ss = nullptr;
+		}
+	}
+	sim.PosX[s] = pos.X;
+	sim.PosY[s] = pos.Y;
+	sim.PosZ[s] = pos.Z;
+
+	particle->subsector = ss;
+	particle->Pos = pos;
+	particle->Vel = FVector3(sim.VelX[s], sim.VelY[s], sim.VelZ[s]);
+	particle->size = sim.Size[s];
+	particle->alpha = sim.Alpha[s];
+	particle->ttl = sim.TTL[s];
+	if (particle->flags & SPF_ROLL)
+	{
+		particle->Roll = sim.Roll[s];
+		particle->RollVel = sim.RollVel[s];
+	}
+}
+
+static void AdvanceParticles(FLevelLocals *Level, uint32_t start, uint32_t end)
+{
+	auto &sim = Level->ParticleSim;
+	double *__restrict posx = sim.PosX.Data(), *__restrict posy = sim.PosY.Data(), *__restrict posz = sim.PosZ.Data();
+	float *__restrict velx = sim.VelX.Data(), *__restrict vely = sim.VelY.Data(), *__restrict velz = sim.VelZ.Data();
+	const float *__restrict accx = sim.AccX.Data(), *__restrict accy = sim.AccY.Data(), *__restrict accz = sim.AccZ.Data();
+	float *__restrict size = sim.Size.Data(), *__restrict alpha = sim.Alpha.Data();
+	const float *__restrict sizestep = sim.SizeStep.Data(), *__restrict fadestep = sim.FadeStep.Data();
+	float *__restrict roll = sim.Roll.Data(), *__restrict rollvel = sim.RollVel.Data();
+	const float *__restrict rollacc = sim.RollAcc.Data();
+	int32_t *__restrict ttl = sim.TTL.Data();
+	uint8_t *__restrict expired = sim.Expired.Data();
+
+	for (uint32_t s = start; s < end; s++)
+	{
+		alpha[s] -= fadestep[s];
+		size[s] += sizestep[s];
+		ttl[s] -= 1;
+		expired[s] = (alpha[s] <= 0) | (ttl[s] <= 0) | (size[s] <= 0);
+
+		posx[s] += velx[s];
+		posy[s] += vely[s];
+		posz[s] += velz[s];
+		velx[s] += accx[s];
+		vely[s] += accy[s];
+		velz[s] += accz[s];
+
+		roll[s] += rollvel[s];
+		rollvel[s] += rollacc[s];
+	}
+
+	for (uint32_t s = start; s < end; s++)
+	{
+		if (!expired[s])
+			FinishParticle(Level, s);
+	}
+}
+
+static void AdvanceParticlesScalar(FLevelLocals *Level)
 {
-	int i = Level->ActiveParticles;
-	particle_t *particle = nullptr, *prev = nullptr;
-	while (i != NO_PARTICLE)
+	auto &sim = Level->ParticleSim;
+	for (uint32_t s = 0; s < sim.Count; s++)
 	{
-		particle = &Level->Particles[i];
-		i = particle->tnext;
-		if (Level->isFrozen() && !(particle->flags &SPF_NOTIMEFREEZE))
+		particle_t *particle = &Level->Particles[sim.Index[s]];
+		sim.Expired[s] = false;
+		if (Level->isFrozen() && !(particle->flags & SPF_NOTIMEFREEZE))
 		{
 			if(particle->flags & SPF_LOCAL_ANIM)
 			{
 				particle->animData.SwitchTic++;
 			}
-
-			prev = particle;
 			continue;
 		}
-		
-		particle->alpha -= particle->fadestep;
-		particle->size += particle->sizestep;
-		if (particle->alpha <= 0 || --particle->ttl <= 0 || (particle->size <= 0))
-		{ // The particle has expired, so free it
-			FreeParticle(Level, particle);
+
+		sim.Alpha[s] -= sim.FadeStep[s];
+		sim.Size[s] += sim.SizeStep[s];
+		if (sim.Alpha[s] <= 0 || --sim.TTL[s] <= 0 || sim.Size[s] <= 0)
+		{ // The particle has expired
+			sim.Expired[s] = true;
 			continue;
 		}
 
 		// Handle crossing a line portal
-		DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
-		particle->Pos.X = newxy.X;
-		particle->Pos.Y = newxy.Y;
-		particle->Pos.Z += particle->Vel.Z;
-		particle->Vel += particle->Acc;
+		DVector2 newxy = Level->GetPortalOffsetPosition(sim.PosX[s], sim.PosY[s], sim.VelX[s], sim.VelY[s]);
+		sim.PosX[s] = newxy.X;
+		sim.PosY[s] = newxy.Y;
+		sim.PosZ[s] += sim.VelZ[s];
+		sim.VelX[s] += sim.AccX[s];
+		sim.VelY[s] += sim.AccY[s];
+		sim.VelZ[s] += sim.AccZ[s];
+
+		sim.Roll[s] += sim.RollVel[s];
+		sim.RollVel[s] += sim.RollAcc[s];
+
+		FinishParticle(Level, s);
+	}
+}
 
-		if(particle->flags & SPF_ROLL)
-		{
-			particle->Roll += particle->RollVel;
-			particle->RollVel += particle->RollAcc;
-		}
-		
-		particle->subsector = Level->PointInRenderSubsector(particle->Pos);
-		sector_t *s = particle->subsector->sector;
-		// Handle crossing a sector portal.
-		if (!s->PortalBlocksMovement(sector_t::ceiling))
+void P_ThinkParticles (FLevelLocals *Level)
+{
+	auto &sim = Level->ParticleSim;
+
+	// Pick up everything spawned since the last tic.
+	for (uint32_t i : sim.Pending)
+	{
+		if (sim.Slot[i] == FParticleSim::PENDING)
+			sim.Load(i, Level->Particles[i]);
+		else if (sim.Slot[i] == FParticleSim::PENDING_FREED)
+			sim.Slot[i] = NO_PARTICLE;
+	}
+	sim.Pending.Clear();
+
+	if (sim.Count == 0)
+		return;
+	sim.BinsDirty = true;
+
+	if (Level->isFrozen() || Level->PortalBlockmap.containsLines)
+	{
+		// The line portal traverser is not thread safe, so this stays on the main thread.
+		AdvanceParticlesScalar(Level);
+	}
+	else
+	{
+		const uint32_t batchSize = 1024;
+		uint32_t count = sim.Count;
+		uint32_t batches = (count + batchSize - 1) / batchSize;
+		FThreadPool *pool = batches > 1 ? P_GetParallelTickPool() : nullptr;
+		if (pool)
 		{
-			if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
+			pool->Run(batches, [=](int batch)
 			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
-				particle->subsector = NULL;
-			}
+				AdvanceParticles(Level, batch * batchSize, min(batch * batchSize + batchSize, count));
+			});
 		}
-		else if (!s->PortalBlocksMovement(sector_t::floor))
+		else
 		{
-			if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::floor);
-				particle->subsector = NULL;
-			}
+			AdvanceParticles(Level, 0, count);
 		}
-		prev = particle;
+	}
+
+	// Free the expired particles. Freeing moves the last slot into the freed one,
+	// so walk backwards to visit every slot exactly once.
+	for (uint32_t s = sim.Count; s-- > 0;)
+	{
+		if (sim.Expired[s])
+			FreeParticle(Level, &Level->Particles[sim.Index[s]]);
 	}
 }
 
@@ -1145,11 +1388,31 @@ void DVisualThinker::Tick()
 		return;
 	}
 
+	TickConcurrent();
+	CommitTick();
+}
+
+// Only visual thinkers without a scripted Tick override can be moved on a worker thread.
+// The line portal traverser used for the movement is not thread safe either.
+bool DVisualThinker::CanTickConcurrently()
+{
+	if (Level->PortalBlockmap.containsLines)
+		return false;
+
+	IFVIRTUAL(DThinker, Tick)
+	{
+		if (!(func->VarFlags & VARF_Native))
+			return false;
+	}
+	return ValidTexture();
+}
+
+void DVisualThinker::TickConcurrent()
+{
 	if (isFrozen())
 	{	// needed here because it won't retroactively update like actors do.
 		PT.subsector = Level->PointInRenderSubsector(PT.Pos);
 		cursector = PT.subsector->sector;
-		UpdateSpriteInfo(); 
 		return;
 	}
 	Prev = PT.Pos;
@@ -1180,6 +1443,11 @@ void DVisualThinker::Tick()
 	}
     
 	UpdateSector(ss);
+}
+
+// Starting a texture animation draws from a shared random number generator.
+void DVisualThinker::CommitTick()
+{
 	UpdateSpriteInfo();
 }
 
@@ -95,15 +95,46 @@ struct particle_t
     FTextureID texture; // +4 = 84
     ERenderStyle style; //+4 = 88
     float Roll, RollVel, RollAcc; //+12 = 100
-    uint16_t    tnext, snext, tprev; //+6 = 106
-	uint16_t flags; //+2 = 108
-	// uint32_t padding; //+4 = 112
-	FStandaloneAnimation animData; //+16 = 128
+    uint32_t    tnext, snext, tprev; //+12 = 112
+	uint16_t flags; //+2 = 114
+	// uint16_t padding[3]; //+6 = 120
+	FStandaloneAnimation animData; //+16 = 136
 };
 
-static_assert(sizeof(particle_t) == 128, "Only LP64/LLP64 is supported");
+static_assert(sizeof(particle_t) == 136, "Only LP64/LLP64 is supported");
 
-const uint16_t NO_PARTICLE = 0xffff;
+const uint32_t NO_PARTICLE = 0xffffffff;
+const int MAX_PARTICLES = 1 << 20;
+
+// The simulation state of a level's particles, kept as a structure of arrays so that the
+// per-tic update runs as straight loops over tightly packed values.
+// Slots [0, Count) hold the live particles in no particular order. The particle_t records
+// the renderers use are written back from here every tic. Newly spawned particles are set up
+// through their record and picked up from it on the next tic.
+struct FParticleSim
+{
+	static const uint32_t PENDING = 0xfffffffe;
+	static const uint32_t PENDING_FREED = 0xfffffffd;	// still listed in Pending, but freed before it got loaded
+
+	uint32_t Count = 0;
+	TArray<uint32_t> Index;		// slot -> particle record
+	TArray<uint32_t> Slot;		// particle record -> slot, PENDING, PENDING_FREED or NO_PARTICLE
+	TArray<uint32_t> Pending;	// records spawned since the last tic
+	bool BinsDirty = true;		// ParticlesInSubsec needs to be rebuilt
+
+	TArray<double> PosX, PosY, PosZ;
+	TArray<float> VelX, VelY, VelZ;
+	TArray<float> AccX, AccY, AccZ;
+	TArray<float> Size, SizeStep;
+	TArray<float> Alpha, FadeStep;
+	TArray<float> Roll, RollVel, RollAcc;
+	TArray<int32_t> TTL;
+	TArray<uint8_t> Expired;
+
+	void Reset(uint32_t capacity);
+	void Load(uint32_t index, const particle_t &particle);
+	void Remove(uint32_t slot);
+};
 
 void P_InitParticles(FLevelLocals *);
 void P_ClearParticles (FLevelLocals *Level);
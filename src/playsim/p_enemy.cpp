@@ -154,27 +154,29 @@ static void NoiseMarkSector(sector_t *sec, AActor *soundtarget, bool splash, AAc
 }
 
 
-static void P_RecursiveSound(sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
+static void P_RecursiveSound(FSoundGraph &graph, sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
 {
-	bool checkabove = !sec->PortalBlocksSound(sector_t::ceiling);
-	bool checkbelow = !sec->PortalBlocksSound(sector_t::floor);
-
-	for (auto check : sec->Lines)
+	// check sector portals
+	// I wish there was a better method to do this than randomly looking through the portal at a few places...
+	for (int plane : { sector_t::ceiling, sector_t::floor })
 	{
-		// check sector portals
-		// I wish there was a better method to do this than randomly looking through the portal at a few places...
-		if (checkabove)
-		{
-			sector_t *upper = sec->Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + sec->GetPortalDisplacement(sector_t::ceiling));
-			NoiseMarkSector(upper, soundtarget, splash, emitter, soundblocks, maxdist);
-		}
-		if (checkbelow)
+		if (!sec->PortalBlocksSound(plane))
 		{
-			sector_t *lower = sec->Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + sec->GetPortalDisplacement(sector_t::floor));
-			NoiseMarkSector(lower, soundtarget, splash, emitter, soundblocks, maxdist);
+			for (auto other : graph.GetPortalSectors(sec, plane))
+			{
+				NoiseMarkSector(other, soundtarget, splash, emitter, soundblocks, maxdist);
+			}
+			for (auto check : graph.GetPolyLines(sec))
+			{
+				sector_t *other = sec->Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + sec->GetPortalDisplacement(plane));
+				NoiseMarkSector(other, soundtarget, splash, emitter, soundblocks, maxdist);
+			}
 		}
+	}
 
-		// ... and line portals;
+	// ... and line portals;
+	for (auto check : graph.GetPortalLines(sec))
+	{
 		FLinePortal *port = check->getPortal();
 		if (port && (port->mFlags & PORTF_SOUNDTRAVERSE))
 		{
@@ -183,48 +185,33 @@ static void P_RecursiveSound(sector_t *sec, AActor *soundtarget, bool splash, AA
 				NoiseMarkSector(port->mDestination->frontsector, soundtarget, splash, emitter, soundblocks, maxdist);
 			}
 		}
+	}
 
-
-		if (check->sidedef[1] == NULL ||
-			!(check->flags & ML_TWOSIDED))
+	for (auto &edge : graph.GetEdges(sec))
+	{
+		line_t *check = edge.Line;
+		if (!(check->flags & ML_TWOSIDED))
 		{
 			continue;
 		}
 
-		// Early out for intra-sector lines
-		if (check->sidedef[0]->sector == check->sidedef[1]->sector) continue;
-
-		sector_t *other;
-		if (check->sidedef[0]->sector == sec)
-			other = check->sidedef[1]->sector;
-		else
-			other = check->sidedef[0]->sector;
-
-		// check for closed door
-		if ((sec->floorplane.ZatPoint(check->v1->fPos()) >=
-			other->ceilingplane.ZatPoint(check->v1->fPos()) &&
-			sec->floorplane.ZatPoint(check->v2->fPos()) >=
-			other->ceilingplane.ZatPoint(check->v2->fPos()))
-			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
-				sec->ceilingplane.ZatPoint(check->v1->fPos()) &&
-				other->floorplane.ZatPoint(check->v2->fPos()) >=
-				sec->ceilingplane.ZatPoint(check->v2->fPos()))
-			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
-				other->ceilingplane.ZatPoint(check->v1->fPos()) &&
-				other->floorplane.ZatPoint(check->v2->fPos()) >=
-				other->ceilingplane.ZatPoint(check->v2->fPos())))
+		int blocks = soundblocks;
+		if (check->flags & ML_SOUNDBLOCK)
 		{
-			continue;
+			if (soundblocks) continue;
+			blocks = 1;
 		}
 
-		if (check->flags & ML_SOUNDBLOCK)
+		// Don't bother checking for a closed door if the other side would not be marked anyway.
+		sector_t *other = edge.Other;
+		if (other->validcount == validcount && other->soundtraversed <= blocks + 1)
 		{
-			if (!soundblocks)
-				NoiseMarkSector(other, soundtarget, splash, emitter, 1, maxdist);
+			continue;
 		}
-		else
+
+		if (!graph.IsClosed(sec, edge))
 		{
-			NoiseMarkSector(other, soundtarget, splash, emitter, soundblocks, maxdist);
+			NoiseMarkSector(other, soundtarget, splash, emitter, blocks, maxdist);
 		}
 	}
 }
@@ -249,12 +236,19 @@ void P_NoiseAlert (AActor *emitter, AActor *target, bool splash, double maxdist)
 	if (target != NULL && target->player && (target->player->cheats & CF_NOTARGET))
 		return;
 
+	auto &graph = emitter->Level->soundgraph;
+	if (!graph.IsBuilt())
+	{
+		graph.Build(emitter->Level);
+	}
+	graph.BeginFlood();
+
 	validcount++;
 	NoiseList.Clear();
 	NoiseMarkSector(emitter->Sector, target, splash, emitter, 0, maxdist);
 	for (unsigned i = 0; i < NoiseList.Size(); i++)
 	{
-		P_RecursiveSound(NoiseList[i].sec, target, splash, emitter, NoiseList[i].soundblocks, maxdist);
+		P_RecursiveSound(graph, NoiseList[i].sec, target, splash, emitter, NoiseList[i].soundblocks, maxdist);
 	}
 }
 
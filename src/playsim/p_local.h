@@ -51,6 +51,7 @@ struct FCheckPosition;
 struct FTranslatedLineTarget;
 struct FLinePortal;
 class DViewPosition;
+class FSpatialQueryContext;
 struct FRenderViewpoint;
 
 #include <stdlib.h>
@@ -271,6 +272,7 @@ bool	P_BounceWall (AActor *mo);
 bool	P_BounceActor (AActor *mo, AActor *BlockingMobj, bool ontop);
 bool    P_ReflectOffActor(AActor* mo, AActor* blocking);
 int	P_CheckSight (AActor *t1, AActor *t2, int flags=0);
+int	P_CheckSight (FSpatialQueryContext &context, AActor *t1, AActor *t2, int flags=0);
 
 enum ESightFlags
 {
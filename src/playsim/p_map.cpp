@@ -7050,6 +7050,7 @@ bool P_ChangeSector(sector_t *sector, int crunch, double amt, int floorOrCeil, b
 	cpos.movemidtex = false;
 	cpos.sector = sector;
 	cpos.instant = instant;
+	sector->Level->SightGeometry++;	// invalidates the memoized sight checks
 
 	// Also process all sectors that have 3D floors transferred from the
 	// changed sector.
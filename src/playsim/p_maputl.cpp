@@ -581,6 +581,41 @@ void AActor::SetOrigin(double x, double y, double z, bool moving)
 //
 
 
+//===========================================================================
+//
+// FSpatialQueryContext
+//
+//===========================================================================
+
+void FSpatialQueryContext::NewQuery()
+{
+	auto resize = [](TArray<uint32_t> &stamps, unsigned size)
+	{
+		if (stamps.Size() != size)
+		{
+			stamps.Resize(size);
+			memset(stamps.Data(), 0, size * sizeof(uint32_t));
+		}
+	};
+	resize(LineStamps, Level->lines.Size());
+	resize(SectorStamps, Level->sectors.Size());
+	resize(PolyStamps, Level->Polyobjects.Size());
+
+	if (++Generation == 0)
+	{
+		// Stamps from 2^32 queries ago would look current, so start over.
+		memset(LineStamps.Data(), 0, LineStamps.Size() * sizeof(uint32_t));
+		memset(SectorStamps.Data(), 0, SectorStamps.Size() * sizeof(uint32_t));
+		memset(PolyStamps.Data(), 0, PolyStamps.Size() * sizeof(uint32_t));
+		Generation = 1;
+	}
+}
+
+bool FSpatialQueryContext::VisitPolyobj(const FPolyObj *poly)
+{
+	return Visit(PolyStamps, unsigned(poly - Level->Polyobjects.Data()));
+}
+
 //===========================================================================
 //
 // FBlockLinesIterator
@@ -598,9 +633,22 @@ FBlockLinesIterator::FBlockLinesIterator(FLevelLocals *l, int _minx, int _miny,
 	Reset();
 }
 
+FBlockLinesIterator::FBlockLinesIterator(FSpatialQueryContext &context, int _minx, int _miny, int _maxx, int _maxy, bool keepvalidcount)
+{
+	if (!keepvalidcount) context.NewQuery();
+	Level = context.Level;
+	Context = &context;
+	minx = _minx;
+	maxx = _maxx;
+	miny = _miny;
+	maxy = _maxy;
+	Reset();
+}
+
 void FBlockLinesIterator::init(const FBoundingBox &box)
 {
-	validcount++;
+	if (Context != nullptr) Context->NewQuery();
+	else validcount++;
 	maxy = Level->blockmap.GetBlockY(box.Top());
 	miny = Level->blockmap.GetBlockY(box.Bottom());
 	maxx = Level->blockmap.GetBlockX(box.Right());
@@ -614,6 +662,37 @@ FBlockLinesIterator::FBlockLinesIterator(FLevelLocals *l, const FBoundingBox &bo
 	init(box);
 }
 
+FBlockLinesIterator::FBlockLinesIterator(FSpatialQueryContext &context, const FBoundingBox &box)
+{
+	Level = context.Level;
+	Context = &context;
+	init(box);
+}
+
+//===========================================================================
+//
+// FBlockLinesIterator :: VisitLine / VisitPolyobj
+//
+// Returns true the first time an element is seen during this query.
+//
+//===========================================================================
+
+bool FBlockLinesIterator::VisitLine(line_t *ld)
+{
+	if (Context != nullptr) return Context->VisitLine(ld);
+	if (ld->validcount == validcount) return false;
+	ld->validcount = validcount;
+	return true;
+}
+
+bool FBlockLinesIterator::VisitPolyobj(FPolyObj *poly)
+{
+	if (Context != nullptr) return Context->VisitPolyobj(poly);
+	if (poly->validcount == validcount) return false;
+	poly->validcount = validcount;
+	return true;
+}
+
 //===========================================================================
 //
 // FBlockLinesIterator :: StartBlock
@@ -656,12 +735,11 @@ line_t *FBlockLinesIterator::Next()
 			{
 				if (polyIndex == 0)
 				{
-					if (polyLink->polyobj->validcount == validcount)
+					if (!VisitPolyobj(polyLink->polyobj))
 					{
 						polyLink = polyLink->next;
 						continue;
 					}
-					polyLink->polyobj->validcount = validcount;
 				}
 
 				line_t *ld = polyLink->polyobj->Linedefs[polyIndex];
@@ -672,13 +750,8 @@ line_t *FBlockLinesIterator::Next()
 					polyIndex = 0;
 				}
 
-				if (ld->validcount == validcount)
-				{
-					continue;
-				}
-				else
+				if (VisitLine(ld))
 				{
-					ld->validcount = validcount;
 					return ld;
 				}
 			}
@@ -692,9 +765,8 @@ line_t *FBlockLinesIterator::Next()
 				line_t *ld = &Level->lines[*list];
 
 				list++;
-				if (ld->validcount != validcount)
+				if (VisitLine(ld))
 				{
-					ld->validcount = validcount;
 					return ld;
 				}
 			}
@@ -1162,7 +1234,7 @@ void FMultiBlockThingsIterator::Reset()
 //
 //===========================================================================
 
-TArray<intercept_t> FPathTraverse::intercepts(128);
+TArray<intercept_t> FPathTraverse::GlobalIntercepts(128);
 
 
 //===========================================================================
@@ -1179,7 +1251,7 @@ TArray<intercept_t> FPathTraverse::intercepts(128);
 
 void FPathTraverse::AddLineIntercepts(int bx, int by)
 {
-	FBlockLinesIterator it(Level, bx, by, bx, by, true);
+	FBlockLinesIterator it = Context != nullptr ? FBlockLinesIterator(*Context, bx, by, bx, by, true) : FBlockLinesIterator(Level, bx, by, bx, by, true);
 	line_t *ld;
 
 	while ((ld = it.Next()))
@@ -1459,7 +1531,8 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		flags |= PT_DELTA;
 	}
 
-	validcount++;
+	if (Context != nullptr) Context->NewQuery();
+	else validcount++;
 	intercept_index = intercepts.Size();
 	Startfrac = startfrac;
 
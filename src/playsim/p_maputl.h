@@ -10,6 +10,7 @@
 
 extern int validcount;
 struct FBlockNode;
+struct FPolyObj;
 
 struct divline_t
 {
@@ -211,10 +212,54 @@ private:
 	TArray<uint16_t> data;
 };
 
+//==========================================================================
+//
+// FSpatialQueryContext
+//
+// Replaces the global validcount for queries that are given one. Each
+// context has its own visited sets, stamped with a generation number so
+// that starting a new query does not need to clear them, and its own
+// intercept list. Queries that use a context write no global or map data,
+// so several threads can run them at the same time, one context per
+// thread, as long as nothing changes the map meanwhile.
+//
+//==========================================================================
+
+class FSpatialQueryContext
+{
+public:
+	FSpatialQueryContext(FLevelLocals *level) : Level(level) {}
+
+	// Starts a new query. Everything visited before counts as unvisited again.
+	void NewQuery();
+
+	// These return true if the element has not been visited yet in this query, and mark it.
+	bool VisitLine(const line_t *line) { return Visit(LineStamps, line->Index()); }
+	bool VisitSector(const sector_t *sector) { return Visit(SectorStamps, sector->Index()); }
+	bool VisitPolyobj(const FPolyObj *poly);
+
+	FLevelLocals *const Level;
+	TArray<intercept_t> Intercepts;
+
+private:
+	bool Visit(TArray<uint32_t> &stamps, unsigned index)
+	{
+		if (stamps[index] == Generation) return false;
+		stamps[index] = Generation;
+		return true;
+	}
+
+	TArray<uint32_t> LineStamps;
+	TArray<uint32_t> SectorStamps;
+	TArray<uint32_t> PolyStamps;
+	uint32_t Generation = 0;
+};
+
 class FBlockLinesIterator
 {
 	friend class FMultiBlockLinesIterator;
 	FLevelLocals *Level;
+	FSpatialQueryContext *Context = nullptr;
 	int minx, maxx;
 	int miny, maxy;
 
@@ -224,12 +269,16 @@ class FBlockLinesIterator
 	int *list;
 
 	void StartBlock(int x, int y);
+	bool VisitLine(line_t *ld);
+	bool VisitPolyobj(FPolyObj *poly);
 
 	FBlockLinesIterator(FLevelLocals *l)  { Level = l; }
 	void init(const FBoundingBox &box);
 public:
 	FBlockLinesIterator(FLevelLocals *Level, int minx, int miny, int maxx, int maxy, bool keepvalidcount = false);
 	FBlockLinesIterator(FLevelLocals *Level, const FBoundingBox &box);
+	FBlockLinesIterator(FSpatialQueryContext &context, int minx, int miny, int maxx, int maxy, bool keepvalidcount = false);
+	FBlockLinesIterator(FSpatialQueryContext &context, const FBoundingBox &box);
 	line_t *Next();
 	void Reset() { StartBlock(minx, miny); }
 };
@@ -367,9 +416,11 @@ public:
 class FPathTraverse
 {
 protected:
-	static TArray<intercept_t> intercepts;
+	static TArray<intercept_t> GlobalIntercepts;
 
 	FLevelLocals *Level;
+	FSpatialQueryContext *Context = nullptr;
+	TArray<intercept_t> &intercepts;
 	divline_t trace;
 	double Startfrac;
 	unsigned int intercept_index;
@@ -378,7 +429,7 @@ protected:
 
 	virtual void AddLineIntercepts(int bx, int by);
 	virtual void AddThingIntercepts(int bx, int by, FBlockThingsIterator &it, bool compatible);
-	FPathTraverse(FLevelLocals *l) 
+	FPathTraverse(FLevelLocals *l) : intercepts(GlobalIntercepts)
 	{
 		Level = l;
 	}
@@ -386,11 +437,17 @@ public:
 
 	intercept_t *Next();
 
-	FPathTraverse(FLevelLocals *l, double x1, double y1, double x2, double y2, int flags, double startfrac = 0)
+	FPathTraverse(FLevelLocals *l, double x1, double y1, double x2, double y2, int flags, double startfrac = 0) : intercepts(GlobalIntercepts)
 	{
 		Level = l;
 		init(x1, y1, x2, y2, flags, startfrac);
 	}
+	FPathTraverse(FSpatialQueryContext &context, double x1, double y1, double x2, double y2, int flags, double startfrac = 0) : intercepts(context.Intercepts)
+	{
+		Level = context.Level;
+		Context = &context;
+		init(x1, y1, x2, y2, flags, startfrac);
+	}
 	void init(double x1, double y1, double x2, double y2, int flags, double startfrac = 0);
 	int PortalRelocate(intercept_t *in, int flags, DVector3 *optpos = nullptr);
 	void PortalRelocate(const DVector2 &disp, int flags, double hitfrac);
@@ -0,0 +1,539 @@
+/*
+** p_sectorpvs.cpp
+**
+** Sector to sector potentially visible set for maps without a REJECT lump
+**
+** The set is built from the GL subsectors, which are convex and closed.
+** Every seg that is not part of a one-sided wall is an opening into the
+** subsector on its other side. Starting with each opening of a sector,
+** sight is flowed through the subsectors behind it, and each further
+** opening is clipped to the part that a straight line through the source
+** opening and the last window can still reach.
+**
+** The result is conservative: openings are never closed by sector heights
+** or line flags, since those can change while the map is running, so only
+** the layout of the one-sided walls is taken into account. Dropping all
+** but the last window from the clipping also only ever makes the set
+** larger. A sector whose flow takes too long simply sees everything.
+**
+** Maps with linked portals or separate gameplay nodes get no set at all,
+** and neither do maps whose polyobjects were left inside the BSP.
+**
+*/
+
+#include "p_local.h"
+#include "g_levellocals.h"
+#include "c_cvars.h"
+#include "i_specialpaths.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "md5.h"
+#include "i_time.h"
+#include "printf.h"
+#include "threadpool.h"
+
+// Only read when a map is loaded. A server setting, so that every player in a netgame uses the same sight checks.
+CVAR(Bool, sight_pvs, true, CVAR_SERVERINFO)
+
+// The matrix needs sectors² bits, so very large maps are left alone.
+static const unsigned PVS_MAX_SECTORS = 8192;
+
+// Number of windows a single opening may pass before its sector is marked as seeing everything.
+static const int PVS_MAX_STEPS = 1 << 16;
+
+// Slack for all clipping, in map units. Errors must only ever widen a window.
+static const double PVS_EPSILON = 1. / 64;
+
+struct FPVSPortal
+{
+	DVector2 V1, Delta;		// the opening is V1 + t * Delta for t in [0, 1]
+	DVector2 Normal;		// points into Cell
+	double Dist;
+	double Length;
+	int Cell;				// subsector behind the opening
+	int Back;				// the same opening seen from Cell, -1 if there is none
+};
+
+struct FPVSCell
+{
+	int FirstPortal;
+	int NumPortals;
+	int Sector;
+};
+
+struct FPVSWindow
+{
+	int Portal;
+	double T0, T1;
+};
+
+struct FPVSPlane
+{
+	DVector2 Normal;
+	double Dist;
+};
+
+struct FPVSBuilder
+{
+	TArray<FPVSPortal> Portals;
+	TArray<FPVSCell> Cells;
+	TArray<TArray<int>> SectorCells;
+	unsigned NumSectors;
+	unsigned RowBytes;
+
+	bool Init(FLevelLocals *Level);
+	void HashInput(uint8_t digest[16]);
+	void FlowSector(int sector, uint8_t *row);
+
+private:
+	// Per thread scratch space for one flow.
+	struct FScratch
+	{
+		TArray<uint32_t> Stamp;
+		TArray<double> T0, T1;
+		TArray<FPVSWindow> Stack;
+		uint32_t Current = 0;
+	};
+
+	bool FlowPortal(const FPVSPortal &source, uint8_t *row, FScratch &scratch);
+};
+
+//==========================================================================
+//
+// Collects the openings of all subsectors. Fails if the subsectors
+// do not form a closed partition of the map.
+//
+//==========================================================================
+
+bool FPVSBuilder::Init(FLevelLocals *Level)
+{
+	NumSectors = Level->sectors.Size();
+	RowBytes = (NumSectors + 7) / 8;
+	SectorCells.Resize(NumSectors);
+	Cells.Resize(Level->subsectors.Size());
+
+	TArray<int> segportal(Level->segs.Size(), true);
+	for (auto &p : segportal) p = -1;
+
+	for (auto &sub : Level->subsectors)
+	{
+		auto &cell = Cells[sub.Index()];
+		cell.FirstPortal = Portals.Size();
+		cell.Sector = sub.sector->Index();
+		SectorCells[cell.Sector].Push(sub.Index());
+
+		DVector2 center(0, 0);
+		for (uint32_t i = 0; i < sub.numlines; i++)
+		{
+			center += sub.firstline[i].v1->fPos();
+		}
+		if (sub.numlines > 0) center /= sub.numlines;
+
+		for (uint32_t i = 0; i < sub.numlines; i++)
+		{
+			seg_t *seg = &sub.firstline[i];
+			if (seg->linedef != nullptr && seg->linedef->backsector == nullptr && !(seg->linedef->sidedef[0]->Flags & WALLF_POLYOBJ))
+			{
+				continue;	// a solid wall
+			}
+			if (seg->PartnerSeg == nullptr || seg->PartnerSeg->Subsector == nullptr)
+			{
+				return false;
+			}
+			DVector2 delta = seg->v2->fPos() - seg->v1->fPos();
+			double length = delta.Length();
+			if (length < PVS_EPSILON)
+			{
+				continue;
+			}
+
+			FPVSPortal &portal = Portals[Portals.Reserve(1)];
+			portal.V1 = seg->v1->fPos();
+			portal.Delta = delta;
+			portal.Length = length;
+			portal.Cell = seg->PartnerSeg->Subsector->Index();
+			portal.Back = -1;
+
+			// Segs have their own subsector on the right, but don't rely on that for degenerate ones.
+			portal.Normal = DVector2(-delta.Y, delta.X) / length;
+			portal.Dist = portal.Normal | portal.V1;
+			if ((portal.Normal | center) - portal.Dist > 0)
+			{
+				portal.Normal = -portal.Normal;
+				portal.Dist = -portal.Dist;
+			}
+			segportal[seg->Index()] = Portals.Size() - 1;
+		}
+		cell.NumPortals = Portals.Size() - cell.FirstPortal;
+	}
+
+	for (auto &sub : Level->subsectors)
+	{
+		for (uint32_t i = 0; i < sub.numlines; i++)
+		{
+			seg_t *seg = &sub.firstline[i];
+			int index = segportal[seg->Index()];
+			if (index >= 0)
+			{
+				Portals[index].Back = segportal[seg->PartnerSeg->Index()];
+			}
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Everything the flow depends on goes into the cache key.
+//
+//==========================================================================
+
+void FPVSBuilder::HashInput(uint8_t digest[16])
+{
+	static const char version[] = "PVS1";
+	uint32_t counts[3] = { NumSectors, Cells.Size(), Portals.Size() };
+	int steps = PVS_MAX_STEPS;
+
+	MD5Context md5;
+	md5.Update((const uint8_t *)version, 4);
+	md5.Update((const uint8_t *)counts, sizeof(counts));
+	md5.Update((const uint8_t *)&steps, sizeof(steps));
+	for (auto &cell : Cells)
+	{
+		md5.Update((const uint8_t *)&cell, sizeof(cell));
+	}
+	for (auto &portal : Portals)
+	{
+		md5.Update((const uint8_t *)&portal.V1, sizeof(portal.V1));
+		md5.Update((const uint8_t *)&portal.Delta, sizeof(portal.Delta));
+		md5.Update((const uint8_t *)&portal.Cell, sizeof(portal.Cell));
+		md5.Update((const uint8_t *)&portal.Back, sizeof(portal.Back));
+	}
+	md5.Final(digest);
+}
+
+//==========================================================================
+//
+// Clips the window t0..t1 of the portal to the front of the plane.
+//
+//==========================================================================
+
+static bool ClipToPlane(const FPVSPortal &portal, const FPVSPlane &plane, double &t0, double &t1)
+{
+	double a = (plane.Normal | portal.V1) - plane.Dist + PVS_EPSILON;
+	double b = plane.Normal | portal.Delta;
+
+	if (b == 0)
+	{
+		return a >= 0;
+	}
+	double t = -a / b;
+	if (b > 0)
+	{
+		if (t > t0) t0 = t;
+	}
+	else
+	{
+		if (t < t1) t1 = t;
+	}
+	return t0 <= t1;
+}
+
+//==========================================================================
+//
+// The lines through both the source and the window are bounded by the
+// lines that connect an end of one with the opposite end of the other.
+// Everything visible lies on the same side of them as the window.
+//
+//==========================================================================
+
+static int GetSeparators(const DVector2 *source, const DVector2 *window, FPVSPlane *planes)
+{
+	int count = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			DVector2 dir = window[j] - source[i];
+			double length = dir.Length();
+			if (length < PVS_EPSILON)
+			{
+				continue;	// shared vertex
+			}
+			DVector2 normal(-dir.Y / length, dir.X / length);
+			double dist = normal | source[i];
+			double sside = (normal | source[i ^ 1]) - dist;
+			double wside = (normal | window[j ^ 1]) - dist;
+
+			if ((sside < 0 && wside > 0) || (sside > 0 && wside < 0))
+			{
+				if (wside < 0)
+				{
+					normal = -normal;
+					dist = -dist;
+				}
+				planes[count++] = { normal, dist };
+			}
+		}
+	}
+	return count;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static inline void MarkVisible(uint8_t *row, int sector)
+{
+	row[sector >> 3] |= 1 << (sector & 7);
+}
+
+bool FPVSBuilder::FlowPortal(const FPVSPortal &source, uint8_t *row, FScratch &scratch)
+{
+	if (++scratch.Current == 0)
+	{
+		// Stamp wrapped around.
+		for (auto &s : scratch.Stamp) s = 0;
+		scratch.Current = 1;
+	}
+	const uint32_t stamp = scratch.Current;
+
+	const FPVSPlane sourceplane = { source.Normal, source.Dist };
+	const DVector2 sourcepts[2] = { source.V1, source.V1 + source.Delta };
+	const int sourceback = source.Back;
+
+	MarkVisible(row, Cells[source.Cell].Sector);
+
+	auto &stack = scratch.Stack;
+	stack.Clear();
+
+	auto pushcell = [&](int cell, int back, const FPVSPlane *planes, int numplanes)
+	{
+		auto &c = Cells[cell];
+		for (int i = 0; i < c.NumPortals; i++)
+		{
+			int index = c.FirstPortal + i;
+			if (index == back) continue;
+
+			auto &portal = Portals[index];
+			double t0 = 0, t1 = 1;
+			if (!ClipToPlane(portal, sourceplane, t0, t1)) continue;
+
+			bool visible = true;
+			for (int p = 0; p < numplanes && visible; p++)
+			{
+				visible = ClipToPlane(portal, planes[p], t0, t1);
+			}
+			if (visible)
+			{
+				stack.Push({ index, t0, t1 });
+			}
+		}
+	};
+
+	pushcell(source.Cell, sourceback, nullptr, 0);
+
+	int steps = 0;
+	FPVSWindow window;
+	while (stack.Pop(window))
+	{
+		auto &portal = Portals[window.Portal];
+
+		// Everything reachable from a window is also reachable from a larger one,
+		// so a window that is covered by an earlier one on the same portal adds nothing.
+		if (scratch.Stamp[window.Portal] == stamp)
+		{
+			double slack = PVS_EPSILON / portal.Length;
+			double &t0 = scratch.T0[window.Portal];
+			double &t1 = scratch.T1[window.Portal];
+			if (window.T0 >= t0 - slack && window.T1 <= t1 + slack)
+			{
+				continue;
+			}
+			t0 = window.T0 = min(t0, window.T0);
+			t1 = window.T1 = max(t1, window.T1);
+		}
+		else
+		{
+			scratch.Stamp[window.Portal] = stamp;
+			scratch.T0[window.Portal] = window.T0;
+			scratch.T1[window.Portal] = window.T1;
+		}
+
+		if (++steps > PVS_MAX_STEPS)
+		{
+			return false;
+		}
+		MarkVisible(row, Cells[portal.Cell].Sector);
+
+		const DVector2 windowpts[2] = { portal.V1 + portal.Delta * window.T0, portal.V1 + portal.Delta * window.T1 };
+		FPVSPlane planes[4];
+		int numplanes = GetSeparators(sourcepts, windowpts, planes);
+		pushcell(portal.Cell, portal.Back, planes, numplanes);
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Fills the row of one sector. Rows are independent, so this can
+// run for many sectors at once.
+//
+//==========================================================================
+
+void FPVSBuilder::FlowSector(int sector, uint8_t *row)
+{
+	thread_local FScratch scratch;
+	if (scratch.Stamp.Size() != Portals.Size())
+	{
+		scratch.Stamp.Resize(Portals.Size());
+		scratch.T0.Resize(Portals.Size());
+		scratch.T1.Resize(Portals.Size());
+		for (auto &s : scratch.Stamp) s = 0;
+		scratch.Current = 0;
+	}
+
+	MarkVisible(row, sector);
+	for (int cell : SectorCells[sector])
+	{
+		auto &c = Cells[cell];
+		for (int i = 0; i < c.NumPortals; i++)
+		{
+			if (!FlowPortal(Portals[c.FirstPortal + i], row, scratch))
+			{
+				memset(row, 0xff, RowBytes);
+				return;
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static FString GetPVSCacheName(const uint8_t digest[16], bool create)
+{
+	FString path = M_GetCachePath(create);
+	path << "/pvs";
+	if (create) CreatePath(path.GetChars());
+	path << '/';
+	for (int i = 0; i < 16; i++)
+	{
+		path.AppendFormat("%02x", digest[i]);
+	}
+	path << ".pvs";
+	return path;
+}
+
+static bool ReadPVSCache(const FString &path, unsigned numsectors, TArray<uint8_t> &pvs)
+{
+	// pvs must already have the right size.
+	FileReader fr;
+	if (!fr.OpenFile(path.GetChars())) return false;
+
+	char magic[4];
+	uint32_t count;
+	if (fr.Read(magic, 4) != 4 || memcmp(magic, "PVS1", 4)) return false;
+	if (fr.Read(&count, 4) != 4 || LittleLong(count) != numsectors) return false;
+	return fr.Read(pvs.Data(), pvs.Size()) == (FileReader::Size)pvs.Size();
+}
+
+static void WritePVSCache(const FString &path, unsigned numsectors, const TArray<uint8_t> &pvs)
+{
+	FileWriter *fw = FileWriter::Open(path.GetChars());
+	if (fw == nullptr)
+	{
+		Printf("Cannot open PVS file %s for writing\n", path.GetChars());
+		return;
+	}
+	uint32_t count = LittleLong(numsectors);
+	if (fw->Write("PVS1", 4) != 4 || fw->Write(&count, 4) != 4 || fw->Write(pvs.Data(), pvs.Size()) != pvs.Size())
+	{
+		Printf("Error saving PVS to file %s\n", path.GetChars());
+	}
+	delete fw;
+}
+
+//==========================================================================
+//
+// FLevelLocals :: BuildSectorPVS
+//
+// Must run after the portals have been set up.
+//
+//==========================================================================
+
+void FLevelLocals::BuildSectorPVS()
+{
+	sectorpvs.Reset();
+
+	if (!sight_pvs || rejectmatrix.Size() > 0 || Displacements.size > 1 || gamenodes.Size() > 0)
+		return;
+	if (sectors.Size() == 0 || sectors.Size() > PVS_MAX_SECTORS)
+		return;
+
+	FPVSBuilder builder;
+	if (!builder.Init(this))
+	{
+		DPrintf(DMSG_NOTIFY, "No sector PVS: subsectors are not closed\n");
+		return;
+	}
+
+	unsigned numsectors = sectors.Size();
+	uint8_t digest[16];
+	builder.HashInput(digest);
+
+	sectorpvs.Resize((numsectors * numsectors + 7) / 8);
+	if (ReadPVSCache(GetPVSCacheName(digest, false), numsectors, sectorpvs))
+	{
+		return;
+	}
+
+	uint64_t starttime = I_msTime();
+	TArray<uint8_t> pvs(builder.RowBytes * numsectors, true);
+	memset(pvs.Data(), 0, pvs.Size());
+	{
+		FThreadPool pool;
+		pool.Run(numsectors, [&](int sector)
+		{
+			builder.FlowSector(sector, &pvs[sector * builder.RowBytes]);
+		});
+	}
+
+	// Each row is conservative on its own and sight goes both ways,
+	// so a pair can be culled if either of its sectors rules it out.
+	for (unsigned i = 0; i < numsectors; i++)
+	{
+		for (unsigned j = i + 1; j < numsectors; j++)
+		{
+			uint8_t *a = &pvs[i * builder.RowBytes + (j >> 3)];
+			uint8_t *b = &pvs[j * builder.RowBytes + (i >> 3)];
+			if (!(*a & (1 << (j & 7))) || !(*b & (1 << (i & 7))))
+			{
+				*a &= ~(1 << (j & 7));
+				*b &= ~(1 << (i & 7));
+			}
+		}
+	}
+
+	// The sight check indexes the matrix like the reject, so repack the rows without padding.
+	memset(sectorpvs.Data(), 0, sectorpvs.Size());
+	for (unsigned i = 0; i < numsectors; i++)
+	{
+		for (unsigned j = 0; j < numsectors; j++)
+		{
+			if (pvs[i * builder.RowBytes + (j >> 3)] & (1 << (j & 7)))
+			{
+				unsigned pnum = i * numsectors + j;
+				sectorpvs[pnum >> 3] |= 1 << (pnum & 7);
+			}
+		}
+	}
+
+	DPrintf(DMSG_NOTIFY, "Sector PVS built in %.3f sec\n", (I_msTime() - starttime) * 0.001);
+	WritePVSCache(GetPVSCacheName(digest, true), numsectors, sectorpvs);
+}
@@ -33,6 +33,7 @@
 #include "b_bot.h"
 #include "p_spec.h"
 #include "vm.h"
+#include "c_cvars.h"
 
 #include "g_levellocals.h"
 #include "actorinlines.h"
@@ -52,9 +53,81 @@ This uses specialized forms of the maputils routines for optimized performance
 
 // Performance meters
 static int sightcounts[6];
-static cycle_t SightCycles;
+static int sightchecks, sightpvsrejects, sightmemolookups, sightmemohits;
+cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
+// Changes playsim results if a script alters sight blocking state the memo does not
+// track, so it is a server setting that is off by default.
+CVAR(Bool, sight_memo, false, CVAR_SERVERINFO)
+
+//==========================================================================
+//
+// Per-tic memo of traced sight checks
+//
+// Monsters look for the same few players every tic, so the result of the
+// trace is remembered until the tic ends or a sector plane or polyobject
+// moves, a special is executed, line blocking is changed by ACS or the 3D
+// floors of a sector are recalculated. Line flags written directly by
+// ZScript are not caught, which is why this is opt-in. Only the trace itself is memoized: everything before it is cheap
+// and may depend on state that is not part of the key, like the target's
+// visibility or the random chance of seeing an invisible target.
+//
+// The trace only depends on the positions and heights of both actors and
+// on the flags, so an entry that matches all of them gives the same result
+// as tracing again, even if one of the actors is not the same object anymore.
+//
+//==========================================================================
+
+struct FSightMemo
+{
+	AActor *t1, *t2;
+	DVector3 pos1, pos2;
+	double height1, height2;
+	int flags;
+	uint32_t generation;
+	bool result;
+};
+
+static const unsigned SIGHT_MEMO_SIZE = 1024;	// must be a power of 2
+static FSightMemo sightmemo[SIGHT_MEMO_SIZE];
+static uint32_t sightmemogen = 1;
+static FLevelLocals *sightmemolevel;
+static int sightmemotime;
+static uint32_t sightmemogeometry;
+
+static void ClearSightMemo()
+{
+	if (++sightmemogen == 0)
+	{
+		// The generation wrapped around so old entries might look valid again.
+		for (auto &memo : sightmemo) memo.generation = 0;
+		sightmemogen = 1;
+	}
+}
+
+static FSightMemo *GetSightMemo(AActor *t1, AActor *t2, int flags)
+{
+	FLevelLocals *Level = t1->Level;
+	if (Level != sightmemolevel || Level->maptime != sightmemotime || Level->SightGeometry != sightmemogeometry)
+	{
+		ClearSightMemo();
+		sightmemolevel = Level;
+		sightmemotime = Level->maptime;
+		sightmemogeometry = Level->SightGeometry;
+	}
+	size_t hash = (size_t)t1 * 31 + (size_t)t2;
+	hash ^= hash >> 15;
+	hash = (hash ^ flags) * 0x9e3779b1;
+	return &sightmemo[(hash >> 8) & (SIGHT_MEMO_SIZE - 1)];
+}
+
+static bool MatchSightMemo(const FSightMemo *memo, AActor *t1, AActor *t2, int flags)
+{
+	return memo->generation == sightmemogen && memo->t1 == t1 && memo->t2 == t2 && memo->flags == flags &&
+		memo->pos1 == t1->Pos() && memo->pos2 == t2->Pos() && memo->height1 == t1->Height && memo->height2 == t2->Height;
+}
+
 enum
 {
 	SO_TOPFRONT = 1,
@@ -87,12 +160,15 @@ struct SightTask
 };
 
 
-static TArray<intercept_t> intercepts (128);
-static TArray<SightTask> portals(32);
+static TArray<intercept_t> sightintercepts (128);
+static TArray<SightTask> sightportals(32);
 
 class SightCheck
 {
 	FLevelLocals *Level;
+	FSpatialQueryContext *Context;
+	TArray<intercept_t> &intercepts;
+	TArray<SightTask> &portals;
 	DVector3 sightstart;
 	DVector2 sightend;
 	double Startfrac;
@@ -116,10 +192,18 @@ class SightCheck
 	bool P_SightTraverseIntercepts ();
 	bool LineBlocksSight(line_t *ld);
 
+	// The counters for the sight stat are only kept for checks on the game thread.
+	void Count(int counter)
+	{
+		if (Context == nullptr) sightcounts[counter]++;
+	}
+
 public:
-	SightCheck(FLevelLocals *l)
+	SightCheck(FLevelLocals *l, FSpatialQueryContext *context, TArray<SightTask> &portallist)
+		: intercepts(context != nullptr ? context->Intercepts : sightintercepts), portals(portallist)
 	{
 		Level = l;
+		Context = context;
 	}
 
 	bool P_SightPathTraverse ();
@@ -434,11 +518,15 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	if (Context != nullptr)
 	{
-		return true;
+		if (!Context->VisitLine(ld)) return true;
+	}
+	else
+	{
+		if (ld->validcount == validcount) return true;
+		ld->validcount = validcount;
 	}
-	ld->validcount = validcount;
 	if (P_PointOnDivlineSide (ld->v1->fPos(), &Trace) ==
 		P_PointOnDivlineSide (ld->v2->fPos(), &Trace))
 	{
@@ -456,7 +544,7 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		if (LineBlocksSight(ld)) return false;
 	}
 
-	sightcounts[3]++;
+	Count(3);
 	// store the line for later intersection testing
 	intercept_t newintercept;
 	newintercept.isaline = true;
@@ -495,9 +583,18 @@ int SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			bool visit;
+			if (Context != nullptr)
 			{
+				visit = Context->VisitPolyobj(polyLink->polyobj);
+			}
+			else
+			{
+				visit = polyLink->polyobj->validcount != validcount;
 				polyLink->polyobj->validcount = validcount;
+			}
+			if (visit)
+			{
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine(polyLink->polyobj->Linedefs[i]))
@@ -627,7 +724,8 @@ bool SightCheck::P_SightPathTraverse ()
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
+	if (Context != nullptr) Context->NewQuery();
+	else validcount++;
 	intercepts.Clear ();
 	x1 = sightstart.X + Startfrac * Trace.dx;
 	y1 = sightstart.Y + Startfrac * Trace.dy;
@@ -760,7 +858,7 @@ bool SightCheck::P_SightPathTraverse ()
 		itres = P_SightBlockLinesIterator(mapx, mapy);
 		if (itres == 0)
 		{
-			sightcounts[1]++;
+			Count(1);
 			return false;	// early out
 		}
 
@@ -771,7 +869,7 @@ bool SightCheck::P_SightPathTraverse ()
 		switch (((xs_FloorToInt(yintercept) == mapy) << 1) | (xs_FloorToInt(xintercept) == mapx))
 		{
 		case 0:		// neither xintercept nor yintercept match!
-sightcounts[5]++;
+Count(5);
 			// Continuing won't make things any better, so we might as well stop right here
 			return false;
 
@@ -790,7 +888,7 @@ sightcounts[5]++;
 			break;
 
 		case 3:		// xintercept and yintercept both match
-			sightcounts[4]++;
+			Count(4);
 			// The trace is exiting a block through its corner. Not only does the block
 			// being entered need to be checked (which will happen when this loop
 			// continues), but the other two blocks adjacent to the corner also need to
@@ -798,7 +896,7 @@ sightcounts[5]++;
 			if (!P_SightBlockLinesIterator (mapx + mapxstep, mapy) ||
 				!P_SightBlockLinesIterator (mapx, mapy + mapystep))
 			{
-sightcounts[1]++;
+Count(1);
 				return false;
 			}
 			xintercept += xstep;
@@ -817,7 +915,7 @@ sightcounts[1]++;
 //
 // couldn't early out, so go through the sorted list
 //
-sightcounts[2]++;
+Count(2);
 
 	bool traverseres = P_SightTraverseIntercepts ( );
 	if (itres == -1) return false;	// if the iterator had an early out there was no line of sight. The traverser was only called to collect more portals.
@@ -835,14 +933,18 @@ sightcounts[2]++;
 =
 = killough 4/20/98: cleaned up, made to use new LOS struct
 =
+= With a query context, the check does not write any global or map data
+= and can run on any thread. Such checks skip the random chance of seeing
+= an invisible target, and the sight stat.
+=
 =====================
 */
 
-int P_CheckSight (AActor *t1, AActor *t2, int flags)
+static int CheckSight (AActor *t1, AActor *t2, int flags, FSpatialQueryContext *context)
 {
-	SightCycles.Clock();
-
 	bool res;
+	TArray<SightTask> localportals;
+	TArray<SightTask> &portals = context != nullptr ? localportals : sightportals;
 
 	if (t1 == nullptr || t2 == nullptr)
 	{
@@ -854,14 +956,21 @@ int P_CheckSight (AActor *t1, AActor *t2, int flags)
 		return false;
 	}
 
+	if (context == nullptr)
+	{
+		SightCycles.Clock();
+		sightchecks++;
+	}
+
 	auto s1 = t1->Sector;
 	auto s2 = t2->Sector;
+	FSightMemo *memo = nullptr;
 	//
 	// check for trivial rejection
 	//
 	if (!t1->Level->CheckReject(s1, s2))
 	{
-sightcounts[0]++;
+		if (context == nullptr) sightcounts[0]++;
 		res = false;			// can't possibly be connected
 		goto done;
 	}
@@ -876,13 +985,26 @@ sightcounts[0]++;
 		(t2->flags8 & MF8_MINVISIBLE) ||
 		!t2->RenderStyle.IsVisible(t2->Alpha)))
 	{ // small chance of an attack being made anyway
-		if ((t1->Level->BotInfo.m_Thinking ? pr_botchecksight() : pr_checksight()) > 50)
+		if (context != nullptr || (t1->Level->BotInfo.m_Thinking ? pr_botchecksight() : pr_checksight()) > 50)
 		{
 			res = false;
 			goto done;
 		}
 	}
 
+	// The sector PVS is only checked after the random roll above,
+	// so that it does not change how often the playsim RNG is called.
+	if (!t1->Level->CheckSectorPVS(s1, s2))
+	{
+		if (context == nullptr)
+		{
+			sightcounts[0]++;
+			sightpvsrejects++;
+		}
+		res = false;
+		goto done;
+	}
+
 	// killough 4/19/98: make fake floors and ceilings block monster view
 
 	if (!(flags & SF_IGNOREWATERBOUNDARY))
@@ -907,7 +1029,20 @@ sightcounts[0]++;
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 
-	validcount++;
+	if (context == nullptr && sight_memo)
+	{
+		sightmemolookups++;
+		memo = GetSightMemo(t1, t2, flags);
+		if (MatchSightMemo(memo, t1, t2, flags))
+		{
+			sightmemohits++;
+			res = memo->result;
+			goto done;
+		}
+	}
+
+	if (context != nullptr) context->NewQuery();
+	else validcount++;
 	portals.Clear();
 	{
 		sector_t *sec;
@@ -919,7 +1054,7 @@ sightcounts[0]++;
 		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
 
 
-		SightCheck s(t1->Level);
+		SightCheck s(t1->Level, context, portals);
 		s.init(t1, t2, sec, &task, flags);
 		res = s.P_SightPathTraverse ();
 		if (!res)
@@ -938,17 +1073,36 @@ sightcounts[0]++;
 		}
 	}
 
+	if (memo != nullptr)
+	{
+		*memo = { t1, t2, t1->Pos(), t2->Pos(), t1->Height, t2->Height, flags, sightmemogen, res };
+	}
+
 done:
-	SightCycles.Unclock();
+	if (context == nullptr) SightCycles.Unclock();
 	return res;
 }
 
+int P_CheckSight (AActor *t1, AActor *t2, int flags)
+{
+	return CheckSight(t1, t2, flags, nullptr);
+}
+
+int P_CheckSight (FSpatialQueryContext &context, AActor *t1, AActor *t2, int flags)
+{
+	assert(t1 == nullptr || t1->Level == context.Level);
+	return CheckSight(t1, t2, flags, &context);
+}
+
 ADD_STAT (sight)
 {
 	FString out;
 	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
 		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+	out.AppendFormat("%5d checks, %4.1f%% rejected (%4.1f%% by pvs), memo %4.1f%% of %d hit",
+		sightchecks, sightchecks ? sightcounts[0] * 100. / sightchecks : 0., sightchecks ? sightpvsrejects * 100. / sightchecks : 0.,
+		sightmemolookups ? sightmemohits * 100. / sightmemolookups : 0., sightmemolookups);
 	return out;
 }
 
@@ -957,6 +1111,8 @@ void P_ResetSightCounters (bool full)
 	if (full)
 	{
 		MaxSightCycles.Reset();
+		ClearSightMemo();
+		sightmemolevel = nullptr;
 	}
 	if (SightCycles.Time() > MaxSightCycles.Time())
 	{
@@ -964,4 +1120,5 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	sightchecks = sightpvsrejects = sightmemolookups = sightmemohits = 0;
 }
@@ -0,0 +1,199 @@
+/*
+** p_soundgraph.cpp
+**
+** Sector adjacency used to flood noise through the map
+**
+** P_NoiseAlert visits the lines of every sector the noise reaches and
+** checks each for a closed door. Most of that only depends on the map
+** layout, so the two-sided lines of each sector are collected once. The
+** closed door check of a line is kept until a plane of one of its sectors
+** changes, and sector portals are only looked through again if the portal
+** changes.
+**
+** None of this changes which sectors the noise reaches.
+**
+*/
+
+#include "p_soundgraph.h"
+#include "g_levellocals.h"
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSoundGraph::Clear()
+{
+	Level = nullptr;
+	Nodes.Reset();
+	Edges.Reset();
+	PortalLines.Reset();
+	PolyLines.Reset();
+	Flood = 0;
+}
+
+//==========================================================================
+//
+// Must not run before the polyobjects and line portals have been set up.
+//
+//==========================================================================
+
+void FSoundGraph::Build(FLevelLocals *level)
+{
+	Clear();
+	Level = level;
+	Nodes.Resize(Level->sectors.Size());
+
+	for (auto &sec : Level->sectors)
+	{
+		auto &node = Nodes[sec.Index()];
+		node.FirstEdge = Edges.Size();
+		node.FirstPortalLine = PortalLines.Size();
+		node.NumPortalLines = 0;
+		node.FirstPolyLine = PolyLines.Size();
+		node.NumPolyLines = 0;
+		node.Planes[sector_t::floor] = sec.floorplane;
+		node.Planes[sector_t::ceiling] = sec.ceilingplane;
+		node.PlaneStamp = 1;
+		node.CheckedFlood = 0;
+		for (auto &through : node.Through)
+		{
+			through.Portal = UINT_MAX;
+			through.Displacement.Zero();
+		}
+
+		for (auto check : sec.Lines)
+		{
+			if (check->sidedef[0]->Flags & WALLF_POLYOBJ)
+			{
+				PolyLines.Push(check);
+			}
+			if (check->getPortal() != nullptr)
+			{
+				PortalLines.Push(check);
+			}
+
+			// The two-sided flag is left to the flood because ACS can change it.
+			if (check->sidedef[1] == nullptr || check->sidedef[0]->sector == check->sidedef[1]->sector)
+			{
+				continue;
+			}
+
+			FSoundEdge &edge = Edges[Edges.Reserve(1)];
+			edge.Line = check;
+			edge.Other = check->sidedef[0]->sector == &sec ? check->sidedef[1]->sector : check->sidedef[0]->sector;
+			edge.Stamps[0] = edge.Stamps[1] = 0;
+			edge.Closed = false;
+			edge.Moves = !!(check->sidedef[0]->Flags & WALLF_POLYOBJ);
+		}
+		node.NumEdges = Edges.Size() - node.FirstEdge;
+		node.NumPortalLines = PortalLines.Size() - node.FirstPortalLine;
+		node.NumPolyLines = PolyLines.Size() - node.FirstPolyLine;
+	}
+}
+
+//==========================================================================
+//
+// Planes cannot change during a flood so each sector is only checked once.
+//
+//==========================================================================
+
+void FSoundGraph::BeginFlood()
+{
+	if (++Flood == 0)
+	{
+		for (auto &node : Nodes) node.CheckedFlood = 0;
+		Flood = 1;
+	}
+}
+
+static bool SamePlane(const secplane_t &a, const secplane_t &b)
+{
+	return a.Normal() == b.Normal() && a.fD() == b.fD();
+}
+
+void FSoundGraph::CheckPlanes(FSoundNode &node, sector_t *sec)
+{
+	if (node.CheckedFlood == Flood)
+	{
+		return;
+	}
+	node.CheckedFlood = Flood;
+
+	if (!SamePlane(node.Planes[sector_t::floor], sec->floorplane) || !SamePlane(node.Planes[sector_t::ceiling], sec->ceilingplane))
+	{
+		node.Planes[sector_t::floor] = sec->floorplane;
+		node.Planes[sector_t::ceiling] = sec->ceilingplane;
+		node.PlaneStamp++;
+	}
+}
+
+//==========================================================================
+//
+// Checks for a closed door, as seen from sec. Sloped planes make this
+// depend on where the line is, so it is not kept for polyobject lines.
+//
+//==========================================================================
+
+bool FSoundGraph::IsClosed(sector_t *sec, FSoundEdge &edge)
+{
+	auto &node = Nodes[sec->Index()];
+	auto &othernode = Nodes[edge.Other->Index()];
+	CheckPlanes(node, sec);
+	CheckPlanes(othernode, edge.Other);
+
+	if (edge.Moves || edge.Stamps[0] != node.PlaneStamp || edge.Stamps[1] != othernode.PlaneStamp)
+	{
+		edge.Stamps[0] = node.PlaneStamp;
+		edge.Stamps[1] = othernode.PlaneStamp;
+
+		sector_t *other = edge.Other;
+		line_t *check = edge.Line;
+		edge.Closed = (sec->floorplane.ZatPoint(check->v1->fPos()) >=
+			other->ceilingplane.ZatPoint(check->v1->fPos()) &&
+			sec->floorplane.ZatPoint(check->v2->fPos()) >=
+			other->ceilingplane.ZatPoint(check->v2->fPos()))
+			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
+				sec->ceilingplane.ZatPoint(check->v1->fPos()) &&
+				other->floorplane.ZatPoint(check->v2->fPos()) >=
+				sec->ceilingplane.ZatPoint(check->v2->fPos()))
+			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
+				other->ceilingplane.ZatPoint(check->v1->fPos()) &&
+				other->floorplane.ZatPoint(check->v2->fPos()) >=
+				other->ceilingplane.ZatPoint(check->v2->fPos()));
+	}
+	return edge.Closed;
+}
+
+//==========================================================================
+//
+// Sectors on the other side of a sector portal, without the ones seen
+// from polyobject lines.
+//
+//==========================================================================
+
+const TArray<sector_t *> &FSoundGraph::GetPortalSectors(sector_t *sec, int plane)
+{
+	auto &through = Nodes[sec->Index()].Through[plane];
+	unsigned portal = sec->Portals[plane];
+	DVector2 displacement = sec->GetPortalDisplacement(plane);
+
+	if (through.Portal != portal || through.Displacement != displacement)
+	{
+		through.Portal = portal;
+		through.Displacement = displacement;
+		through.Sectors.Clear();
+		for (auto check : sec->Lines)
+		{
+			if (check->sidedef[0]->Flags & WALLF_POLYOBJ) continue;
+
+			sector_t *other = Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + displacement);
+			if (through.Sectors.Find(other) == through.Sectors.Size())
+			{
+				through.Sectors.Push(other);
+			}
+		}
+	}
+	return through.Sectors;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "tarray.h"
+#include "r_defs.h"
+
+struct FLevelLocals;
+
+// Sector adjacency for P_NoiseAlert. Built on the first alert of a level.
+// The graph only contains what cannot change while the map runs. Line flags
+// are still read from the lines, and whether a line is closed is cached per
+// direction until the planes of one of its sectors change.
+
+struct FSoundEdge
+{
+	line_t *Line;
+	sector_t *Other;
+	uint32_t Stamps[2];				// plane stamps of both sectors when Closed was last set
+	bool Closed;
+	bool Moves;						// belongs to a polyobject
+};
+
+struct FSoundPortalSectors
+{
+	unsigned Portal;				// sector portal the list was made for
+	DVector2 Displacement;
+	TArray<sector_t *> Sectors;		// distinct sectors behind the portal at the midpoints of the lines that cannot move
+};
+
+struct FSoundNode
+{
+	unsigned FirstEdge, NumEdges;
+	unsigned FirstPortalLine, NumPortalLines;
+	unsigned FirstPolyLine, NumPolyLines;
+	secplane_t Planes[2];			// planes the current stamp belongs to
+	uint32_t PlaneStamp;
+	uint32_t CheckedFlood;			// planes have been compared during this flood
+	FSoundPortalSectors Through[2];
+};
+
+class FSoundGraph
+{
+	FLevelLocals *Level = nullptr;
+	TArray<FSoundNode> Nodes;
+	TArray<FSoundEdge> Edges;
+	TArray<line_t *> PortalLines;
+	TArray<line_t *> PolyLines;
+	uint32_t Flood = 0;
+
+	void CheckPlanes(FSoundNode &node, sector_t *sec);
+
+public:
+	void Build(FLevelLocals *Level);
+	void Clear();
+
+	bool IsBuilt() const
+	{
+		return Level != nullptr;
+	}
+
+	void BeginFlood();
+	bool IsClosed(sector_t *sec, FSoundEdge &edge);
+	const TArray<sector_t *> &GetPortalSectors(sector_t *sec, int plane);
+
+	TArrayView<FSoundEdge> GetEdges(sector_t *sec)
+	{
+		auto &node = Nodes[sec->Index()];
+		return TArrayView<FSoundEdge>(Edges.Data() + node.FirstEdge, node.NumEdges);
+	}
+
+	// Lines with a line portal. Where the portals lead can still be changed by ACS.
+	TArrayView<line_t *> GetPortalLines(sector_t *sec)
+	{
+		auto &node = Nodes[sec->Index()];
+		return TArrayView<line_t *>(PortalLines.Data() + node.FirstPortalLine, node.NumPortalLines);
+	}
+
+	// Polyobject lines move, so looking through a sector portal at them cannot be cached.
+	TArrayView<line_t *> GetPolyLines(sector_t *sec)
+	{
+		auto &node = Nodes[sec->Index()];
+		return TArrayView<line_t *>(PolyLines.Data() + node.FirstPolyLine, node.NumPolyLines);
+	}
+};
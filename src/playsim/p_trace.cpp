@@ -51,6 +51,7 @@
 struct FTraceInfo
 {
 	FLevelLocals *Level;
+	FSpatialQueryContext *Context;
 	DVector3 Start;
 	DVector3 Vec;
 	ActorFlags ActorMask;
@@ -149,7 +150,7 @@ static bool isLiquid(F3DFloor *ff)
 //
 //==========================================================================
 
-bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+static bool Trace(FSpatialQueryContext *context, const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
 	ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
 	ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
 {
@@ -160,6 +161,7 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	tempResult.Fraction = tempResult.Distance = NO_VALUE;
 
 	inf.Level = sector->Level;
+	inf.Context = context;
 	inf.Start = start;
 	GetPortalTransition(inf.Start, sector);
 	inf.ptflags = actorMask ? PT_ADDLINES|PT_ADDTHINGS|PT_COMPATIBLE : PT_ADDLINES;
@@ -207,6 +209,21 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	}
 }
 
+bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+	ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
+	ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
+{
+	return Trace(nullptr, start, sector, direction, maxDist, actorMask, wallMask, ignore, res, flags, callback, callbackdata);
+}
+
+bool Trace(FSpatialQueryContext &context, const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+	ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
+	ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
+{
+	assert(sector->Level == context.Level);
+	return Trace(&context, start, sector, direction, maxDist, actorMask, wallMask, ignore, res, flags, callback, callbackdata);
+}
+
 
 //============================================================================
 //
@@ -789,7 +806,9 @@ bool FTraceInfo::TraceTraverse (int ptflags)
 	// Do a 3D floor check in the starting sector
 	Setup3DFloors();
 
-	FPathTraverse it(Level, Start.X, Start.Y, Vec.X * MaxDist, Vec.Y * MaxDist, ptflags | PT_DELTA, startfrac);
+	FPathTraverse it = Context != nullptr ?
+		FPathTraverse(*Context, Start.X, Start.Y, Vec.X * MaxDist, Vec.Y * MaxDist, ptflags | PT_DELTA, startfrac) :
+		FPathTraverse(Level, Start.X, Start.Y, Vec.X * MaxDist, Vec.Y * MaxDist, ptflags | PT_DELTA, startfrac);
 	intercept_t *in;
 	int lastsplashsector = -1;
 
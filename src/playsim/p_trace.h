@@ -43,6 +43,7 @@ struct sector_t;
 struct line_t;
 class AActor;
 struct F3DFloor;
+class FSpatialQueryContext;
 
 enum ETraceResult
 {
@@ -116,6 +117,12 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	ActorFlags ActorMask, uint32_t WallMask, AActor *ignore, FTraceResults &res, uint32_t traceFlags = 0,
 	ETraceStatus(*callback)(FTraceResults &res, void *) = NULL, void *callbackdata = NULL);
 
+// Same as above, but without touching any global or map data, so that traces can run on several
+// threads at once, each with its own context. The callback must be thread safe as well.
+bool Trace(FSpatialQueryContext &context, const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+	ActorFlags ActorMask, uint32_t WallMask, AActor *ignore, FTraceResults &res, uint32_t traceFlags = 0,
+	ETraceStatus(*callback)(FTraceResults &res, void *) = NULL, void *callbackdata = NULL);
+
 // [ZZ] this is the object that's used for ZScript
 class DLineTracer : public DObject
 {
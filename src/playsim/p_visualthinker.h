@@ -67,6 +67,9 @@ public:
 	float InterpolatedRoll(double ticFrac) const;
 
 	void Tick() override;
+	bool CanTickConcurrently() override;
+	void TickConcurrent() override;
+	void CommitTick() override;
 	void UpdateSpriteInfo();
 	void UpdateSector();
 	void Serialize(FSerializer& arc) override;
@@ -887,6 +887,7 @@ bool FPolyObj::MovePolyobj (const DVector2 &pos, bool force)
 	LinkPolyobj ();
 	ClearSubsectorLinks();
 	RecalcActorFloorCeil(Bounds | oldbounds);
+	Level->SightGeometry++;
 	return true;
 }
 
@@ -981,6 +982,7 @@ bool FPolyObj::RotatePolyobj (DAngle angle, bool fromsave)
 	LinkPolyobj();
 	ClearSubsectorLinks();
 	RecalcActorFloorCeil(Bounds | oldbounds);
+	Level->SightGeometry++;
 	return true;
 }
 
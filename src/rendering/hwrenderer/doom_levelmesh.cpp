@@ -21,6 +21,7 @@
 
 #include "vm.h"
 #include "p_setup.h"
+#include "threadpool.h"
 
 static void UpdateLightmapTiles();
 static int InvalidateLightmap();
@@ -151,7 +152,14 @@ ADD_STAT(levelmesh)
 	auto& stats = level.levelMesh->LastFrameStats;
 	FString out;
 	if (level.levelMesh)
+	{
 		out.Format("Sides=%d, flats=%d, portals=%d, dynlights=%d", stats.SidesUpdated, stats.FlatsUpdated, stats.Portals, stats.DynLights);
+		if (stats.GenerateThreads > 0)
+		{
+			out.AppendFormat("\nSurface generation: %2.3f ms, %2.3f ms of work on %d threads (%.2fx)", stats.GenerateTime, stats.GenerateWorkTime, stats.GenerateThreads,
+				stats.GenerateTime > 0.0 ? stats.GenerateWorkTime / stats.GenerateTime : 1.0);
+		}
+	}
 	else
 		out = "No level mesh";
 	return out;
@@ -250,6 +258,18 @@ EXTERN_CVAR(Float, lm_scale);
 
 CVAR(Bool, lm_models, true, CVAR_NOSAVE); // CVar-gated for debugging convenience
 
+// Generate side and flat geometry on worker threads when at least this many need a full update
+CVAR(Bool, lm_parallelupdate, true, CVAR_ARCHIVE)
+CVAR(Int, lm_parallelminupdates, 8, CVAR_ARCHIVE)
+
+static FThreadPool* GetSurfaceThreadPool()
+{
+	if (!lm_parallelupdate)
+		return nullptr;
+	FThreadPool* pool = GetSharedThreadPool();
+	return pool->GetThreadCount() > 1 ? pool : nullptr;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 DoomLevelMesh::DoomLevelMesh(FLevelLocals& doomMap)
@@ -719,6 +739,21 @@ void DoomLevelMesh::BeginFrame(FLevelLocals& doomMap)
 		}
 	}
 
+	// Generate the geometry for all full updates up front so that it can be spread over multiple threads
+	TArray<int> fullSides, fullFlats;
+	for (int sideIndex : SideUpdateList)
+	{
+		if (Sides[sideIndex].UpdateType == SurfaceUpdateType::Full)
+			fullSides.Push(sideIndex);
+	}
+	for (int flatIndex : FlatUpdateList)
+	{
+		if (Flats[flatIndex].UpdateType == SurfaceUpdateType::Full)
+			fullFlats.Push(flatIndex);
+	}
+	GenerateSurfaces(doomMap, fullSides, fullFlats);
+
+	unsigned int pendingIndex = 0;
 	for (int sideIndex : SideUpdateList)
 	{
 		if (Sides[sideIndex].UpdateType == SurfaceUpdateType::LightLevel)
@@ -735,12 +770,14 @@ void DoomLevelMesh::BeginFrame(FLevelLocals& doomMap)
 		}
 		else // SurfaceUpdateType::Full
 		{
-			CreateSide(doomMap, sideIndex);
+			CommitSide(doomMap, sideIndex, PendingSides[pendingIndex++]);
 		}
 		Sides[sideIndex].UpdateType = SurfaceUpdateType::None;
 	}
 	SideUpdateList.Clear();
 
+	pendingIndex = 0;
+
 	for (int flatIndex : FlatUpdateList)
 	{
 		if (Flats[flatIndex].UpdateType == SurfaceUpdateType::LightLevel)
@@ -757,9 +794,11 @@ void DoomLevelMesh::BeginFrame(FLevelLocals& doomMap)
 		}
 		else // SurfaceUpdateType::Full
 		{
-			CreateFlat(doomMap, flatIndex);
+			CommitFlat(doomMap, flatIndex, PendingFlats[pendingIndex++]);
 		}
 	}
+	PendingSides.Clear();
+	PendingFlats.Clear();
 
 	PackLightmapAtlas();
 
@@ -919,6 +958,7 @@ void DoomLevelMesh::CreateSurfaces(FLevelLocals& doomMap)
 		i = -1;
 
 	// Create surface objects for all sides
+	TArray<int> sides, flats;
 	for (unsigned int i = 0; i < doomMap.sides.Size(); i++)
 	{
 		side_t* side = &doomMap.sides[i];
@@ -929,7 +969,7 @@ void DoomLevelMesh::CreateSurfaces(FLevelLocals& doomMap)
 			continue;
 		}
 
-		CreateSide(doomMap, i);
+		sides.Push(i);
 	}
 
 	// Create surfaces for all flats
@@ -938,8 +978,148 @@ void DoomLevelMesh::CreateSurfaces(FLevelLocals& doomMap)
 		sector_t* sector = &doomMap.sectors[i];
 		if (sector->subsectorcount == 0 || sector->subsectors[0]->flags & SSECF_POLYORG)
 			continue;
-		CreateFlat(doomMap, i);
+		flats.Push(i);
 	}
+
+	GenerateSurfaces(doomMap, sides, flats);
+	for (unsigned int i = 0; i < sides.Size(); i++)
+		CommitSide(doomMap, sides[i], PendingSides[i]);
+	for (unsigned int i = 0; i < flats.Size(); i++)
+		CommitFlat(doomMap, flats[i], PendingFlats[i]);
+	PendingSides.Clear();
+	PendingFlats.Clear();
+}
+
+//==========================================================================
+//
+// Runs the part of a full side or flat update that does not touch the level
+// mesh. The results are committed serially afterwards, in list order, so the
+// allocations come out the same no matter how many threads did the work.
+//
+//==========================================================================
+
+static void PrepareTexture(FTextureID texnum)
+{
+	if (!texnum.isValid())
+		return;
+
+	// Same texture and scale flags as HWWall and HWFlat pass to SetMaterial
+	FGameTexture* tex = TexMan.GetGameTexture(texnum, true);
+	if (!tex || !tex->isValid())
+		return;
+
+	tex->setSeen();
+	tex->GetTranslucency();
+	FMaterial::ValidateTexture(tex, shouldUpscale(tex, UF_Texture) ? CTF_Upscale : 0);
+}
+
+static void PrepareSectorTextures(sector_t* sector)
+{
+	if (!sector)
+		return;
+
+	PrepareTexture(sector->GetTexture(sector_t::floor));
+	PrepareTexture(sector->GetTexture(sector_t::ceiling));
+	if (sector->GetHeightSec())
+	{
+		PrepareTexture(sector->heightsec->GetTexture(sector_t::floor));
+		PrepareTexture(sector->heightsec->GetTexture(sector_t::ceiling));
+	}
+	for (F3DFloor* rover : sector->e->XFloor.ffloors)
+	{
+		if (rover->top.texture) PrepareTexture(*rover->top.texture);
+		if (rover->bottom.texture) PrepareTexture(*rover->bottom.texture);
+		if (rover->master && rover->master->sidedef[0])
+		{
+			for (int i = 0; i < 3; i++)
+				PrepareTexture(rover->master->sidedef[0]->GetTexture(i));
+		}
+	}
+}
+
+//==========================================================================
+//
+// Textures determine their translucency and create their materials on first
+// use, which goes through image caches that are not thread safe. This does
+// it on the main thread for everything the workers are about to look at, so
+// that they only read texture state.
+//
+//==========================================================================
+
+static void PrepareTextures(FLevelLocals& doomMap, const TArray<int>& sides, const TArray<int>& flats)
+{
+	for (int sideIndex : sides)
+	{
+		side_t* side = &doomMap.sides[sideIndex];
+		for (int i = 0; i < 3; i++)
+			PrepareTexture(side->GetTexture(i));
+		PrepareSectorTextures(side->linedef->frontsector);
+		PrepareSectorTextures(side->linedef->backsector);
+	}
+	for (int sectorIndex : flats)
+	{
+		PrepareSectorTextures(&doomMap.sectors[sectorIndex]);
+	}
+}
+
+void DoomLevelMesh::GenerateSurfaces(FLevelLocals& doomMap, const TArray<int>& sides, const TArray<int>& flats)
+{
+	PendingSides.Clear();
+	PendingFlats.Clear();
+	PendingSides.Resize(sides.Size());
+	PendingFlats.Resize(flats.Size());
+
+	int count = sides.Size() + flats.Size();
+	if (count == 0)
+		return;
+
+	// Hand out several chunks per thread as the cost per side or flat varies a lot
+	FThreadPool* pool = GetSurfaceThreadPool();
+	int threads = (pool && count >= lm_parallelminupdates) ? pool->GetThreadCount() : 1;
+	int chunks = min(count, threads * 4);
+
+	while ((int)WorkerBuilders.Size() < chunks)
+		WorkerBuilders.Push(std::make_unique<MeshBuilder>());
+
+	TArray<double> chunkTime(chunks, true);
+	auto generate = [&](int chunk)
+	{
+		cycle_t time;
+		time.ResetAndClock();
+
+		MeshBuilder& builder = *WorkerBuilders[chunk];
+		int start = (int)((int64_t)count * chunk / chunks);
+		int end = (int)((int64_t)count * (chunk + 1) / chunks);
+		for (int i = start; i < end; i++)
+		{
+			if (i < (int)sides.Size())
+				GenerateSide(doomMap, sides[i], builder, PendingSides[i]);
+			else
+				GenerateFlat(doomMap, flats[i - sides.Size()], builder, PendingFlats[i - sides.Size()]);
+		}
+
+		time.Unclock();
+		chunkTime[chunk] = time.TimeMS();
+	};
+
+	cycle_t totalTime;
+	totalTime.ResetAndClock();
+	if (chunks > 1)
+	{
+		PrepareTextures(doomMap, sides, flats);
+		pool->Run(chunks, generate);
+	}
+	else
+	{
+		for (int chunk = 0; chunk < chunks; chunk++)
+			generate(chunk);
+	}
+	totalTime.Unclock();
+
+	CurFrameStats.GenerateThreads = max(CurFrameStats.GenerateThreads, threads);
+	CurFrameStats.GenerateTime += totalTime.TimeMS();
+	for (double t : chunkTime)
+		CurFrameStats.GenerateWorkTime += t;
 }
 
 void DoomLevelMesh::ReleaseTiles(int surf)
@@ -1343,38 +1523,36 @@ LightListAllocInfo DoomLevelMesh::CreateLightList(FLightNode* node, int portalgr
 	return info;
 }
 
-void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
+void DoomLevelMesh::GenerateSide(FLevelLocals& doomMap, unsigned int sideIndex, MeshBuilder& state, PendingSide& pending)
 {
-	CurFrameStats.SidesUpdated++;
-
-	FreeSide(doomMap, sideIndex);
-
 	side_t* side = &doomMap.sides[sideIndex];
 	seg_t* seg = side->segs[0];
 	if (!seg) // When can this happen?
 		return;
 
-	auto& sideBlock = Sides[sideIndex];
+	const auto& sideBlock = Sides[sideIndex];
 
 	if ((side->Flags & WALLF_POLYOBJ) == WALLF_POLYOBJ && sideBlock.PolySegs.size() == 0)
 		return;
 
+	pending.Empty = false;
+
 	HWMeshHelper result;
 	HWWallDispatcher disp(&doomMap, &result, getRealLightmode(&doomMap, true));
 
 	if (side->Flags & WALLF_POLYOBJ)
 	{
-		bool lightlistCreated = false;
 		for (seg_t* polyseg : sideBlock.PolySegs)
 		{
 			// Is there really not a better way of finding the subsector a polyseg resides in?
 			subsector_t* sub = level.PointInRenderSubsector((polyseg->v1->fPos() + polyseg->v2->fPos()) * 0.5);
 			if (sub)
 			{
-				if (!lightlistCreated)
+				if (!pending.HasLightList)
 				{
-					sideBlock.Lights = CreateLightList(sub->section->lighthead, sub->sector->PortalGroup);
-					lightlistCreated = true;
+					pending.LightHead = sub->section->lighthead;
+					pending.PortalGroup = sub->sector->PortalGroup;
+					pending.HasLightList = true;
 				}
 
 				sector_t* front = sub->sector;
@@ -1388,7 +1566,9 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	}
 	else
 	{
-		sideBlock.Lights = CreateLightList(side->lighthead, side->sector->PortalGroup);
+		pending.LightHead = side->lighthead;
+		pending.PortalGroup = side->sector->PortalGroup;
+		pending.HasLightList = true;
 
 		subsector_t* sub = seg->Subsector;
 		sector_t* front = side->sector;
@@ -1400,7 +1580,7 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	}
 
 	// Grab the decals generated
-	sideBlock.Decals = result.decals;
+	pending.Decals = result.decals;
 
 	state.SetDepthMask(true);
 	state.EnableFog(true);
@@ -1412,15 +1592,15 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	state.EnableTexture(true);
 	state.EnableBrightmap(true);
 	state.AlphaFunc(Alpha_GEqual, 0.f);
-	CreateWallSurface(side, disp, state, result.opaque, LevelMeshDrawType::Opaque, sideIndex, sideBlock.Lights);
+	GenerateWallSurface(disp, state, result.opaque, LevelMeshDrawType::Opaque, pending.Surfaces);
 
 	// Part 2: masked geometry. This is set up so that only pixels with alpha>gl_mask_threshold will show
 	state.AlphaFunc(Alpha_GEqual, gl_mask_threshold);
-	CreateWallSurface(side, disp, state, result.masked, LevelMeshDrawType::Masked, sideIndex, sideBlock.Lights);
+	GenerateWallSurface(disp, state, result.masked, LevelMeshDrawType::Masked, pending.Surfaces);
 
 	// Part 3: masked geometry with polygon offset.
 	state.SetDepthBias(-1, -128);
-	CreateWallSurface(side, disp, state, result.maskedOffset, LevelMeshDrawType::MaskedOffset, sideIndex, sideBlock.Lights);
+	GenerateWallSurface(disp, state, result.maskedOffset, LevelMeshDrawType::MaskedOffset, pending.Surfaces);
 	state.ClearDepthBias();
 
 	// These things aren't working properly with the level mesh.
@@ -1438,12 +1618,12 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	if (result.translucent.size() != 0 || result.translucentBorder.size() != 0 || incompatible)
 	{
 		// For things that HWWall doesn't do correctly when drawn into the level mesh for one reason or another.
-		sideBlock.NeedsImmediateRendering = true;
+		pending.NeedsImmediateRendering = true;
 	}
 	else
 	{
 		for (const HWWall& portal : result.portals)
-			sideBlock.WallPortals.Push(portal);
+			pending.WallPortals.Push(portal);
 	}
 
 	/*
@@ -1451,9 +1631,9 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	state.AlphaFunc(Alpha_GEqual, gl_mask_sprite_threshold);
 	state.SetRenderStyle(STYLE_Translucent);
 	state.EnableBrightmap(true);
-	CreateWallSurface(side, disp, state, result.translucent, LevelMeshDrawType::TranslucentBorder, sideIndex);
+	GenerateWallSurface(disp, state, result.translucent, LevelMeshDrawType::TranslucentBorder, pending.Surfaces);
 	state.SetDepthMask(false);
-	CreateWallSurface(side, disp, state, result.translucent, LevelMeshDrawType::Translucent, sideIndex);
+	GenerateWallSurface(disp, state, result.translucent, LevelMeshDrawType::Translucent, pending.Surfaces);
 	state.EnableBrightmap(false);
 	state.AlphaFunc(Alpha_GEqual, 0.f);
 	state.SetDepthMask(true);
@@ -1461,28 +1641,46 @@ void DoomLevelMesh::CreateSide(FLevelLocals& doomMap, unsigned int sideIndex)
 	*/
 
 	for (const HWMissing& missing : result.upper)
-		sideBlock.MissingUpper.Push(missing);
+		pending.MissingUpper.Push(missing);
 
 	for (const HWMissing& missing : result.lower)
-		sideBlock.MissingLower.Push(missing);
+		pending.MissingLower.Push(missing);
 
 	// Add portal surface to the level mesh so raytraces can see them
-	CreateWallSurface(side, disp, state, result.portals, LevelMeshDrawType::Portal, sideIndex, sideBlock.Lights);
+	GenerateWallSurface(disp, state, result.portals, LevelMeshDrawType::Portal, pending.Surfaces);
 }
 
-void DoomLevelMesh::CreateFlat(FLevelLocals& doomMap, unsigned int sectorIndex)
+void DoomLevelMesh::CommitSide(FLevelLocals& doomMap, unsigned int sideIndex, PendingSide& pending)
 {
-	CurFrameStats.FlatsUpdated++;
+	CurFrameStats.SidesUpdated++;
 
-	FreeFlat(doomMap, sectorIndex);
+	FreeSide(doomMap, sideIndex);
+
+	if (pending.Empty)
+		return;
+
+	side_t* side = &doomMap.sides[sideIndex];
+	auto& sideBlock = Sides[sideIndex];
+
+	if (pending.HasLightList)
+		sideBlock.Lights = CreateLightList(pending.LightHead, pending.PortalGroup);
+
+	sideBlock.Decals = std::move(pending.Decals);
+	sideBlock.WallPortals = std::move(pending.WallPortals);
+	sideBlock.MissingUpper = std::move(pending.MissingUpper);
+	sideBlock.MissingLower = std::move(pending.MissingLower);
+	sideBlock.NeedsImmediateRendering = pending.NeedsImmediateRendering;
 
+	for (PendingWallSurface& surface : pending.Surfaces)
+		CommitWallSurface(doomMap, side, surface, sideIndex, sideBlock.Lights);
+}
+
+void DoomLevelMesh::GenerateFlat(FLevelLocals& doomMap, unsigned int sectorIndex, MeshBuilder& state, PendingFlat& pending)
+{
 	sector_t* sector = &doomMap.sectors[sectorIndex];
 	int lightlistSection = 0;
 	for (FSection& section : doomMap.sections.SectionsForSector(sectorIndex))
 	{
-		Flats[sectorIndex].Lights.Push(CreateLightList(section.lighthead, section.sector->PortalGroup));
-		const auto& lightlist = Flats[sectorIndex].Lights.Last();
-
 		HWFlatMeshHelper result;
 		HWFlatDispatcher disp(&doomMap, &result, getRealLightmode(&doomMap, true));
 
@@ -1495,22 +1693,45 @@ void DoomLevelMesh::CreateFlat(FLevelLocals& doomMap, unsigned int sectorIndex)
 		state.ClearDepthBias();
 		state.EnableTexture(true);
 		state.EnableBrightmap(true);
-		CreateFlatSurface(disp, state, result.list, LevelMeshDrawType::Opaque, false, sectorIndex, lightlist, lightlistSection);
+		GenerateFlatSurface(disp, state, result.list, LevelMeshDrawType::Opaque, false, lightlistSection, pending.Surfaces);
 
-		CreateFlatSurface(disp, state, result.portals, LevelMeshDrawType::Portal, false, sectorIndex, lightlist, lightlistSection);
+		GenerateFlatSurface(disp, state, result.portals, LevelMeshDrawType::Portal, false, lightlistSection, pending.Surfaces);
 
 		// final pass: translucent stuff
 		state.AlphaFunc(Alpha_GEqual, gl_mask_sprite_threshold);
 		state.SetRenderStyle(STYLE_Translucent);
-		CreateFlatSurface(disp, state, result.translucentborder, LevelMeshDrawType::Translucent, true, sectorIndex, lightlist, lightlistSection);
+		GenerateFlatSurface(disp, state, result.translucentborder, LevelMeshDrawType::Translucent, true, lightlistSection, pending.Surfaces);
 		state.SetDepthMask(false);
-		CreateFlatSurface(disp, state, result.translucent, LevelMeshDrawType::Translucent, true, sectorIndex, lightlist, lightlistSection);
+		GenerateFlatSurface(disp, state, result.translucent, LevelMeshDrawType::Translucent, true, lightlistSection, pending.Surfaces);
 		state.AlphaFunc(Alpha_GEqual, 0.f);
 		state.SetDepthMask(true);
 		state.SetRenderStyle(STYLE_Normal);
 
 		lightlistSection++;
 	}
+}
+
+void DoomLevelMesh::CommitFlat(FLevelLocals& doomMap, unsigned int sectorIndex, PendingFlat& pending)
+{
+	CurFrameStats.FlatsUpdated++;
+
+	FreeFlat(doomMap, sectorIndex);
+
+	unsigned int next = 0;
+	int lightlistSection = 0;
+	for (FSection& section : doomMap.sections.SectionsForSector(sectorIndex))
+	{
+		Flats[sectorIndex].Lights.Push(CreateLightList(section.lighthead, section.sector->PortalGroup));
+		const auto& lightlist = Flats[sectorIndex].Lights.Last();
+
+		while (next < pending.Surfaces.Size() && pending.Surfaces[next].LightListSection == lightlistSection)
+		{
+			CommitFlatSurface(doomMap, pending.Surfaces[next], sectorIndex, lightlist);
+			next++;
+		}
+
+		lightlistSection++;
+	}
 
 	// Sort the generated surfaces into subsectors
 	int surf = Flats[sectorIndex].FirstSurface;
@@ -1608,7 +1829,7 @@ void DoomLevelMesh::SetFlatLights(FLevelLocals& doomMap, unsigned int sectorInde
 	}
 }
 
-void DoomLevelMesh::CreateWallSurface(side_t* side, HWWallDispatcher& disp, MeshBuilder& state, TArray<HWWall>& list, LevelMeshDrawType drawType, unsigned int sideIndex, const LightListAllocInfo& lightlist)
+void DoomLevelMesh::GenerateWallSurface(HWWallDispatcher& disp, MeshBuilder& state, TArray<HWWall>& list, LevelMeshDrawType drawType, TArray<PendingWallSurface>& surfaces)
 {
 	for (HWWall& wallpart : list)
 	{
@@ -1637,42 +1858,16 @@ void DoomLevelMesh::CreateWallSurface(side_t* side, HWWallDispatcher& disp, Mesh
 			wallpart.DrawWall(&disp, state, drawType == LevelMeshDrawType::Translucent || drawType == LevelMeshDrawType::TranslucentBorder);
 		}
 
-		int numVertices = 0;
-		int numIndexes = 0;
-		int numUniforms = 0;
-		for (auto& it : state.mSortedLists)
-		{
-			numUniforms++;
-			for (MeshDrawCommand& command : it.second.mDraws)
-			{
-				if (command.DrawType == DT_TriangleFan && command.Count >= 3)
-				{
-					numVertices += command.Count;
-					numIndexes += (command.Count - 2) * 3;
-				}
-			}
-		}
-
-		GeometryAllocInfo ginfo = AllocGeometry(numVertices, numIndexes);
-		UniformsAllocInfo uinfo = AllocUniforms(numUniforms);
-		SurfaceAllocInfo sinfo = AllocSurface();
-
-		SurfaceUniforms* curUniforms = GetUniforms(uinfo);
-		SurfaceLightUniforms* curLightUniforms = GetLightUniforms(uinfo);
-		FMaterialState* curMaterial = GetMaterials(uinfo);
-
-		auto indexes = GetIndexes(ginfo);
-		auto vertices = GetVertices(ginfo);
-		auto uniformIndexes = GetUniformIndexes(ginfo);
+		PendingWallSurface& surface = surfaces[surfaces.Reserve(1)];
+		surface.DrawType = drawType;
+		surface.Wall = wallpart;
 
-		int pipelineID = 0;
-		int uniformsIndex = uinfo.Start;
-		int vertIndex = ginfo.VertexStart;
+		PendingSurfaceGeometry& geometry = surface.Geometry;
+		int uniformsIndex = 0;
+		int vertIndex = 0;
 		for (auto& it : state.mSortedLists)
 		{
-			const MeshApplyState& applyState = it.first;
-
-			pipelineID = screen->GetLevelMeshPipelineID(applyState.applyData, applyState.surfaceUniforms, applyState.material);
+			geometry.ApplyStates.Push(it.first);
 
 			for (MeshDrawCommand& command : it.second.mDraws)
 			{
@@ -1680,94 +1875,128 @@ void DoomLevelMesh::CreateWallSurface(side_t* side, HWWallDispatcher& disp, Mesh
 				{
 					for (int i = 2, count = command.Count; i < count; i++)
 					{
-						*(indexes++) = vertIndex;
-						*(indexes++) = vertIndex + i - 1;
-						*(indexes++) = vertIndex + i;
+						geometry.Indexes.Push(vertIndex);
+						geometry.Indexes.Push(vertIndex + i - 1);
+						geometry.Indexes.Push(vertIndex + i);
 					}
 
 					for (int i = command.Start, end = command.Start + command.Count; i < end; i++)
 					{
-						*(vertices++) = state.mVertices[i];
-						*(uniformIndexes++) = uniformsIndex;
+						geometry.Vertices.Push(state.mVertices[i]);
+						geometry.UniformIndexes.Push(uniformsIndex);
 					}
 					vertIndex += command.Count;
 				}
 			}
 
-			*(curUniforms++) = applyState.surfaceUniforms;
-			*(curMaterial++) = applyState.material;
-
-			curLightUniforms->uVertexColor = applyState.surfaceUniforms.uVertexColor;
-			curLightUniforms->uDesaturationFactor = applyState.surfaceUniforms.uDesaturationFactor;
-			curLightUniforms->uLightLevel = applyState.surfaceUniforms.uLightLevel;
-			curLightUniforms++;
-
 			uniformsIndex++;
 		}
+	}
+}
 
-		FVector2 v1 = FVector2(side->V1()->fPos());
-		FVector2 v2 = FVector2(side->V2()->fPos());
-		FVector2 N = FVector2(v2.Y - v1.Y, v1.X - v2.X).Unit();
+void DoomLevelMesh::CommitWallSurface(FLevelLocals& doomMap, side_t* side, PendingWallSurface& pending, unsigned int sideIndex, const LightListAllocInfo& lightlist)
+{
+	const PendingSurfaceGeometry& geometry = pending.Geometry;
+	const HWWall& wallpart = pending.Wall;
+	LevelMeshDrawType drawType = pending.DrawType;
 
-		uint16_t sampleDimension = 0;
-		if (wallpart.LevelMeshInfo.Type == ST_UPPERSIDE)
-		{
-			sampleDimension = side->textures[side_t::top].LightmapSampleDistance;
-		}
-		else if (wallpart.LevelMeshInfo.Type == ST_MIDDLESIDE)
-		{
-			sampleDimension = side->textures[side_t::mid].LightmapSampleDistance;
-		}
-		else if (wallpart.LevelMeshInfo.Type == ST_LOWERSIDE)
-		{
-			sampleDimension = side->textures[side_t::bottom].LightmapSampleDistance;
-		}
+	GeometryAllocInfo ginfo = AllocGeometry(geometry.Vertices.Size(), geometry.Indexes.Size());
+	UniformsAllocInfo uinfo = AllocUniforms(geometry.ApplyStates.Size());
+	SurfaceAllocInfo sinfo = AllocSurface();
+
+	SurfaceUniforms* curUniforms = GetUniforms(uinfo);
+	SurfaceLightUniforms* curLightUniforms = GetLightUniforms(uinfo);
+	FMaterialState* curMaterial = GetMaterials(uinfo);
 
-		DoomSurfaceInfo& info = *GetDoomSurface(sinfo);
-		info.Type = wallpart.LevelMeshInfo.Type;
-		info.ControlSector = wallpart.LevelMeshInfo.ControlSector;
-		info.TypeIndex = side->Index();
-		info.Side = side;
+	auto indexes = GetIndexes(ginfo);
+	auto vertices = GetVertices(ginfo);
+	auto uniformIndexes = GetUniformIndexes(ginfo);
 
-		info.NextSurface = Sides[sideIndex].FirstSurface;
-		Sides[sideIndex].FirstSurface = sinfo.Index;
+	for (unsigned int i = 0, count = geometry.Indexes.Size(); i < count; i++)
+		indexes[i] = ginfo.VertexStart + geometry.Indexes[i];
 
-		auto surface = GetSurface(sinfo);
-		surface->PipelineID = pipelineID;
-		surface->SectorGroup = sectorGroup[side->sector->Index()];
-		surface->Alpha = float(side->linedef->alpha);
-		surface->MeshLocation.StartVertIndex = ginfo.VertexStart;
-		surface->MeshLocation.StartElementIndex = ginfo.IndexStart;
-		surface->MeshLocation.NumVerts = ginfo.VertexCount;
-		surface->MeshLocation.NumElements = ginfo.IndexCount;
-		surface->Plane = FVector4(N.X, N.Y, 0.0f, v1 | N);
-		surface->Texture = wallpart.texture;
-		surface->PortalIndex = (drawType == LevelMeshDrawType::Portal) ? linePortals[side->linedef->Index()] : 0;
-		surface->IsSky = (drawType == LevelMeshDrawType::Portal) ? (wallpart.portaltype == PORTALTYPE_SKY || wallpart.portaltype == PORTALTYPE_SKYBOX || wallpart.portaltype == PORTALTYPE_HORIZON) : false;
-		surface->Bounds = GetBoundsFromSurface(*surface);
-		surface->LightList.Pos = lightlist.Start;
-		surface->LightList.Count = lightlist.Count;
+	for (unsigned int i = 0, count = geometry.Vertices.Size(); i < count; i++)
+	{
+		vertices[i] = geometry.Vertices[i];
+		uniformIndexes[i] = uinfo.Start + geometry.UniformIndexes[i];
+	}
 
-		if (disp.Level->lightmaps && !surface->IsSky)
-		{
-			surface->LightmapTileIndex = AddSurfaceToTile(info, *surface, sampleDimension, !!(side->sector->Flags & SECF_LM_DYNAMIC));
-			Lightmap.AddedSurfaces.Push(sinfo.Index);
-		}
-		else
-		{
-			surface->LightmapTileIndex = -1;
-		}
-		
-		SetSideLightmap(sinfo.Index);
+	int pipelineID = 0;
+	for (const MeshApplyState& applyState : geometry.ApplyStates)
+	{
+		pipelineID = screen->GetLevelMeshPipelineID(applyState.applyData, applyState.surfaceUniforms, applyState.material);
 
-		for (int i = ginfo.IndexStart / 3, end = (ginfo.IndexStart + ginfo.IndexCount) / 3; i < end; i++)
-			Mesh.SurfaceIndexes[i] = sinfo.Index;
+		*(curUniforms++) = applyState.surfaceUniforms;
+		*(curMaterial++) = applyState.material;
 
-		Sides[sideIndex].Geometries.Push(ginfo);
-		Sides[sideIndex].Uniforms.Push(uinfo);
+		curLightUniforms->uVertexColor = applyState.surfaceUniforms.uVertexColor;
+		curLightUniforms->uDesaturationFactor = applyState.surfaceUniforms.uDesaturationFactor;
+		curLightUniforms->uLightLevel = applyState.surfaceUniforms.uLightLevel;
+		curLightUniforms++;
+	}
+
+	FVector2 v1 = FVector2(side->V1()->fPos());
+	FVector2 v2 = FVector2(side->V2()->fPos());
+	FVector2 N = FVector2(v2.Y - v1.Y, v1.X - v2.X).Unit();
 
-		AddToDrawList(Sides[sideIndex].DrawRanges, drawType, pipelineID, ginfo.IndexStart, ginfo.IndexCount);
+	uint16_t sampleDimension = 0;
+	if (wallpart.LevelMeshInfo.Type == ST_UPPERSIDE)
+	{
+		sampleDimension = side->textures[side_t::top].LightmapSampleDistance;
 	}
+	else if (wallpart.LevelMeshInfo.Type == ST_MIDDLESIDE)
+	{
+		sampleDimension = side->textures[side_t::mid].LightmapSampleDistance;
+	}
+	else if (wallpart.LevelMeshInfo.Type == ST_LOWERSIDE)
+	{
+		sampleDimension = side->textures[side_t::bottom].LightmapSampleDistance;
+	}
+
+	DoomSurfaceInfo& info = *GetDoomSurface(sinfo);
+	info.Type = wallpart.LevelMeshInfo.Type;
+	info.ControlSector = wallpart.LevelMeshInfo.ControlSector;
+	info.TypeIndex = side->Index();
+	info.Side = side;
+
+	info.NextSurface = Sides[sideIndex].FirstSurface;
+	Sides[sideIndex].FirstSurface = sinfo.Index;
+
+	auto surface = GetSurface(sinfo);
+	surface->PipelineID = pipelineID;
+	surface->SectorGroup = sectorGroup[side->sector->Index()];
+	surface->Alpha = float(side->linedef->alpha);
+	surface->MeshLocation.StartVertIndex = ginfo.VertexStart;
+	surface->MeshLocation.StartElementIndex = ginfo.IndexStart;
+	surface->MeshLocation.NumVerts = ginfo.VertexCount;
+	surface->MeshLocation.NumElements = ginfo.IndexCount;
+	surface->Plane = FVector4(N.X, N.Y, 0.0f, v1 | N);
+	surface->Texture = wallpart.texture;
+	surface->PortalIndex = (drawType == LevelMeshDrawType::Portal) ? linePortals[side->linedef->Index()] : 0;
+	surface->IsSky = (drawType == LevelMeshDrawType::Portal) ? (wallpart.portaltype == PORTALTYPE_SKY || wallpart.portaltype == PORTALTYPE_SKYBOX || wallpart.portaltype == PORTALTYPE_HORIZON) : false;
+	surface->Bounds = GetBoundsFromSurface(*surface);
+	surface->LightList.Pos = lightlist.Start;
+	surface->LightList.Count = lightlist.Count;
+
+	if (doomMap.lightmaps && !surface->IsSky)
+	{
+		surface->LightmapTileIndex = AddSurfaceToTile(info, *surface, sampleDimension, !!(side->sector->Flags & SECF_LM_DYNAMIC));
+		Lightmap.AddedSurfaces.Push(sinfo.Index);
+	}
+	else
+	{
+		surface->LightmapTileIndex = -1;
+	}
+	
+	SetSideLightmap(sinfo.Index);
+
+	for (int i = ginfo.IndexStart / 3, end = (ginfo.IndexStart + ginfo.IndexCount) / 3; i < end; i++)
+		Mesh.SurfaceIndexes[i] = sinfo.Index;
+
+	Sides[sideIndex].Geometries.Push(ginfo);
+	Sides[sideIndex].Uniforms.Push(uinfo);
+
+	AddToDrawList(Sides[sideIndex].DrawRanges, drawType, pipelineID, ginfo.IndexStart, ginfo.IndexCount);
 }
 
 void DoomLevelMesh::AddToDrawList(TArray<DrawRangeInfo>& drawRanges, LevelMeshDrawType drawType, int pipelineID, int indexStart, int indexCount)
@@ -1841,7 +2070,7 @@ int DoomLevelMesh::GetSampleDimension(uint16_t sampleDimension)
 	return sampleDimension;
 }
 
-void DoomLevelMesh::CreateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state, TArray<HWFlat>& list, LevelMeshDrawType drawType, bool translucent, unsigned int sectorIndex, const LightListAllocInfo& lightlist, int lightlistSection)
+void DoomLevelMesh::GenerateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state, TArray<HWFlat>& list, LevelMeshDrawType drawType, bool translucent, int lightlistSection, TArray<PendingFlatSurface>& surfaces)
 {
 	for (HWFlat& flatpart : list)
 	{
@@ -1874,110 +2103,34 @@ void DoomLevelMesh::CreateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state
 			flatpart.DrawFlat(&disp, state, translucent);
 		}
 
-		VSMatrix textureMatrix;
-		textureMatrix.loadIdentity();
-
-		int pipelineID = 0;
-		const SurfaceUniforms* uniforms = nullptr;
-		const FMaterialState* material = nullptr;
-		bool foundDraw = false;
-		for (auto& it : state.mSortedLists)
-		{
-			const MeshApplyState& applyState = it.first;
-
-			pipelineID = screen->GetLevelMeshPipelineID(applyState.applyData, applyState.surfaceUniforms, applyState.material);
-			textureMatrix = applyState.textureMatrix;
-			uniforms = &applyState.surfaceUniforms;
-			material = &applyState.material;
-			foundDraw = true;
-			break;
-		}
-
-		if (!foundDraw)
+		if (state.mSortedLists.empty())
 			continue;
 
-		int numVertices = 0;
-		int numIndexes = 0;
-		for (subsector_t* sub : flatpart.section->subsectors)
-		{
-			if (sub->numlines < 3)
-				continue;
-			numVertices += sub->numlines;
-			numIndexes += (sub->numlines - 2) * 3;
-		}
+		const MeshApplyState& applyState = state.mSortedLists.begin()->first;
+		const VSMatrix& textureMatrix = applyState.textureMatrix;
 
-		GeometryAllocInfo ginfo = AllocGeometry(numVertices, numIndexes);
-		UniformsAllocInfo uinfo = AllocUniforms(1);
+		PendingFlatSurface& surface = surfaces[surfaces.Reserve(1)];
+		surface.DrawType = drawType;
+		surface.Flat = flatpart;
+		surface.LightListSection = lightlistSection;
 
-		Flats[sectorIndex].Geometries.Push(ginfo);
-		Flats[sectorIndex].Uniforms.Push(uinfo);
+		PendingSurfaceGeometry& geometry = surface.Geometry;
+		geometry.ApplyStates.Push(applyState);
 
-		int* surfaceIndexes = &Mesh.SurfaceIndexes[ginfo.IndexStart / 3];
-
-		*GetUniforms(uinfo) = *uniforms;
-		*GetMaterials(uinfo) = *material;
-
-		auto lightUniforms = GetLightUniforms(uinfo);
-		lightUniforms->uVertexColor = uniforms->uVertexColor;
-		lightUniforms->uDesaturationFactor = uniforms->uDesaturationFactor;
-		lightUniforms->uLightLevel = uniforms->uLightLevel;
-
-		int uniformsIndex = uinfo.Start;
-		int vertIndex = ginfo.VertexStart;
-		int elementIndex = ginfo.IndexStart;
-
-		uint16_t sampleDimension = 0;
-		if (flatpart.ceiling)
-		{
-			sampleDimension = flatpart.sector->planes[sector_t::ceiling].LightmapSampleDistance;
-		}
-		else
-		{
-			sampleDimension = flatpart.sector->planes[sector_t::floor].LightmapSampleDistance;
-		}
-
-		DoomSurfaceInfo info;
-		info.Type = flatpart.ceiling ? ST_CEILING : ST_FLOOR;
-		info.ControlSector = flatpart.controlsector ? flatpart.controlsector->model : nullptr;
-
-		LevelMeshSurface surf;
-		surf.SectorGroup = sectorGroup[flatpart.sector->Index()];
-		surf.Alpha = flatpart.alpha;
-		surf.Texture = flatpart.texture;
-		surf.PipelineID = pipelineID;
-		surf.PortalIndex = sectorPortals[flatpart.ceiling][flatpart.sector->Index()];
-		if(drawType == LevelMeshDrawType::Portal)
-		{
-			FSectorPortal* port = flatpart.sector->GetPortal(flatpart.ceiling ? sector_t::ceiling : sector_t::floor);
-			surf.IsSky = flatpart.plane.texture == skyflatnum || (port && port->mType == PORTS_SKYVIEWPOINT);
-		}
-		else
-		{
-			surf.IsSky = false;
-		}
-
-		auto plane = info.ControlSector ? info.ControlSector->GetSecPlane(!flatpart.ceiling) : flatpart.sector->GetSecPlane(flatpart.ceiling);
-		surf.Plane = FVector4((float)plane.Normal().X, (float)plane.Normal().Y, (float)plane.Normal().Z, -(float)plane.D);
-
-		if (info.ControlSector)
-			surf.Plane = -surf.Plane;
+		sector_t* controlSector = flatpart.controlsector ? flatpart.controlsector->model : nullptr;
+		auto plane = controlSector ? controlSector->GetSecPlane(!flatpart.ceiling) : flatpart.sector->GetSecPlane(flatpart.ceiling);
 
 		float skyZ = flatpart.ceiling ? 32768.0f : -32768.0f;
 		bool useSkyZ = (drawType == LevelMeshDrawType::Portal && flatpart.plane.texture == skyflatnum);
 
-		FFlatVertex* vertices = GetVertices(ginfo);
-		int* uniformIndexes = GetUniformIndexes(ginfo);
-		uint32_t* indexes = GetIndexes(ginfo);
-
+		int vertIndex = 0;
 		for (subsector_t* sub : flatpart.section->subsectors)
 		{
 			if (sub->numlines < 3)
 				continue;
 
 			int startVertIndex = vertIndex;
-			int startElementIndex = elementIndex;
 			vertIndex += sub->numlines;
-			elementIndex += (sub->numlines - 2) * 3;
 
 			for (int i = 0, end = sub->numlines; i < end; i++)
 			{
@@ -1996,69 +2149,161 @@ void DoomLevelMesh::CreateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state
 				ffv.lv = 0.0f;
 				ffv.lindex = -1.0f;
 
-				*(vertices++) = ffv;
-				*(uniformIndexes++) = uniformsIndex;
+				geometry.Vertices.Push(ffv);
 			}
 
-			SurfaceAllocInfo sinfo = AllocSurface();
-
 			if (flatpart.ceiling)
 			{
 				for (int i = 2, count = sub->numlines; i < count; i++)
 				{
-					*(indexes++) = startVertIndex;
-					*(indexes++) = startVertIndex + i - 1;
-					*(indexes++) = startVertIndex + i;
-					*(surfaceIndexes++) = sinfo.Index;
+					geometry.Indexes.Push(startVertIndex);
+					geometry.Indexes.Push(startVertIndex + i - 1);
+					geometry.Indexes.Push(startVertIndex + i);
 				}
 			}
 			else
 			{
 				for (int i = 2, count = sub->numlines; i < count; i++)
 				{
-					*(indexes++) = startVertIndex + i;
-					*(indexes++) = startVertIndex + i - 1;
-					*(indexes++) = startVertIndex;
-					*(surfaceIndexes++) = sinfo.Index;
+					geometry.Indexes.Push(startVertIndex + i);
+					geometry.Indexes.Push(startVertIndex + i - 1);
+					geometry.Indexes.Push(startVertIndex);
 				}
 			}
+		}
+	}
+}
+
+void DoomLevelMesh::CommitFlatSurface(FLevelLocals& doomMap, PendingFlatSurface& pending, unsigned int sectorIndex, const LightListAllocInfo& lightlist)
+{
+	const PendingSurfaceGeometry& geometry = pending.Geometry;
+	const HWFlat& flatpart = pending.Flat;
+	LevelMeshDrawType drawType = pending.DrawType;
 
-			info.TypeIndex = sub->Index();
-			info.Subsector = sub;
-			surf.MeshLocation.StartVertIndex = startVertIndex;
-			surf.MeshLocation.StartElementIndex = startElementIndex;
-			surf.MeshLocation.NumVerts = sub->numlines;
-			surf.MeshLocation.NumElements = (sub->numlines - 2) * 3;
-			surf.Bounds = GetBoundsFromSurface(surf);
+	const MeshApplyState& applyState = geometry.ApplyStates[0];
+	int pipelineID = screen->GetLevelMeshPipelineID(applyState.applyData, applyState.surfaceUniforms, applyState.material);
+	const SurfaceUniforms* uniforms = &applyState.surfaceUniforms;
+	const FMaterialState* material = &applyState.material;
 
-			if (disp.Level->lightmaps && !surf.IsSky)
-			{
-				surf.LightmapTileIndex = AddSurfaceToTile(info, surf, sampleDimension, !!(flatpart.sector->Flags & SECF_LM_DYNAMIC));
-				Lightmap.AddedSurfaces.Push(sinfo.Index);
-			}
-			else
-			{
-				surf.LightmapTileIndex = -1;
-			}
+	GeometryAllocInfo ginfo = AllocGeometry(geometry.Vertices.Size(), geometry.Indexes.Size());
+	UniformsAllocInfo uinfo = AllocUniforms(1);
+
+	Flats[sectorIndex].Geometries.Push(ginfo);
+	Flats[sectorIndex].Uniforms.Push(uinfo);
+
+	int* surfaceIndexes = &Mesh.SurfaceIndexes[ginfo.IndexStart / 3];
+
+	*GetUniforms(uinfo) = *uniforms;
+	*GetMaterials(uinfo) = *material;
+
+	auto lightUniforms = GetLightUniforms(uinfo);
+	lightUniforms->uVertexColor = uniforms->uVertexColor;
+	lightUniforms->uDesaturationFactor = uniforms->uDesaturationFactor;
+	lightUniforms->uLightLevel = uniforms->uLightLevel;
+
+	int uniformsIndex = uinfo.Start;
+	int vertIndex = ginfo.VertexStart;
+	int elementIndex = ginfo.IndexStart;
+
+	uint16_t sampleDimension = 0;
+	if (flatpart.ceiling)
+	{
+		sampleDimension = flatpart.sector->planes[sector_t::ceiling].LightmapSampleDistance;
+	}
+	else
+	{
+		sampleDimension = flatpart.sector->planes[sector_t::floor].LightmapSampleDistance;
+	}
+
+	DoomSurfaceInfo info;
+	info.Type = flatpart.ceiling ? ST_CEILING : ST_FLOOR;
+	info.ControlSector = flatpart.controlsector ? flatpart.controlsector->model : nullptr;
+
+	LevelMeshSurface surf;
+	surf.SectorGroup = sectorGroup[flatpart.sector->Index()];
+	surf.Alpha = flatpart.alpha;
+	surf.Texture = flatpart.texture;
+	surf.PipelineID = pipelineID;
+	surf.PortalIndex = sectorPortals[flatpart.ceiling][flatpart.sector->Index()];
+	if(drawType == LevelMeshDrawType::Portal)
+	{
+		FSectorPortal* port = flatpart.sector->GetPortal(flatpart.ceiling ? sector_t::ceiling : sector_t::floor);
+		surf.IsSky = flatpart.plane.texture == skyflatnum || (port && port->mType == PORTS_SKYVIEWPOINT);
+	}
+	else
+	{
+		surf.IsSky = false;
+	}
+
+	auto plane = info.ControlSector ? info.ControlSector->GetSecPlane(!flatpart.ceiling) : flatpart.sector->GetSecPlane(flatpart.ceiling);
+	surf.Plane = FVector4((float)plane.Normal().X, (float)plane.Normal().Y, (float)plane.Normal().Z, -(float)plane.D);
+
+	if (info.ControlSector)
+		surf.Plane = -surf.Plane;
+
+	FFlatVertex* vertices = GetVertices(ginfo);
+	int* uniformIndexes = GetUniformIndexes(ginfo);
+	uint32_t* indexes = GetIndexes(ginfo);
+
+	for (unsigned int i = 0, count = geometry.Vertices.Size(); i < count; i++)
+	{
+		vertices[i] = geometry.Vertices[i];
+		uniformIndexes[i] = uniformsIndex;
+	}
+
+	for (unsigned int i = 0, count = geometry.Indexes.Size(); i < count; i++)
+		indexes[i] = ginfo.VertexStart + geometry.Indexes[i];
+
+	for (subsector_t* sub : flatpart.section->subsectors)
+	{
+		if (sub->numlines < 3)
+			continue;
 
-			surf.LightList.Pos = lightlist.Start;
-			surf.LightList.Count = lightlist.Count;
-			info.LightListSection = lightlistSection;
+		int startVertIndex = vertIndex;
+		int startElementIndex = elementIndex;
+		vertIndex += sub->numlines;
+		elementIndex += (sub->numlines - 2) * 3;
 
-			info.NextSurface = Flats[sectorIndex].FirstSurface;
-			Flats[sectorIndex].FirstSurface = sinfo.Index;
+		SurfaceAllocInfo sinfo = AllocSurface();
 
-			*GetSurface(sinfo) = surf;
-			*GetDoomSurface(sinfo) = info;
+		for (int i = 2, count = sub->numlines; i < count; i++)
+			*(surfaceIndexes++) = sinfo.Index;
 
-			for (int i = ginfo.IndexStart / 3, end = (ginfo.IndexStart + ginfo.IndexCount) / 3; i < end; i++)
-				Mesh.SurfaceIndexes[i] = sinfo.Index;
+		info.TypeIndex = sub->Index();
+		info.Subsector = sub;
+		surf.MeshLocation.StartVertIndex = startVertIndex;
+		surf.MeshLocation.StartElementIndex = startElementIndex;
+		surf.MeshLocation.NumVerts = sub->numlines;
+		surf.MeshLocation.NumElements = (sub->numlines - 2) * 3;
+		surf.Bounds = GetBoundsFromSurface(surf);
 
-			SetSubsectorLightmap(sinfo.Index);
+		if (doomMap.lightmaps && !surf.IsSky)
+		{
+			surf.LightmapTileIndex = AddSurfaceToTile(info, surf, sampleDimension, !!(flatpart.sector->Flags & SECF_LM_DYNAMIC));
+			Lightmap.AddedSurfaces.Push(sinfo.Index);
 		}
+		else
+		{
+			surf.LightmapTileIndex = -1;
+		}
+
+		surf.LightList.Pos = lightlist.Start;
+		surf.LightList.Count = lightlist.Count;
+		info.LightListSection = pending.LightListSection;
 
-		AddToDrawList(Flats[sectorIndex].DrawRanges, drawType, pipelineID, ginfo.IndexStart, ginfo.IndexCount);
+		info.NextSurface = Flats[sectorIndex].FirstSurface;
+		Flats[sectorIndex].FirstSurface = sinfo.Index;
+
+		*GetSurface(sinfo) = surf;
+		*GetDoomSurface(sinfo) = info;
+
+		for (int i = ginfo.IndexStart / 3, end = (ginfo.IndexStart + ginfo.IndexCount) / 3; i < end; i++)
+			Mesh.SurfaceIndexes[i] = sinfo.Index;
+
+		SetSubsectorLightmap(sinfo.Index);
 	}
+
+	AddToDrawList(Flats[sectorIndex].DrawRanges, drawType, pipelineID, ginfo.IndexStart, ginfo.IndexCount);
 }
 
 void DoomLevelMesh::SetSubsectorLightmap(int surfaceIndex)
@@ -2613,7 +2858,7 @@ void SaveMapLumps(FileWriter* writer, const TArray<MapLump>& lumps, const char*
 	}
 }
 
-void DoomLevelMesh::SaveLightmapLump(FLevelLocals& doomMap)
+void DoomLevelMesh::SaveLightmapLump(FLevelLocals& doomMap, bool downloadLightmap)
 {
 	/*
 	// LIGHTMAP version 4 pseudo-C specification:
@@ -2641,10 +2886,14 @@ void DoomLevelMesh::SaveLightmapLump(FLevelLocals& doomMap)
 	};
 	*/
 
-	Lightmap.TextureData.Resize(Lightmap.TextureSize * Lightmap.TextureSize * Lightmap.TextureCount * 4);
-	for (int arrayIndex = 0; arrayIndex < Lightmap.TextureCount; arrayIndex++)
+	// The CPU lightmapper bakes straight into TextureData and has nothing to download
+	if (downloadLightmap)
 	{
-		screen->DownloadLightmap(arrayIndex, Lightmap.TextureData.Data() + arrayIndex * Lightmap.TextureSize * Lightmap.TextureSize * 4);
+		Lightmap.TextureData.Resize(Lightmap.TextureSize * Lightmap.TextureSize * Lightmap.TextureCount * 4);
+		for (int arrayIndex = 0; arrayIndex < Lightmap.TextureCount; arrayIndex++)
+		{
+			screen->DownloadLightmap(arrayIndex, Lightmap.TextureData.Data() + arrayIndex * Lightmap.TextureSize * Lightmap.TextureSize * 4);
+		}
 	}
 
 	// Calculate size of lump
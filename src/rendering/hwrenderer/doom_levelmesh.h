@@ -11,6 +11,7 @@
 #include "bounds.h"
 #include <set>
 #include <map>
+#include <memory>
 
 struct FLevelLocals;
 struct FPolyObj;
@@ -112,6 +113,52 @@ enum class LevelMeshDrawType
 	NumDrawTypes
 };
 
+// Geometry of one wall or flat part, as produced by the MeshBuilder. Vertex and
+// uniform indexes are relative to the part until it gets allocated in the mesh.
+struct PendingSurfaceGeometry
+{
+	TArray<MeshApplyState> ApplyStates;
+	TArray<FFlatVertex> Vertices;
+	TArray<int> UniformIndexes;
+	TArray<uint32_t> Indexes;
+};
+
+struct PendingWallSurface
+{
+	LevelMeshDrawType DrawType = {};
+	HWWall Wall;
+	PendingSurfaceGeometry Geometry;
+};
+
+struct PendingFlatSurface
+{
+	LevelMeshDrawType DrawType = {};
+	HWFlat Flat;
+	int LightListSection = 0;
+	PendingSurfaceGeometry Geometry;
+};
+
+// Everything a full side or flat update needs that can be generated without touching
+// the level mesh. This is the part of a surface update that runs on worker threads.
+struct PendingSide
+{
+	bool Empty = true;
+	FLightNode* LightHead = nullptr;
+	int PortalGroup = 0;
+	bool HasLightList = false;
+	TArray<HWDecalCreateInfo> Decals;
+	TArray<HWWall> WallPortals;
+	TArray<HWMissing> MissingUpper;
+	TArray<HWMissing> MissingLower;
+	bool NeedsImmediateRendering = false;
+	TArray<PendingWallSurface> Surfaces;
+};
+
+struct PendingFlat
+{
+	TArray<PendingFlatSurface> Surfaces;
+};
+
 class LevelMeshDrawLists
 {
 public:
@@ -168,7 +215,7 @@ public:
 	TArray<int> sectorPortals[2]; // index is sector+plane, value is index into the portal list
 	TArray<int> linePortals; // index is linedef, value is index into the portal list
 
-	void SaveLightmapLump(FLevelLocals& doomMap);
+	void SaveLightmapLump(FLevelLocals& doomMap, bool downloadLightmap = true);
 	void DeleteLightmapLump(FLevelLocals& doomMap);
 	static FString GetMapFilename(FLevelLocals& doomMap);
 
@@ -200,6 +247,9 @@ public:
 		int SidesUpdated = 0;
 		int Portals = 0;
 		int DynLights = 0;
+		int GenerateThreads = 0;
+		double GenerateTime = 0.0; // Wall clock time of the surface generation stage
+		double GenerateWorkTime = 0.0; // Sum of the time spent by every thread in it
 	};
 	Stats LastFrameStats, CurFrameStats;
 
@@ -220,8 +270,11 @@ private:
 	void UpdateSideLightList(FLevelLocals& doomMap, unsigned int sideIndex);
 	void UpdateFlatLightList(FLevelLocals& doomMap, unsigned int sectorIndex);
 
-	void CreateSide(FLevelLocals& doomMap, unsigned int sideIndex);
-	void CreateFlat(FLevelLocals& doomMap, unsigned int sectorIndex);
+	void GenerateSide(FLevelLocals& doomMap, unsigned int sideIndex, MeshBuilder& state, PendingSide& pending);
+	void GenerateFlat(FLevelLocals& doomMap, unsigned int sectorIndex, MeshBuilder& state, PendingFlat& pending);
+	void CommitSide(FLevelLocals& doomMap, unsigned int sideIndex, PendingSide& pending);
+	void CommitFlat(FLevelLocals& doomMap, unsigned int sectorIndex, PendingFlat& pending);
+	void GenerateSurfaces(FLevelLocals& doomMap, const TArray<int>& sides, const TArray<int>& flats);
 
 	void SetSideLights(FLevelLocals& doomMap, unsigned int sideIndex);
 	void SetFlatLights(FLevelLocals& doomMap, unsigned int sectorIndex);
@@ -234,8 +287,10 @@ private:
 
 	void CreateModelSurfaces(AActor* thing, FSpriteModelFrame* modelframe);
 
-	void CreateWallSurface(side_t* side, HWWallDispatcher& disp, MeshBuilder& state, TArray<HWWall>& list, LevelMeshDrawType drawType, unsigned int sectorIndex, const LightListAllocInfo& lightlist);
-	void CreateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state, TArray<HWFlat>& list, LevelMeshDrawType drawType, bool translucent, unsigned int sectorIndex, const LightListAllocInfo& lightlist, int lightlistSection);
+	void GenerateWallSurface(HWWallDispatcher& disp, MeshBuilder& state, TArray<HWWall>& list, LevelMeshDrawType drawType, TArray<PendingWallSurface>& surfaces);
+	void GenerateFlatSurface(HWFlatDispatcher& disp, MeshBuilder& state, TArray<HWFlat>& list, LevelMeshDrawType drawType, bool translucent, int lightlistSection, TArray<PendingFlatSurface>& surfaces);
+	void CommitWallSurface(FLevelLocals& doomMap, side_t* side, PendingWallSurface& pending, unsigned int sideIndex, const LightListAllocInfo& lightlist);
+	void CommitFlatSurface(FLevelLocals& doomMap, PendingFlatSurface& pending, unsigned int sectorIndex, const LightListAllocInfo& lightlist);
 
 	BBox GetBoundsFromSurface(const LevelMeshSurface& surface) const;
 
@@ -277,6 +332,11 @@ private:
 	TArray<int> SideUpdateList;
 	TArray<int> FlatUpdateList;
 
+	// Surfaces generated ahead of the serial update, in the same order as the lists passed to GenerateSurfaces
+	TArray<PendingSide> PendingSides;
+	TArray<PendingFlat> PendingFlats;
+	TArray<std::unique_ptr<MeshBuilder>> WorkerBuilders;
+
 	TArray<TArray<int>> VisibleSides;
 	TArray<TArray<int>> VisibleSubsectors;
 
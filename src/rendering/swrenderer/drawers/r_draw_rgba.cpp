@@ -59,10 +59,15 @@
 #include "r_draw_sprite32_sse2.h"
 #include "r_draw_span32_sse2.h"
 #include "r_draw_sky32_sse2.h"
+#include "r_draw_wall32_avx2.h"
+#include "r_draw_sprite32_avx2.h"
+#include "r_draw_span32_avx2.h"
+#include "r_draw_sky32_avx2.h"
 #endif
 
 #include "gi.h"
 #include "stats.h"
+#include "x86.h"
 #include <vector>
 
 ;
@@ -244,6 +249,179 @@ namespace swrenderer
 		DrawSkyDouble32Command::DrawColumn(args);
 	}
 
+#ifndef NO_SSE
+	bool SWTruecolorDrawersAVX2::IsSupported()
+	{
+		if (!CPU.bAVX2 || !CPU.bAVX || !CPU.bOSXSAVE)
+			return false;
+
+		// The OS must also save the upper halves of the ymm registers
+#ifdef _MSC_VER
+		uint64_t xcr0 = _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+		uint64_t xcr0 = ((uint64_t)edx << 32) | eax;
+#endif
+		return (xcr0 & 6) == 6;
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWall(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWall32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWallMasked(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWallMasked32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWallAdd(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWallAddClamp32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWallAddClamp(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWallAddClamp32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWallSubClamp(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWallSubClamp32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawWallRevSubClamp(const WallDrawerArgs &args)
+	{
+		DrawWallColumns<DrawWallRevSubClamp32AVX2Command>(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSprite32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::FillColumn(const SpriteDrawerArgs &args)
+	{
+		FillSprite32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::FillAddColumn(const SpriteDrawerArgs &args)
+	{
+		FillSpriteAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::FillAddClampColumn(const SpriteDrawerArgs &args)
+	{
+		FillSpriteAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::FillSubClampColumn(const SpriteDrawerArgs &args)
+	{
+		FillSpriteSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::FillRevSubClampColumn(const SpriteDrawerArgs &args)
+	{
+		FillSpriteRevSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawAddColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawTranslatedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteTranslated32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawTranslatedAddColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteTranslatedAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawShadedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteShaded32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawAddClampShadedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteAddClampShaded32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawAddClampColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteTranslatedAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSubClampColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteTranslatedSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawRevSubClampColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteRevSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args)
+	{
+		DrawSpriteTranslatedRevSubClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpan(const SpanDrawerArgs &args)
+	{
+		DrawSpan32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpanMasked(const SpanDrawerArgs &args)
+	{
+		DrawSpanMasked32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpanTranslucent(const SpanDrawerArgs &args)
+	{
+		DrawSpanTranslucent32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpanMaskedTranslucent(const SpanDrawerArgs &args)
+	{
+		DrawSpanAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpanAddClamp(const SpanDrawerArgs &args)
+	{
+		DrawSpanTranslucent32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSpanMaskedAddClamp(const SpanDrawerArgs &args)
+	{
+		DrawSpanAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawSingleSkyColumn(const SkyDrawerArgs &args)
+	{
+		DrawSkySingle32AVX2Command::DrawColumn(args);
+	}
+
+	void SWTruecolorDrawersAVX2::DrawDoubleSkyColumn(const SkyDrawerArgs &args)
+	{
+		DrawSkyDouble32AVX2Command::DrawColumn(args);
+	}
+#endif
+
 	/////////////////////////////////////////////////////////////////////////////
 
 	void SWTruecolorDrawers::DrawScaledFuzzColumn(const SpriteDrawerArgs& drawerargs)
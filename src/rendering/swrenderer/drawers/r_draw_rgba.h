@@ -71,6 +71,13 @@ namespace swrenderer
 	#define VECTORCALL
 	#endif
 
+	// Compile a function for AVX2 even when the rest of the file is built for an older instruction set
+	#if !defined(NO_SSE) && defined(__GNUC__)
+	#define AVX2_TARGET __attribute__((target("avx2")))
+	#else
+	#define AVX2_TARGET
+	#endif
+
 	template<typename CommandType, typename BlendMode>
 	class DrawerBlendCommand : public CommandType
 	{
@@ -142,6 +149,50 @@ namespace swrenderer
 		WallColumnDrawerArgs wallcolargs;
 	};
 
+#ifndef NO_SSE
+	// Truecolor drawers using the AVX2 versions of the wall, sprite, span and sky drawers
+	class SWTruecolorDrawersAVX2 : public SWTruecolorDrawers
+	{
+	public:
+		using SWTruecolorDrawers::SWTruecolorDrawers;
+
+		// True if both the CPU and the OS support AVX2
+		static bool IsSupported();
+
+		void DrawWall(const WallDrawerArgs &args) override;
+		void DrawWallMasked(const WallDrawerArgs &args) override;
+		void DrawWallAdd(const WallDrawerArgs &args) override;
+		void DrawWallAddClamp(const WallDrawerArgs &args) override;
+		void DrawWallSubClamp(const WallDrawerArgs &args) override;
+		void DrawWallRevSubClamp(const WallDrawerArgs &args) override;
+		void DrawSingleSkyColumn(const SkyDrawerArgs &args) override;
+		void DrawDoubleSkyColumn(const SkyDrawerArgs &args) override;
+		void DrawColumn(const SpriteDrawerArgs &args) override;
+		void FillColumn(const SpriteDrawerArgs &args) override;
+		void FillAddColumn(const SpriteDrawerArgs &args) override;
+		void FillAddClampColumn(const SpriteDrawerArgs &args) override;
+		void FillSubClampColumn(const SpriteDrawerArgs &args) override;
+		void FillRevSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddColumn(const SpriteDrawerArgs &args) override;
+		void DrawTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawTranslatedAddColumn(const SpriteDrawerArgs &args) override;
+		void DrawShadedColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampShadedColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawRevSubClampColumn(const SpriteDrawerArgs &args) override;
+		void DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args) override;
+		void DrawSpan(const SpanDrawerArgs &args) override;
+		void DrawSpanMasked(const SpanDrawerArgs &args) override;
+		void DrawSpanTranslucent(const SpanDrawerArgs &args) override;
+		void DrawSpanMaskedTranslucent(const SpanDrawerArgs &args) override;
+		void DrawSpanAddClamp(const SpanDrawerArgs &args) override;
+		void DrawSpanMaskedAddClamp(const SpanDrawerArgs &args) override;
+	};
+#endif
+
 	/////////////////////////////////////////////////////////////////////////////
 	// Pixel shading inline functions:
 
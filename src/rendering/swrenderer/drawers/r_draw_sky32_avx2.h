@@ -0,0 +1,208 @@
+/*
+**  Drawer commands for skies
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/viewport/r_skydrawer.h"
+
+namespace swrenderer
+{
+	// AVX2 versions of the sky drawers. The textured and faded bands are drawn eight pixels at a time,
+	// using gathers to fetch the texels.
+	template<bool DoubleSky>
+	class DrawSky32AVX2T
+	{
+	public:
+		AVX2_TARGET static void DrawColumn(const SkyDrawerArgs& args)
+		{
+			uint32_t *dest = (uint32_t *)args.Dest();
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			const uint32_t *source0 = (const uint32_t *)args.FrontTexturePixels();
+			const uint32_t *source1 = DoubleSky ? (const uint32_t *)args.BackTexturePixels() : nullptr;
+			int textureheight0 = args.FrontTextureHeight();
+			uint32_t maxtextureheight1 = DoubleSky ? args.BackTextureHeight() - 1 : 0;
+
+			int32_t frac = args.TextureVPos();
+			int32_t fracstep = args.TextureVStep();
+
+			uint32_t solid_top = args.SolidTopColor();
+			uint32_t solid_bottom = args.SolidBottomColor();
+			bool fadeSky = args.FadeSky();
+
+			int count = args.Count();
+
+			if (!fadeSky)
+			{
+				DrawTextured(dest, pitch, frac, fracstep, 0, count, source0, source1, textureheight0, maxtextureheight1);
+				return;
+			}
+
+			// Find bands for top solid color, top fade, center textured, bottom fade, bottom solid color:
+			int start_fade = 2; // How fast it should fade out
+			int fade_length = (1 << (24 - start_fade));
+			int start_fadetop_y = (-frac) / fracstep;
+			int end_fadetop_y = (fade_length - frac) / fracstep;
+			int start_fadebottom_y = ((2 << 24) - fade_length - frac) / fracstep;
+			int end_fadebottom_y = ((2 << 24) - frac) / fracstep;
+			start_fadetop_y = clamp(start_fadetop_y, 0, count);
+			end_fadetop_y = clamp(end_fadetop_y, 0, count);
+			start_fadebottom_y = clamp(start_fadebottom_y, 0, count);
+			end_fadebottom_y = clamp(end_fadebottom_y, 0, count);
+
+			// The bottom fade blends towards solid_top_fill just like the SSE2 drawer does
+			__m256i solid_top_fill = _mm256_broadcastq_epi64(_mm_unpacklo_epi8(_mm_cvtsi32_si128(solid_top), _mm_setzero_si128()));
+
+			int index = 0;
+
+			// Top solid color:
+			while (index < start_fadetop_y)
+			{
+				*dest = solid_top;
+				dest += pitch;
+				frac += fracstep;
+				index++;
+			}
+
+			// Top fade:
+			while (index < end_fadetop_y)
+			{
+				int n = min(end_fadetop_y - index, 8);
+				__m256i fracs = FracSteps(frac, fracstep);
+				__m256i fg = Sample(fracs, source0, source1, textureheight0, maxtextureheight1);
+				if (!DoubleSky)
+					fg = _mm256_or_si256(fg, _mm256_set1_epi32(0xff000000));
+
+				__m256i alpha = _mm256_srai_epi32(fracs, 16 - start_fade);
+				alpha = _mm256_max_epi32(_mm256_min_epi32(alpha, _mm256_set1_epi32(256)), _mm256_setzero_si256());
+				Store(dest, pitch, n, Fade(fg, solid_top_fill, alpha));
+
+				frac += fracstep * n;
+				dest += pitch * n;
+				index += n;
+			}
+
+			// Textured center:
+			DrawTextured(dest, pitch, frac, fracstep, index, start_fadebottom_y, source0, source1, textureheight0, maxtextureheight1);
+			if (index < start_fadebottom_y)
+			{
+				int n = start_fadebottom_y - index;
+				frac += fracstep * n;
+				dest += pitch * n;
+				index += n;
+			}
+
+			// Fade bottom:
+			while (index < end_fadebottom_y)
+			{
+				int n = min(end_fadebottom_y - index, 8);
+				__m256i fracs = FracSteps(frac, fracstep);
+				__m256i fg = Sample(fracs, source0, source1, textureheight0, maxtextureheight1);
+				if (!DoubleSky)
+					fg = _mm256_or_si256(fg, _mm256_set1_epi32(0xff000000));
+
+				__m256i alpha = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_set1_epi32(2 << 24), fracs), 16 - start_fade);
+				alpha = _mm256_max_epi32(_mm256_min_epi32(alpha, _mm256_set1_epi32(256)), _mm256_setzero_si256());
+				Store(dest, pitch, n, Fade(fg, solid_top_fill, alpha));
+
+				frac += fracstep * n;
+				dest += pitch * n;
+				index += n;
+			}
+
+			// Bottom solid color:
+			while (index < count)
+			{
+				*dest = solid_bottom;
+				dest += pitch;
+				index++;
+			}
+		}
+
+		FORCEINLINE AVX2_TARGET static void VECTORCALL DrawTextured(uint32_t *dest, int pitch, int32_t frac, int32_t fracstep, int index, int end, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			while (index < end)
+			{
+				int n = min(end - index, 8);
+				__m256i fg = Sample(FracSteps(frac, fracstep), source0, source1, textureheight0, maxtextureheight1);
+				if (!DoubleSky)
+					fg = _mm256_or_si256(fg, _mm256_set1_epi32(0xff000000));
+				Store(dest, pitch, n, fg);
+
+				frac += fracstep * n;
+				dest += pitch * n;
+				index += n;
+			}
+		}
+
+		// Texels for eight rows. The double sky uses the back texture where the front texture is transparent.
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Sample(__m256i fracs, const uint32_t *source0, const uint32_t *source1, int textureheight0, uint32_t maxtextureheight1)
+		{
+			__m256i sample_index = _mm256_srli_epi32(_mm256_slli_epi32(fracs, 8), FRACBITS);
+			sample_index = _mm256_srli_epi32(_mm256_mullo_epi32(sample_index, _mm256_set1_epi32(textureheight0)), FRACBITS);
+			__m256i fg = _mm256_i32gather_epi32((const int *)source0, sample_index, 4);
+			if (DoubleSky)
+			{
+				__m256i transparent = _mm256_cmpeq_epi32(fg, _mm256_setzero_si256());
+				if (!_mm256_testz_si256(transparent, transparent))
+				{
+					__m256i sample_index2 = _mm256_min_epu32(sample_index, _mm256_set1_epi32(maxtextureheight1));
+					fg = _mm256_mask_i32gather_epi32(fg, (const int *)source1, sample_index2, transparent, 4);
+					fg = _mm256_or_si256(fg, _mm256_and_si256(transparent, _mm256_set1_epi32(0xff000000)));
+				}
+			}
+			return fg;
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Fade(__m256i fg, __m256i fill, __m256i alpha)
+		{
+			__m256i v = _mm256_packs_epi32(alpha, alpha);
+			v = _mm256_unpacklo_epi16(v, v);
+			__m256i alpha_lo = _mm256_unpacklo_epi32(v, v);
+			__m256i alpha_hi = _mm256_unpackhi_epi32(v, v);
+			__m256i inv_alpha_lo = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_lo);
+			__m256i inv_alpha_hi = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_hi);
+
+			__m256i c_lo = _mm256_unpacklo_epi8(fg, _mm256_setzero_si256());
+			__m256i c_hi = _mm256_unpackhi_epi8(fg, _mm256_setzero_si256());
+			c_lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c_lo, alpha_lo), _mm256_mullo_epi16(fill, inv_alpha_lo)), 8);
+			c_hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c_hi, alpha_hi), _mm256_mullo_epi16(fill, inv_alpha_hi)), 8);
+			return _mm256_packus_epi16(c_lo, c_hi);
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL FracSteps(int32_t frac, int32_t fracstep)
+		{
+			return _mm256_add_epi32(_mm256_set1_epi32(frac), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(fracstep)));
+		}
+
+		FORCEINLINE AVX2_TARGET static void VECTORCALL Store(uint32_t *dest, int pitch, int n, __m256i colors)
+		{
+			uint32_t tmp[8];
+			_mm256_storeu_si256((__m256i*)tmp, colors);
+			for (int i = 0; i < n; i++)
+				dest[i * pitch] = tmp[i];
+		}
+	};
+
+	typedef DrawSky32AVX2T<false> DrawSkySingle32AVX2Command;
+	typedef DrawSky32AVX2T<true> DrawSkyDouble32AVX2Command;
+}
@@ -0,0 +1,407 @@
+/*
+**  Drawer commands for spans
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_span32_sse2.h"
+
+namespace swrenderer
+{
+	// AVX2 version of DrawSpan32T. Eight pixels are processed per iteration:
+	// the 32-bit colors are unpacked into two registers with 16-bit channels, one holding pixels 0,1,4,5 and the other 2,3,6,7.
+	template<typename BlendT>
+	class DrawSpan32AVX2T
+	{
+	public:
+		typedef typename DrawSpan32T<BlendT>::TextureData TextureData;
+
+		AVX2_TARGET static void DrawColumn(const SpanDrawerArgs& args)
+		{
+			using namespace DrawSpan32TModes;
+
+			TextureData texdata;
+			texdata.width = args.TextureWidth();
+			texdata.height = args.TextureHeight();
+			texdata.xstep = args.TextureUStep();
+			texdata.ystep = args.TextureVStep();
+			texdata.xfrac = args.TextureUPos();
+			texdata.yfrac = args.TextureVPos();
+
+			texdata.source = (const uint32_t*)args.TexturePixels();
+
+			double lod = args.TextureLOD();
+			bool mipmapped = args.MipmappedTexture();
+
+			bool magnifying = lod < 0.0;
+			if (r_mipmap && mipmapped)
+			{
+				int level = (int)lod;
+				while (level > 0)
+				{
+					if (texdata.width <= 2 || texdata.height <= 2)
+						break;
+
+					texdata.source += texdata.width * texdata.height;
+					texdata.width = max<uint32_t>(texdata.width / 2, 1);
+					texdata.height = max<uint32_t>(texdata.height / 2, 1);
+					level--;
+				}
+			}
+
+			texdata.xone = (0x80000000u / texdata.width) << 1;
+			texdata.yone = (0x80000000u / texdata.height) << 1;
+
+			bool is_nearest_filter = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
+			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
+
+			auto shade_constants = args.ColormapConstants();
+			if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+			}
+			else
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
+		FORCEINLINE AVX2_TARGET static void VECTORCALL Loop(const SpanDrawerArgs& args, TextureData texdata, ShadeConstants shade_constants)
+		{
+			using namespace DrawSpan32TModes;
+
+			// Shade constants
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			__m256i mlight = SetBGRA(256, light, light, light);
+			__m256i inv_light = SetBGRA(0, 256 - light, 256 - light, 256 - light);
+
+			__m256i inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				inv_desaturate = SetBGRA(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate);
+				shade_fade = SetBGRA(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade_fade = _mm256_mullo_epi16(shade_fade, inv_light);
+				shade_light = SetBGRA(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue);
+				desaturate = shade_constants.desaturate;
+			}
+			else
+			{
+				inv_desaturate = _mm256_setzero_si256();
+				shade_fade = _mm256_setzero_si256();
+				shade_light = _mm256_setzero_si256();
+				desaturate = 0;
+			}
+
+			auto lights = args.dc_lights;
+			auto num_lights = args.dc_num_lights;
+			float vpx = args.dc_viewpos.X;
+			float stepvpx = args.dc_viewpos_step.X;
+			__m256 viewpos_x = _mm256_add_ps(_mm256_set1_ps(vpx), _mm256_mul_ps(_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f), _mm256_set1_ps(stepvpx)));
+			__m256 step_viewpos_x = _mm256_set1_ps(stepvpx * 8.0f);
+
+			int count = args.DestX2() - args.DestX1() + 1;
+			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				texdata.xfrac -= texdata.xone / 2;
+				texdata.yfrac -= texdata.yone / 2;
+			}
+
+			uint32_t srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			uint32_t destalpha = args.DestAlpha() >> (FRACBITS - 8);
+
+			for (int index = 0; index < count; index += 8)
+			{
+				int n = min(count - index, 8);
+
+				uint32_t ifgcolor[8] = { 0 };
+				for (int i = 0; i < n; i++)
+				{
+					ifgcolor[i] = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xstep, texdata.ystep, texdata.xfrac, texdata.yfrac, texdata.source);
+					texdata.xfrac += texdata.xstep;
+					texdata.yfrac += texdata.ystep;
+				}
+
+				uint32_t desttmp[8] = { 0 };
+				__m256i bgcolor;
+				if (BlendT::Mode == (int)SpanBlendModes::Opaque)
+				{
+					bgcolor = _mm256_setzero_si256();
+				}
+				else if (n == 8)
+				{
+					bgcolor = _mm256_loadu_si256((const __m256i*)(dest + index));
+				}
+				else
+				{
+					memcpy(desttmp, dest + index, n * sizeof(uint32_t));
+					bgcolor = _mm256_loadu_si256((const __m256i*)desttmp);
+				}
+
+				__m256i fgcolor = _mm256_loadu_si256((const __m256i*)ifgcolor);
+				__m256i fg_lo = _mm256_unpacklo_epi8(fgcolor, _mm256_setzero_si256());
+				__m256i fg_hi = _mm256_unpackhi_epi8(fgcolor, _mm256_setzero_si256());
+				__m256i material_lo = fg_lo;
+				__m256i material_hi = fg_hi;
+
+				fg_lo = Shade<ShadeModeT>(fg_lo, mlight, desaturate, inv_desaturate, shade_fade, shade_light);
+				fg_hi = Shade<ShadeModeT>(fg_hi, mlight, desaturate, inv_desaturate, shade_fade, shade_light);
+				AddLights(material_lo, material_hi, fg_lo, fg_hi, lights, num_lights, viewpos_x);
+				__m256i outcolor = Blend(fg_lo, fg_hi, fgcolor, bgcolor, srcalpha, destalpha);
+
+				if (n == 8)
+				{
+					_mm256_storeu_si256((__m256i*)(dest + index), outcolor);
+				}
+				else
+				{
+					_mm256_storeu_si256((__m256i*)desttmp, outcolor);
+					memcpy(dest + index, desttmp, n * sizeof(uint32_t));
+				}
+
+				viewpos_x = _mm256_add_ps(viewpos_x, step_viewpos_x);
+			}
+		}
+
+		template<typename FilterModeT, typename TextureSizeT>
+		FORCEINLINE AVX2_TARGET static unsigned int VECTORCALL Sample(uint32_t width, uint32_t height, uint32_t xone, uint32_t yone, uint32_t xstep, uint32_t ystep, uint32_t xfrac, uint32_t yfrac, const uint32_t *source)
+		{
+			return DrawSpan32T<BlendT>::template Sample<FilterModeT, TextureSizeT>(width, height, xone, yone, xstep, ystep, xfrac, yfrac, source);
+		}
+
+		template<typename ShadeModeT>
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Shade(__m256i fgcolor, __m256i mlight, int desaturate, __m256i inv_desaturate, __m256i shade_fade, __m256i shade_light)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, mlight), 8);
+			}
+			else
+			{
+				__m256i intensity = Intensity(fgcolor, desaturate);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, inv_desaturate), intensity), 8);
+				fgcolor = _mm256_mullo_epi16(fgcolor, mlight);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade_fade, fgcolor), 8);
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade_light), 8);
+			}
+			return fgcolor;
+		}
+
+		FORCEINLINE AVX2_TARGET static void VECTORCALL AddLights(__m256i material_lo, __m256i material_hi, __m256i &fgcolor_lo, __m256i &fgcolor_hi, const DrawerLight *lights, int num_lights, __m256 viewpos_x)
+		{
+			__m256i lit_lo = _mm256_setzero_si256();
+			__m256i lit_hi = _mm256_setzero_si256();
+
+			for (int i = 0; i != num_lights; i++)
+			{
+				__m256 light_x = _mm256_set1_ps(lights[i].x);
+				__m256 light_y = _mm256_set1_ps(lights[i].y);
+				__m256 light_z = _mm256_set1_ps(lights[i].z);
+				__m256 light_radius = _mm256_set1_ps(lights[i].radius);
+				__m256 m256 = _mm256_set1_ps(256.0f);
+
+				// L = light-pos
+				// dist = sqrt(dot(L, L))
+				// distance_attenuation = 1 - min(dist * (1/radius), 1)
+				__m256 Lyz2 = light_y; // L.y*L.y + L.z*L.z
+				__m256 Lx = _mm256_sub_ps(light_x, viewpos_x);
+				__m256 dist2 = _mm256_add_ps(Lyz2, _mm256_mul_ps(Lx, Lx));
+				__m256 rcp_dist = _mm256_rsqrt_ps(dist2);
+				__m256 dist = _mm256_mul_ps(dist2, rcp_dist);
+				__m256 distance_attenuation = _mm256_sub_ps(m256, _mm256_min_ps(_mm256_mul_ps(dist, light_radius), m256));
+
+				// The simple light type
+				__m256 simple_attenuation = distance_attenuation;
+
+				// The point light type
+				// diffuse = dot(N,L) * attenuation
+				__m256 point_attenuation = _mm256_mul_ps(_mm256_mul_ps(light_z, rcp_dist), distance_attenuation);
+
+				__m256 is_attenuated = _mm256_cmp_ps(light_z, _mm256_setzero_ps(), _CMP_EQ_OQ);
+				__m256i attenuation = _mm256_cvtps_epi32(_mm256_blendv_ps(point_attenuation, simple_attenuation, is_attenuated));
+
+				__m256i attenuation_lo, attenuation_hi;
+				Expand(attenuation, attenuation_lo, attenuation_hi);
+
+				__m256i light_color = _mm256_broadcastq_epi64(_mm_unpacklo_epi8(_mm_cvtsi32_si128(lights[i].color), _mm_setzero_si128()));
+
+				lit_lo = _mm256_add_epi16(lit_lo, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, attenuation_lo), 8));
+				lit_hi = _mm256_add_epi16(lit_hi, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, attenuation_hi), 8));
+			}
+
+			lit_lo = _mm256_min_epi16(lit_lo, _mm256_set1_epi16(256));
+			lit_hi = _mm256_min_epi16(lit_hi, _mm256_set1_epi16(256));
+
+			fgcolor_lo = _mm256_add_epi16(fgcolor_lo, _mm256_srli_epi16(_mm256_mullo_epi16(material_lo, lit_lo), 8));
+			fgcolor_hi = _mm256_add_epi16(fgcolor_hi, _mm256_srli_epi16(_mm256_mullo_epi16(material_hi, lit_hi), 8));
+			fgcolor_lo = _mm256_min_epi16(fgcolor_lo, _mm256_set1_epi16(255));
+			fgcolor_hi = _mm256_min_epi16(fgcolor_hi, _mm256_set1_epi16(255));
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Blend(__m256i fgcolor_lo, __m256i fgcolor_hi, __m256i ifgcolor, __m256i bgcolor, uint32_t srcalpha, uint32_t destalpha)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (BlendT::Mode == (int)SpanBlendModes::Opaque)
+			{
+				__m256i outcolor = _mm256_packus_epi16(fgcolor_lo, fgcolor_hi);
+				outcolor = _mm256_or_si256(outcolor, _mm256_set1_epi32(0xff000000));
+				return outcolor;
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::Masked)
+			{
+				__m256i fgcolor = _mm256_packus_epi16(fgcolor_lo, fgcolor_hi);
+				__m256i mask = _mm256_cmpeq_epi32(fgcolor, _mm256_setzero_si256());
+				__m256i outcolor = _mm256_blendv_epi8(fgcolor, bgcolor, mask);
+				outcolor = _mm256_or_si256(outcolor, _mm256_set1_epi32(0xff000000));
+				return outcolor;
+			}
+			else
+			{
+				__m256i fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				if (BlendT::Mode == (int)SpanBlendModes::Translucent)
+				{
+					fgalpha_lo = fgalpha_hi = _mm256_set1_epi16(srcalpha);
+					bgalpha_lo = bgalpha_hi = _mm256_set1_epi16(destalpha);
+				}
+				else
+				{
+					__m256i alpha = _mm256_srli_epi32(ifgcolor, 24);
+					alpha = _mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 7)); // 255->256
+					__m256i inv_alpha = _mm256_sub_epi32(_mm256_set1_epi32(256), alpha);
+
+					__m256i bgalpha = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(destalpha), alpha), _mm256_slli_epi32(inv_alpha, 8));
+					bgalpha = _mm256_srli_epi32(_mm256_add_epi32(bgalpha, _mm256_set1_epi32(128)), 8);
+					__m256i fgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(srcalpha), alpha);
+					fgalpha = _mm256_srli_epi32(_mm256_add_epi32(fgalpha, _mm256_set1_epi32(128)), 8);
+
+					Expand(fgalpha, fgalpha_lo, fgalpha_hi);
+					Expand(bgalpha, bgalpha_lo, bgalpha_hi);
+				}
+
+				__m256i bgcolor_lo = _mm256_unpacklo_epi8(bgcolor, _mm256_setzero_si256());
+				__m256i bgcolor_hi = _mm256_unpackhi_epi8(bgcolor, _mm256_setzero_si256());
+
+				__m256i out_lo = BlendHalf(fgcolor_lo, bgcolor_lo, fgalpha_lo, bgalpha_lo);
+				__m256i out_hi = BlendHalf(fgcolor_hi, bgcolor_hi, fgalpha_hi, bgalpha_hi);
+				__m256i outcolor = _mm256_packus_epi16(out_lo, out_hi);
+				outcolor = _mm256_or_si256(outcolor, _mm256_set1_epi32(0xff000000));
+				return outcolor;
+			}
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL BlendHalf(__m256i fgcolor, __m256i bgcolor, __m256i fgalpha, __m256i bgalpha)
+		{
+			using namespace DrawSpan32TModes;
+
+			fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+			bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+			__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+			__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+			__m256i out_lo, out_hi;
+			if (BlendT::Mode == (int)SpanBlendModes::SubClamp)
+			{
+				out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::RevSubClamp)
+			{
+				out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+				out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+			}
+			else
+			{
+				out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+			}
+
+			out_lo = _mm256_srai_epi32(out_lo, 8);
+			out_hi = _mm256_srai_epi32(out_hi, 8);
+			return _mm256_packs_epi32(out_lo, out_hi);
+		}
+
+		// Desaturation intensity ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate, placed in the color channels of each pixel
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Intensity(__m256i fgcolor, int desaturate)
+		{
+			__m256i sum = _mm256_madd_epi16(fgcolor, SetBGRA(0, 77, 143, 37));
+			sum = _mm256_add_epi32(sum, _mm256_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			__m256i intensity = _mm256_mullo_epi16(_mm256_srli_epi32(sum, 8), _mm256_set1_epi32(desaturate));
+			intensity = _mm256_or_si256(intensity, _mm256_slli_epi32(intensity, 16));
+			return _mm256_and_si256(intensity, _mm256_set1_epi64x(0x0000ffffffffffffLL));
+		}
+
+		// Spreads one 32-bit value per pixel into all four 16-bit channels of the matching pixel in the lo and hi registers
+		FORCEINLINE AVX2_TARGET static void VECTORCALL Expand(__m256i values, __m256i &lo, __m256i &hi)
+		{
+			__m256i v = _mm256_packs_epi32(values, values);
+			v = _mm256_unpacklo_epi16(v, v);
+			lo = _mm256_unpacklo_epi32(v, v);
+			hi = _mm256_unpackhi_epi32(v, v);
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL SetBGRA(int alpha, int red, int green, int blue)
+		{
+			return _mm256_set_epi16(alpha, red, green, blue, alpha, red, green, blue, alpha, red, green, blue, alpha, red, green, blue);
+		}
+	};
+
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::OpaqueSpan> DrawSpan32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::MaskedSpan> DrawSpanMasked32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::TranslucentSpan> DrawSpanTranslucent32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::AddClampSpan> DrawSpanAddClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::SubClampSpan> DrawSpanSubClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::RevSubClampSpan> DrawSpanRevSubClamp32AVX2Command;
+}
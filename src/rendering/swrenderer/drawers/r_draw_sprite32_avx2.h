@@ -0,0 +1,361 @@
+/*
+**  Drawer commands for sprites
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_sprite32_sse2.h"
+
+namespace swrenderer
+{
+	// AVX2 version of DrawSprite32T. Eight pixels are processed per iteration:
+	// the 32-bit colors are unpacked into two registers with 16-bit channels, one holding pixels 0,1,4,5 and the other 2,3,6,7.
+	template<typename BlendT, typename SamplerT>
+	class DrawSprite32AVX2T
+	{
+	public:
+		AVX2_TARGET static void DrawColumn(const SpriteDrawerArgs& args)
+		{
+			using namespace DrawSprite32TModes;
+
+			auto shade_constants = args.ColormapConstants();
+			if (SamplerT::Mode == (int)SpriteSamplers::Texture)
+			{
+				const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
+				bool is_nearest_filter = (source2 == nullptr);
+
+				if (shade_constants.simple_shade)
+				{
+					if (is_nearest_filter)
+						Loop<SimpleShade, NearestFilter>(args, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter>(args, shade_constants);
+				}
+				else
+				{
+					if (is_nearest_filter)
+						Loop<AdvancedShade, NearestFilter>(args, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter>(args, shade_constants);
+				}
+			}
+			else // no linear filtering for translated, shaded or fill
+			{
+				if (shade_constants.simple_shade)
+				{
+					Loop<SimpleShade, NearestFilter>(args, shade_constants);
+				}
+				else
+				{
+					Loop<AdvancedShade, NearestFilter>(args, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT>
+		FORCEINLINE AVX2_TARGET static void VECTORCALL Loop(const SpriteDrawerArgs& args, ShadeConstants shade_constants)
+		{
+			using namespace DrawSprite32TModes;
+
+			const uint32_t *source;
+			const uint32_t *source2;
+			const uint8_t *colormap;
+			const uint32_t *translation;
+
+			if (SamplerT::Mode == (int)SpriteSamplers::Shaded || SamplerT::Mode == (int)SpriteSamplers::Translated)
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = nullptr;
+				colormap = args.Colormap(args.Viewport());
+				translation = (const uint32_t*)args.TranslationMap();
+			}
+			else
+			{
+				source = (const uint32_t*)args.TexturePixels();
+				source2 = (const uint32_t*)args.TexturePixels2();
+				colormap = nullptr;
+				translation = nullptr;
+			}
+
+			int textureheight = args.TextureHeight();
+			uint32_t one = ((0x20000000 + textureheight - 1) / textureheight) * 2 + 1;
+
+			// Shade constants
+			__m256i dynlight = _mm256_broadcastq_epi64(_mm_unpacklo_epi8(_mm_cvtsi32_si128(args.DynamicLight()), _mm_setzero_si128()));
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			__m256i mlight = SetBGRA(256, light, light, light);
+
+			__m256i inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			__m256i lightcontrib;
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				__m256i inv_light = SetBGRA(0, 256 - light, 256 - light, 256 - light);
+				inv_desaturate = SetBGRA(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate);
+				shade_fade = SetBGRA(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade_fade = _mm256_mullo_epi16(shade_fade, inv_light);
+				shade_light = SetBGRA(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue);
+				desaturate = shade_constants.desaturate;
+
+				lightcontrib = _mm256_min_epi16(_mm256_add_epi16(mlight, dynlight), _mm256_set1_epi16(256));
+				lightcontrib = _mm256_sub_epi16(lightcontrib, mlight);
+			}
+			else
+			{
+				inv_desaturate = _mm256_setzero_si256();
+				shade_fade = _mm256_setzero_si256();
+				shade_light = _mm256_setzero_si256();
+				desaturate = 0;
+				lightcontrib = _mm256_setzero_si256();
+
+				mlight = _mm256_min_epi16(_mm256_add_epi16(mlight, dynlight), _mm256_set1_epi16(256));
+			}
+
+			int count = args.Count();
+			if (count <= 0) return;
+			int pitch = args.Viewport()->RenderTarget->GetPitch();
+			uint32_t fracstep = args.TextureVStep();
+			uint32_t frac = args.TextureVPos();
+			uint32_t texturefracx = args.TextureUPos();
+			uint32_t *dest = (uint32_t*)args.Dest();
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				frac -= one / 2;
+			}
+
+			uint32_t srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			uint32_t destalpha = args.DestAlpha() >> (FRACBITS - 8);
+			uint32_t srccolor = args.SrcColorBgra();
+			uint32_t color = LightBgra::shade_bgra_simple(args.SolidColorBgra(),
+				LightBgra::calc_light_multiplier(light));
+
+			for (int index = 0; index < count; index += 8)
+			{
+				int n = min(count - index, 8);
+				uint32_t *destline = dest + index * pitch;
+
+				uint32_t desttmp[8] = { 0 };
+				uint32_t ifgcolor[8] = { 0 };
+				uint32_t ifgshade[8] = { 0 };
+				for (int i = 0; i < n; i++)
+				{
+					if (BlendT::Mode != (int)SpriteBlendModes::Opaque && BlendT::Mode != (int)SpriteBlendModes::Copy)
+						desttmp[i] = destline[i * pitch];
+
+					ifgcolor[i] = Sample<FilterModeT>(frac, source, source2, translation, textureheight, one, texturefracx, color, srccolor);
+					ifgshade[i] = SampleShade(frac, source, colormap);
+					frac += fracstep;
+				}
+
+				__m256i fgcolor = _mm256_loadu_si256((const __m256i*)ifgcolor);
+				__m256i bgcolor = _mm256_loadu_si256((const __m256i*)desttmp);
+				__m256i fgshade = _mm256_loadu_si256((const __m256i*)ifgshade);
+
+				__m256i fg_lo = _mm256_unpacklo_epi8(fgcolor, _mm256_setzero_si256());
+				__m256i fg_hi = _mm256_unpackhi_epi8(fgcolor, _mm256_setzero_si256());
+
+				fg_lo = Shade<ShadeModeT>(fg_lo, mlight, desaturate, inv_desaturate, shade_fade, shade_light, lightcontrib);
+				fg_hi = Shade<ShadeModeT>(fg_hi, mlight, desaturate, inv_desaturate, shade_fade, shade_light, lightcontrib);
+				__m256i outcolor = Blend(fg_lo, fg_hi, fgcolor, bgcolor, fgshade, srcalpha, destalpha);
+
+				_mm256_storeu_si256((__m256i*)desttmp, outcolor);
+				for (int i = 0; i < n; i++)
+					destline[i * pitch] = desttmp[i];
+			}
+		}
+
+		template<typename FilterModeT>
+		FORCEINLINE AVX2_TARGET static unsigned int VECTORCALL Sample(uint32_t frac, const uint32_t *source, const uint32_t *source2, const uint32_t *translation, int textureheight, uint32_t one, uint32_t texturefracx, uint32_t color, uint32_t srccolor)
+		{
+			return DrawSprite32T<BlendT, SamplerT>::template Sample<FilterModeT>(frac, source, source2, translation, textureheight, one, texturefracx, color, srccolor);
+		}
+
+		FORCEINLINE AVX2_TARGET static unsigned int VECTORCALL SampleShade(uint32_t frac, const uint32_t *source, const uint8_t *colormap)
+		{
+			return DrawSprite32T<BlendT, SamplerT>::SampleShade(frac, source, colormap);
+		}
+
+		template<typename ShadeModeT>
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Shade(__m256i fgcolor, __m256i mlight, int desaturate, __m256i inv_desaturate, __m256i shade_fade, __m256i shade_light, __m256i lightcontrib)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Copy)
+				return fgcolor;
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, mlight), 8);
+				return fgcolor;
+			}
+			else
+			{
+				__m256i lit_dynlight = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, lightcontrib), 8);
+
+				__m256i intensity = Intensity(fgcolor, desaturate);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, inv_desaturate), intensity), 8);
+				fgcolor = _mm256_mullo_epi16(fgcolor, mlight);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade_fade, fgcolor), 8);
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade_light), 8);
+
+				fgcolor = _mm256_add_epi16(fgcolor, lit_dynlight);
+				fgcolor = _mm256_min_epi16(fgcolor, _mm256_set1_epi16(255));
+				return fgcolor;
+			}
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Blend(__m256i fgcolor_lo, __m256i fgcolor_hi, __m256i ifgcolor, __m256i bgcolor, __m256i ifgshade, uint32_t srcalpha, uint32_t destalpha)
+		{
+			using namespace DrawSprite32TModes;
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Opaque || BlendT::Mode == (int)SpriteBlendModes::Copy)
+			{
+				__m256i outcolor = _mm256_packus_epi16(fgcolor_lo, fgcolor_hi);
+				outcolor = _mm256_or_si256(outcolor, _mm256_set1_epi32(0xff000000));
+				return outcolor;
+			}
+
+			__m256i bgcolor_lo = _mm256_unpacklo_epi8(bgcolor, _mm256_setzero_si256());
+			__m256i bgcolor_hi = _mm256_unpackhi_epi8(bgcolor, _mm256_setzero_si256());
+			__m256i out_lo, out_hi;
+
+			if (BlendT::Mode == (int)SpriteBlendModes::Shaded)
+			{
+				__m256i alpha_lo, alpha_hi;
+				Expand(ifgshade, alpha_lo, alpha_hi);
+				__m256i inv_alpha_lo = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_lo);
+				__m256i inv_alpha_hi = _mm256_sub_epi16(_mm256_set1_epi16(256), alpha_hi);
+
+				out_lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor_lo, alpha_lo), _mm256_mullo_epi16(bgcolor_lo, inv_alpha_lo)), 8);
+				out_hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor_hi, alpha_hi), _mm256_mullo_epi16(bgcolor_hi, inv_alpha_hi)), 8);
+			}
+			else if (BlendT::Mode == (int)SpriteBlendModes::AddClampShaded)
+			{
+				__m256i alpha_lo, alpha_hi;
+				Expand(ifgshade, alpha_lo, alpha_hi);
+
+				out_lo = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(fgcolor_lo, alpha_lo), 8), bgcolor_lo);
+				out_hi = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(fgcolor_hi, alpha_hi), 8), bgcolor_hi);
+			}
+			else
+			{
+				__m256i alpha = _mm256_srli_epi32(ifgcolor, 24);
+				alpha = _mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 7)); // 255->256
+				__m256i inv_alpha = _mm256_sub_epi32(_mm256_set1_epi32(256), alpha);
+
+				__m256i bgalpha = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(destalpha), alpha), _mm256_slli_epi32(inv_alpha, 8));
+				bgalpha = _mm256_srli_epi32(_mm256_add_epi32(bgalpha, _mm256_set1_epi32(128)), 8);
+				__m256i fgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(srcalpha), alpha);
+				fgalpha = _mm256_srli_epi32(_mm256_add_epi32(fgalpha, _mm256_set1_epi32(128)), 8);
+
+				__m256i fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				Expand(fgalpha, fgalpha_lo, fgalpha_hi);
+				Expand(bgalpha, bgalpha_lo, bgalpha_hi);
+
+				out_lo = BlendHalf(fgcolor_lo, bgcolor_lo, fgalpha_lo, bgalpha_lo);
+				out_hi = BlendHalf(fgcolor_hi, bgcolor_hi, fgalpha_hi, bgalpha_hi);
+			}
+
+			__m256i outcolor = _mm256_packus_epi16(out_lo, out_hi);
+			outcolor = _mm256_or_si256(outcolor, _mm256_set1_epi32(0xff000000));
+			return outcolor;
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL BlendHalf(__m256i fgcolor, __m256i bgcolor, __m256i fgalpha, __m256i bgalpha)
+		{
+			using namespace DrawSprite32TModes;
+
+			fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+			bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+			__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+			__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+			__m256i out_lo, out_hi;
+			if (BlendT::Mode == (int)SpriteBlendModes::SubClamp)
+			{
+				out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+			}
+			else if (BlendT::Mode == (int)SpriteBlendModes::RevSubClamp)
+			{
+				out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+				out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+			}
+			else
+			{
+				out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+			}
+
+			out_lo = _mm256_srai_epi32(out_lo, 8);
+			out_hi = _mm256_srai_epi32(out_hi, 8);
+			return _mm256_packs_epi32(out_lo, out_hi);
+		}
+
+		// Desaturation intensity ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate, placed in the color channels of each pixel
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL Intensity(__m256i fgcolor, int desaturate)
+		{
+			__m256i sum = _mm256_madd_epi16(fgcolor, SetBGRA(0, 77, 143, 37));
+			sum = _mm256_add_epi32(sum, _mm256_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			__m256i intensity = _mm256_mullo_epi16(_mm256_srli_epi32(sum, 8), _mm256_set1_epi32(desaturate));
+			intensity = _mm256_or_si256(intensity, _mm256_slli_epi32(intensity, 16));
+			return _mm256_and_si256(intensity, _mm256_set1_epi64x(0x0000ffffffffffffLL));
+		}
+
+		// Spreads one 32-bit value per pixel into all four 16-bit channels of the matching pixel in the lo and hi registers
+		FORCEINLINE AVX2_TARGET static void VECTORCALL Expand(__m256i values, __m256i &lo, __m256i &hi)
+		{
+			__m256i v = _mm256_packs_epi32(values, values);
+			v = _mm256_unpacklo_epi16(v, v);
+			lo = _mm256_unpacklo_epi32(v, v);
+			hi = _mm256_unpackhi_epi32(v, v);
+		}
+
+		FORCEINLINE AVX2_TARGET static __m256i VECTORCALL SetBGRA(int alpha, int red, int green, int blue)
+		{
+			return _mm256_set_epi16(alpha, red, green, blue, alpha, red, green, blue, alpha, red, green, blue, alpha, red, green, blue);
+		}
+	};
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::CopySprite, DrawSprite32TModes::TextureSampler> DrawSpriteCopy32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TextureSampler> DrawSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TextureSampler> DrawSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::FillSampler> FillSprite32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::FillSampler> FillSpriteAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::FillSampler> FillSpriteRevSubClamp32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::ShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteShaded32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampShadedSprite, DrawSprite32TModes::ShadedSampler> DrawSpriteAddClampShaded32AVX2Command;
+
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::OpaqueSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslated32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::AddClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedAddClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::SubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedSubClamp32AVX2Command;
+	typedef DrawSprite32AVX2T<DrawSprite32TModes::RevSubClampSprite, DrawSprite32TModes::TranslatedSampler> DrawSpriteTranslatedRevSubClamp32AVX2Command;
+}
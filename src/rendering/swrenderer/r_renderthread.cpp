@@ -74,7 +74,12 @@ namespace swrenderer
 		PlaneList.reset(new VisiblePlaneList(this));
 		DrawSegments.reset(new DrawSegmentList(this));
 		ClipSegments.reset(new RenderClipSegment());
-		tc_drawers.reset(new SWTruecolorDrawers(this));
+#ifndef NO_SSE
+		if (SWTruecolorDrawersAVX2::IsSupported())
+			tc_drawers.reset(new SWTruecolorDrawersAVX2(this));
+		else
+#endif
+			tc_drawers.reset(new SWTruecolorDrawers(this));
 		pal_drawers.reset(new SWPalDrawers(this));
 	}
 
@@ -63,11 +63,14 @@ EXTERN_CVAR(Int, r_clearbuffer)
 EXTERN_CVAR(Int, r_debug_draw)
 
 CVAR(Int, r_scene_multithreaded, 1, 0);
+CVAR(Int, r_scene_slicing, 1, 0);		// 0 = equal slices, 1 = adaptive slices, 2 = work stealing tiles
+CVAR(Int, r_scene_tilesperthread, 4, 0);
 CVAR(Bool, r_models, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 
 namespace swrenderer
 {
 	cycle_t WallCycles, PlaneCycles, MaskedCycles;
+	static std::vector<double> SliceTimes;	// per thread render times of the last frame, for the swfps stat
 	
 	RenderScene::RenderScene()
 	{
@@ -186,15 +189,12 @@ namespace swrenderer
 			StartThreads(numThreads);
 		}
 
+		// Camera textures use different view sizes, so they always get equal slices to not disturb the adaption of the main view.
+		bool adaptive = r_scene_slicing == 1 && !MainThread()->Viewport->RenderingToCanvas;
+
 		// Setup threads:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
-		for (int i = 0; i < numThreads; i++)
-		{
-			*Threads[i]->Viewport = *MainThread()->Viewport;
-			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
-		}
+		SetupSlices(numThreads, adaptive);
 		run_id++;
 		FSoftwareTexture::CurrentUpdate = run_id;
 		start_lock.unlock();
@@ -206,7 +206,7 @@ namespace swrenderer
 		}
 
 		// Do the main thread ourselves:
-		RenderThreadSlice(MainThread());
+		RenderThreadWork(MainThread());
 
 		// Wait for everyone to finish:
 		if (Threads.size() > 1)
@@ -221,11 +221,138 @@ namespace swrenderer
 			finished_threads = 0;
 		}
 
+		SliceTimes.resize(Threads.size());
+		for (size_t i = 0; i < Threads.size(); i++)
+			SliceTimes[i] = Threads[i]->SliceTimeMS;
+
+		if (adaptive)
+			UpdateSliceEdges();
+
 		// Change main thread back to covering the whole screen for player sprites
 		MainThread()->X1 = 0;
 		MainThread()->X2 = viewwidth;
 	}
 
+	void RenderScene::SetupSlices(int numThreads, bool adaptive)
+	{
+		UseTiles = r_scene_slicing == 2 && numThreads > 1;
+
+		if (UseTiles)
+		{
+			// Keep an untouched copy of the view, as portals modify the thread's viewport while rendering a tile
+			if (!TileViewport)
+			{
+				TileViewport.reset(new RenderViewport());
+				TileLight.reset(new LightVisibility());
+			}
+			*TileViewport = *MainThread()->Viewport;
+			*TileLight = *MainThread()->Light;
+
+			TileCount = clamp(numThreads * (int)r_scene_tilesperthread, numThreads, max(viewwidth / 8, numThreads));
+			NextTile = 0;
+		}
+		else if (adaptive && (SliceEdges.size() != (size_t)numThreads + 1 || SliceEdges.back() != viewwidth))
+		{
+			SliceEdges.resize(numThreads + 1);
+			for (int i = 0; i <= numThreads; i++)
+				SliceEdges[i] = viewwidth * i / numThreads;
+		}
+
+		for (int i = 0; i < numThreads; i++)
+		{
+			*Threads[i]->Viewport = *MainThread()->Viewport;
+			*Threads[i]->Light = *MainThread()->Light;
+			if (adaptive && !UseTiles)
+			{
+				Threads[i]->X1 = SliceEdges[i];
+				Threads[i]->X2 = SliceEdges[i + 1];
+			}
+			else
+			{
+				Threads[i]->X1 = viewwidth * i / numThreads;
+				Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			}
+		}
+	}
+
+	// Moves the slice edges so that every thread gets about the same amount of work in the next frame.
+	// The cost of a slice is assumed to be evenly spread over its columns.
+	void RenderScene::UpdateSliceEdges()
+	{
+		int numThreads = (int)Threads.size();
+		if (numThreads < 2 || UseTiles)
+			return;
+
+		double total = 0.0;
+		for (auto &thread : Threads)
+			total += thread->SliceTimeMS;
+		if (total <= 0.0)
+			return;
+
+		std::vector<int> edges(numThreads + 1);
+		edges[0] = 0;
+		edges[numThreads] = viewwidth;
+
+		int slice = 0;
+		double before = 0.0; // cost of all slices left of the current one
+		for (int i = 1; i < numThreads; i++)
+		{
+			double target = total * i / numThreads;
+			while (slice < numThreads - 1 && before + Threads[slice]->SliceTimeMS < target)
+			{
+				before += Threads[slice]->SliceTimeMS;
+				slice++;
+			}
+
+			double cost = Threads[slice]->SliceTimeMS;
+			double frac = cost > 0.0 ? clamp((target - before) / cost, 0.0, 1.0) : 0.5;
+			double x = SliceEdges[slice] + frac * (SliceEdges[slice + 1] - SliceEdges[slice]);
+
+			// Only move halfway to dampen oscillation caused by frame to frame noise
+			edges[i] = xs_RoundToInt((SliceEdges[i] + x) * 0.5);
+		}
+
+		// Keep a minimum width so that a slice can always find its way back
+		int minwidth = max(viewwidth / (numThreads * 8), 1);
+		for (int i = 1; i < numThreads; i++)
+			edges[i] = max(edges[i], edges[i - 1] + minwidth);
+		for (int i = numThreads - 1; i > 0; i--)
+			edges[i] = min(edges[i], edges[i + 1] - minwidth);
+
+		SliceEdges = edges;
+	}
+
+	void RenderScene::RenderThreadWork(RenderThread *thread)
+	{
+		cycle_t cycles;
+		cycles.Reset();
+		cycles.Clock();
+
+		if (UseTiles)
+			RenderThreadTiles(thread);
+		else
+			RenderThreadSlice(thread);
+
+		cycles.Unclock();
+		thread->SliceTimeMS = cycles.TimeMS();
+	}
+
+	void RenderScene::RenderThreadTiles(RenderThread *thread)
+	{
+		while (true)
+		{
+			int tile = NextTile++;
+			if (tile >= TileCount)
+				break;
+
+			*thread->Viewport = *TileViewport;
+			*thread->Light = *TileLight;
+			thread->X1 = viewwidth * tile / TileCount;
+			thread->X2 = viewwidth * (tile + 1) / TileCount;
+			RenderThreadSlice(thread);
+		}
+	}
+
 	void RenderScene::RenderThreadSlice(RenderThread *thread)
 	{
 		thread->FrameMemory->Clear();
@@ -313,7 +440,7 @@ namespace swrenderer
 					last_run_id = run_id;
 					start_lock.unlock();
 
-					RenderThreadSlice(renderthread);
+					RenderThreadWork(renderthread);
 
 					// Notify main thread that we finished:
 					std::unique_lock<std::mutex> end_lock(end_mutex);
@@ -393,6 +520,16 @@ namespace swrenderer
 		FString out;
 		out.Format("frame=%04.1f ms  walls=%04.1f ms  planes=%04.1f ms  masked=%04.1f ms",
 			FrameCycles.TimeMS(), WallCycles.TimeMS(), PlaneCycles.TimeMS(), MaskedCycles.TimeMS());
+
+		if (SliceTimes.size() > 1)
+		{
+			out += "\nthreads=";
+			for (double time : SliceTimes)
+			{
+				out.AppendFormat(" %04.1f", time);
+			}
+			out += " ms";
+		}
 		return out;
 	}
 
@@ -27,6 +27,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include "r_defs.h"
 #include "d_player.h"
 
@@ -37,6 +38,8 @@ namespace swrenderer
 	extern cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
 
 	class RenderThread;
+	class RenderViewport;
+	class LightVisibility;
 	
 	class RenderScene
 	{
@@ -58,7 +61,11 @@ namespace swrenderer
 	private:
 		void RenderActorView(AActor *actor,bool renderplayersprite, bool dontmaplines);
 		void RenderThreadSlices();
+		void RenderThreadWork(RenderThread *thread);
 		void RenderThreadSlice(RenderThread *thread);
+		void RenderThreadTiles(RenderThread *thread);
+		void SetupSlices(int numThreads, bool adaptive);
+		void UpdateSliceEdges();
 		void RenderPSprites();
 
 		void StartThreads(size_t numThreads);
@@ -75,5 +82,15 @@ namespace swrenderer
 		std::mutex end_mutex;
 		std::condition_variable end_condition;
 		size_t finished_threads = 0;
+
+		// Column boundaries for the adaptive slicing. Slice i covers SliceEdges[i] to SliceEdges[i + 1].
+		std::vector<int> SliceEdges;
+
+		// Work stealing tiles
+		bool UseTiles = false;
+		int TileCount = 0;
+		std::atomic<int> NextTile = { 0 };
+		std::unique_ptr<RenderViewport> TileViewport;
+		std::unique_ptr<LightVisibility> TileLight;
 	};
 }
@@ -808,6 +808,7 @@ DEFINE_ACTION_FUNCTION_NATIVE(_Sector, SetXOffset, SetXOffset)
   static void SetPlaneTexZ(sector_t *self, int pos, double o, bool)
   {
 	  self->SetPlaneTexZ(pos, o, true);	// not setting 'dirty' here is a guaranteed cause for problems.
+	  self->Level->SightGeometry++;
   }
 
  DEFINE_ACTION_FUNCTION_NATIVE(_Sector, SetPlaneTexZ, SetPlaneTexZ)
@@ -816,7 +817,7 @@ DEFINE_ACTION_FUNCTION_NATIVE(_Sector, SetXOffset, SetXOffset)
 	 PARAM_INT(pos);
 	 PARAM_FLOAT(o);
 	 PARAM_BOOL(dirty);
-	 self->SetPlaneTexZ(pos, o, true);	// not setting 'dirty' here is a guaranteed cause for problems.
+	 SetPlaneTexZ(self, pos, o, dirty);
 	 return 0;
  }
 
@@ -43,11 +43,15 @@
 
 #include "doomdata.h"
 #include "nodebuild.h"
+#include "threadpool.h"
 
 const int MaxSegs = 64;
 const int SplitCost = 8;
 const int AAPreference = 16;
 
+// Minimum amount of work (candidates * segs in set) before splitter scoring is spread across threads
+const int ParallelScoreThreshold = 32768;
+
 #if 0
 #define D(x) x
 #else
@@ -55,7 +59,7 @@ const int AAPreference = 16;
 #endif
 
 FNodeBuilder::FNodeBuilder(FLevel &lev)
-: Level(lev), GLNodes(false), SegsStuffed(0)
+: Level(lev), GLNodes(false), SegsStuffed(0), ThreadPool(NULL)
 {
 	VertexMap = NULL;
 	OldVertexTable = NULL;
@@ -63,15 +67,21 @@ FNodeBuilder::FNodeBuilder(FLevel &lev)
 
 FNodeBuilder::FNodeBuilder (FLevel &lev,
 							TArray<FPolyStart> &polyspots, TArray<FPolyStart> &anchors,
-							bool makeGLNodes)
-	: Level(lev), GLNodes(makeGLNodes), SegsStuffed(0)
+							bool makeGLNodes, int numThreads)
+	: Level(lev), GLNodes(makeGLNodes), SegsStuffed(0), ThreadPool(NULL)
 {
 	VertexMap = new FVertexMap (*this, Level.MinX, Level.MinY, Level.MaxX, Level.MaxY);
 	FindUsedVertices (Level.Vertices, Level.NumVertices);
 	MakeSegsFromSides ();
 	FindPolyContainers (polyspots, anchors);
 	GroupSegPlanes ();
+	if (numThreads != 1)
+	{
+		ThreadPool = new FThreadPool (numThreads);
+	}
 	BuildTree ();
+	delete ThreadPool;
+	ThreadPool = NULL;
 }
 
 FNodeBuilder::~FNodeBuilder()
@@ -445,6 +455,7 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 	uint32_t bestseg;
 	uint32_t seg;
 	bool nosplitters = false;
+	unsigned int segsInSet = 0;
 
 	bestvalue = 0;
 	bestseg = UINT_MAX;
@@ -456,6 +467,8 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 
 	D(Printf (PRINT_LOG, "Processing set %d\n", set));
 
+	// Gather one seg from each plane as a splitter candidate
+	Candidates.Clear();
 	while (seg != UINT_MAX)
 	{
 		FPrivSeg *pseg = &Segs[seg];
@@ -473,26 +486,52 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 				}
 
 				stepleft = step;
-				SetNodeFromSeg (node, pseg);
-
-				int value = Heuristic (node, set, nosplit);
-
-				D(Printf (PRINT_LOG, "Seg %5d, ld %d (%5d,%5d)-(%5d,%5d) scores %d\n", seg, Segs[seg].linedef, node.x>>16, node.y>>16,
-					(node.x+node.dx)>>16, (node.y+node.dy)>>16, value));
-
-				if (value > bestvalue)
-				{
-					bestvalue = value;
-					bestseg = seg;
-				}
-				else if (value < 0)
-				{
-					nosplitters = true;
-				}
+				Candidates.Push (seg);
 			}
 		}
 
 		seg = pseg->next;
+		segsInSet++;
+	}
+
+	// Score the candidates. Heuristic only reads the seg and vertex lists, so the
+	// candidates can be evaluated in any order on any thread.
+	CandidateScores.Resize (Candidates.Size());
+	if (ThreadPool != NULL && Candidates.Size() > 1 && (uint64_t)Candidates.Size() * segsInSet >= ParallelScoreThreshold)
+	{
+		ThreadPool->Run ((int)Candidates.Size(), [&](int i)
+		{
+			thread_local TArray<int> touched, colinear;
+			node_t candnode;
+			SetNodeFromSeg (candnode, &Segs[Candidates[i]]);
+			CandidateScores[i] = Heuristic (candnode, set, nosplit, touched, colinear);
+		});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < Candidates.Size(); ++i)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates[i]]);
+			CandidateScores[i] = Heuristic (node, set, nosplit);
+		}
+	}
+
+	// Pick the best one in seg order so that the result does not depend on the thread count
+	for (unsigned int i = 0; i < Candidates.Size(); ++i)
+	{
+		int value = CandidateScores[i];
+
+		D(Printf (PRINT_LOG, "Seg %5d, ld %d scores %d\n", Candidates[i], Segs[Candidates[i]].linedef, value));
+
+		if (value > bestvalue)
+		{
+			bestvalue = value;
+			bestseg = Candidates[i];
+		}
+		else if (value < 0)
+		{
+			nosplitters = true;
+		}
 	}
 
 	if (bestseg == UINT_MAX)
@@ -516,6 +555,11 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 // in the set.
 
 int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
+{
+	return Heuristic (node, set, honorNoSplit, Touched, Colinear);
+}
+
+int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit, TArray<int> &touched, TArray<int> &colinear)
 {
 	// Set the initial score above 0 so that near vertex anti-weighting is less likely to produce a negative score.
 	int score = 1000000;
@@ -530,8 +574,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	unsigned int max, m2, p, q;
 	double frac;
 
-	Touched.Clear ();
-	Colinear.Clear ();
+	touched.Clear ();
+	colinear.Clear ();
 
 	while (i != UINT_MAX)
 	{
@@ -557,32 +601,32 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 			{
 				if ((sidev[0] | sidev[1]) != 0)
 				{
-					max = Touched.Size();
+					max = touched.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Touched[p] == test->loopnum)
+						if (touched[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Touched.Push (test->loopnum);
+						touched.Push (test->loopnum);
 					}
 				}
 				else
 				{
-					max = Colinear.Size();
+					max = colinear.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Colinear[p] == test->loopnum)
+						if (colinear[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Colinear.Push (test->loopnum);
+						colinear.Push (test->loopnum);
 					}
 				}
 			}
@@ -699,8 +743,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	// seg of that sector must be crossing the container's corner and does not
 	// actually split the container.
 
-	max = Touched.Size ();
-	m2 = Colinear.Size ();
+	max = touched.Size ();
+	m2 = colinear.Size ();
 
 	// If honorNoSplit is false, then both these lists will be empty.
 
@@ -713,10 +757,10 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 
 	for (p = 0; p < max; ++p)
 	{
-		int look = Touched[p];
+		int look = touched[p];
 		for (q = 0; q < m2; ++q)
 		{
-			if (look == Colinear[q])
+			if (look == colinear[q])
 			{
 				break;
 			}
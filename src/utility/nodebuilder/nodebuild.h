@@ -42,6 +42,7 @@
 #include "x86.h"
 
 struct FPolySeg;
+class FThreadPool;
 struct FMiniBSP;
 struct FLevelLocals;
 
@@ -229,9 +230,11 @@ public:
 	};
 
 	FNodeBuilder (FLevel &lev);
+	// numThreads is the number of threads used to score splitter candidates.
+	// Zero means one per hardware thread. The resulting tree is the same for any thread count.
 	FNodeBuilder (FLevel &lev,
 		TArray<FPolyStart> &polyspots, TArray<FPolyStart> &anchors,
-		bool makeGLNodes);
+		bool makeGLNodes, int numThreads = 1);
 	~FNodeBuilder ();
 
 	void Extract(FLevelLocals &lev);
@@ -267,6 +270,8 @@ private:
 
 	TArray<int> Touched;	// Loops a splitter touches on a vertex
 	TArray<int> Colinear;	// Loops with edges colinear to a splitter
+	TArray<uint32_t> Candidates;	// Splitter candidates for the current set
+	TArray<int> CandidateScores;	// Heuristic scores for the splitter candidates
 	FEventTree Events;		// Vertices intersected by the current splitter
 
 	TArray<uint32_t> UnsetSegs;			// Segs with no definitive side in current splitter
@@ -280,6 +285,8 @@ private:
 	// Progress meter stuff
 	int SegsStuffed;
 
+	FThreadPool *ThreadPool;
+
 	void FindUsedVertices (vertex_t *vertices, int max);
 	void BuildTree ();
 	void MakeSegsFromSides ();
@@ -301,6 +308,7 @@ private:
 	void SplitSegs (uint32_t set, node_t &node, uint32_t splitseg, uint32_t &outset0, uint32_t &outset1, unsigned int &count0, unsigned int &count1);
 	uint32_t SplitSeg (uint32_t segnum, int splitvert, int v1InFront);
 	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit);
+	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit, TArray<int> &touched, TArray<int> &colinear);
 
 	// Returns:
 	//	0 = seg is in front